@@ -177,6 +177,13 @@
 #define CONF_ARCH_ENDIAN_LITTLE 1
 #endif
 
+/* vector instruction sets available without runtime detection */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONF_SIMD_SSE2 1
+#elif defined(CONF_ARCH_ARM64) && defined(__ARM_NEON)
+#define CONF_SIMD_NEON 1
+#endif
+
 #ifndef CONF_FAMILY_STRING
 #define CONF_FAMILY_STRING "unknown"
 #endif
@@ -39,6 +39,7 @@
 #include <netinet/in.h>
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 
 #include <dirent.h>
@@ -153,6 +154,17 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+typedef struct
+{
+	int size;
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+} NETSOCKET_SEND_QUEUE;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -161,6 +173,9 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+#ifdef CONF_PLATFORM_LINUX
+	NETSOCKET_SEND_QUEUE *send_queue;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -349,6 +364,46 @@ long int io_length(IOHANDLE io)
 	return length;
 }
 
+bool io_map(IOHANDLE io, void **result, unsigned *result_len)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE *)io));
+	LARGE_INTEGER size;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > 0xffffffffLL)
+		return false;
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping)
+		return false;
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(!data)
+		return false;
+	*result = data;
+	*result_len = (unsigned)size.QuadPart;
+	return true;
+#else
+	struct stat sb;
+	int fd = fileno((FILE *)io);
+	if(fd < 0 || fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size <= 0 || (unsigned long long)sb.st_size > 0xffffffffULL)
+		return false;
+	void *data = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED)
+		return false;
+	*result = data;
+	*result_len = (unsigned)sb.st_size;
+	return true;
+#endif
+}
+
+void io_unmap(void *data, unsigned len)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, len);
+#endif
+}
+
 int io_error(IOHANDLE io)
 {
 	return ferror((FILE *)io);
@@ -1405,6 +1460,15 @@ static void priv_net_close_socket(int sock)
 
 static int priv_net_close_all_sockets(NETSOCKET sock)
 {
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_queue)
+	{
+		net_udp_flush(sock);
+		free(sock->send_queue);
+		sock->send_queue = nullptr;
+	}
+#endif
+
 	/* close down ipv4 */
 	if(sock->ipv4sock >= 0)
 	{
@@ -1615,10 +1679,54 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static bool priv_net_udp_queue(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
+{
+	NETSOCKET_SEND_QUEUE *queue = sock->send_queue;
+	int i = queue->size;
+	if(size > PACKETSIZE)
+	{
+		net_udp_flush(sock);
+		return false;
+	}
+	else if(addr->type == NETTYPE_IPV4 && sock->ipv4sock >= 0)
+	{
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)&queue->sockaddrs[i]);
+		queue->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	}
+	else if(addr->type == NETTYPE_IPV6 && sock->ipv6sock >= 0)
+	{
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)&queue->sockaddrs[i]);
+		queue->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+	}
+	else
+	{
+		/* broadcasts and websockets are sent directly, keep the order */
+		net_udp_flush(sock);
+		return false;
+	}
+
+	mem_copy(queue->bufs[i], data, size);
+	queue->iovecs[i].iov_len = size;
+	queue->size++;
+	network_stats.sent_bytes += size;
+	network_stats.sent_packets++;
+
+	if(queue->size == VLEN)
+		net_udp_flush(sock);
+	return true;
+}
+#endif
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_queue && priv_net_udp_queue(sock, addr, data, size))
+		return size;
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -1635,6 +1743,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 
 			d = sendto((int)sock->ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_syscalls++;
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1673,6 +1782,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 
 			d = sendto((int)sock->ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			network_stats.send_syscalls++;
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1698,6 +1808,70 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 	return d;
 }
 
+void net_udp_set_batching(NETSOCKET sock, bool batching)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(batching && !sock->send_queue)
+	{
+		NETSOCKET_SEND_QUEUE *queue = (NETSOCKET_SEND_QUEUE *)malloc(sizeof(*queue));
+		mem_zero(queue, sizeof(*queue));
+		for(int i = 0; i < VLEN; i++)
+		{
+			queue->iovecs[i].iov_base = queue->bufs[i];
+			queue->msgs[i].msg_hdr.msg_iov = &queue->iovecs[i];
+			queue->msgs[i].msg_hdr.msg_iovlen = 1;
+			queue->msgs[i].msg_hdr.msg_name = &queue->sockaddrs[i];
+		}
+		sock->send_queue = queue;
+	}
+	else if(!batching && sock->send_queue)
+	{
+		net_udp_flush(sock);
+		free(sock->send_queue);
+		sock->send_queue = nullptr;
+	}
+#endif
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_QUEUE *queue = sock->send_queue;
+	if(!queue)
+		return 0;
+
+	/* one sendmmsg per run of packets with the same address family */
+	int sent = 0;
+	int start = 0;
+	while(start < queue->size)
+	{
+		const int family = queue->sockaddrs[start].ss_family;
+		int end = start + 1;
+		while(end < queue->size && queue->sockaddrs[end].ss_family == family)
+			end++;
+
+		const int fd = family == AF_INET ? sock->ipv4sock : sock->ipv6sock;
+		while(start < end)
+		{
+			int result = sendmmsg(fd, &queue->msgs[start], end - start, 0);
+			network_stats.send_syscalls++;
+			if(result <= 0)
+			{
+				/* drop the packet that failed, like sendto would */
+				start++;
+				continue;
+			}
+			start += result;
+			sent += result;
+		}
+	}
+	queue->size = 0;
+	return sent;
+#else
+	return 0;
+#endif
+}
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer)
 {
 #if defined(CONF_PLATFORM_LINUX)
@@ -1752,6 +1926,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		{
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv4sock, sock->buffer.msgs, VLEN, 0, NULL);
+			network_stats.recv_syscalls++;
 			sock->buffer.pos = 0;
 		}
 	}
@@ -1762,6 +1937,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		{
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv6sock, sock->buffer.msgs, VLEN, 0, NULL);
+			network_stats.recv_syscalls++;
 			sock->buffer.pos = 0;
 		}
 	}
@@ -1781,6 +1957,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in);
 		bytes = recvfrom(sock->ipv4sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 	}
 
@@ -1788,6 +1965,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 	{
 		socklen_t fromlen = sizeof(struct sockaddr_in6);
 		bytes = recvfrom(sock->ipv6sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
+		network_stats.recv_syscalls++;
 		*data = (unsigned char *)sock->buffer.buf;
 	}
 #endif
@@ -365,6 +365,32 @@ int io_flush(IOHANDLE io);
  */
 int io_sync(IOHANDLE io);
 
+/**
+ * Maps the whole file read-only into memory.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param result Receives a pointer to the mapped file contents.
+ * @param result_len Receives the size of the file.
+ *
+ * @return true on success, false if the file is empty or couldn't be mapped.
+ *
+ * @remark The mapping stays valid after the file is closed, it must be released with @link io_unmap @endlink.
+ * @remark Truncating the file while it is mapped makes accessing the mapping crash.
+ */
+bool io_map(IOHANDLE io, void **result, unsigned *result_len);
+
+/**
+ * Releases a mapping created by @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by io_map.
+ * @param len Size returned by io_map.
+ */
+void io_unmap(void *data, unsigned len);
+
 /**
  * Checks whether an error occurred during I/O with the file.
  *
@@ -970,6 +996,32 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Queues packets sent over an UDP socket instead of sending each of them
+ * with its own system call. Queued packets are sent by @ref net_udp_flush
+ * or once the queue is full. Only Linux supports batching, other
+ * platforms keep sending every packet right away.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param batching Whether to queue packets. Disabling it flushes the queue.
+ *
+ * @remark While batching, @ref net_udp_send can't report send errors.
+ */
+void net_udp_set_batching(NETSOCKET sock, bool batching);
+
+/**
+ * Sends all packets queued on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @return The number of packets sent.
+ */
+int net_udp_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -2022,6 +2074,8 @@ typedef struct
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	uint64_t send_syscalls;
+	uint64_t recv_syscalls;
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
@@ -36,6 +36,8 @@ public:
 	virtual SHA256_DIGEST Sha256() = 0;
 	virtual unsigned Crc() = 0;
 	virtual int MapSize() = 0;
+	virtual const unsigned char *FileData() = 0;
+	virtual unsigned FileSize() = 0;
 	virtual IOHANDLE File() = 0;
 };
 
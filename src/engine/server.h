@@ -314,6 +314,12 @@ public:
 	// DDRace
 
 	virtual void OnPreTickTeehistorian() = 0;
+	// seeds the random number generator like in a recorded game, returns
+	// false if the description is not supported
+	virtual bool RestorePrng(const char *pPrngDescription) = 0;
+	// the rounded character position as recorded by teehistorian, returns
+	// false if the player has no character
+	virtual bool CharacterPos(int ClientID, int *pX, int *pY) const = 0;
 
 	virtual void OnSetAuthed(int ClientID, int Level) = 0;
 	virtual bool PlayerExists(int ClientID) const = 0;
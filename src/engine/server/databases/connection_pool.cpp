@@ -1,6 +1,7 @@
 #include "connection_pool.h"
 #include "connection.h"
 
+#include <base/math.h>
 #include <base/system.h>
 #include <cstring>
 #include <engine/console.h>
@@ -64,6 +65,8 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	// when the query was added to the queue
+	int64_t m_QueuedTime = 0;
 };
 
 CSqlExecData::CSqlExecData(
@@ -117,17 +120,105 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+static void AtomicMax(std::atomic_int &Max, int Value)
+{
+	int Cur = Max.load();
+	while(Cur < Value && !Max.compare_exchange_weak(Cur, Value))
+		;
+}
+
+static void AtomicMax(std::atomic<int64_t> &Max, int64_t Value)
+{
+	int64_t Cur = Max.load();
+	while(Cur < Value && !Max.compare_exchange_weak(Cur, Value))
+		;
+}
+
+void CDbConnectionPool::CQueueCounters::OnQueued()
+{
+	AtomicMax(m_MaxQueued, m_Queued.fetch_add(1) + 1);
+}
+
+void CDbConnectionPool::CQueueCounters::OnStarted(int64_t WaitTime)
+{
+	m_Queued.fetch_sub(1);
+	m_WaitTime.fetch_add(WaitTime);
+	AtomicMax(m_MaxWaitTime, WaitTime);
+}
+
+void CDbConnectionPool::CQueueCounters::OnDone(int64_t ExecTime, bool Success)
+{
+	m_NumQueries.fetch_add(1);
+	if(!Success)
+		m_NumFailed.fetch_add(1);
+	m_ExecTime.fetch_add(ExecTime);
+	AtomicMax(m_MaxExecTime, ExecTime);
+}
+
 CDbConnectionPool::~CDbConnectionPool() = default;
 
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		// the read workers only copy the read databases, print them here
+		{
+			std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+			for(auto &pReadConnection : m_pShared->m_vpReadConnections)
+				if(pReadConnection)
+					pReadConnection->Print(pConsole, "Read");
+			if(m_pShared->m_vpReadConnections.empty())
+				pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+		}
+		PrintStats(pConsole, "Read", DatabaseMode);
+		return;
+	}
+
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::WRITE)
+		PrintStats(pConsole, "Write", DatabaseMode);
+}
+
+void CDbConnectionPool::PrintStats(IConsole *pConsole, const char *pName, Mode DatabaseMode) const
+{
+	CQueueStats Stats;
+	GetStats(DatabaseMode, &Stats);
+	const int64_t NumStarted = maximum(Stats.m_NumQueries, (int64_t)1);
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"%s queue: workers=%d queued=%d (max %d) queries=%lld failed=%lld wait=%.2fms (max %.2fms) exec=%.2fms (max %.2fms)",
+		pName, Stats.m_NumWorkers, Stats.m_Queued, Stats.m_MaxQueued,
+		(long long)Stats.m_NumQueries, (long long)Stats.m_NumFailed,
+		Stats.m_WaitTime * 1000.0 / NumStarted / time_freq(), Stats.m_MaxWaitTime * 1000.0 / time_freq(),
+		Stats.m_ExecTime * 1000.0 / NumStarted / time_freq(), Stats.m_MaxExecTime * 1000.0 / time_freq());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CDbConnectionPool::GetStats(Mode DatabaseMode, CQueueStats *pStats) const
+{
+	const CQueueCounters &Counters = DatabaseMode == Mode::READ ? m_pShared->m_ReadCounters : m_pShared->m_WriteCounters;
+	pStats->m_NumWorkers = DatabaseMode == Mode::READ ? m_pShared->m_NumRunningReadWorkers.load() : 1;
+	pStats->m_Queued = Counters.m_Queued.load();
+	pStats->m_MaxQueued = Counters.m_MaxQueued.load();
+	pStats->m_NumQueries = Counters.m_NumQueries.load();
+	pStats->m_NumFailed = Counters.m_NumFailed.load();
+	pStats->m_WaitTime = Counters.m_WaitTime.load();
+	pStats->m_MaxWaitTime = Counters.m_MaxWaitTime.load();
+	pStats->m_ExecTime = Counters.m_ExecTime.load();
+	pStats->m_MaxExecTime = Counters.m_MaxExecTime.load();
 }
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		auto pSqlite = CreateSqliteConnection(aFileName, true);
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadConnections.push_back(std::move(pSqlite));
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -135,6 +226,13 @@ void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFi
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		auto pMysql = CreateMysqlConnection(*pMysqlConfig);
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadConnections.push_back(std::move(pMysql));
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -145,9 +243,14 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	auto pData = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	pData->m_QueuedTime = time_get();
+	m_pShared->m_ReadCounters.OnQueued();
+	{
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+		m_pShared->m_ReadQueries.push_back(std::move(pData));
+	}
+	m_pShared->m_NumRead.Signal();
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -155,7 +258,10 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	auto pData = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	pData->m_QueuedTime = time_get();
+	m_pShared->m_WriteCounters.OnQueued();
+	m_pShared->m_aQueries[m_InsertIdx++] = std::move(pData);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
 }
@@ -164,8 +270,17 @@ void CDbConnectionPool::OnShutdown()
 {
 	m_pShared->m_Shutdown.store(true);
 	m_pShared->m_NumBackup.Signal();
+	m_pShared->m_ReadShutdown.store(true);
+	{
+		std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+		for(int i = 0; i < m_NumReadWorkers; i++)
+			m_pShared->m_ReadQueries.push_back(nullptr);
+	}
+	for(int i = 0; i < m_NumReadWorkers; i++)
+		m_pShared->m_NumRead.Signal();
+	m_NumReadWorkers = 0;
 	int i = 0;
-	while(m_pShared->m_Shutdown.load())
+	while(m_pShared->m_Shutdown.load() || m_pShared->m_NumRunningReadWorkers.load() > 0)
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -233,8 +348,8 @@ void CBackup::ProcessQueries()
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
+// the worker thread executes write queries on mysql or sqlite. If we write
+// on a mysql server and have a backup server configured, we'll remove the
 // entry from the backup server after completing it on the write server.
 // static void Worker(void *pUser);
 class CWorker
@@ -255,8 +370,7 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	// The READ servers belong to the read workers.
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -273,10 +387,8 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup database
+	// until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
@@ -292,38 +404,15 @@ void CWorker::ProcessQueries()
 			m_pShared->m_Shutdown.store(false);
 			return;
 		}
+		const int64_t StartTime = time_get();
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS)
+			m_pShared->m_WriteCounters.OnStarted(StartTime - pThreadData->m_QueuedTime);
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
+			dbg_assert(false, "read queries are executed by the read workers");
+			break;
 		case CSqlExecData::WRITE_ACCESS:
 		{
 			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
@@ -347,6 +436,7 @@ void CWorker::ProcessQueries()
 				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
 				Success = true;
 			}
+			m_pShared->m_WriteCounters.OnDone(time_get() - StartTime, Success);
 		}
 		break;
 		case CSqlExecData::ADD_MYSQL:
@@ -355,7 +445,7 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_MySql.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
+				dbg_assert(false, "read databases are added to the read workers");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pMysql);
@@ -375,7 +465,7 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
+				dbg_assert(false, "read databases are added to the read workers");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pSqlite);
@@ -406,14 +496,7 @@ void CWorker::ProcessQueries()
 
 void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
-	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
-	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -429,6 +512,102 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read workers execute read queries in parallel to each other and to the
+// write queries. Each of them connects to its own copies of the read
+// databases, so a slow query only blocks one of them.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int WorkerID) :
+		m_pShared(std::move(pShared)), m_WorkerID(WorkerID) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+	int m_WorkerID;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read requests during it
+	// until all requests are handled
+	bool FailMode = false;
+	for(int JobNum = 0;; JobNum++)
+	{
+		if(FailMode && m_pShared->m_NumRead.GetApproximateValue() == 0)
+		{
+			FailMode = false;
+		}
+		m_pShared->m_NumRead.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			std::unique_lock<std::mutex> Lock(m_pShared->m_ReadLock);
+			pThreadData = std::move(m_pShared->m_ReadQueries.front());
+			m_pShared->m_ReadQueries.pop_front();
+			// pick up read databases added since the last query
+			while(m_vpReadConnections.size() < m_pShared->m_vpReadConnections.size())
+			{
+				IDbConnection *pConnection = m_pShared->m_vpReadConnections[m_vpReadConnections.size()].get();
+				m_vpReadConnections.emplace_back(pConnection != nullptr ? pConnection->Copy() : nullptr);
+			}
+		}
+		// OnShutdown sends one nullptr to every read worker
+		if(pThreadData == nullptr)
+		{
+			m_pShared->m_NumRunningReadWorkers.fetch_sub(1);
+			return;
+		}
+		const int64_t StartTime = time_get();
+		m_pShared->m_ReadCounters.OnStarted(StartTime - pThreadData->m_QueuedTime);
+		bool Success = false;
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_ReadShutdown)
+			{
+				dbg_msg("sql", "[r%d:%i] %s dismissed read request during shutdown", m_WorkerID, JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(FailMode)
+			{
+				dbg_msg("sql", "[r%d:%i] %s dismissed read request during FailMode", m_WorkerID, JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				dbg_msg("sql", "[r%d:%i] %s done on read database %d", m_WorkerID, JobNum, pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			FailMode = true;
+			dbg_msg("sql", "[r%d:%i] %s failed on all databases", m_WorkerID, JobNum, pThreadData->m_pName);
+		}
+		m_pShared->m_ReadCounters.OnDone(time_get() - StartTime, Success);
+		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		{
+			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
+	}
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -469,4 +648,16 @@ CDbConnectionPool::CDbConnectionPool()
 
 	thread_init_and_detach(CWorker::Start, new CWorker(m_pShared), "database worker thread");
 	thread_init_and_detach(CBackup::Start, new CBackup(m_pShared), "database backup worker thread");
+	SetNumReadWorkers(1);
+}
+
+void CDbConnectionPool::SetNumReadWorkers(int NumWorkers)
+{
+	while(m_NumReadWorkers < NumWorkers)
+	{
+		// counted here, so OnShutdown waits for workers that didn't start yet
+		m_pShared->m_NumRunningReadWorkers.fetch_add(1);
+		thread_init_and_detach(CReadWorker::Start, new CReadWorker(m_pShared, m_NumReadWorkers), "database read worker thread");
+		m_NumReadWorkers++;
+	}
 }
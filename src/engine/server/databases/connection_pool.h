@@ -3,7 +3,9 @@
 
 #include <atomic>
 #include <base/tl/threading.h>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 class IDbConnection;
@@ -76,7 +78,31 @@ public:
 		NUM_MODES,
 	};
 
+	// queue depth and latency of the read or write queries, times are in
+	// `time_get` units
+	struct CQueueStats
+	{
+		int m_NumWorkers;
+		int m_Queued;
+		int m_MaxQueued;
+		int64_t m_NumQueries;
+		int64_t m_NumFailed;
+		// time from adding the query until a worker picked it up
+		int64_t m_WaitTime;
+		int64_t m_MaxWaitTime;
+		// time the worker spent executing the query
+		int64_t m_ExecTime;
+		int64_t m_MaxExecTime;
+	};
+
 	void Print(IConsole *pConsole, Mode DatabaseMode);
+	// WRITE_BACKUP has no separate queue, it is part of WRITE
+	void GetStats(Mode DatabaseMode, CQueueStats *pStats) const;
+
+	// starts read workers until there are `NumWorkers`, each of them has its
+	// own connections to the read databases. Workers are never stopped
+	// before `OnShutdown`.
+	void SetNumReadWorkers(int NumWorkers);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
@@ -95,15 +121,36 @@ public:
 	void OnShutdown();
 
 	friend class CWorker;
+	friend class CReadWorker;
 	friend class CBackup;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
+	void PrintStats(IConsole *pConsole, const char *pName, Mode DatabaseMode) const;
+
+	int m_NumReadWorkers = 0;
 
 	// Only the main thread accesses this variable. It points to the index,
 	// where the next query is added to the queue.
 	int m_InsertIdx = 0;
 
+	// collected by the workers, read by the main thread
+	struct CQueueCounters
+	{
+		std::atomic_int m_Queued{0};
+		std::atomic_int m_MaxQueued{0};
+		std::atomic<int64_t> m_NumQueries{0};
+		std::atomic<int64_t> m_NumFailed{0};
+		std::atomic<int64_t> m_WaitTime{0};
+		std::atomic<int64_t> m_MaxWaitTime{0};
+		std::atomic<int64_t> m_ExecTime{0};
+		std::atomic<int64_t> m_MaxExecTime{0};
+
+		void OnQueued();
+		void OnStarted(int64_t WaitTime);
+		void OnDone(int64_t ExecTime, bool Success);
+	};
+
 	struct CSharedData
 	{
 		// Used as signal that shutdown is in progress from main thread to
@@ -120,7 +167,26 @@ private:
 		CSemaphore m_NumWorker;
 
 		// spsc queue with additional backup worker to look at queries first.
+		// Only write queries and the configuration of the write databases
+		// go through it, so they are executed in order.
 		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+
+		// Read queries don't depend on each other and are executed by
+		// multiple read workers in parallel. nullptr tells a read worker to
+		// exit.
+		std::mutex m_ReadLock;
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_ReadQueries;
+		CSemaphore m_NumRead;
+		// The read databases, each read worker connects to its own copy of
+		// them. Entries are only appended. Protected by m_ReadLock.
+		std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+		// Set from the main thread on shutdown, read workers dismiss all
+		// remaining read queries afterwards and exit.
+		std::atomic_bool m_ReadShutdown{false};
+		std::atomic_int m_NumRunningReadWorkers{0};
+
+		CQueueCounters m_ReadCounters;
+		CQueueCounters m_WriteCounters;
 	};
 
 	std::shared_ptr<CSharedData> m_pShared;
@@ -137,8 +137,9 @@ bool CSqliteConnection::Connect(char *pError, int ErrorSize)
 		return true;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for the read workers and the write worker to unlock the database
+	// instead of failing with SQLITE_BUSY, a negative timeout would not wait
+	sqlite3_busy_timeout(m_pDb, 60 * 1000);
 
 	if(m_Setup)
 	{
@@ -0,0 +1,75 @@
+#include "input_ring.h"
+
+void CInputRing::Reset()
+{
+	for(auto &Input : m_aInputs)
+	{
+		Input.m_GameTick = -1;
+		Input.m_NextInput = -1;
+	}
+	m_CurrentInput = 0;
+	for(auto &InputTick : m_aInputTicks)
+		InputTick.m_Tick = -1;
+	m_NumDropped = 0;
+}
+
+CInputRing::CInput *CInputRing::Add(int GameTick, int CurrentTick)
+{
+	static_assert((NUM_TICKS & (NUM_TICKS - 1)) == 0, "NUM_TICKS must be a power of two");
+
+	// a tick NUM_TICKS ahead shares its slot with a tick that still gets
+	// simulated, so it would take over or get mixed into its inputs
+	if(!InWindow(GameTick, CurrentTick))
+	{
+		m_NumDropped++;
+		return nullptr;
+	}
+
+	// the overwritten input is the oldest one, so it is the first of its
+	// tick unless a later tick took the slot of its tick
+	CInput *pInput = &m_aInputs[m_CurrentInput];
+	if(pInput->m_GameTick >= 0)
+	{
+		CInputTick &OldTick = m_aInputTicks[pInput->m_GameTick & (NUM_TICKS - 1)];
+		if(OldTick.m_Tick == pInput->m_GameTick && OldTick.m_FirstInput == m_CurrentInput)
+		{
+			OldTick.m_FirstInput = pInput->m_NextInput;
+			if(OldTick.m_FirstInput == -1)
+				OldTick.m_Tick = -1;
+		}
+	}
+
+	pInput->m_GameTick = GameTick;
+	pInput->m_NextInput = -1;
+	// inside the window the slot holds this tick or one that was simulated
+	CInputTick &InputTick = m_aInputTicks[GameTick & (NUM_TICKS - 1)];
+	if(InputTick.m_Tick == GameTick)
+	{
+		m_aInputs[InputTick.m_LastInput].m_NextInput = m_CurrentInput;
+		InputTick.m_LastInput = m_CurrentInput;
+	}
+	else
+	{
+		InputTick.m_Tick = GameTick;
+		InputTick.m_FirstInput = m_CurrentInput;
+		InputTick.m_LastInput = m_CurrentInput;
+	}
+
+	m_CurrentInput = (m_CurrentInput + 1) % MAX_INPUTS;
+	return pInput;
+}
+
+CInputRing::CInput *CInputRing::First(int Tick)
+{
+	const CInputTick &InputTick = m_aInputTicks[Tick & (NUM_TICKS - 1)];
+	if(Tick < 0 || InputTick.m_Tick != Tick)
+		return nullptr;
+	return &m_aInputs[InputTick.m_FirstInput];
+}
+
+CInputRing::CInput *CInputRing::Next(const CInput *pInput)
+{
+	if(pInput->m_NextInput == -1)
+		return nullptr;
+	return &m_aInputs[pInput->m_NextInput];
+}
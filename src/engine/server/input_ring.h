@@ -0,0 +1,60 @@
+#ifndef ENGINE_SERVER_INPUT_RING_H
+#define ENGINE_SERVER_INPUT_RING_H
+
+#include <engine/shared/protocol.h>
+
+// The last inputs of a client in the order they arrived, linked into lists
+// per tick so that the inputs for a tick are found without a search.
+class CInputRing
+{
+public:
+	enum
+	{
+		MAX_INPUTS = 200,
+		// must be a power of two
+		NUM_TICKS = 256,
+	};
+
+	class CInput
+	{
+	public:
+		int m_aData[MAX_INPUT_SIZE];
+		int m_GameTick; // the tick that was chosen for the input
+		int m_NextInput; // index of the next input for the same tick or -1
+	};
+
+private:
+	// the inputs for one tick in the order they arrived
+	class CInputTick
+	{
+	public:
+		int m_Tick;
+		int m_FirstInput;
+		int m_LastInput;
+	};
+
+	// the oldest input is overwritten first
+	CInput m_aInputs[MAX_INPUTS];
+	int m_CurrentInput;
+	// indexed by tick modulo NUM_TICKS
+	CInputTick m_aInputTicks[NUM_TICKS];
+	int m_NumDropped;
+
+public:
+	CInputRing() { Reset(); }
+
+	void Reset();
+
+	// returns the input to fill in, or nullptr if the tick was already
+	// simulated or is so far ahead that its slot belongs to a live tick
+	CInput *Add(int GameTick, int CurrentTick);
+	CInput *First(int Tick);
+	CInput *Next(const CInput *pInput);
+
+	// inputs rejected by Add
+	int NumDropped() const { return m_NumDropped; }
+	// true if Add accepts inputs for the tick
+	static bool InWindow(int GameTick, int CurrentTick) { return GameTick > CurrentTick && GameTick - CurrentTick < NUM_TICKS; }
+};
+
+#endif // ENGINE_SERVER_INPUT_RING_H
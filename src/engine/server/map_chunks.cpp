@@ -0,0 +1,52 @@
+#include "map_chunks.h"
+
+#include <base/math.h>
+#include <engine/message.h>
+#include <engine/shared/protocol.h>
+
+void CMapChunks::Build(const unsigned char *pMap, unsigned MapSize, unsigned MapCrc, bool Sixup)
+{
+	Clear();
+
+	const int NumChunks = MapSize / CHUNK_SIZE + 1;
+	m_vData.reserve(MapSize + NumChunks * 16);
+	m_vOffsets.reserve(NumChunks + 1);
+
+	for(int Chunk = 0; Chunk < NumChunks; Chunk++)
+	{
+		const unsigned Offset = Chunk * CHUNK_SIZE;
+		const int ChunkSize = MapBytes(MapSize, Chunk);
+		const int Last = Offset + CHUNK_SIZE >= MapSize;
+
+		CMsgPacker Msg(NETMSG_MAP_DATA, true);
+		if(!Sixup)
+		{
+			Msg.AddInt(Last);
+			Msg.AddInt(MapCrc);
+			Msg.AddInt(Chunk);
+			Msg.AddInt(ChunkSize);
+		}
+		Msg.AddRaw(pMap + Offset, ChunkSize);
+
+		// the id of this system message is the same in 0.6 and 0.7, so
+		// this is what RepackMsg in the server would produce
+		CPacker Pack;
+		Pack.Reset();
+		Pack.AddInt((NETMSG_MAP_DATA << 1) | 1);
+		Pack.AddRaw(Msg.Data(), Msg.Size());
+		m_vOffsets.push_back(m_vData.size());
+		m_vData.insert(m_vData.end(), Pack.Data(), Pack.Data() + Pack.Size());
+	}
+	m_vOffsets.push_back(m_vData.size());
+}
+
+void CMapChunks::Clear()
+{
+	m_vData.clear();
+	m_vOffsets.clear();
+}
+
+int CMapChunks::MapBytes(unsigned MapSize, int Chunk)
+{
+	return minimum<unsigned>(CHUNK_SIZE, MapSize - Chunk * CHUNK_SIZE);
+}
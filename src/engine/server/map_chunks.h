@@ -0,0 +1,33 @@
+#ifndef ENGINE_SERVER_MAP_CHUNKS_H
+#define ENGINE_SERVER_MAP_CHUNKS_H
+
+#include <vector>
+
+// The packed NETMSG_MAP_DATA messages for every chunk of a map, built once
+// when the map is loaded so that sending a chunk only copies bytes.
+class CMapChunks
+{
+	std::vector<unsigned char> m_vData;
+	// chunk i is at [m_vOffsets[i], m_vOffsets[i + 1])
+	std::vector<int> m_vOffsets;
+
+public:
+	enum
+	{
+		CHUNK_SIZE = 1024 - 128,
+	};
+
+	// every chunk reaching the end of the map is marked as last, which
+	// includes an empty one if the size is a multiple of the chunk size
+	void Build(const unsigned char *pMap, unsigned MapSize, unsigned MapCrc, bool Sixup);
+	void Clear();
+
+	int Num() const { return m_vOffsets.empty() ? 0 : (int)m_vOffsets.size() - 1; }
+	const unsigned char *Data(int Chunk) const { return m_vData.data() + m_vOffsets[Chunk]; }
+	int Size(int Chunk) const { return m_vOffsets[Chunk + 1] - m_vOffsets[Chunk]; }
+
+	// the number of map bytes in a chunk
+	static int MapBytes(unsigned MapSize, int Chunk);
+};
+
+#endif // ENGINE_SERVER_MAP_CHUNKS_H
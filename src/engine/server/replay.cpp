@@ -0,0 +1,553 @@
+#include "replay.h"
+
+#include "server.h"
+
+#include "databases/connection_pool.h"
+
+#include <base/system.h>
+
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/storage.h>
+
+extern bool IsInterrupted();
+
+#define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
+#include <engine/shared/teehistorian_ex_chunks.h>
+#undef UUID
+
+enum
+{
+	// mismatches that are printed in detail, the rest is only counted
+	MAX_REPORTED_MISMATCHES = 20,
+};
+
+// the type of an argument in the parameter description of a console command
+static char ParamType(const char *pParams, int Index)
+{
+	for(int i = 0; *pParams; pParams++)
+	{
+		if(*pParams == '?' || *pParams == ' ')
+			continue;
+		if(*pParams == '[')
+		{
+			// skip the description of the parameter
+			pParams = str_find(pParams, "]");
+			if(!pParams)
+				return 0;
+			continue;
+		}
+		if(i++ == Index)
+			return *pParams;
+	}
+	return 0;
+}
+
+static const char *JsonString(const json_value *pObject, const char *pName)
+{
+	const json_value *pValue = json_object_get(pObject, pName);
+	return pValue->type == json_string ? json_string_get(pValue) : "";
+}
+
+static int ConsoleAccessLevel(int Authed)
+{
+	switch(Authed)
+	{
+	case AUTHED_ADMIN: return IConsole::ACCESS_LEVEL_ADMIN;
+	case AUTHED_MOD: return IConsole::ACCESS_LEVEL_MOD;
+	case AUTHED_HELPER: return IConsole::ACCESS_LEVEL_HELPER;
+	default: return IConsole::ACCESS_LEVEL_USER;
+	}
+}
+
+CServerReplay::CServerReplay(CServer *pServer) :
+	m_pServer(pServer)
+{
+	m_aMapName[0] = '\0';
+	m_aMapSha256[0] = '\0';
+	m_aPrngDescription[0] = '\0';
+	m_SkipCommands = 0;
+}
+
+CConfig *CServerReplay::Config() { return m_pServer->Config(); }
+IConsole *CServerReplay::Console() { return m_pServer->Console(); }
+IGameServer *CServerReplay::GameServer() { return m_pServer->GameServer(); }
+
+bool CServerReplay::Load(const char *pFilename)
+{
+	void *pFile;
+	unsigned FileSize;
+	if(!m_pServer->Storage()->ReadFile(pFilename, IStorage::TYPE_ALL_OR_ABSOLUTE, &pFile, &FileSize))
+	{
+		dbg_msg("replay", "failed to read '%s'", pFilename);
+		return false;
+	}
+
+	CTeeHistorianReader::CHeader Header;
+	if(!CTeeHistorianReader::ParseHeader(pFile, FileSize, &Header))
+	{
+		dbg_msg("replay", "'%s' is not a supported teehistorian file", pFilename);
+		free(pFile);
+		return false;
+	}
+
+	const char *pJson = (const char *)pFile + sizeof(CUuid);
+	json_value *pRoot = json_parse(pJson, str_length(pJson));
+	if(!pRoot)
+	{
+		dbg_msg("replay", "failed to parse the header of '%s'", pFilename);
+		free(pFile);
+		return false;
+	}
+
+	str_copy(m_aMapName, JsonString(pRoot, "map_name"));
+	str_copy(m_aMapSha256, JsonString(pRoot, "map_sha256"));
+	str_copy(m_aPrngDescription, JsonString(pRoot, "prng_description"));
+
+	// the recorded config only contains values that differ from the default
+	const json_value *pConfig = json_object_get(pRoot, "config");
+	if(pConfig->type == json_object)
+	{
+		for(unsigned i = 0; i < pConfig->u.object.length; i++)
+		{
+			const json_value *pValue = pConfig->u.object.values[i].value;
+			if(pValue->type != json_string)
+				continue;
+			char aValue[512];
+			char *pDst = aValue;
+			str_escape(&pDst, json_string_get(pValue), aValue + sizeof(aValue));
+			char aLine[1024];
+			str_format(aLine, sizeof(aLine), "%s \"%s\"", pConfig->u.object.values[i].name, aValue);
+			Console()->ExecuteLine(aLine);
+		}
+	}
+	// the tuning commands belong to the game and can only be applied after
+	// it is initialized
+	const json_value *pTuning = json_object_get(pRoot, "tuning");
+	if(pTuning->type == json_object)
+	{
+		for(unsigned i = 0; i < pTuning->u.object.length; i++)
+		{
+			const json_value *pValue = pTuning->u.object.values[i].value;
+			if(pValue->type == json_string)
+				m_vTuning.emplace_back(pTuning->u.object.values[i].name, str_toint(json_string_get(pValue)));
+		}
+	}
+	json_value_free(pRoot);
+
+	const unsigned char *pBody = (const unsigned char *)pFile + Header.m_Size;
+	const int BodySize = FileSize - Header.m_Size;
+	bool Result = true;
+	if(Header.m_Compressed)
+		Result = CTeeHistorianReader::Decompress(pBody, BodySize, &m_vData);
+	else
+		m_vData.assign(pBody, pBody + BodySize);
+	free(pFile);
+	if(!Result)
+	{
+		dbg_msg("replay", "failed to decompress '%s'", pFilename);
+		return false;
+	}
+
+	str_copy(Config()->m_SvMap, m_aMapName);
+	ScanVersions();
+	return true;
+}
+
+void CServerReplay::ScanVersions()
+{
+	// the game records the version sent by a client only when it enters,
+	// but the engine knows it from the start
+	CTeeHistorianReader Reader;
+	Reader.SetData(m_vData.data(), m_vData.size());
+	CTeeHistorianReader::CRecord Record;
+	while(Reader.Next(&Record))
+	{
+		if(Record.m_Type == CTeeHistorianReader::RECORD_JOIN)
+		{
+			CDDNetVersion Version;
+			Version.m_Version = -1;
+			m_avVersions[Record.m_ClientID].push_back(Version);
+		}
+		else if(Record.m_Type == CTeeHistorianReader::RECORD_EX && Record.m_Uuid == UUID_TEEHISTORIAN_DDNETVER)
+		{
+			CUnpacker Unpacker;
+			Unpacker.Reset(Record.m_pData, Record.m_DataSize);
+			const int ClientID = Unpacker.GetInt();
+			const CUuid *pConnectionID = (const CUuid *)Unpacker.GetRaw(sizeof(CUuid));
+			const int DDNetVersion = Unpacker.GetInt();
+			const char *pVersion = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+			if(Unpacker.Error() || ClientID < 0 || ClientID >= MAX_CLIENTS || m_avVersions[ClientID].empty())
+				continue;
+			CDDNetVersion &Version = m_avVersions[ClientID].back();
+			Version.m_Version = DDNetVersion;
+			Version.m_ConnectionID = *pConnectionID;
+			str_copy(Version.m_aVersion, pVersion);
+		}
+	}
+}
+
+bool CServerReplay::Run(bool Snapshots, CStats *pStats)
+{
+	mem_zero(pStats, sizeof(*pStats));
+	pStats->m_FirstMismatchTick = -1;
+
+	// nothing of the replay may end up in the files or databases of the
+	// recorded server
+	Config()->m_SvTeeHistorian = 0;
+	Config()->m_SvUseSQL = 0;
+	Config()->m_SvSqliteFile[0] = '\0';
+
+	CServer *pServer = m_pServer;
+	pServer->m_RunServer = CServer::RUNNING;
+	pServer->m_Replaying = true;
+	pServer->m_AuthManager.Init();
+	{
+		int Size = GameServer()->PersistentClientDataSize();
+		for(auto &Client : pServer->m_aClients)
+		{
+			Client.m_HasPersistentData = false;
+			Client.m_pPersistentData = malloc(Size);
+		}
+	}
+
+	if(!pServer->LoadMap(Config()->m_SvMap))
+	{
+		dbg_msg("replay", "failed to load map. mapname='%s'", Config()->m_SvMap);
+		return false;
+	}
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(pServer->m_aCurrentMapSha256[CServer::MAP_TYPE_SIX], aSha256, sizeof(aSha256));
+	if(str_comp(aSha256, m_aMapSha256) != 0)
+	{
+		dbg_msg("replay", "map differs from the recorded one. recorded_sha256=%s sha256=%s", m_aMapSha256, aSha256);
+	}
+
+	pServer->Antibot()->Init();
+	GameServer()->OnInit();
+	if(pServer->ErrorShutdown())
+	{
+		dbg_msg("replay", "game failed to start (%s)", pServer->m_aErrorShutdownReason);
+		return false;
+	}
+	if(!GameServer()->RestorePrng(m_aPrngDescription))
+	{
+		dbg_msg("replay", "can't restore the random number generator '%s'", m_aPrngDescription);
+	}
+	for(const auto &Tune : m_vTuning)
+	{
+		// the recorded values are truncated, aim for the middle of the range
+		// that truncates to them
+		char aLine[256];
+		str_format(aLine, sizeof(aLine), "tune %s %f", Tune.first.c_str(), (Tune.second + (Tune.second < 0 ? -0.5f : 0.5f)) / 100.0f);
+		Console()->ExecuteLine(aLine);
+	}
+	Console()->SetTeeHistorianCommandCallback(CommandCallback, this);
+	pServer->m_GameStartTime = time_get();
+
+	for(auto &Position : m_aPositions)
+		Position.m_Alive = false;
+	for(auto &NumJoins : m_aNumJoins)
+		NumJoins = 0;
+	for(auto &Sixup : m_aSixup)
+		Sixup = false;
+
+	m_Reader.Reset();
+	m_Reader.SetData(m_vData.data(), m_vData.size());
+
+	const int64_t StartTime = time_get();
+	bool Verified = true;
+	CTeeHistorianReader::CRecord Record;
+	while(!pServer->ErrorShutdown() && !IsInterrupted() && m_Reader.Next(&Record))
+	{
+		pStats->m_Records++;
+		switch(Record.m_Type)
+		{
+		case CTeeHistorianReader::RECORD_TICK:
+			// the positions of the last tick are recorded completely now
+			if(!Verified)
+				Verify(pServer->Tick(), pStats);
+			m_GeneratedCommands.clear();
+			while(pServer->Tick() < Record.m_Tick && !pServer->ErrorShutdown())
+			{
+				// skipped ticks have no records, the positions didn't change
+				if(!Verified)
+					Verify(pServer->Tick(), pStats);
+				Tick(Snapshots);
+				pStats->m_Ticks++;
+				Verified = false;
+			}
+			break;
+		case CTeeHistorianReader::RECORD_FINISH:
+			break;
+		case CTeeHistorianReader::RECORD_INPUT_NEW:
+		case CTeeHistorianReader::RECORD_INPUT_DIFF:
+			m_avInputs[Record.m_ClientID].push_back(m_Reader.Player(Record.m_ClientID).m_Input);
+			break;
+		case CTeeHistorianReader::RECORD_MESSAGE:
+			OnMessage(Record.m_ClientID, Record.m_pData, Record.m_DataSize);
+			break;
+		case CTeeHistorianReader::RECORD_JOIN:
+			OnJoin(Record.m_ClientID);
+			break;
+		case CTeeHistorianReader::RECORD_DROP:
+			OnDrop(Record.m_ClientID, Record.m_pString);
+			break;
+		case CTeeHistorianReader::RECORD_CONSOLE_COMMAND:
+			OnConsoleCommand(&Record);
+			break;
+		case CTeeHistorianReader::RECORD_EX:
+			OnEx(&Record);
+			break;
+		}
+	}
+	if(!Verified)
+		Verify(pServer->Tick(), pStats);
+	pStats->m_GameTime = time_get() - StartTime;
+
+	const bool Error = m_Reader.Error();
+	if(Error)
+		dbg_msg("replay", "failed to decode the recording after tick %d", m_Reader.Tick());
+	else if(!m_Reader.Finished() && !IsInterrupted())
+		dbg_msg("replay", "recording ends without finishing the game, the server probably crashed");
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pServer->m_aClients[i].m_State != CServer::CClient::STATE_EMPTY)
+			pServer->DropClient(i, "Server shutdown");
+	}
+	GameServer()->OnShutdown();
+	pServer->m_pMap->Unload();
+	pServer->DbPool()->OnShutdown();
+
+	return !Error && !pServer->ErrorShutdown();
+}
+
+void CServerReplay::CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
+{
+	CServerReplay *pSelf = (CServerReplay *)pUser;
+	if(pSelf->m_SkipCommands > 0)
+		pSelf->m_SkipCommands--;
+	else
+		pSelf->m_GeneratedCommands.emplace_back(pCmd);
+}
+
+void CServerReplay::Tick(bool Snapshots)
+{
+	CServer *pServer = m_pServer;
+
+	// the inputs are recorded right before the tick, after everything else
+	// the server received
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(pServer->m_aClients[c].m_State != CServer::CClient::STATE_INGAME)
+			continue;
+		if(m_avInputs[c].empty())
+			GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+		for(auto &Input : m_avInputs[c])
+			GameServer()->OnClientPredictedEarlyInput(c, &Input);
+	}
+
+	pServer->m_CurrentGameTick++;
+
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(pServer->m_aClients[c].m_State != CServer::CClient::STATE_INGAME)
+			continue;
+		GameServer()->OnClientPredictedInput(c, m_avInputs[c].empty() ? nullptr : &m_avInputs[c][0]);
+	}
+	for(auto &vInputs : m_avInputs)
+		vInputs.clear();
+
+	GameServer()->OnTick();
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		m_aPositions[i].m_Alive = GameServer()->CharacterPos(i, &m_aPositions[i].m_X, &m_aPositions[i].m_Y);
+
+	if(Snapshots && (Config()->m_SvHighBandwidth || (pServer->Tick() % 2) == 0))
+		pServer->DoSnapshot();
+	pServer->Antibot()->OnEngineTick();
+}
+
+void CServerReplay::Verify(int Tick, CStats *pStats)
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CTeeHistorianReader::CPlayer &Recorded = m_Reader.Player(i);
+		const CPosition &Replayed = m_aPositions[i];
+		if(!Recorded.m_Alive && !Replayed.m_Alive)
+			continue;
+		pStats->m_Positions++;
+		if(Recorded.m_Alive == Replayed.m_Alive && (!Recorded.m_Alive || (Recorded.m_X == Replayed.m_X && Recorded.m_Y == Replayed.m_Y)))
+			continue;
+
+		if(pStats->m_Mismatches == 0)
+			pStats->m_FirstMismatchTick = Tick;
+		if(pStats->m_Mismatches < MAX_REPORTED_MISMATCHES)
+		{
+			char aRecorded[64];
+			char aReplayed[64];
+			if(Recorded.m_Alive)
+				str_format(aRecorded, sizeof(aRecorded), "(%d, %d)", Recorded.m_X, Recorded.m_Y);
+			else
+				str_copy(aRecorded, "dead");
+			if(Replayed.m_Alive)
+				str_format(aReplayed, sizeof(aReplayed), "(%d, %d)", Replayed.m_X, Replayed.m_Y);
+			else
+				str_copy(aReplayed, "dead");
+			dbg_msg("replay", "position mismatch. tick=%d cid=%d recorded=%s replayed=%s", Tick, i, aRecorded, aReplayed);
+		}
+		pStats->m_Mismatches++;
+	}
+}
+
+void CServerReplay::OnJoin(int ClientID)
+{
+	CServer *pServer = m_pServer;
+	if(pServer->m_aClients[ClientID].m_State != CServer::CClient::STATE_EMPTY)
+		pServer->DropClient(ClientID, "replaced by a new client");
+
+	CServer::NewClientCallback(ClientID, pServer, m_aSixup[ClientID]);
+	m_aSixup[ClientID] = false;
+
+	CServer::CClient &Client = pServer->m_aClients[ClientID];
+	Client.m_State = CServer::CClient::STATE_CONNECTING;
+	const int Join = m_aNumJoins[ClientID]++;
+	if(Join < (int)m_avVersions[ClientID].size() && m_avVersions[ClientID][Join].m_Version >= 0)
+	{
+		const CDDNetVersion &Version = m_avVersions[ClientID][Join];
+		Client.m_ConnectionID = Version.m_ConnectionID;
+		Client.m_DDNetVersion = Version.m_Version;
+		str_copy(Client.m_aDDNetVersionStr, Version.m_aVersion);
+		Client.m_DDNetVersionSettled = true;
+		Client.m_GotDDNetVersionPacket = true;
+	}
+}
+
+void CServerReplay::OnDrop(int ClientID, const char *pReason)
+{
+	// kicks by the game already dropped the client
+	if(m_pServer->m_aClients[ClientID].m_State != CServer::CClient::STATE_EMPTY)
+		m_pServer->DropClient(ClientID, pReason);
+}
+
+void CServerReplay::Connect(int ClientID)
+{
+	// the engine messages that make a client ready aren't recorded, only the
+	// game messages after it
+	CServer::CClient &Client = m_pServer->m_aClients[ClientID];
+	if(Client.m_State == CServer::CClient::STATE_EMPTY || Client.m_State >= CServer::CClient::STATE_READY)
+		return;
+	Client.m_State = CServer::CClient::STATE_READY;
+	GameServer()->OnClientConnected(ClientID, nullptr);
+}
+
+void CServerReplay::OnMessage(int ClientID, const void *pData, int DataSize)
+{
+	Connect(ClientID);
+	if(m_pServer->m_aClients[ClientID].m_State < CServer::CClient::STATE_READY)
+		return;
+
+	CUnpacker Unpacker;
+	Unpacker.Reset(pData, DataSize);
+	CMsgPacker Packer(NETMSG_EX, true);
+	int Msg;
+	bool Sys;
+	CUuid Uuid;
+	if(UnpackMessageID(&Msg, &Sys, &Uuid, &Unpacker, &Packer) == UNPACKMESSAGE_ERROR || Sys)
+		return;
+	GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+}
+
+void CServerReplay::OnConsoleCommand(const CTeeHistorianReader::CRecord *pRecord)
+{
+	// commands the game executed itself, like chat commands and votes
+	if(!m_GeneratedCommands.empty() && m_GeneratedCommands.front() == pRecord->m_pString)
+	{
+		m_GeneratedCommands.pop_front();
+		return;
+	}
+
+	const IConsole::CCommandInfo *pInfo = Console()->GetCommandInfo(pRecord->m_pString, pRecord->m_FlagMask, false);
+	std::string Line = pRecord->m_pString;
+	for(int i = 0; i < (int)pRecord->m_vpArgs.size(); i++)
+	{
+		Line += ' ';
+		if(pInfo && ParamType(pInfo->m_pParams, i) == 'r')
+		{
+			Line += pRecord->m_vpArgs[i];
+			continue;
+		}
+		char aArg[512];
+		char *pDst = aArg;
+		str_escape(&pDst, pRecord->m_vpArgs[i], aArg + sizeof(aArg));
+		Line += '"';
+		Line += aArg;
+		Line += '"';
+	}
+
+	// executed with the rights the client had, like rcon commands
+	CServer *pServer = m_pServer;
+	const int ClientID = pRecord->m_ClientID;
+	if(ClientID >= 0 && ClientID < MAX_CLIENTS)
+	{
+		pServer->m_RconClientID = ClientID;
+		pServer->m_RconAuthLevel = pServer->m_aClients[ClientID].m_Authed;
+		Console()->SetAccessLevel(ConsoleAccessLevel(pServer->m_aClients[ClientID].m_Authed));
+	}
+	m_SkipCommands = 1;
+	Console()->ExecuteLineFlag(Line.c_str(), pRecord->m_FlagMask, ClientID, false);
+	m_SkipCommands = 0;
+	Console()->SetAccessLevel(IConsole::ACCESS_LEVEL_ADMIN);
+	pServer->m_RconClientID = IServer::RCON_CID_SERV;
+	pServer->m_RconAuthLevel = AUTHED_ADMIN;
+}
+
+void CServerReplay::OnEx(const CTeeHistorianReader::CRecord *pRecord)
+{
+	CServer *pServer = m_pServer;
+	CUnpacker Unpacker;
+	Unpacker.Reset(pRecord->m_pData, pRecord->m_DataSize);
+	const int ClientID = Unpacker.GetInt();
+	if(Unpacker.Error() || ClientID < 0 || ClientID >= MAX_CLIENTS)
+		return;
+
+	if(pRecord->m_Uuid == UUID_TEEHISTORIAN_JOINVER6 || pRecord->m_Uuid == UUID_TEEHISTORIAN_JOINVER7)
+	{
+		// written right before the join
+		m_aSixup[ClientID] = pRecord->m_Uuid == UUID_TEEHISTORIAN_JOINVER7;
+	}
+	else if(pRecord->m_Uuid == UUID_TEEHISTORIAN_PLAYER_READY)
+	{
+		Connect(ClientID);
+		CServer::CClient &Client = pServer->m_aClients[ClientID];
+		if(Client.m_State != CServer::CClient::STATE_READY)
+			return;
+		Client.m_State = CServer::CClient::STATE_INGAME;
+		// there are no acks, send full snapshots right away
+		Client.m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+		GameServer()->OnClientEnter(ClientID);
+	}
+	else if(pRecord->m_Uuid == UUID_TEEHISTORIAN_AUTH_INIT || pRecord->m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGIN)
+	{
+		const int Level = Unpacker.GetInt();
+		const char *pName = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+		if(Unpacker.Error())
+			return;
+		// the game may look up the name of the key, the password is unknown
+		int Key = pServer->m_AuthManager.FindKey(pName);
+		if(Key < 0)
+			Key = pServer->m_AuthManager.AddKey(pName, "", Level);
+		pServer->m_aClients[ClientID].m_Authed = Level;
+		pServer->m_aClients[ClientID].m_AuthKey = Key;
+		if(pRecord->m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGIN)
+			GameServer()->OnSetAuthed(ClientID, Level);
+	}
+	else if(pRecord->m_Uuid == UUID_TEEHISTORIAN_AUTH_LOGOUT)
+	{
+		pServer->m_aClients[ClientID].m_Authed = AUTHED_NO;
+		pServer->m_aClients[ClientID].m_AuthKey = -1;
+		GameServer()->OnSetAuthed(ClientID, AUTHED_NO);
+	}
+}
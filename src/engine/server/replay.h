@@ -0,0 +1,107 @@
+#ifndef ENGINE_SERVER_REPLAY_H
+#define ENGINE_SERVER_REPLAY_H
+
+#include <base/hash.h>
+
+#include <engine/console.h>
+#include <engine/shared/teehistorian_reader.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CConfig;
+class CServer;
+class IGameServer;
+
+// Runs the game recorded in a teehistorian file again, without networking.
+// The map of the recording is loaded and the recorded joins, drops, inputs,
+// messages and console commands are fed to the game tick by tick, after
+// each tick the character positions are compared to the recorded ones.
+class CServerReplay
+{
+public:
+	class CStats
+	{
+	public:
+		int m_Ticks;
+		int64_t m_Records;
+		// character positions compared to the recording and how many of
+		// them differed, a dead character counts as a position
+		int64_t m_Positions;
+		int64_t m_Mismatches;
+		int m_FirstMismatchTick;
+		// time spent running the game, without loading the file and map
+		int64_t m_GameTime;
+	};
+
+	CServerReplay(CServer *pServer);
+
+	// reads the file and applies the config recorded in its header, console
+	// commands executed afterwards can override it
+	bool Load(const char *pFilename);
+	// loads the map and replays the whole file, creating snapshots like a
+	// real server does if requested
+	bool Run(bool Snapshots, CStats *pStats);
+
+private:
+	class CDDNetVersion
+	{
+	public:
+		// -1 if the client didn't send its version to the engine
+		int m_Version;
+		CUuid m_ConnectionID;
+		char m_aVersion[64];
+	};
+
+	class CPosition
+	{
+	public:
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+	};
+
+	static void CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser);
+
+	CConfig *Config();
+	IConsole *Console();
+	IGameServer *GameServer();
+
+	void ScanVersions();
+	void Tick(bool Snapshots);
+	void Verify(int Tick, CStats *pStats);
+
+	void OnJoin(int ClientID);
+	void OnDrop(int ClientID, const char *pReason);
+	void OnMessage(int ClientID, const void *pData, int DataSize);
+	void OnConsoleCommand(const CTeeHistorianReader::CRecord *pRecord);
+	void OnEx(const CTeeHistorianReader::CRecord *pRecord);
+	void Connect(int ClientID);
+
+	CServer *m_pServer;
+	CTeeHistorianReader m_Reader;
+	std::vector<unsigned char> m_vData;
+
+	char m_aMapName[128];
+	char m_aMapSha256[SHA256_MAXSTRSIZE];
+	char m_aPrngDescription[128];
+	std::vector<std::pair<std::string, int>> m_vTuning;
+
+	// the version of every join of a client, in order
+	std::vector<CDDNetVersion> m_avVersions[MAX_CLIENTS];
+	int m_aNumJoins[MAX_CLIENTS];
+	bool m_aSixup[MAX_CLIENTS];
+
+	// the inputs recorded for the next tick
+	std::vector<CNetObj_PlayerInput> m_avInputs[MAX_CLIENTS];
+	CPosition m_aPositions[MAX_CLIENTS];
+
+	// console commands the game executed by itself, they are also recorded
+	// and must not be executed a second time
+	std::deque<std::string> m_GeneratedCommands;
+	int m_SkipCommands;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/map.h>
+#include <engine/server.h>
+#include <engine/storage.h>
+
+#include <engine/server/antibot.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/replay.h>
+#include <engine/server/server.h>
+
+#include <engine/shared/config.h>
+
+#include <game/version.h>
+
+#include <csignal>
+
+volatile sig_atomic_t InterruptSignaled = 0;
+
+bool IsInterrupted()
+{
+	return InterruptSignaled;
+}
+
+void HandleSigIntTerm(int Param)
+{
+	InterruptSignaled = 1;
+
+	// Exit the next time a signal is received
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	bool Snapshots = false;
+	int FirstArg = 1;
+	if(FirstArg < argc && str_comp(argv[FirstArg], "--snapshots") == 0)
+	{
+		Snapshots = true;
+		FirstArg++;
+	}
+	if(FirstArg >= argc)
+	{
+		dbg_msg("usage", "%s [--snapshots] <teehistorian file> [console commands]", argv[0]);
+		dbg_msg("usage", "replays a recorded game and checks the character positions against the recording");
+		return -1;
+	}
+	const char *pFilename = argv[FirstArg++];
+
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("secure", "could not initialize secure RNG");
+		return -1;
+	}
+	if(MysqlInit() != 0)
+	{
+		dbg_msg("mysql", "failed to initialize MySQL library");
+		return -1;
+	}
+
+	signal(SIGINT, HandleSigIntTerm);
+	signal(SIGTERM, HandleSigIntTerm);
+
+	CServer *pServer = CreateServer();
+	IKernel *pKernel = IKernel::Create();
+
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr, 2);
+	IEngineMap *pEngineMap = CreateEngineMap();
+	IGameServer *pGameServer = CreateGameServer();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON).release();
+	IStorage *pStorage = CreateStorage(IStorage::STORAGETYPE_SERVER, argc, argv);
+	IConfigManager *pConfigManager = CreateConfigManager();
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+
+	{
+		bool RegisterFail = false;
+
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pServer);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngine);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngineMap); // register as both
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pGameServer);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConsole);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pStorage);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConfigManager);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pEngineAntibot);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+
+		if(RegisterFail)
+		{
+			delete pKernel;
+			return -1;
+		}
+	}
+
+	pEngine->Init();
+	pConfigManager->Init();
+	pConsole->Init();
+
+	// register all console commands
+	pServer->RegisterCommands();
+
+	// the recorded config replaces the autoexec file, arguments can still
+	// override it
+	CServerReplay Replay(pServer);
+	if(!Replay.Load(pFilename))
+	{
+		delete pKernel;
+		return -1;
+	}
+	if(FirstArg < argc)
+		pConsole->ParseArguments(argc - FirstArg, &argv[FirstArg]);
+
+	pConsole->Register("sv_test_cmds", "", CFGFLAG_SERVER, CServer::ConTestingCommands, pConsole, "Turns testing commands aka cheats on/off (setting only works in initial config)");
+	pConsole->Register("sv_rescue", "", CFGFLAG_SERVER, CServer::ConRescue, pConsole, "Allow /rescue command so players can teleport themselves out of freeze (setting only works in initial config)");
+
+	log_set_loglevel((LEVEL)g_Config.m_Loglevel);
+
+	CServerReplay::CStats Stats;
+	const bool Success = Replay.Run(Snapshots, &Stats);
+
+	const double Seconds = maximum(Stats.m_GameTime, (int64_t)1) / (double)time_freq();
+	dbg_msg("replay", "ticks=%d records=%lld time=%.3fs ticks/s=%.0f realtime=%.1fx",
+		Stats.m_Ticks, (long long)Stats.m_Records, Seconds, Stats.m_Ticks / Seconds, Stats.m_Ticks / Seconds / SERVER_TICK_SPEED);
+	dbg_msg("replay", "positions=%lld mismatches=%lld first_mismatch_tick=%d",
+		(long long)Stats.m_Positions, (long long)Stats.m_Mismatches, Stats.m_FirstMismatchTick);
+
+	MysqlUninit();
+	secure_random_uninit();
+
+	delete pKernel;
+
+	return Success && Stats.m_Mismatches == 0 ? 0 : 1;
+}
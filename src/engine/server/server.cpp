@@ -203,7 +203,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 			CNetHash NetHash(&Data);
 			char aBuf[256];
 			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
-			Server()->m_NetServer.Drop(i, aBuf);
+			Server()->DropClient(i, aBuf);
 		}
 	}
 
@@ -289,10 +289,18 @@ void CRconClientLogger::Log(const CLogMessage *pMessage)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(auto &Input : m_aInputs)
-		Input.m_GameTick = -1;
-	m_CurrentInput = 0;
+	m_Inputs.Reset();
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
+	m_NumInputs = 0;
+	m_NumLateInputs = 0;
+	m_NumEarlyInputs = 0;
+	m_NumExtraInputs = 0;
+	m_NumInputTicks = 0;
+	m_NumMissingInputs = 0;
+	m_MinInputTimeLeft = 0;
+	m_MaxInputTimeLeft = 0;
+	m_InputTimeLeftSum = 0;
+	m_InputTimeLeftSquaredSum = 0;
 
 	m_Snapshots.PurgeAll();
 	m_LastAckedSnapshot = -1;
@@ -301,6 +309,10 @@ void CServer::CClient::Reset()
 	m_Score = 0;
 	m_NextMapChunk = 0;
 	m_Flags = 0;
+	m_MapDownloadStart = 0;
+	m_MapDownloadEnd = 0;
+	m_MapDownloadBytes = 0;
+	m_MapDownloadChunks = 0;
 }
 
 CServer::CServer()
@@ -310,12 +322,24 @@ CServer::CServer()
 		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
 	m_aDemoRecorder[MAX_CLIENTS] = CDemoRecorder(&m_SnapshotDelta, false);
 
+	m_SnapJobThreads = 0;
+	sphore_init(&m_SnapJobsDone);
+	m_SnapTimeTotal = 0;
+	m_SnapTimeMax = 0;
+	m_NumSnapTimes = 0;
+	m_NumStoredSnapshots = 0;
+	m_NumSharedSnapshots = 0;
+	m_SendBatching = false;
+	mem_zero(&m_NetStatsStart, sizeof(m_NetStatsStart));
+	m_NetStatsStartTick = 0;
+
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
 
 	m_CurrentGameTick = 0;
 	m_RunServer = UNINITIALIZED;
+	m_Replaying = false;
 
 	m_aShutdownReason[0] = 0;
 
@@ -350,10 +374,8 @@ CServer::CServer()
 
 CServer::~CServer()
 {
-	for(auto &pCurrentMapData : m_apCurrentMapData)
-	{
-		free(pCurrentMapData);
-	}
+	// the six map data belongs to m_pMap
+	free((void *)m_apCurrentMapData[MAP_TYPE_SIXUP]);
 
 	if(m_RunServer != UNINITIALIZED)
 	{
@@ -365,6 +387,9 @@ CServer::~CServer()
 
 	delete m_pRegister;
 	delete m_pConnectionPool;
+
+	m_pSnapJobPool = nullptr;
+	sphore_destroy(&m_SnapJobsDone);
 }
 
 bool CServer::IsClientNameAvailable(int ClientID, const char *pNameRequest)
@@ -509,7 +534,16 @@ void CServer::Kick(int ClientID, const char *pReason)
 		return;
 	}
 
-	m_NetServer.Drop(ClientID, pReason);
+	DropClient(ClientID, pReason);
+}
+
+void CServer::DropClient(int ClientID, const char *pReason)
+{
+	// without connections, drop the client like the network would
+	if(m_Replaying)
+		DelClientCallback(ClientID, pReason, this);
+	else
+		m_NetServer.Drop(ClientID, pReason);
 }
 
 void CServer::Ban(int ClientID, int Seconds, const char *pReason)
@@ -532,7 +566,7 @@ int CServer::Init()
 		Client.m_aName[0] = 0;
 		Client.m_aClan[0] = 0;
 		Client.m_Country = -1;
-		Client.m_Snapshots.Init();
+		Client.m_Snapshots.Init(&m_SnapshotBufferPool);
 		Client.m_Traffic = 0;
 		Client.m_TrafficSince = 0;
 		Client.m_ShowIps = false;
@@ -671,7 +705,9 @@ int CServer::Port() const
 
 int CServer::MaxClients() const
 {
-	return m_RunServer == UNINITIALIZED ? 0 : m_NetServer.MaxClients();
+	if(m_RunServer == UNINITIALIZED)
+		return 0;
+	return m_Replaying ? Config()->m_SvMaxClients : m_NetServer.MaxClients();
 }
 
 int CServer::ClientCount() const
@@ -809,7 +845,7 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 					Recorder.RecordMessage(Pack6.Data(), Pack6.Size());
 		}
 
-		if(!(Flags & MSGFLAG_NOSEND))
+		if(!(Flags & MSGFLAG_NOSEND) && !m_Replaying)
 		{
 			for(int i = 0; i < MAX_CLIENTS; i++)
 			{
@@ -834,29 +870,40 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 		if(RepackMsg(pMsg, Pack, m_aClients[ClientID].m_Sixup))
 			return -1;
 
-		Packet.m_ClientID = ClientID;
-		Packet.m_pData = Pack.Data();
-		Packet.m_DataSize = Pack.Size();
+		SendPackedMsg(Pack.Data(), Pack.Size(), Flags, ClientID);
+	}
 
-		if(Antibot()->OnEngineServerMessage(ClientID, Packet.m_pData, Packet.m_DataSize, Flags))
-		{
-			return 0;
-		}
+	return 0;
+}
 
-		// write message to demo recorders
-		if(!(Flags & MSGFLAG_NORECORD))
-		{
-			if(m_aDemoRecorder[ClientID].IsRecording())
-				m_aDemoRecorder[ClientID].RecordMessage(Pack.Data(), Pack.Size());
-			if(m_aDemoRecorder[MAX_CLIENTS].IsRecording())
-				m_aDemoRecorder[MAX_CLIENTS].RecordMessage(Pack.Data(), Pack.Size());
-		}
+void CServer::SendPackedMsg(const void *pData, int Size, int Flags, int ClientID)
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(CNetChunk));
+	if(Flags & MSGFLAG_VITAL)
+		Packet.m_Flags |= NETSENDFLAG_VITAL;
+	if(Flags & MSGFLAG_FLUSH)
+		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+	Packet.m_ClientID = ClientID;
+	Packet.m_pData = pData;
+	Packet.m_DataSize = Size;
 
-		if(!(Flags & MSGFLAG_NOSEND))
-			m_NetServer.Send(&Packet);
+	if(Antibot()->OnEngineServerMessage(ClientID, Packet.m_pData, Packet.m_DataSize, Flags))
+	{
+		return;
 	}
 
-	return 0;
+	// write message to demo recorders
+	if(!(Flags & MSGFLAG_NORECORD))
+	{
+		if(m_aDemoRecorder[ClientID].IsRecording())
+			m_aDemoRecorder[ClientID].RecordMessage(pData, Size);
+		if(m_aDemoRecorder[MAX_CLIENTS].IsRecording())
+			m_aDemoRecorder[MAX_CLIENTS].RecordMessage(pData, Size);
+	}
+
+	if(!(Flags & MSGFLAG_NOSEND) && !m_Replaying)
+		m_NetServer.Send(&Packet);
 }
 
 void CServer::SendMsgRaw(int ClientID, const void *pData, int Size, int Flags)
@@ -875,11 +922,69 @@ void CServer::SendMsgRaw(int ClientID, const void *pData, int Size, int Flags)
 	{
 		Packet.m_Flags |= NETSENDFLAG_FLUSH;
 	}
-	m_NetServer.Send(&Packet);
+	if(!m_Replaying)
+		m_NetServer.Send(&Packet);
+}
+
+class CSnapshotJob : public IJob
+{
+	CServer *m_pServer;
+	int m_ClientID;
+	SEMAPHORE *m_pDone;
+
+	void Run() override
+	{
+		m_pServer->CompressSnapshot(m_ClientID);
+		sphore_signal(m_pDone);
+	}
+
+public:
+	CSnapshotJob(CServer *pServer, int ClientID, SEMAPHORE *pDone) :
+		m_pServer(pServer), m_ClientID(ClientID), m_pDone(pDone)
+	{
+	}
+};
+
+void CServer::CompressSnapshot(int ClientID)
+{
+	// only touches the state of this client, may run on a worker thread
+	CClient &Client = m_aClients[ClientID];
+	CSnapshotWork *pWork = m_apSnapshotWork[ClientID].get();
+	CSnapshot *pData = (CSnapshot *)pWork->m_aData;
+
+	// find snapshot that we can perform delta against
+	CSnapshot EmptySnap;
+	EmptySnap.Clear();
+
+	pWork->m_DeltaTick = -1;
+	CSnapshot *pDeltashot = &EmptySnap;
+	{
+		int DeltashotSize = Client.m_Snapshots.Get(Client.m_LastAckedSnapshot, 0, &pDeltashot, 0);
+		if(DeltashotSize >= 0)
+			pWork->m_DeltaTick = Client.m_LastAckedSnapshot;
+		else
+		{
+			// no acked package found, force client to recover rate
+			if(Client.m_SnapRate == CClient::SNAPRATE_FULL)
+				Client.m_SnapRate = CClient::SNAPRATE_RECOVER;
+		}
+	}
+
+	// create delta
+	CSnapshotDelta *pSnapshotDelta = Client.m_Sixup ? &m_SnapshotDeltaSixup : &m_SnapshotDelta;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = pSnapshotDelta->CreateDelta(pDeltashot, pData, aDeltaData);
+
+	// compress it
+	pWork->m_CompSize = 0;
+	if(DeltaSize)
+		pWork->m_CompSize = CVariableInt::Compress(aDeltaData, DeltaSize, pWork->m_aCompData, sizeof(pWork->m_aCompData));
 }
 
 void CServer::DoSnapshot()
 {
+	int64_t SnapStart = time_get();
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -896,7 +1001,25 @@ void CServer::DoSnapshot()
 		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	if(m_SnapJobThreads != Config()->m_SvSnapThreads)
+	{
+		m_SnapJobThreads = Config()->m_SvSnapThreads;
+		m_pSnapJobPool = nullptr;
+		if(m_SnapJobThreads > 0)
+		{
+			m_pSnapJobPool = std::make_unique<CJobPool>();
+			m_pSnapJobPool->Init(m_SnapJobThreads);
+		}
+	}
+
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, false);
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, false);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
+
 	// create snapshots for all clients
+	bool aSnapped[MAX_CLIENTS] = {false};
+	int NumJobs = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -911,104 +1034,157 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
+		if(!m_apSnapshotWork[i])
+			m_apSnapshotWork[i] = std::make_unique<CSnapshotWork>();
+		CSnapshotWork *pWork = m_apSnapshotWork[i].get();
+
+		m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+
+		GameServer()->OnSnap(i);
+
+		// finish snapshot
+		CSnapshot *pData = (CSnapshot *)pWork->m_aData; // Fix compiler warning for strict-aliasing
+		pWork->m_SnapshotSize = m_SnapshotBuilder.Finish(pData);
+
+		if(m_aDemoRecorder[i].IsRecording())
 		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+			// write snapshot
+			m_aDemoRecorder[i].RecordSnapshot(Tick(), pWork->m_aData, pWork->m_SnapshotSize);
+		}
 
-			GameServer()->OnSnap(i);
+		pWork->m_Crc = pData->Crc();
 
-			// finish snapshot
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+		// remove old snapshots
+		// keep 3 seconds worth of snapshots
+		CSnapshotStorage &Storage = m_aClients[i].m_Snapshots;
+		Storage.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
+		// save the snapshot, clients with the same view get byte identical
+		// snapshots which only have to be stored once
+		CSnapshotBuffer *pShared = nullptr;
+		for(int j = 0; j < i && !pShared; j++)
+		{
+			const CSnapshotWork *pOther = m_apSnapshotWork[j].get();
+			if(aSnapped[j] && pOther->m_Crc == pWork->m_Crc && pOther->m_SnapshotSize == pWork->m_SnapshotSize &&
+				mem_comp(pOther->m_aData, pWork->m_aData, pWork->m_SnapshotSize) == 0)
+				pShared = m_aClients[j].m_Snapshots.m_pLast->m_pBuffer;
+		}
+		if(pShared)
+		{
+			Storage.Add(m_CurrentGameTick, time_get(), pShared);
+			m_NumSharedSnapshots++;
+		}
+		else
+			Storage.Add(m_CurrentGameTick, time_get(), pWork->m_SnapshotSize, pData, 0, nullptr);
+		m_NumStoredSnapshots++;
+
+		aSnapped[i] = true;
+
+		// delta, compression and storage don't depend on the game state
+		if(m_pSnapJobPool)
+		{
+			m_pSnapJobPool->Add(std::make_shared<CSnapshotJob>(this, i, &m_SnapJobsDone));
+			NumJobs++;
+		}
+		else
+			CompressSnapshot(i);
+	}
 
-			int Crc = pData->Crc();
+	for(int i = 0; i < NumJobs; i++)
+		sphore_wait(&m_SnapJobsDone);
 
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
+	// send the snapshots
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		if(!aSnapped[i])
+			continue;
 
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+		const CSnapshotWork *pWork = m_apSnapshotWork[i].get();
+		const int DeltaTick = pWork->m_DeltaTick;
+		const int Crc = pWork->m_Crc;
 
-			// find snapshot that we can perform delta against
-			static CSnapshot s_EmptySnap;
-			s_EmptySnap.Clear();
+		if(pWork->m_CompSize)
+		{
+			const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+			const int SnapshotSize = pWork->m_CompSize;
+			const char *pCompData = pWork->m_aCompData;
+			int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
 
-			int DeltaTick = -1;
-			CSnapshot *pDeltashot = &s_EmptySnap;
+			for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				int Chunk = Left < MaxSize ? Left : MaxSize;
+				Left -= Chunk;
+
+				if(NumPackets == 1)
+				{
+					CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				}
 				else
 				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
+					CMsgPacker Msg(NETMSG_SNAP, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(NumPackets);
+					Msg.AddInt(n);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
 				}
 			}
+		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - DeltaTick);
+			SendMsg(&Msg, MSGFLAG_FLUSH, i);
+		}
+	}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	GameServer()->OnPostSnap();
 
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	int64_t SnapTime = time_get() - SnapStart;
+	m_SnapTimeTotal += SnapTime;
+	m_SnapTimeMax = maximum(m_SnapTimeMax, SnapTime);
+	m_NumSnapTimes++;
+}
 
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+int64_t CServer::BuildSnapshots(int Iterations, unsigned *pChecksum)
+{
+	// the first round is an untimed warm-up, like in DoSnapshot it also
+	// consumes the events of the current tick so every timed round snaps
+	// the same world
+	int64_t Start = 0;
+	for(int Iteration = -1; Iteration < Iterations; Iteration++)
+	{
+		if(Iteration == 0)
+			Start = time_get();
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+		GameServer()->OnPreSnap();
+		for(int i = 0; i < MaxClients(); i++)
+		{
+			if(m_aClients[i].m_State != CClient::STATE_INGAME)
+				continue;
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
-			}
-			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
-			}
+			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+			GameServer()->OnSnap(i);
+
+			char aData[CSnapshot::MAX_SIZE];
+			CSnapshot *pData = (CSnapshot *)aData;
+			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+			if(Iteration == 0)
+				*pChecksum = *pChecksum * 31 + pData->Crc() + SnapshotSize;
 		}
+		GameServer()->OnPostSnap();
 	}
-
-	GameServer()->OnPostSnap();
+	return time_get() - Start;
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -1213,42 +1389,36 @@ void CServer::SendMap(int ClientID)
 		if(MapType == MAP_TYPE_SIXUP)
 		{
 			Msg.AddInt(Config()->m_SvMapWindow);
-			Msg.AddInt(1024 - 128);
+			Msg.AddInt(MAP_CHUNK_SIZE);
 			Msg.AddRaw(m_aCurrentMapSha256[MapType].data, sizeof(m_aCurrentMapSha256[MapType].data));
 		}
 		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
 	}
 
 	m_aClients[ClientID].m_NextMapChunk = 0;
+	m_aClients[ClientID].m_MapDownloadStart = 0;
+	m_aClients[ClientID].m_MapDownloadEnd = 0;
+	m_aClients[ClientID].m_MapDownloadBytes = 0;
+	m_aClients[ClientID].m_MapDownloadChunks = 0;
 }
 
 void CServer::SendMapData(int ClientID, int Chunk)
 {
 	int MapType = IsSixup(ClientID) ? MAP_TYPE_SIXUP : MAP_TYPE_SIX;
-	unsigned int ChunkSize = 1024 - 128;
-	unsigned int Offset = Chunk * ChunkSize;
-	int Last = 0;
+	const CMapChunks &Chunks = m_aMapChunks[MapType];
 
 	// drop faulty map data requests
-	if(Chunk < 0 || Offset > m_aCurrentMapSize[MapType])
+	if(Chunk < 0 || Chunk >= Chunks.Num())
 		return;
 
-	if(Offset + ChunkSize >= m_aCurrentMapSize[MapType])
-	{
-		ChunkSize = m_aCurrentMapSize[MapType] - Offset;
-		Last = 1;
-	}
+	SendPackedMsg(Chunks.Data(Chunk), Chunks.Size(Chunk), MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
 
-	CMsgPacker Msg(NETMSG_MAP_DATA, true);
-	if(MapType == MAP_TYPE_SIX)
-	{
-		Msg.AddInt(Last);
-		Msg.AddInt(m_aCurrentMapCrc[MAP_TYPE_SIX]);
-		Msg.AddInt(Chunk);
-		Msg.AddInt(ChunkSize);
-	}
-	Msg.AddRaw(&m_apCurrentMapData[MapType][Offset], ChunkSize);
-	SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
+	const int ChunkSize = CMapChunks::MapBytes(m_aCurrentMapSize[MapType], Chunk);
+	CClient &Client = m_aClients[ClientID];
+	if(!Client.m_MapDownloadChunks)
+		Client.m_MapDownloadStart = time_get();
+	Client.m_MapDownloadBytes += ChunkSize;
+	Client.m_MapDownloadChunks++;
 
 	if(Config()->m_Debug)
 	{
@@ -1517,6 +1687,15 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				str_format(aBuf, sizeof(aBuf), "player is ready. ClientID=%d addr=<{%s}> secure=%s", ClientID, aAddrStr, m_NetServer.HasSecurityToken(ClientID) ? "yes" : "no");
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 
+				CClient &Client = m_aClients[ClientID];
+				if(Client.m_MapDownloadChunks)
+				{
+					Client.m_MapDownloadEnd = time_get();
+					const double Seconds = maximum(Client.m_MapDownloadEnd - Client.m_MapDownloadStart, (int64_t)1) / (double)time_freq();
+					str_format(aBuf, sizeof(aBuf), "map download finished. ClientID=%d bytes=%d chunks=%d time=%.2fs rate=%.1fKiB/s", ClientID, Client.m_MapDownloadBytes, Client.m_MapDownloadChunks, Seconds, Client.m_MapDownloadBytes / 1024.0 / Seconds);
+					Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
+				}
+
 				void *pPersistentData = 0;
 				if(m_aClients[ClientID].m_HasPersistentData)
 				{
@@ -1578,6 +1757,19 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			{
 				int TimeLeft = ((TickStartTime(IntendedTick) - time_get()) * 1000) / time_freq();
 
+				CClient &Client = m_aClients[ClientID];
+				if(!Client.m_NumInputs || TimeLeft < Client.m_MinInputTimeLeft)
+					Client.m_MinInputTimeLeft = TimeLeft;
+				if(!Client.m_NumInputs || TimeLeft > Client.m_MaxInputTimeLeft)
+					Client.m_MaxInputTimeLeft = TimeLeft;
+				Client.m_InputTimeLeftSum += TimeLeft;
+				Client.m_InputTimeLeftSquaredSum += (int64_t)TimeLeft * TimeLeft;
+				Client.m_NumInputs++;
+				if(IntendedTick <= Tick())
+					Client.m_NumLateInputs++;
+				else if(IntendedTick > Tick() + TickSpeed())
+					Client.m_NumEarlyInputs++;
+
 				CMsgPacker Msgp(NETMSG_INPUTTIMING, true);
 				Msgp.AddInt(IntendedTick);
 				Msgp.AddInt(TimeLeft);
@@ -1586,12 +1778,20 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
 
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
-
 			if(IntendedTick <= Tick())
 				IntendedTick = Tick() + 1;
 
-			pInput->m_GameTick = IntendedTick;
+			if(m_aClients[ClientID].m_Inputs.First(IntendedTick))
+				m_aClients[ClientID].m_NumExtraInputs++;
+			pInput = m_aClients[ClientID].m_Inputs.Add(IntendedTick, Tick());
+			// inputs outside the tick window are not kept for their tick,
+			// but still become the latest input
+			CClient::CInput DroppedInput;
+			if(!pInput)
+			{
+				mem_zero(&DroppedInput, sizeof(DroppedInput));
+				pInput = &DroppedInput;
+			}
 
 			for(int i = 0; i < Size / 4; i++)
 				pInput->m_aData[i] = Unpacker.GetInt();
@@ -1599,9 +1799,6 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			GameServer()->OnClientPrepareInput(ClientID, pInput->m_aData);
 			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE * sizeof(int));
 
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
-
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
 				GameServer()->OnClientDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
@@ -2464,13 +2661,9 @@ int CServer::LoadMap(const char *pMapName)
 
 	str_copy(m_aCurrentMap, pMapName);
 
-	// load complete map into memory for download
-	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
-		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
-		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
-	}
+	// the map is already in memory, serve downloads from it directly
+	m_apCurrentMapData[MAP_TYPE_SIX] = m_pMap->FileData();
+	m_aCurrentMapSize[MAP_TYPE_SIX] = m_pMap->FileSize();
 
 	// load sixup version of the map
 	if(Config()->m_SvSixup)
@@ -2490,7 +2683,7 @@ int CServer::LoadMap(const char *pMapName)
 		}
 		else
 		{
-			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
+			free((void *)m_apCurrentMapData[MAP_TYPE_SIXUP]);
 			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
 
 			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
@@ -2502,10 +2695,18 @@ int CServer::LoadMap(const char *pMapName)
 	}
 	if(!Config()->m_SvSixup)
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
+		free((void *)m_apCurrentMapData[MAP_TYPE_SIXUP]);
 		m_apCurrentMapData[MAP_TYPE_SIXUP] = 0;
 	}
 
+	for(int MapType = 0; MapType < NUM_MAP_TYPES; MapType++)
+	{
+		if(m_apCurrentMapData[MapType])
+			m_aMapChunks[MapType].Build(m_apCurrentMapData[MapType], m_aCurrentMapSize[MapType], m_aCurrentMapCrc[MAP_TYPE_SIX], MapType == MAP_TYPE_SIXUP);
+		else
+			m_aMapChunks[MapType].Clear();
+	}
+
 	for(int i = 0; i < MAX_CLIENTS; i++)
 		m_aPrevStates[i] = m_aClients[i].m_State;
 
@@ -2540,6 +2741,7 @@ int CServer::Run()
 		return -1;
 	}
 
+	DbPool()->SetNumReadWorkers(Config()->m_SvSqlReadWorkers);
 	if(Config()->m_SvSqliteFile[0] != '\0')
 	{
 		char aFullPath[IO_MAX_PATH_LENGTH];
@@ -2629,8 +2831,15 @@ int CServer::Run()
 		m_GameStartTime = time_get();
 
 		UpdateServerInfo();
+		net_stats(&m_NetStatsStart);
 		while(m_RunServer < STOPPING)
 		{
+			if(m_SendBatching != (bool)Config()->m_SvSendBatching)
+			{
+				m_SendBatching = Config()->m_SvSendBatching;
+				m_NetServer.SetSendBatching(m_SendBatching);
+			}
+
 			if(NonActive)
 				PumpNetwork(PacketWaiting);
 
@@ -2739,17 +2948,11 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick() + 1)
-						{
-							GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
-							ClientHadInput = true;
-						}
-					}
-					if(!ClientHadInput)
+					CClient::CInput *pInput = m_aClients[c].m_Inputs.First(Tick() + 1);
+					if(!pInput)
 						GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+					for(; pInput; pInput = m_aClients[c].m_Inputs.Next(pInput))
+						GameServer()->OnClientPredictedEarlyInput(c, pInput->m_aData);
 				}
 
 				m_CurrentGameTick++;
@@ -2760,18 +2963,14 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
+					CClient::CInput *pInput = m_aClients[c].m_Inputs.First(Tick());
+					if(m_aClients[c].m_NumInputs)
 					{
-						if(Input.m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
+						m_aClients[c].m_NumInputTicks++;
+						if(!pInput)
+							m_aClients[c].m_NumMissingInputs++;
 					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedInput(c, nullptr);
+					GameServer()->OnClientPredictedInput(c, pInput ? pInput->m_aData : nullptr);
 				}
 
 				GameServer()->OnTick();
@@ -2805,6 +3004,9 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			// send everything this iteration produced before sleeping
+			m_NetServer.FlushSend();
+
 			NonActive = true;
 
 			for(const auto &Client : m_aClients)
@@ -2918,6 +3120,138 @@ void CServer::ConKick(IConsole::IResult *pResult, void *pUser)
 		((CServer *)pUser)->Kick(pResult->GetInteger(0), "Kicked by console");
 }
 
+void CServer::ConSnapBench(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	int Iterations = pResult->NumArguments() ? maximum(pResult->GetInteger(0), 1) : 100;
+
+	// the snapshots built here are thrown away, nothing is sent or recorded
+	int OldSnapShared = pThis->Config()->m_SvSnapShared;
+	unsigned aChecksums[3] = {0, 0, 0};
+	int64_t aTimes[3];
+	for(int Shared = 0; Shared < 3; Shared++)
+	{
+		pThis->Config()->m_SvSnapShared = Shared;
+		aTimes[Shared] = pThis->BuildSnapshots(Iterations, &aChecksums[Shared]);
+	}
+	pThis->Config()->m_SvSnapShared = OldSnapShared;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "clients=%d iterations=%d per-client=%.3fms shared=%.3fms grid=%.3fms speedup=%.2fx snapshots %s",
+		pThis->ClientCount(), Iterations,
+		aTimes[0] * 1000.0 / time_freq() / Iterations,
+		aTimes[1] * 1000.0 / time_freq() / Iterations,
+		aTimes[2] * 1000.0 / time_freq() / Iterations,
+		aTimes[2] ? (double)aTimes[0] / aTimes[2] : 0.0,
+		aChecksums[0] == aChecksums[1] && aChecksums[0] == aChecksums[2] ? "match" : "differ");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "snap_bench", aBuf);
+}
+
+void CServer::ConSnapStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "threads=%d snaps=%d avg=%.3fms max=%.3fms",
+		pThis->m_SnapJobThreads, pThis->m_NumSnapTimes,
+		pThis->m_NumSnapTimes ? pThis->m_SnapTimeTotal * 1000.0 / time_freq() / pThis->m_NumSnapTimes : 0.0,
+		pThis->m_SnapTimeMax * 1000.0 / time_freq());
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "snap_stats", aBuf);
+
+	pThis->m_SnapTimeTotal = 0;
+	pThis->m_SnapTimeMax = 0;
+	pThis->m_NumSnapTimes = 0;
+}
+
+void CServer::ConSnapStorage(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	const CSnapshotBufferPool &Pool = pThis->m_SnapshotBufferPool;
+
+	int NumHolders = 0;
+	int NumFreeHolders = 0;
+	for(const auto &Client : pThis->m_aClients)
+	{
+		NumHolders += Client.m_Snapshots.NumHolders();
+		NumFreeHolders += Client.m_Snapshots.NumFreeHolders();
+	}
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "buffers=%d used=%d allocated=%dKiB in_use=%dKiB",
+		Pool.NumBuffers(), Pool.NumUsedBuffers(), (int)(Pool.AllocatedBytes() / 1024), (int)(Pool.UsedBytes() / 1024));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "snap_storage", aBuf);
+	str_format(aBuf, sizeof(aBuf), "holders=%d free_holders=%d holder_memory=%dKiB stored=%lld shared=%lld",
+		NumHolders, NumFreeHolders, (int)((NumHolders + NumFreeHolders) * sizeof(CSnapshotStorage::CHolder) / 1024),
+		(long long)pThis->m_NumStoredSnapshots, (long long)pThis->m_NumSharedSnapshots);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "snap_storage", aBuf);
+}
+
+void CServer::ConNetSyscalls(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+
+	NETSTATS Stats;
+	net_stats(&Stats);
+	const NETSTATS &Start = pThis->m_NetStatsStart;
+	const int Ticks = maximum(pThis->m_CurrentGameTick - pThis->m_NetStatsStartTick, 1);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "ticks=%d batching=%d sent_packets=%.1f/tick send_syscalls=%.1f/tick recv_packets=%.1f/tick recv_syscalls=%.1f/tick",
+		Ticks, pThis->m_SendBatching,
+		(double)(Stats.sent_packets - Start.sent_packets) / Ticks,
+		(double)(Stats.send_syscalls - Start.send_syscalls) / Ticks,
+		(double)(Stats.recv_packets - Start.recv_packets) / Ticks,
+		(double)(Stats.recv_syscalls - Start.recv_syscalls) / Ticks);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_syscalls", aBuf);
+
+	pThis->m_NetStatsStart = Stats;
+	pThis->m_NetStatsStartTick = pThis->m_CurrentGameTick;
+}
+
+void CServer::ConMapDownloads(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	const int64_t Now = time_get();
+
+	char aBuf[256];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CClient &Client = pThis->m_aClients[i];
+		if(Client.m_State == CClient::STATE_EMPTY || !Client.m_MapDownloadChunks)
+			continue;
+
+		const int MapType = pThis->IsSixup(i) ? MAP_TYPE_SIXUP : MAP_TYPE_SIX;
+		const int64_t End = Client.m_MapDownloadEnd ? Client.m_MapDownloadEnd : Now;
+		const double Seconds = maximum(End - Client.m_MapDownloadStart, (int64_t)1) / (double)time_freq();
+		str_format(aBuf, sizeof(aBuf), "id=%d %s sent=%d/%d chunks=%d time=%.2fs rate=%.1fKiB/s",
+			i, Client.m_MapDownloadEnd ? "done" : "downloading", Client.m_MapDownloadBytes, pThis->m_aCurrentMapSize[MapType],
+			Client.m_MapDownloadChunks, Seconds, Client.m_MapDownloadBytes / 1024.0 / Seconds);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "map_downloads", aBuf);
+	}
+}
+
+void CServer::ConInputStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+
+	char aBuf[256];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CClient &Client = pThis->m_aClients[i];
+		if(Client.m_State != CClient::STATE_INGAME || !Client.m_NumInputs)
+			continue;
+
+		// the time left is how long before its tick an input arrived
+		const double Mean = Client.m_InputTimeLeftSum / (double)Client.m_NumInputs;
+		const double Variance = Client.m_InputTimeLeftSquaredSum / (double)Client.m_NumInputs - Mean * Mean;
+		str_format(aBuf, sizeof(aBuf), "id=%d inputs=%d late=%d early=%d extra=%d dropped=%d missing=%d/%d timeleft=%d/%.1f/%dms jitter=%.1fms",
+			i, Client.m_NumInputs, Client.m_NumLateInputs, Client.m_NumEarlyInputs, Client.m_NumExtraInputs, Client.m_Inputs.NumDropped(),
+			Client.m_NumMissingInputs, Client.m_NumInputTicks,
+			Client.m_MinInputTimeLeft, Mean, Client.m_MaxInputTimeLeft, sqrt(maximum(Variance, 0.0)));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "input_stats", aBuf);
+	}
+}
+
 void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 {
 	char aBuf[1024];
@@ -3465,6 +3799,14 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainSqlReadWorkersUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	CServer *pSelf = (CServer *)pUserData;
+	if(pResult->NumArguments() && pSelf->m_RunServer == RUNNING)
+		pSelf->DbPool()->SetNumReadWorkers(pSelf->Config()->m_SvSqlReadWorkers);
+}
+
 void CServer::ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -3655,6 +3997,12 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("snap_stats", "", CFGFLAG_SERVER, ConSnapStats, this, "Show and reset the main thread time spent creating snapshots");
+	Console()->Register("net_syscalls", "", CFGFLAG_SERVER, ConNetSyscalls, this, "Show and reset the packets and network syscalls per tick");
+	Console()->Register("snap_storage", "", CFGFLAG_SERVER, ConSnapStorage, this, "Show the memory used to store snapshots for delta creation");
+	Console()->Register("map_downloads", "", CFGFLAG_SERVER, ConMapDownloads, this, "Show the map download progress and speed of the clients");
+	Console()->Register("input_stats", "", CFGFLAG_SERVER, ConInputStats, this, "Show how timely the inputs of the clients arrive");
+	Console()->Register("snap_bench", "?i[iterations]", CFGFLAG_SERVER, ConSnapBench, this, "Compare building snapshots per client against the shared candidate list and grid");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER | CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -3682,6 +4030,7 @@ void CServer::RegisterCommands()
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_sql_read_workers", ConchainSqlReadWorkersUpdate, this);
 	Console()->Chain("access_level", ConchainCommandAccessUpdate, this);
 
 	Console()->Chain("sv_rcon_password", ConchainRconPasswordChange, this);
@@ -3718,6 +4067,7 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaSixup.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
@@ -3783,7 +4133,7 @@ int *CServer::GetIdMap(int ClientID)
 
 bool CServer::SetTimedOut(int ClientID, int OrigID)
 {
-	if(!m_NetServer.SetTimedOut(ClientID, OrigID))
+	if(m_Replaying || !m_NetServer.SetTimedOut(ClientID, OrigID))
 	{
 		return false;
 	}
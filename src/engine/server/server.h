@@ -11,6 +11,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
@@ -23,6 +24,8 @@
 
 #include "antibot.h"
 #include "authmanager.h"
+#include "input_ring.h"
+#include "map_chunks.h"
 #include "name_ban.h"
 
 #if defined(CONF_UPNP)
@@ -100,6 +103,7 @@ public:
 class CServer : public IServer
 {
 	friend class CServerLogger;
+	friend class CServerReplay;
 
 	class IGameServer *m_pGameServer;
 	class CConfig *m_pConfig;
@@ -156,12 +160,7 @@ public:
 			DNSBL_STATE_WHITELISTED,
 		};
 
-		class CInput
-		{
-		public:
-			int m_aData[MAX_INPUT_SIZE];
-			int m_GameTick; // the tick that was chosen for the input
-		};
+		typedef CInputRing::CInput CInput;
 
 		// connection state info
 		int m_State;
@@ -176,8 +175,19 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInputRing m_Inputs;
+
+		// input arrival stats since the client connected
+		int m_NumInputs;
+		int m_NumLateInputs; // intended for a tick that was already simulated
+		int m_NumEarlyInputs; // intended for a tick more than a second ahead
+		int m_NumExtraInputs; // not the first input for their tick
+		int m_NumInputTicks; // ticks simulated since the first input
+		int m_NumMissingInputs; // ticks simulated without an input
+		int m_MinInputTimeLeft;
+		int m_MaxInputTimeLeft;
+		int64_t m_InputTimeLeftSum;
+		int64_t m_InputTimeLeftSquaredSum;
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -188,6 +198,12 @@ public:
 		int m_AuthTries;
 		int m_NextMapChunk;
 		int m_Flags;
+
+		// map download stats, reset when the map is sent
+		int64_t m_MapDownloadStart;
+		int64_t m_MapDownloadEnd;
+		int m_MapDownloadBytes;
+		int m_MapDownloadChunks;
 		bool m_ShowIps;
 
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
@@ -213,11 +229,43 @@ public:
 		bool m_Sixup;
 	};
 
+	// shared by the snapshot storages of all clients, must outlive them
+	CSnapshotBufferPool m_SnapshotBufferPool;
 	CClient m_aClients[MAX_CLIENTS];
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDelta m_SnapshotDeltaSixup;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// per-client output of the snapshot delta and compression stage
+	class CSnapshotWork
+	{
+	public:
+		int m_DeltaTick;
+		int m_Crc;
+		int m_SnapshotSize;
+		int m_CompSize;
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+	std::unique_ptr<CSnapshotWork> m_apSnapshotWork[MAX_CLIENTS];
+	std::unique_ptr<CJobPool> m_pSnapJobPool;
+	int m_SnapJobThreads;
+	SEMAPHORE m_SnapJobsDone;
+
+	// main thread time spent in DoSnapshot
+	int64_t m_SnapTimeTotal;
+	int64_t m_SnapTimeMax;
+	int m_NumSnapTimes;
+	// stored snapshots and how many of them reused another client's buffer
+	int64_t m_NumStoredSnapshots;
+	int64_t m_NumSharedSnapshots;
+
+	bool m_SendBatching;
+	// network counters at the last net_syscalls
+	NETSTATS m_NetStatsStart;
+	int m_NetStatsStartTick;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -239,6 +287,8 @@ public:
 	};
 
 	int m_RunServer;
+	// driven by `CServerReplay` instead of the network, nothing is sent
+	bool m_Replaying;
 
 	bool m_MapReload;
 	bool m_ReloadedWhenEmpty;
@@ -251,15 +301,19 @@ public:
 	{
 		MAP_TYPE_SIX = 0,
 		MAP_TYPE_SIXUP,
-		NUM_MAP_TYPES
+		NUM_MAP_TYPES,
+
+		MAP_CHUNK_SIZE = CMapChunks::CHUNK_SIZE,
 	};
 
 	char m_aCurrentMap[IO_MAX_PATH_LENGTH];
 	SHA256_DIGEST m_aCurrentMapSha256[NUM_MAP_TYPES];
 	unsigned m_aCurrentMapCrc[NUM_MAP_TYPES];
-	unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
+	const unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
 
+	CMapChunks m_aMapChunks[NUM_MAP_TYPES];
+
 	CDemoRecorder m_aDemoRecorder[MAX_CLIENTS + 1];
 	CAuthManager m_AuthManager;
 
@@ -284,6 +338,7 @@ public:
 	void SetClientFlags(int ClientID, int Flags) override;
 
 	void Kick(int ClientID, const char *pReason) override;
+	void DropClient(int ClientID, const char *pReason);
 	void Ban(int ClientID, int Seconds, const char *pReason) override;
 
 	void DemoRecorder_HandleAutoStart() override;
@@ -314,8 +369,11 @@ public:
 
 	int GetClientVersion(int ClientID) const override;
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) override;
+	void SendPackedMsg(const void *pData, int Size, int Flags, int ClientID);
 
 	void DoSnapshot();
+	void CompressSnapshot(int ClientID);
+	int64_t BuildSnapshots(int Iterations, unsigned *pChecksum);
 
 	static int NewClientCallback(int ClientID, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -395,6 +453,12 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapBench(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapStats(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapStorage(IConsole::IResult *pResult, void *pUser);
+	static void ConNetSyscalls(IConsole::IResult *pResult, void *pUser);
+	static void ConMapDownloads(IConsole::IResult *pResult, void *pUser);
+	static void ConInputStats(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
@@ -414,6 +478,7 @@ public:
 	static void ConchainLoglevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainSqlReadWorkersUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainCommandAccessUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
 	void LogoutClient(int ClientID, const char *pReason);
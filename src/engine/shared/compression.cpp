@@ -6,6 +6,12 @@
 
 #include <iterator> // std::size
 
+#if defined(CONF_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i, int DstSize)
 {
@@ -75,6 +81,82 @@ long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int D
 	const int *pDstEnd = pDst + DstSize / sizeof(int);
 	while(pSrc < pSrcEnd)
 	{
+		// snapshot deltas are mostly small values, unpack runs of 16
+		// single byte ints at once
+#if defined(CONF_SIMD_SSE2)
+		if(pSrcEnd - pSrc >= 16 && pDstEnd - pDst >= 16)
+		{
+			const __m128i Bytes = _mm_loadu_si128((const __m128i *)pSrc);
+			if(_mm_movemask_epi8(Bytes) == 0)
+			{
+				const __m128i Zero = _mm_setzero_si128();
+				const __m128i Low = _mm_unpacklo_epi8(Bytes, Zero);
+				const __m128i High = _mm_unpackhi_epi8(Bytes, Zero);
+				const __m128i aWords[4] = {
+					_mm_unpacklo_epi16(Low, Zero),
+					_mm_unpackhi_epi16(Low, Zero),
+					_mm_unpacklo_epi16(High, Zero),
+					_mm_unpackhi_epi16(High, Zero),
+				};
+				for(int i = 0; i < 4; i++)
+				{
+					const __m128i Data = _mm_and_si128(aWords[i], _mm_set1_epi32(0x3F));
+					const __m128i Sign = _mm_srai_epi32(_mm_slli_epi32(aWords[i], 25), 31);
+					_mm_storeu_si128((__m128i *)(pDst + i * 4), _mm_xor_si128(Data, Sign));
+				}
+				pSrc += 16;
+				pDst += 16;
+				continue;
+			}
+
+			// do not retry the vector path for every byte of this block
+			const unsigned char *pBlockEnd = pSrc + 16;
+			while(pSrc < pBlockEnd && pDst < pDstEnd)
+			{
+				pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
+				if(!pSrc)
+					return -1;
+				pDst++;
+			}
+			continue;
+		}
+#elif defined(CONF_SIMD_NEON)
+		if(pSrcEnd - pSrc >= 16 && pDstEnd - pDst >= 16)
+		{
+			const uint8x16_t Bytes = vld1q_u8(pSrc);
+			if(vmaxvq_u8(Bytes) < 0x80)
+			{
+				const uint16x8_t Low = vmovl_u8(vget_low_u8(Bytes));
+				const uint16x8_t High = vmovl_u8(vget_high_u8(Bytes));
+				const int32x4_t aWords[4] = {
+					vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(Low))),
+					vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(Low))),
+					vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(High))),
+					vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(High))),
+				};
+				for(int i = 0; i < 4; i++)
+				{
+					const int32x4_t Data = vandq_s32(aWords[i], vdupq_n_s32(0x3F));
+					const int32x4_t Sign = vshrq_n_s32(vshlq_n_s32(aWords[i], 25), 31);
+					vst1q_s32(pDst + i * 4, veorq_s32(Data, Sign));
+				}
+				pSrc += 16;
+				pDst += 16;
+				continue;
+			}
+
+			// do not retry the vector path for every byte of this block
+			const unsigned char *pBlockEnd = pSrc + 16;
+			while(pSrc < pBlockEnd && pDst < pDstEnd)
+			{
+				pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
+				if(!pSrc)
+					return -1;
+				pDst++;
+			}
+			continue;
+		}
+#endif
 		if(pDst >= pDstEnd)
 			return -1;
 		pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
@@ -95,6 +177,78 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 	SrcSize /= sizeof(int);
 	while(SrcSize)
 	{
+		// pack runs of 16 ints that fit into a single byte at once
+#if defined(CONF_SIMD_SSE2)
+		if(SrcSize >= 16 && pDstEnd - pDst >= 16)
+		{
+			__m128i aBytes[4];
+			__m128i TooLarge = _mm_setzero_si128();
+			for(int i = 0; i < 4; i++)
+			{
+				const __m128i Value = _mm_loadu_si128((const __m128i *)(pSrc + i * 4));
+				const __m128i Sign = _mm_srai_epi32(Value, 31);
+				const __m128i Magnitude = _mm_xor_si128(Value, Sign);
+				TooLarge = _mm_or_si128(TooLarge, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32(0x3F)));
+				aBytes[i] = _mm_or_si128(Magnitude, _mm_and_si128(Sign, _mm_set1_epi32(0x40)));
+			}
+			if(_mm_movemask_epi8(TooLarge) == 0)
+			{
+				const __m128i Low = _mm_packs_epi32(aBytes[0], aBytes[1]);
+				const __m128i High = _mm_packs_epi32(aBytes[2], aBytes[3]);
+				_mm_storeu_si128((__m128i *)pDst, _mm_packus_epi16(Low, High));
+				pDst += 16;
+				pSrc += 16;
+				SrcSize -= 16;
+				continue;
+			}
+
+			// do not retry the vector path for every int of this block
+			for(int i = 0; i < 16; i++)
+			{
+				pDst = CVariableInt::Pack(pDst, pSrc[i], pDstEnd - pDst);
+				if(!pDst)
+					return -1;
+			}
+			pSrc += 16;
+			SrcSize -= 16;
+			continue;
+		}
+#elif defined(CONF_SIMD_NEON)
+		if(SrcSize >= 16 && pDstEnd - pDst >= 16)
+		{
+			uint16x4_t aBytes[4];
+			uint32x4_t TooLarge = vdupq_n_u32(0);
+			for(int i = 0; i < 4; i++)
+			{
+				const int32x4_t Value = vld1q_s32(pSrc + i * 4);
+				const int32x4_t Sign = vshrq_n_s32(Value, 31);
+				const int32x4_t Magnitude = veorq_s32(Value, Sign);
+				TooLarge = vorrq_u32(TooLarge, vcgtq_s32(Magnitude, vdupq_n_s32(0x3F)));
+				aBytes[i] = vmovn_u32(vreinterpretq_u32_s32(vorrq_s32(Magnitude, vandq_s32(Sign, vdupq_n_s32(0x40)))));
+			}
+			if(vmaxvq_u32(TooLarge) == 0)
+			{
+				const uint8x8_t Low = vmovn_u16(vcombine_u16(aBytes[0], aBytes[1]));
+				const uint8x8_t High = vmovn_u16(vcombine_u16(aBytes[2], aBytes[3]));
+				vst1q_u8(pDst, vcombine_u8(Low, High));
+				pDst += 16;
+				pSrc += 16;
+				SrcSize -= 16;
+				continue;
+			}
+
+			// do not retry the vector path for every int of this block
+			for(int i = 0; i < 16; i++)
+			{
+				pDst = CVariableInt::Pack(pDst, pSrc[i], pDstEnd - pDst);
+				if(!pDst)
+					return -1;
+			}
+			pSrc += 16;
+			SrcSize -= 16;
+			continue;
+		}
+#endif
 		pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
 		if(!pDst)
 			return -1;
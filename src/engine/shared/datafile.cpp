@@ -3,8 +3,8 @@
 
 #include "datafile.h"
 
-#include <base/hash_ctxt.h>
 #include <base/log.h>
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/storage.h>
 
@@ -80,6 +80,14 @@ struct CDatafileInfo
 struct CDatafile
 {
 	IOHANDLE m_File;
+
+	// the whole file, mapped or read into memory
+	unsigned char *m_pFileData;
+	unsigned m_FileSize;
+	bool m_FileMapped;
+
+	// the hashes are only calculated when they're needed
+	bool m_HashesValid;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
@@ -89,6 +97,14 @@ struct CDatafile
 	char *m_pData;
 };
 
+static void FreeFileData(void *pData, unsigned Size, bool Mapped)
+{
+	if(Mapped)
+		io_unmap(pData, Size);
+	else
+		free(pData);
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	log_trace("datafile", "loading. filename='%s'", pFilename);
@@ -100,44 +116,33 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
-	// take the CRC of the file and store it
-	unsigned Crc = 0;
-	SHA256_DIGEST Sha256;
+	// get the whole file into memory once, everything else works on that
+	void *pFileData;
+	unsigned FileSize;
+	bool FileMapped = io_map(File, &pFileData, &FileSize);
+	if(!FileMapped)
 	{
-		enum
-		{
-			BUFFER_SIZE = 64 * 1024
-		};
-
-		SHA256_CTX Sha256Ctxt;
-		sha256_init(&Sha256Ctxt);
-		unsigned char aBuffer[BUFFER_SIZE];
-
-		while(true)
-		{
-			unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
-			if(Bytes == 0)
-				break;
-			Crc = crc32(Crc, aBuffer, Bytes);
-			sha256_update(&Sha256Ctxt, aBuffer, Bytes);
-		}
-		Sha256 = sha256_finish(&Sha256Ctxt);
-
+		io_read_all(File, &pFileData, &FileSize);
 		io_seek(File, 0, IOSEEK_START);
 	}
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
+	if(FileSize < sizeof(Header))
 	{
 		dbg_msg("datafile", "couldn't load header");
+		FreeFileData(pFileData, FileSize, FileMapped);
+		io_close(File);
 		return false;
 	}
+	mem_copy(&Header, pFileData, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			FreeFileData(pFileData, FileSize, FileMapped);
+			io_close(File);
 			return false;
 		}
 	}
@@ -148,6 +153,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		FreeFileData(pFileData, FileSize, FileMapped);
+		io_close(File);
 		return false;
 	}
 
@@ -169,21 +176,25 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile + 1) + Header.m_NumRawData * sizeof(char *);
 	pTmpDataFile->m_File = File;
-	pTmpDataFile->m_Sha256 = Sha256;
-	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pFileData = (unsigned char *)pFileData;
+	pTmpDataFile->m_FileSize = FileSize;
+	pTmpDataFile->m_FileMapped = FileMapped;
+	pTmpDataFile->m_HashesValid = false;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
 
-	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	// copy types, offsets, sizes and item data
+	unsigned ReadSize = minimum(Size, FileSize - (unsigned)sizeof(Header));
 	if(ReadSize != Size)
 	{
+		FreeFileData(pFileData, FileSize, FileMapped);
 		io_close(pTmpDataFile->m_File);
 		free(pTmpDataFile);
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
 		return false;
 	}
+	mem_copy(pTmpDataFile->m_pData, (unsigned char *)pFileData + sizeof(Header), Size);
 
 	Close();
 	m_pDataFile = pTmpDataFile;
@@ -271,37 +282,40 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		int SwapSize = DataSize;
 #endif
 
+		// the data is read straight from the file contents, a truncated
+		// file only provides the bytes that are there
+		const unsigned char *pFileData = nullptr;
+		unsigned Available = 0;
+		unsigned Offset = m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+		if(m_pDataFile->m_Info.m_pDataOffsets[Index] >= 0 && Offset <= m_pDataFile->m_FileSize)
+		{
+			pFileData = m_pDataFile->m_pFileData + Offset;
+			Available = minimum(m_pDataFile->m_FileSize - Offset, (unsigned)maximum(DataSize, 0));
+		}
+
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = malloc(DataSize);
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
 
 			log_trace("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
 
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
-
 			// decompress the data, TODO: check for errors
 			s = UncompressedSize;
-			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef *)pTemp, DataSize);
+			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (const Bytef *)pFileData, Available);
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			SwapSize = s;
 #endif
-
-			// clean up the temporary buffers
-			free(pTemp);
 		}
 		else
 		{
 			// load the data
 			log_trace("datafile", "loading data index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			if(Available)
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pFileData, Available);
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -474,12 +488,22 @@ bool CDataFileReader::Close()
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 		free(m_pDataFile->m_ppDataPtrs[i]);
 
+	FreeFileData(m_pDataFile->m_pFileData, m_pDataFile->m_FileSize, m_pDataFile->m_FileMapped);
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
 }
 
+void CDataFileReader::CalculateHashes() const
+{
+	if(m_pDataFile->m_HashesValid)
+		return;
+	m_pDataFile->m_Sha256 = sha256(m_pDataFile->m_pFileData, m_pDataFile->m_FileSize);
+	m_pDataFile->m_Crc = crc32(0, m_pDataFile->m_pFileData, m_pDataFile->m_FileSize);
+	m_pDataFile->m_HashesValid = true;
+}
+
 SHA256_DIGEST CDataFileReader::Sha256() const
 {
 	if(!m_pDataFile)
@@ -491,6 +515,7 @@ SHA256_DIGEST CDataFileReader::Sha256() const
 		}
 		return Result;
 	}
+	CalculateHashes();
 	return m_pDataFile->m_Sha256;
 }
 
@@ -498,6 +523,7 @@ unsigned CDataFileReader::Crc() const
 {
 	if(!m_pDataFile)
 		return 0xFFFFFFFF;
+	CalculateHashes();
 	return m_pDataFile->m_Crc;
 }
 
@@ -508,6 +534,20 @@ int CDataFileReader::MapSize() const
 	return m_pDataFile->m_Header.m_Size + 16;
 }
 
+const unsigned char *CDataFileReader::FileData() const
+{
+	if(!m_pDataFile)
+		return 0;
+	return m_pDataFile->m_pFileData;
+}
+
+unsigned CDataFileReader::FileSize() const
+{
+	if(!m_pDataFile)
+		return 0;
+	return m_pDataFile->m_FileSize;
+}
+
 IOHANDLE CDataFileReader::File()
 {
 	if(!m_pDataFile)
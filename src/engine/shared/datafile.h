@@ -25,6 +25,8 @@ class CDataFileReader
 	int GetExternalItemType(int InternalType);
 	int GetInternalItemType(int ExternalType);
 
+	void CalculateHashes() const;
+
 public:
 	CDataFileReader() :
 		m_pDataFile(nullptr) {}
@@ -51,6 +53,8 @@ public:
 	SHA256_DIGEST Sha256() const;
 	unsigned Crc() const;
 	int MapSize() const;
+	const unsigned char *FileData() const; // the complete file, valid until Close
+	unsigned FileSize() const;
 	IOHANDLE File();
 };
 
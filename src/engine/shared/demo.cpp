@@ -45,7 +45,7 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapDat
 }
 
 // Record
-int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, SHA256_DIGEST *pSha256, unsigned Crc, const char *pType, unsigned MapSize, unsigned char *pMapData, IOHANDLE MapFile, DEMOFUNC_FILTER pfnFilter, void *pUser)
+int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, SHA256_DIGEST *pSha256, unsigned Crc, const char *pType, unsigned MapSize, const unsigned char *pMapData, IOHANDLE MapFile, DEMOFUNC_FILTER pfnFilter, void *pUser)
 {
 	m_pfnFilter = pfnFilter;
 	m_pUser = pUser;
@@ -655,6 +655,21 @@ void CDemoPlayer::DoTick()
 		{
 			// process full snapshot
 			CSnapshot *pSnap = (CSnapshot *)s_aData;
+			if(pSnap->IsValidLayout(DataSize) && !pSnap->IsSorted())
+			{
+				// demos of older versions don't have their items sorted by key
+				CSnapshotBuilder Builder;
+				Builder.Init();
+				for(int i = 0; i < pSnap->NumItems(); i++)
+				{
+					const CSnapshotItem *pItem = pSnap->GetItem(i);
+					const int ItemSize = pSnap->GetItemSize(i);
+					void *pObj = Builder.NewItem(pItem->Type(), pItem->ID(), ItemSize);
+					if(pObj)
+						mem_copy(pObj, pItem->Data(), ItemSize);
+				}
+				DataSize = Builder.Finish(s_aData);
+			}
 			if(!pSnap->IsValid(DataSize))
 			{
 				if(m_pConsole)
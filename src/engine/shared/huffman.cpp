@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <base/system.h>
 
+#include <cstdint>
+
 const unsigned CHuffman::ms_aFreqTable[HUFFMAN_MAX_SYMBOLS] = {
 	1 << 30, 4545, 2657, 431, 1950, 919, 444, 482, 2244, 617, 838, 542, 715, 1814, 304, 240, 754, 212, 647, 186,
 	283, 131, 146, 166, 543, 164, 167, 136, 179, 859, 363, 113, 157, 154, 204, 108, 137, 180, 202, 176,
@@ -88,6 +90,10 @@ void CHuffman::ConstructTree(const unsigned *pFrequencies)
 
 	// build symbol bits
 	Setbits_r(m_pStartNode, 0, 0);
+
+	m_MaxCodeBits = 0;
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		m_MaxCodeBits = std::max(m_MaxCodeBits, m_aNodes[i].m_NumBits);
 }
 
 void CHuffman::Init(const unsigned *pFrequencies)
@@ -125,79 +131,94 @@ void CHuffman::Init(const unsigned *pFrequencies)
 		if(k == HUFFMAN_LUTBITS)
 			m_apDecodeLut[i] = pNode;
 	}
+
+	BuildDecodeTable();
+}
+
+void CHuffman::BuildDecodeTable()
+{
+	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+
+	for(int i = 0; i < HUFFMAN_TABLESIZE; i++)
+	{
+		CDecodeEntry &Entry = m_aDecodeTable[i];
+		mem_zero(&Entry, sizeof(Entry));
+
+		// decode as many complete symbols as fit into the index bits
+		int Pos = 0;
+		while(Entry.m_NumSymbols < HUFFMAN_TABLE_MAX_SYMBOLS)
+		{
+			const CNode *pNode = m_pStartNode;
+			int k = Pos;
+			while(!pNode->m_NumBits && k < HUFFMAN_TABLEBITS)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[(i >> k) & 1]];
+				k++;
+			}
+
+			// long codes and EOF are left to the slow path
+			if(!pNode->m_NumBits || pNode == pEof)
+				break;
+
+			Entry.m_aSymbols[Entry.m_NumSymbols++] = pNode->m_Symbol;
+			Pos = k;
+		}
+		Entry.m_NumBits = Pos;
+	}
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	do \
-	{ \
-		Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-		Bitcount += m_aNodes[Sym].m_NumBits; \
-	} while(0)
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	do \
-	{ \
-		while(Bitcount >= 8) \
-		{ \
-			*pDst++ = (unsigned char)(Bits & 0xff); \
-			if(pDst == pDstEnd) \
-				return -1; \
-			Bits >>= 8; \
-			Bitcount -= 8; \
-		} \
-	} while(0)
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// symbols are collected in a 64 bit buffer and written out 32 bits at
+	// a time, there's always room for another symbol below 32 bits
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	while(pSrc != pSrcEnd)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode *pNode = &m_aNodes[*pSrc++];
+		Bits |= (uint64_t)pNode->m_Bits << Bitcount;
+		Bitcount += pNode->m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE();
+			// the last byte is always written, so keep one byte spare
+			if(pDstEnd - pDst <= 4)
+				return -1;
+			pDst[0] = (unsigned char)Bits;
+			pDst[1] = (unsigned char)(Bits >> 8);
+			pDst[2] = (unsigned char)(Bits >> 16);
+			pDst[3] = (unsigned char)(Bits >> 24);
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-		HUFFMAN_MACRO_WRITE();
 	}
 
 	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL);
-	HUFFMAN_MACRO_WRITE();
+	Bits |= (uint64_t)m_aNodes[HUFFMAN_EOF_SYMBOL].m_Bits << Bitcount;
+	Bitcount += m_aNodes[HUFFMAN_EOF_SYMBOL].m_NumBits;
+	while(Bitcount >= 8)
+	{
+		*pDst++ = (unsigned char)Bits;
+		if(pDst == pDstEnd)
+			return -1;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
 
 	// write out the last bits
-	*pDst++ = Bits;
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -209,10 +230,67 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 	unsigned char *pDstEnd = pDst + OutputSize;
 	unsigned char *pSrcEnd = pSrc + InputSize;
 
+	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+
+	// fast path: while at least 8 input bytes and a full table entry of
+	// output are left, look up the next bits in the decode table, which
+	// yields up to HUFFMAN_TABLE_MAX_SYMBOLS symbols at once
+	const unsigned MinBitcount = std::max<unsigned>(m_MaxCodeBits, HUFFMAN_TABLEBITS);
+	unsigned BitOffset = 0;
+	while(pSrcEnd - pSrc >= 8 && pDstEnd - pDst >= HUFFMAN_TABLE_MAX_SYMBOLS)
+	{
+		uint64_t Bits = 0;
+		for(int i = 0; i < 8; i++)
+			Bits |= (uint64_t)pSrc[i] << (i * 8);
+		Bits >>= BitOffset;
+		const unsigned Loaded = 64 - BitOffset;
+
+		// decode while the buffer holds the longest code and a full lookup
+		unsigned Bitcount = Loaded;
+		while(Bitcount >= MinBitcount && pDstEnd - pDst >= HUFFMAN_TABLE_MAX_SYMBOLS)
+		{
+			unsigned Consumed;
+			const CDecodeEntry &Entry = m_aDecodeTable[Bits & HUFFMAN_TABLEMASK];
+			if(Entry.m_NumSymbols)
+			{
+				mem_copy(pDst, Entry.m_aSymbols, HUFFMAN_TABLE_MAX_SYMBOLS);
+				pDst += Entry.m_NumSymbols;
+				Consumed = Entry.m_NumBits;
+			}
+			else
+			{
+				// long code or EOF, walk the tree from the end of the lut
+				const CNode *pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+				if(pNode->m_NumBits)
+					Consumed = pNode->m_NumBits;
+				else
+				{
+					Consumed = HUFFMAN_LUTBITS;
+					while(!pNode->m_NumBits)
+						pNode = &m_aNodes[pNode->m_aLeafs[(Bits >> Consumed++) & 1]];
+				}
+
+				if(pNode == pEof)
+					return (int)(pDst - (const unsigned char *)pOutput);
+				*pDst++ = pNode->m_Symbol;
+			}
+			Bits >>= Consumed;
+			Bitcount -= Consumed;
+		}
+
+		BitOffset += Loaded - Bitcount;
+		pSrc += BitOffset >> 3;
+		BitOffset &= 7;
+	}
+
+	// continue bit by bit for the rest of the input
 	unsigned Bits = 0;
 	unsigned Bitcount = 0;
-
-	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+	if(BitOffset)
+	{
+		Bits = *pSrc++ >> BitOffset;
+		Bitcount = 8 - BitOffset;
+	}
 
 	while(true)
 	{
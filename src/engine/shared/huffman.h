@@ -14,7 +14,13 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+
+		// multi symbol decode table
+		HUFFMAN_TABLEBITS = 12,
+		HUFFMAN_TABLESIZE = (1 << HUFFMAN_TABLEBITS),
+		HUFFMAN_TABLEMASK = (HUFFMAN_TABLESIZE - 1),
+		HUFFMAN_TABLE_MAX_SYMBOLS = 4
 	};
 
 	struct CNode
@@ -30,15 +36,28 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	struct CDecodeEntry
+	{
+		// the symbols fully contained in the looked up bits, EOF excluded
+		unsigned char m_aSymbols[HUFFMAN_TABLE_MAX_SYMBOLS];
+		unsigned char m_NumSymbols;
+
+		// number of bits used by the symbols
+		unsigned char m_NumBits;
+	};
+
 	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
 	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeTable[HUFFMAN_TABLESIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
+	unsigned m_MaxCodeBits;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
+	void BuildDecodeTable();
 
 public:
 	/*
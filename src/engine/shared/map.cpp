@@ -75,6 +75,16 @@ int CMap::MapSize()
 	return m_DataFile.MapSize();
 }
 
+const unsigned char *CMap::FileData()
+{
+	return m_DataFile.FileData();
+}
+
+unsigned CMap::FileSize()
+{
+	return m_DataFile.FileSize();
+}
+
 IOHANDLE CMap::File()
 {
 	return m_DataFile.File();
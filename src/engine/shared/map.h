@@ -36,6 +36,8 @@ public:
 	unsigned Crc() override;
 
 	int MapSize() override;
+	const unsigned char *FileData() override;
+	unsigned FileSize() override;
 
 	IOHANDLE File() override;
 };
@@ -367,6 +367,16 @@ class CNetServer
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
+	enum
+	{
+		SLOT_HASH_SIZE = 256,
+	};
+	// slots chained by the hash of their peer ip, the port is ignored so
+	// that lookups with and without port can use the same buckets
+	int m_aSlotHashFirst[SLOT_HASH_SIZE];
+	int m_aSlotHashNext[NET_MAX_CLIENTS];
+	int m_aSlotHash[NET_MAX_CLIENTS];
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -391,6 +401,8 @@ class CNetServer
 	void OnConnCtrlMsg(NETADDR &Addr, int ClientID, int ControlMsg, const CNetPacketConstruct &Packet);
 	bool ClientExists(const NETADDR &Addr) { return GetClientSlot(Addr) != -1; }
 	int GetClientSlot(const NETADDR &Addr);
+	static int SlotHash(const NETADDR &Addr);
+	void UpdateSlotHash(int Slot);
 	void SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken);
 
 	int TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth = false, bool Sixup = false, SECURITY_TOKEN Token = 0);
@@ -411,6 +423,10 @@ public:
 	int Send(CNetChunk *pChunk);
 	int Update();
 
+	// queue outgoing packets until FlushSend instead of a syscall per packet
+	void SetSendBatching(bool Batching) { net_udp_set_batching(m_Socket, Batching); }
+	int FlushSend() { return net_udp_flush(m_Socket); }
+
 	//
 	int Drop(int ClientID, const char *pReason);
 
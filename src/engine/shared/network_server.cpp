@@ -70,6 +70,14 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	for(auto &Slot : m_aSlots)
 		Slot.m_Connection.Init(m_Socket, true);
 
+	for(auto &First : m_aSlotHashFirst)
+		First = -1;
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		m_aSlotHashNext[i] = -1;
+		m_aSlotHash[i] = -1;
+	}
+
 	return true;
 }
 
@@ -155,7 +163,7 @@ void CNetServer::SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra,
 int CNetServer::NumClientsWithAddr(NETADDR Addr)
 {
 	int FoundAddr = 0;
-	for(int i = 0; i < MaxClients(); ++i)
+	for(int i = m_aSlotHashFirst[SlotHash(Addr)]; i != -1; i = m_aSlotHashNext[i])
 	{
 		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE ||
 			(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR &&
@@ -248,6 +256,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 
 	// init connection slot
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken, Token, Sixup);
+	UpdateSlotHash(Slot);
 
 	if(VanillaAuth)
 	{
@@ -578,12 +587,13 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
 	int Slot = -1;
 
-	for(int i = 0; i < MaxClients(); i++)
+	// the highest matching slot wins, like with the linear search
+	for(int i = m_aSlotHashFirst[SlotHash(Addr)]; i != -1; i = m_aSlotHashNext[i])
 	{
-		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
+		if(i > Slot &&
+			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
 			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
 			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-
 		{
 			Slot = i;
 		}
@@ -592,6 +602,33 @@ int CNetServer::GetClientSlot(const NETADDR &Addr)
 	return Slot;
 }
 
+int CNetServer::SlotHash(const NETADDR &Addr)
+{
+	const int Length = Addr.type == NETTYPE_IPV6 ? 16 : 4;
+	unsigned Hash = 2166136261u;
+	for(int i = 0; i < Length; i++)
+		Hash = (Hash ^ Addr.ip[i]) * 16777619u;
+	return (Hash ^ (Hash >> 16)) & (SLOT_HASH_SIZE - 1);
+}
+
+void CNetServer::UpdateSlotHash(int Slot)
+{
+	// the peer address of a slot only changes in TryAcceptClient and
+	// SetTimedOut, offline slots stay in the index and are skipped on lookup
+	if(m_aSlotHash[Slot] != -1)
+	{
+		int *pLink = &m_aSlotHashFirst[m_aSlotHash[Slot]];
+		while(*pLink != Slot)
+			pLink = &m_aSlotHashNext[*pLink];
+		*pLink = m_aSlotHashNext[Slot];
+	}
+
+	const int Hash = SlotHash(*m_aSlots[Slot].m_Connection.PeerAddress());
+	m_aSlotHash[Slot] = Hash;
+	m_aSlotHashNext[Slot] = m_aSlotHashFirst[Hash];
+	m_aSlotHashFirst[Hash] = Slot;
+}
+
 static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 {
 	if(!(pPacket->m_Flags & NET_PACKETFLAG_CONTROL) || pPacket->m_DataSize < 1)
@@ -796,6 +833,7 @@ bool CNetServer::SetTimedOut(int ClientID, int OrigID)
 
 	m_aSlots[ClientID].m_Connection.SetTimedOut(ClientAddr(OrigID), m_aSlots[OrigID].m_Connection.SeqSequence(), m_aSlots[OrigID].m_Connection.AckSequence(), m_aSlots[OrigID].m_Connection.SecurityToken(), m_aSlots[OrigID].m_Connection.ResendBuffer(), m_aSlots[OrigID].m_Connection.m_Sixup);
 	m_aSlots[OrigID].m_Connection.Reset();
+	UpdateSlotHash(ClientID);
 	return true;
 }
 
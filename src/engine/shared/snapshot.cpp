@@ -4,12 +4,20 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 
+#include <base/math.h>
 #include <base/system.h>
 #include <game/generated/protocolglue.h>
 
+#if defined(CONF_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 // CSnapshot
 
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -50,17 +58,40 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 	return g_UuidManager.LookupUuid(Uuid);
 }
 
-int CSnapshot::GetItemIndex(int Key) const
+int CSnapshot::LowerBound(int Key) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
-	for(int i = 0; i < m_NumItems; i++)
+	// items are sorted by key, see CSnapshotBuilder::Finish
+	int Low = 0;
+	int High = m_NumItems;
+	while(Low < High)
 	{
-		if(GetItem(i)->Key() == Key)
-			return i;
+		int Mid = Low + (High - Low) / 2;
+		if(GetItem(Mid)->Key() < Key)
+			Low = Mid + 1;
+		else
+			High = Mid;
 	}
+	return Low;
+}
+
+int CSnapshot::GetItemIndex(int Key) const
+{
+	int Index = LowerBound(Key);
+	if(Index < m_NumItems && GetItem(Index)->Key() == Key)
+		return Index;
 	return -1;
 }
 
+bool CSnapshot::IsSorted() const
+{
+	for(int i = 1; i < m_NumItems; i++)
+	{
+		if(GetItem(i - 1)->Key() > GetItem(i)->Key())
+			return false;
+	}
+	return true;
+}
+
 const void *CSnapshot::FindItem(int Type, int ID) const
 {
 	int InternalType = Type;
@@ -71,18 +102,18 @@ const void *CSnapshot::FindItem(int Type, int ID) const
 		for(int i = 0; i < (int)sizeof(CUuid) / 4; i++)
 			aTypeUuidItem[i] = bytes_be_to_int(&TypeUuid.m_aData[i * 4]);
 
+		// the NETOBJTYPE_EX items are the ones with type 0 and a high ID
 		bool Found = false;
-		for(int i = 0; i < m_NumItems; i++)
+		for(int i = LowerBound(OFFSET_UUID_TYPE); i < m_NumItems; i++)
 		{
 			const CSnapshotItem *pItem = GetItem(i);
-			if(pItem->Type() == 0 && pItem->ID() >= OFFSET_UUID_TYPE) // NETOBJTYPE_EX
+			if(pItem->Type() != 0)
+				break;
+			if(mem_comp(pItem->Data(), aTypeUuidItem, sizeof(CUuid)) == 0)
 			{
-				if(mem_comp(pItem->Data(), aTypeUuidItem, sizeof(CUuid)) == 0)
-				{
-					InternalType = pItem->ID();
-					Found = true;
-					break;
-				}
+				InternalType = pItem->ID();
+				Found = true;
+				break;
 			}
 		}
 		if(!Found)
@@ -123,6 +154,12 @@ void CSnapshot::DebugDump()
 }
 
 bool CSnapshot::IsValid(size_t ActualSize) const
+{
+	// lookups rely on the items being sorted by key
+	return IsValidLayout(ActualSize) && IsSorted();
+}
+
+bool CSnapshot::IsValidLayout(size_t ActualSize) const
 {
 	// validate total size
 	if(ActualSize < sizeof(CSnapshot) || m_NumItems < 0 || m_DataSize < 0 || ActualSize != TotalSize())
@@ -144,61 +181,31 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 
 // CSnapshotDelta
 
-enum
-{
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
-
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
-
-inline size_t CalcHashID(int Key)
-{
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
-}
-
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	int Needed = 0;
+#if defined(CONF_SIMD_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4, pPast += 4, pCurrent += 4, pOut += 4)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashID = CalcHashID(Key);
-		if(pHashlist[HashID].m_Num < HASHLIST_BUCKET_SIZE)
-		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
-		}
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)pCurrent), _mm_loadu_si128((const __m128i *)pPast));
+		_mm_storeu_si128((__m128i *)pOut, Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
 	}
-}
-
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
-{
-	size_t HashID = CalcHashID(Key);
-	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	NeededVec = _mm_or_si128(NeededVec, _mm_shuffle_epi32(NeededVec, _MM_SHUFFLE(1, 0, 3, 2)));
+	NeededVec = _mm_or_si128(NeededVec, _mm_shuffle_epi32(NeededVec, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(NeededVec);
+#elif defined(CONF_SIMD_NEON)
+	int32x4_t NeededVec = vdupq_n_s32(0);
+	for(; Size >= 4; Size -= 4, pPast += 4, pCurrent += 4, pOut += 4)
 	{
-		if(pHashlist[HashID].m_aKeys[i] == Key)
-			return pHashlist[HashID].m_aIndex[i];
+		const int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent), vld1q_s32(pPast));
+		vst1q_s32(pOut, Diff);
+		NeededVec = vorrq_s32(NeededVec, Diff);
 	}
-
-	return -1;
-}
-
-int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
-{
-	int Needed = 0;
+	const int32x2_t NeededHalf = vorr_s32(vget_low_s32(NeededVec), vget_high_s32(NeededVec));
+	Needed = vget_lane_s32(NeededHalf, 0) | vget_lane_s32(NeededHalf, 1);
+#endif
 	while(Size)
 	{
 		*pOut = *pCurrent - *pPast;
@@ -214,6 +221,49 @@ int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, i
 
 void CSnapshotDelta::UndiffItem(const int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate)
 {
+	// the data rate counts one bit per unchanged int and the packed
+	// size of every changed one
+#if defined(CONF_SIMD_SSE2)
+	const __m128i Zero = _mm_setzero_si128();
+	__m128i DataRate = Zero;
+	for(; Size >= 4; Size -= 4, pPast += 4, pDiff += 4, pOut += 4)
+	{
+		const __m128i Diff = _mm_loadu_si128((const __m128i *)pDiff);
+		_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pPast), Diff));
+
+		// packed bytes are 1 + one per threshold the magnitude reaches,
+		// the comparisons yield -1 per threshold
+		const __m128i Magnitude = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		__m128i Bytes = _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 6) - 1));
+		Bytes = _mm_add_epi32(Bytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 13) - 1)));
+		Bytes = _mm_add_epi32(Bytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 20) - 1)));
+		Bytes = _mm_add_epi32(Bytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 27) - 1)));
+		const __m128i Bits = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(1), Bytes), 3);
+		const __m128i IsZero = _mm_cmpeq_epi32(Diff, Zero);
+		DataRate = _mm_add_epi32(DataRate, _mm_or_si128(_mm_andnot_si128(IsZero, Bits), _mm_and_si128(IsZero, _mm_set1_epi32(1))));
+	}
+	DataRate = _mm_add_epi32(DataRate, _mm_shuffle_epi32(DataRate, _MM_SHUFFLE(1, 0, 3, 2)));
+	DataRate = _mm_add_epi32(DataRate, _mm_shuffle_epi32(DataRate, _MM_SHUFFLE(2, 3, 0, 1)));
+	*pDataRate += _mm_cvtsi128_si32(DataRate);
+#elif defined(CONF_SIMD_NEON)
+	int32x4_t DataRate = vdupq_n_s32(0);
+	for(; Size >= 4; Size -= 4, pPast += 4, pDiff += 4, pOut += 4)
+	{
+		const int32x4_t Diff = vld1q_s32(pDiff);
+		vst1q_s32(pOut, vaddq_s32(vld1q_s32(pPast), Diff));
+
+		const int32x4_t Magnitude = veorq_s32(Diff, vshrq_n_s32(Diff, 31));
+		int32x4_t Bytes = vreinterpretq_s32_u32(vcgtq_s32(Magnitude, vdupq_n_s32((1 << 6) - 1)));
+		Bytes = vaddq_s32(Bytes, vreinterpretq_s32_u32(vcgtq_s32(Magnitude, vdupq_n_s32((1 << 13) - 1))));
+		Bytes = vaddq_s32(Bytes, vreinterpretq_s32_u32(vcgtq_s32(Magnitude, vdupq_n_s32((1 << 20) - 1))));
+		Bytes = vaddq_s32(Bytes, vreinterpretq_s32_u32(vcgtq_s32(Magnitude, vdupq_n_s32((1 << 27) - 1))));
+		const int32x4_t Bits = vshlq_n_s32(vsubq_s32(vdupq_n_s32(1), Bytes), 3);
+		const uint32x4_t IsZero = vceqq_s32(Diff, vdupq_n_s32(0));
+		DataRate = vaddq_s32(DataRate, vbslq_s32(IsZero, vdupq_n_s32(1), Bits));
+	}
+	const int32x2_t DataRateHalf = vadd_s32(vget_low_s32(DataRate), vget_high_s32(DataRate));
+	*pDataRate += vget_lane_s32(DataRateHalf, 0) + vget_lane_s32(DataRateHalf, 1);
+#endif
 	while(Size)
 	{
 		*pOut = *pPast + *pDiff;
@@ -262,7 +312,6 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -272,32 +321,34 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	// both snapshots are sorted by key, so matching items is a linear merge
+	const int NumFromItems = pFrom->NumItems();
+	const int NumItems = pTo->NumItems();
 
 	// pack deleted stuff
-	for(int i = 0; i < pFrom->NumItems(); i++)
+	for(int i = 0, j = 0; i < NumFromItems; i++)
 	{
-		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		const int Key = pFrom->GetItem(i)->Key();
+		while(j < NumItems && pTo->GetItem(j)->Key() < Key)
+			j++;
+		if(j == NumItems || pTo->GetItem(j)->Key() != Key)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
-			*pData = pFromItem->Key();
+			*pData = Key;
 			pData++;
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
 	int aPastIndices[CSnapshot::MAX_ITEMS];
-	const int NumItems = pTo->NumItems();
-	for(int i = 0; i < NumItems; i++)
+	for(int i = 0, j = 0; i < NumItems; i++)
 	{
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		const int Key = pTo->GetItem(i)->Key();
+		while(j < NumFromItems && pFrom->GetItem(j)->Key() < Key)
+			j++;
+		aPastIndices[i] = j < NumFromItems && pFrom->GetItem(j)->Key() == Key ? j : -1;
 	}
 
 	for(int i = 0; i < NumItems; i++)
@@ -364,28 +415,29 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 
 	// unpack deleted stuff
 	int *pDeleted = pData;
-	if(pDelta->m_NumDeletedItems < 0)
+	if(pDelta->m_NumDeletedItems < 0 || pDelta->m_NumDeletedItems > CSnapshot::MAX_ITEMS)
 		return -1;
 	pData += pDelta->m_NumDeletedItems;
 	if(pData > pEnd)
 		return -1;
 
+	// the deleted keys are not necessarily sorted, older servers send them
+	// in the order of their own snapshots
+	int aDeleted[CSnapshot::MAX_ITEMS];
+	const int NumDeleted = pDelta->m_NumDeletedItems;
+	mem_copy(aDeleted, pDeleted, NumDeleted * sizeof(int));
+	std::sort(aDeleted, aDeleted + NumDeleted);
+
 	// copy all non deleted stuff
+	int d = 0;
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
 		const int ItemSize = pFrom->GetItemSize(i);
-		bool Keep = true;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = false;
-				break;
-			}
-		}
-
-		if(Keep)
+		const int Key = pFromItem->Key();
+		while(d < NumDeleted && aDeleted[d] < Key)
+			d++;
+		if(d == NumDeleted || aDeleted[d] != Key)
 		{
 			void *pObj = Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize);
 			if(!pObj)
@@ -396,6 +448,12 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 		}
 	}
 
+	// the kept items are sorted. updates of newer servers come sorted as
+	// well, so an update can only refer to an item added by an earlier one
+	// if the keys are out of order
+	const int NumKeptItems = Builder.NumItems();
+	int LastKey = -1;
+
 	// unpack updated stuff
 	for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
 	{
@@ -428,7 +486,8 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 		const int Key = (Type << 16) | ID;
 
 		// create the item if needed
-		int *pNewData = Builder.GetItemData(Key);
+		int *pNewData = Key > LastKey ? Builder.GetItemData(Key, NumKeptItems) : Builder.GetItemData(Key);
+		LastKey = maximum(LastKey, Key);
 		if(!pNewData)
 			pNewData = (int *)Builder.NewItem(Type, ID, ItemSize);
 
@@ -457,84 +516,176 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 
 // CSnapshotStorage
 
-void CSnapshotStorage::Init()
+// CSnapshotBufferPool
+
+CSnapshotBufferPool::CSnapshotBufferPool()
 {
-	m_pFirst = 0;
-	m_pLast = 0;
+	mem_zero(m_apFree, sizeof(m_apFree));
+	m_NumBuffers = 0;
+	m_NumUsedBuffers = 0;
+	m_AllocatedBytes = 0;
+	m_UsedBytes = 0;
 }
 
-void CSnapshotStorage::PurgeAll()
+CSnapshotBufferPool::~CSnapshotBufferPool()
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
-	{
-		CHolder *pNext = pHolder->m_pNext;
-		free(pHolder);
-		pHolder = pNext;
-	}
+	dbg_assert(m_NumUsedBuffers == 0, "snapshot buffers still in use");
+	Trim();
+}
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+int CSnapshotBufferPool::SizeClass(int Size)
+{
+	const size_t Needed = sizeof(CSnapshotBuffer) + Size;
+	int SizeClass = 0;
+	while(ClassSize(SizeClass) < Needed)
+		SizeClass++;
+	return SizeClass;
 }
 
-void CSnapshotStorage::PurgeUntil(int Tick)
+CSnapshotBuffer *CSnapshotBufferPool::New(const void *pData, int Size)
 {
-	CHolder *pHolder = m_pFirst;
+	const int Class = SizeClass(Size);
+	dbg_assert(Class < NUM_SIZE_CLASSES, "snapshot too large for pool");
 
-	while(pHolder)
+	CSnapshotBuffer *pBuffer = m_apFree[Class];
+	if(pBuffer)
+		m_apFree[Class] = pBuffer->m_pNextFree;
+	else
 	{
-		CHolder *pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		free(pHolder);
+		pBuffer = (CSnapshotBuffer *)malloc(ClassSize(Class));
+		pBuffer->m_SizeClass = Class;
+		m_NumBuffers++;
+		m_AllocatedBytes += ClassSize(Class);
+	}
+	pBuffer->m_pNextFree = 0;
+	pBuffer->m_Refcount = 1;
+	pBuffer->m_Size = Size;
+	mem_copy(pBuffer->Snap(), pData, Size);
 
-		// did we come to the end of the list?
-		if(!pNext)
-			break;
+	m_NumUsedBuffers++;
+	m_UsedBytes += ClassSize(Class);
+	return pBuffer;
+}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = 0x0;
+void CSnapshotBufferPool::Release(CSnapshotBuffer *pBuffer)
+{
+	dbg_assert(pBuffer->m_Refcount > 0, "snapshot buffer released too often");
+	if(--pBuffer->m_Refcount > 0)
+		return;
+
+	pBuffer->m_pNextFree = m_apFree[pBuffer->m_SizeClass];
+	m_apFree[pBuffer->m_SizeClass] = pBuffer;
+	m_NumUsedBuffers--;
+	m_UsedBytes -= ClassSize(pBuffer->m_SizeClass);
+}
 
-		pHolder = pNext;
+void CSnapshotBufferPool::Trim()
+{
+	for(int Class = 0; Class < NUM_SIZE_CLASSES; Class++)
+	{
+		while(m_apFree[Class])
+		{
+			CSnapshotBuffer *pNext = m_apFree[Class]->m_pNextFree;
+			free(m_apFree[Class]);
+			m_apFree[Class] = pNext;
+			m_NumBuffers--;
+			m_AllocatedBytes -= ClassSize(Class);
+		}
 	}
+}
 
-	// no more snapshots in storage
+// CSnapshotStorage
+
+CSnapshotStorage::CSnapshotStorage()
+{
 	m_pFirst = 0;
 	m_pLast = 0;
+	m_pPool = &m_OwnPool;
+	m_pFirstFree = 0;
+	m_NumHolders = 0;
+	m_NumFreeHolders = 0;
+	mem_zero(m_apTickIndex, sizeof(m_apTickIndex));
+	m_NumUnindexed = 0;
 }
 
-void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData, int AltDataSize, void *pAltData)
+CSnapshotStorage::~CSnapshotStorage()
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder) + DataSize;
-
-	if(AltDataSize > 0)
+	PurgeAll();
+	while(m_pFirstFree)
 	{
-		TotalSize += AltDataSize;
+		CHolder *pNext = m_pFirstFree->m_pNext;
+		free(m_pFirstFree);
+		m_pFirstFree = pNext;
 	}
+}
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+void CSnapshotStorage::Init(CSnapshotBufferPool *pPool)
+{
+	PurgeAll();
+	m_pPool = pPool ? pPool : &m_OwnPool;
+}
 
-	// set data
-	pHolder->m_Tick = Tick;
-	pHolder->m_Tagtime = Tagtime;
-	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot *)(pHolder + 1);
-	mem_copy(pHolder->m_pSnap, pData, DataSize);
+void CSnapshotStorage::Remove(CHolder *pHolder)
+{
+	// unlink
+	if(pHolder->m_pPrev)
+		pHolder->m_pPrev->m_pNext = pHolder->m_pNext;
+	else
+		m_pFirst = pHolder->m_pNext;
+	if(pHolder->m_pNext)
+		pHolder->m_pNext->m_pPrev = pHolder->m_pPrev;
+	else
+		m_pLast = pHolder->m_pPrev;
 
-	if(AltDataSize > 0) // create alternative if wanted
-	{
-		pHolder->m_pAltSnap = (CSnapshot *)(((char *)pHolder->m_pSnap) + DataSize);
-		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
-		pHolder->m_AltSnapSize = AltDataSize;
-	}
+	CHolder *&pIndexed = m_apTickIndex[pHolder->m_Tick & (TICK_INDEX_SIZE - 1)];
+	if(pIndexed == pHolder)
+		pIndexed = 0;
 	else
+		m_NumUnindexed--;
+
+	if(pHolder->m_pBuffer)
+		m_pPool->Release(pHolder->m_pBuffer);
+	if(pHolder->m_pAltBuffer)
+		m_pPool->Release(pHolder->m_pAltBuffer);
+
+	pHolder->m_pNext = m_pFirstFree;
+	m_pFirstFree = pHolder;
+	m_NumHolders--;
+	m_NumFreeHolders++;
+}
+
+void CSnapshotStorage::PurgeAll()
+{
+	while(m_pFirst)
+		Remove(m_pFirst);
+}
+
+void CSnapshotStorage::PurgeUntil(int Tick)
+{
+	while(m_pFirst && m_pFirst->m_Tick < Tick)
+		Remove(m_pFirst);
+}
+
+CSnapshotStorage::CHolder *CSnapshotStorage::NewHolder(int Tick, int64_t Tagtime)
+{
+	CHolder *pHolder = m_pFirstFree;
+	if(pHolder)
 	{
-		pHolder->m_pAltSnap = 0;
-		pHolder->m_AltSnapSize = 0;
+		m_pFirstFree = pHolder->m_pNext;
+		m_NumFreeHolders--;
 	}
+	else
+		pHolder = (CHolder *)malloc(sizeof(CHolder));
+	m_NumHolders++;
+
+	pHolder->m_Tick = Tick;
+	pHolder->m_Tagtime = Tagtime;
+	pHolder->m_SnapSize = 0;
+	pHolder->m_pSnap = 0;
+	pHolder->m_pBuffer = 0;
+	pHolder->m_AltSnapSize = 0;
+	pHolder->m_pAltSnap = 0;
+	pHolder->m_pAltBuffer = 0;
 
 	// link
 	pHolder->m_pNext = 0;
@@ -544,29 +695,74 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	else
 		m_pFirst = pHolder;
 	m_pLast = pHolder;
+
+	// the oldest holder of a tick stays in the index, Get returns that one
+	CHolder *&pIndexed = m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)];
+	if(pIndexed && pIndexed->m_Tick == Tick)
+		m_NumUnindexed++;
+	else
+	{
+		if(pIndexed)
+			m_NumUnindexed++;
+		pIndexed = pHolder;
+	}
+	return pHolder;
 }
 
-int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
+void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, const void *pData, int AltDataSize, const void *pAltData)
 {
-	CHolder *pHolder = m_pFirst;
+	CHolder *pHolder = NewHolder(Tick, Tagtime);
+
+	pHolder->m_pBuffer = m_pPool->New(pData, DataSize);
+	pHolder->m_pSnap = pHolder->m_pBuffer->Snap();
+	pHolder->m_SnapSize = DataSize;
 
-	while(pHolder)
+	if(AltDataSize > 0) // create alternative if wanted
 	{
-		if(pHolder->m_Tick == Tick)
+		pHolder->m_pAltBuffer = m_pPool->New(pAltData, AltDataSize);
+		pHolder->m_pAltSnap = pHolder->m_pAltBuffer->Snap();
+		pHolder->m_AltSnapSize = AltDataSize;
+	}
+}
+
+void CSnapshotStorage::Add(int Tick, int64_t Tagtime, CSnapshotBuffer *pBuffer)
+{
+	CHolder *pHolder = NewHolder(Tick, Tagtime);
+
+	m_pPool->Acquire(pBuffer);
+	pHolder->m_pBuffer = pBuffer;
+	pHolder->m_pSnap = pBuffer->Snap();
+	pHolder->m_SnapSize = pBuffer->m_Size;
+}
+
+int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
+{
+	CHolder *pHolder = m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)];
+	if(!pHolder || pHolder->m_Tick != Tick)
+	{
+		pHolder = 0;
+		if(m_NumUnindexed)
 		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
+			for(CHolder *pCur = m_pFirst; pCur; pCur = pCur->m_pNext)
+			{
+				if(pCur->m_Tick == Tick)
+				{
+					pHolder = pCur;
+					break;
+				}
+			}
 		}
-
-		pHolder = pHolder->m_pNext;
 	}
+	if(!pHolder)
+		return -1;
 
-	return -1;
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
@@ -602,14 +798,62 @@ int *CSnapshotBuilder::GetItemData(int Key)
 	return 0;
 }
 
+int *CSnapshotBuilder::GetItemData(int Key, int NumSortedItems)
+{
+	// only searches the first items, which must be sorted by key
+	int Low = 0;
+	int High = NumSortedItems;
+	while(Low < High)
+	{
+		int Mid = Low + (High - Low) / 2;
+		if(GetItem(Mid)->Key() < Key)
+			Low = Mid + 1;
+		else
+			High = Mid;
+	}
+	if(Low < NumSortedItems && GetItem(Low)->Key() == Key)
+		return GetItem(Low)->Data();
+	return 0;
+}
+
 int CSnapshotBuilder::Finish(void *pSnapData)
 {
+	// sort the items by key so lookups can use binary search and deltas
+	// can be created by merging
+	int aOrder[CSnapshot::MAX_ITEMS];
+	bool Sorted = true;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		aOrder[i] = i;
+		if(i > 0 && GetItem(i - 1)->Key() > GetItem(i)->Key())
+			Sorted = false;
+	}
+
 	// flatten and make the snapshot
 	CSnapshot *pSnap = (CSnapshot *)pSnapData;
 	pSnap->m_DataSize = m_DataSize;
 	pSnap->m_NumItems = m_NumItems;
-	mem_copy(pSnap->Offsets(), m_aOffsets, pSnap->OffsetSize());
-	mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
+	if(Sorted)
+	{
+		mem_copy(pSnap->Offsets(), m_aOffsets, pSnap->OffsetSize());
+		mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
+		return pSnap->TotalSize();
+	}
+
+	std::stable_sort(aOrder, aOrder + m_NumItems, [this](int a, int b) { return GetItem(a)->Key() < GetItem(b)->Key(); });
+
+	int *pOffsets = pSnap->Offsets();
+	char *pDataStart = pSnap->DataStart();
+	int Offset = 0;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		const int Index = aOrder[i];
+		const int End = Index == m_NumItems - 1 ? m_DataSize : m_aOffsets[Index + 1];
+		const int Size = End - m_aOffsets[Index];
+		pOffsets[i] = Offset;
+		mem_copy(pDataStart + Offset, m_aData + m_aOffsets[Index], Size);
+		Offset += Size;
+	}
 	return pSnap->TotalSize();
 }
 
@@ -35,6 +35,8 @@ class CSnapshot
 	size_t OffsetSize() const { return sizeof(int) * m_NumItems; }
 	size_t TotalSize() const { return sizeof(CSnapshot) + OffsetSize() + m_DataSize; }
 
+	int LowerBound(int Key) const;
+
 public:
 	enum
 	{
@@ -58,10 +60,12 @@ public:
 	int GetItemType(int Index) const;
 	int GetExternalItemType(int InternalType) const;
 	const void *FindItem(int Type, int ID) const;
+	bool IsSorted() const;
 
 	unsigned Crc();
 	void DebugDump();
 	bool IsValid(size_t ActualSize) const;
+	bool IsValidLayout(size_t ActualSize) const;
 };
 
 // CSnapshotDelta
@@ -88,9 +92,8 @@ private:
 	int m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
 	CData m_Empty;
 
-	static void UndiffItem(const int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
-
 public:
+	static void UndiffItem(const int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
 	static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
@@ -102,6 +105,60 @@ public:
 	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, const void *pSrcData, int DataSize);
 };
 
+// CSnapshotBufferPool
+
+// reference counted copy of a snapshot, several storages can hold the same one
+class CSnapshotBuffer
+{
+	friend class CSnapshotBufferPool;
+
+	CSnapshotBuffer *m_pNextFree;
+	int m_SizeClass;
+	int m_Refcount;
+
+public:
+	int m_Size;
+
+	CSnapshot *Snap() { return (CSnapshot *)(this + 1); }
+	int Refcount() const { return m_Refcount; }
+};
+
+// recycles snapshot buffers in power of two size classes instead of
+// going through malloc for every stored snapshot, not thread safe
+class CSnapshotBufferPool
+{
+	enum
+	{
+		MIN_SIZE_LOG2 = 10,
+		NUM_SIZE_CLASSES = 8, // 1 KiB up to 128 KiB, enough for CSnapshot::MAX_SIZE
+	};
+
+	CSnapshotBuffer *m_apFree[NUM_SIZE_CLASSES];
+	int m_NumBuffers;
+	int m_NumUsedBuffers;
+	size_t m_AllocatedBytes;
+	size_t m_UsedBytes;
+
+	static int SizeClass(int Size);
+	static size_t ClassSize(int SizeClass) { return (size_t)1 << (SizeClass + MIN_SIZE_LOG2); }
+
+public:
+	CSnapshotBufferPool();
+	~CSnapshotBufferPool();
+
+	// returns a buffer with a reference count of one
+	CSnapshotBuffer *New(const void *pData, int Size);
+	void Acquire(CSnapshotBuffer *pBuffer) { pBuffer->m_Refcount++; }
+	void Release(CSnapshotBuffer *pBuffer);
+	// frees buffers that are not in use
+	void Trim();
+
+	int NumBuffers() const { return m_NumBuffers; }
+	int NumUsedBuffers() const { return m_NumUsedBuffers; }
+	size_t AllocatedBytes() const { return m_AllocatedBytes; }
+	size_t UsedBytes() const { return m_UsedBytes; }
+};
+
 // CSnapshotStorage
 
 class CSnapshotStorage
@@ -121,18 +178,48 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		CSnapshotBuffer *m_pBuffer;
+		CSnapshotBuffer *m_pAltBuffer;
 	};
 
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
-	CSnapshotStorage() { Init(); }
-	~CSnapshotStorage() { PurgeAll(); }
-	void Init();
+	CSnapshotStorage();
+	~CSnapshotStorage();
+	// uses its own buffer pool if none is given, a shared pool must outlive the storage
+	void Init(CSnapshotBufferPool *pPool = nullptr);
 	void PurgeAll();
 	void PurgeUntil(int Tick);
-	void Add(int Tick, int64_t Tagtime, int DataSize, void *pData, int AltDataSize, void *pAltData);
+	void Add(int Tick, int64_t Tagtime, int DataSize, const void *pData, int AltDataSize, const void *pAltData);
+	// stores a snapshot without copying it, the buffer must come from this storage's pool
+	void Add(int Tick, int64_t Tagtime, CSnapshotBuffer *pBuffer);
 	int Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+
+	int NumHolders() const { return m_NumHolders; }
+	int NumFreeHolders() const { return m_NumFreeHolders; }
+
+private:
+	enum
+	{
+		TICK_INDEX_SIZE = 256,
+	};
+
+	CSnapshotBufferPool m_OwnPool;
+	CSnapshotBufferPool *m_pPool;
+
+	CHolder *m_pFirstFree;
+	int m_NumHolders;
+	int m_NumFreeHolders;
+
+	// holder per tick modulo TICK_INDEX_SIZE, holders that don't fit
+	// into the index are only found by walking the list
+	CHolder *m_apTickIndex[TICK_INDEX_SIZE];
+	int m_NumUnindexed;
+
+	CHolder *NewHolder(int Tick, int64_t Tagtime);
+	void Remove(CHolder *pHolder);
 };
 
 class CSnapshotBuilder
@@ -166,6 +253,8 @@ public:
 
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
+	int *GetItemData(int Key, int NumSortedItems);
+	int NumItems() const { return m_NumItems; }
 
 	int Finish(void *pSnapdata);
 };
@@ -11,5 +11,23 @@ enum
 	OFFSET_GAME_UUID
 };
 
+// record types, written negated as the first int of a record, except for
+// player diffs which start with the client id
+enum
+{
+	TEEHISTORIAN_NONE,
+	TEEHISTORIAN_FINISH,
+	TEEHISTORIAN_TICK_SKIP,
+	TEEHISTORIAN_PLAYER_NEW,
+	TEEHISTORIAN_PLAYER_OLD,
+	TEEHISTORIAN_INPUT_DIFF,
+	TEEHISTORIAN_INPUT_NEW,
+	TEEHISTORIAN_MESSAGE,
+	TEEHISTORIAN_JOIN,
+	TEEHISTORIAN_DROP,
+	TEEHISTORIAN_CONSOLE_COMMAND,
+	TEEHISTORIAN_EX,
+};
+
 void RegisterTeehistorianUuids(class CUuidManager *pManager);
 #endif // ENGINE_SHARED_TEEHISTORIAN_EX_H
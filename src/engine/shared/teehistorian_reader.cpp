@@ -0,0 +1,368 @@
+#include "teehistorian_reader.h"
+
+#include "teehistorian_writer.h"
+
+#include <engine/shared/json.h>
+#include <engine/shared/teehistorian_ex.h>
+
+#include <zlib.h>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+
+#define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
+#include <engine/shared/teehistorian_ex_chunks.h>
+#undef UUID
+
+enum
+{
+	NUM_INPUT_INTS = sizeof(CNetObj_PlayerInput) / sizeof(int),
+};
+
+static unsigned ReadLittleEndian(const unsigned char *pData, int Size)
+{
+	unsigned Result = 0;
+	for(int i = 0; i < Size; i++)
+		Result |= (unsigned)pData[i] << (i * 8);
+	return Result;
+}
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	Reset();
+}
+
+bool CTeeHistorianReader::ParseHeader(const void *pData, int DataSize, CHeader *pHeader)
+{
+	if(DataSize < (int)sizeof(CUuid) || mem_comp(pData, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+		return false;
+	const char *pJson = (const char *)pData + sizeof(CUuid);
+	if(!mem_has_null(pJson, DataSize - sizeof(CUuid)))
+		return false;
+	const char *pEnd = pJson + str_length(pJson);
+
+	json_value *pRoot = json_parse(pJson, pEnd - pJson);
+	if(!pRoot)
+		return false;
+	const json_value *pVersion = json_object_get(pRoot, "version");
+	const json_value *pCompression = json_object_get(pRoot, "compression");
+	bool Result = pVersion->type == json_string;
+	if(Result)
+	{
+		pHeader->m_Version = str_toint(json_string_get(pVersion));
+		pHeader->m_Compressed = pCompression->type == json_string && str_comp(json_string_get(pCompression), "zlib") == 0;
+		pHeader->m_Size = pEnd + 1 - (const char *)pData;
+		Result = (pHeader->m_Version == 2 && pCompression->type == json_none) || (pHeader->m_Version == 3 && pHeader->m_Compressed);
+	}
+	json_value_free(pRoot);
+	return Result;
+}
+
+bool CTeeHistorianReader::ReadIndex(IOHANDLE File, std::vector<CIndexEntry> *pvEntries)
+{
+	pvEntries->clear();
+	CUuid Uuid;
+	if(io_read(File, &Uuid, sizeof(Uuid)) != sizeof(Uuid) || !(Uuid == CTeeHistorianWriter::INDEX_UUID))
+		return false;
+
+	unsigned char aEntry[CTeeHistorianWriter::INDEX_ENTRY_SIZE];
+	while(io_read(File, aEntry, sizeof(aEntry)) == sizeof(aEntry))
+	{
+		CIndexEntry Entry;
+		Entry.m_Tick = (int)ReadLittleEndian(aEntry, 4);
+		Entry.m_Offset = ReadLittleEndian(aEntry + 4, 4) | (int64_t)ReadLittleEndian(aEntry + 8, 4) << 32;
+		// written in order, anything else is broken
+		if(!pvEntries->empty() && (Entry.m_Tick < pvEntries->back().m_Tick || Entry.m_Offset <= pvEntries->back().m_Offset))
+			return false;
+		pvEntries->push_back(Entry);
+	}
+	return true;
+}
+
+bool CTeeHistorianReader::Decompress(const void *pData, int DataSize, std::vector<unsigned char> *pvOut)
+{
+	const unsigned char *pBlock = (const unsigned char *)pData;
+	const unsigned char *pEnd = pBlock + DataSize;
+	while(pBlock < pEnd)
+	{
+		if(pEnd - pBlock < CTeeHistorianWriter::BLOCK_HEADER_SIZE)
+			return false;
+		const unsigned RawSize = ReadLittleEndian(pBlock, 4);
+		const unsigned CompressedSize = ReadLittleEndian(pBlock + 4, 4);
+		pBlock += CTeeHistorianWriter::BLOCK_HEADER_SIZE;
+		if((unsigned)(pEnd - pBlock) < CompressedSize)
+			return false;
+
+		const size_t Offset = pvOut->size();
+		pvOut->resize(Offset + RawSize);
+		uLongf Size = RawSize;
+		if(uncompress(pvOut->data() + Offset, &Size, pBlock, CompressedSize) != Z_OK || Size != RawSize)
+			return false;
+		pBlock += CompressedSize;
+	}
+	return true;
+}
+
+void CTeeHistorianReader::Reset()
+{
+	m_Unpacker.Reset(nullptr, 0);
+	m_Error = false;
+	m_Finished = false;
+
+	// tick 0 is implicit at the start, see `CTeeHistorian::Reset`
+	m_Tick = 0;
+	m_MaxClientID = MAX_CLIENTS;
+	for(auto &Player : m_aPlayers)
+	{
+		mem_zero(&Player, sizeof(Player));
+	}
+	for(auto &Practice : m_aPractice)
+	{
+		Practice = false;
+	}
+}
+
+void CTeeHistorianReader::SetData(const void *pData, int DataSize)
+{
+	m_Unpacker.Reset(pData, DataSize);
+}
+
+bool CTeeHistorianReader::ValidClientID(int ClientID)
+{
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+	{
+		m_Error = true;
+		return false;
+	}
+	return true;
+}
+
+bool CTeeHistorianReader::ReadKeyframe(CUnpacker *pUnpacker)
+{
+	const int Tick = pUnpacker->GetInt();
+	const int MaxClientID = pUnpacker->GetInt();
+	const int NumPlayers = pUnpacker->GetInt();
+	if(NumPlayers < 0 || NumPlayers > MAX_CLIENTS)
+		return false;
+
+	CPlayer aPlayers[MAX_CLIENTS];
+	mem_zero(aPlayers, sizeof(aPlayers));
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		const int ClientID = pUnpacker->GetInt();
+		const int Flags = pUnpacker->GetInt();
+		if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+			return false;
+		CPlayer &Player = aPlayers[ClientID];
+		Player.m_Alive = Flags & 1;
+		if(Player.m_Alive)
+		{
+			Player.m_X = pUnpacker->GetInt();
+			Player.m_Y = pUnpacker->GetInt();
+		}
+		Player.m_HasInput = Flags & 2;
+		if(Player.m_HasInput)
+		{
+			for(int j = 0; j < NUM_INPUT_INTS; j++)
+				((int *)&Player.m_Input)[j] = pUnpacker->GetInt();
+		}
+		Player.m_Team = pUnpacker->GetInt();
+	}
+
+	bool aPractice[MAX_CLIENTS] = {false};
+	const int NumPracticeTeams = pUnpacker->GetInt();
+	if(NumPracticeTeams < 0 || NumPracticeTeams > MAX_CLIENTS)
+		return false;
+	for(int i = 0; i < NumPracticeTeams; i++)
+	{
+		const int Team = pUnpacker->GetInt();
+		if(Team < 0 || Team >= MAX_CLIENTS)
+			return false;
+		aPractice[Team] = true;
+	}
+	if(pUnpacker->Error())
+		return false;
+
+	m_Tick = Tick;
+	m_MaxClientID = MaxClientID;
+	mem_copy(m_aPlayers, aPlayers, sizeof(m_aPlayers));
+	mem_copy(m_aPractice, aPractice, sizeof(m_aPractice));
+	return true;
+}
+
+bool CTeeHistorianReader::Next(CRecord *pRecord)
+{
+	if(m_Error || m_Finished || m_Unpacker.RemainingSize() <= 0)
+		return false;
+
+	// player data with a client id that isn't higher than the last one
+	// starts the next tick, in that case the record is read again after
+	// reporting the tick
+	const CUnpacker Start = m_Unpacker;
+
+	pRecord->m_ClientID = -1;
+	pRecord->m_pData = nullptr;
+	pRecord->m_DataSize = 0;
+	pRecord->m_pString = nullptr;
+	pRecord->m_vpArgs.clear();
+
+	// player diffs start with the client id instead of a type
+	int Type = m_Unpacker.GetInt();
+	int ClientID = -1;
+	if(Type >= 0)
+	{
+		ClientID = Type;
+		Type = TEEHISTORIAN_NONE;
+	}
+	else
+	{
+		Type = -Type;
+		if(Type == TEEHISTORIAN_PLAYER_NEW || Type == TEEHISTORIAN_PLAYER_OLD)
+			ClientID = m_Unpacker.GetInt();
+	}
+
+	if(Type == TEEHISTORIAN_NONE || Type == TEEHISTORIAN_PLAYER_NEW || Type == TEEHISTORIAN_PLAYER_OLD)
+	{
+		if(!ValidClientID(ClientID))
+			return false;
+		if(ClientID <= m_MaxClientID)
+		{
+			m_Unpacker = Start;
+			m_Tick++;
+			m_MaxClientID = -1;
+			pRecord->m_Type = RECORD_TICK;
+			pRecord->m_Tick = m_Tick;
+			return true;
+		}
+		m_MaxClientID = ClientID;
+	}
+
+	pRecord->m_Tick = m_Tick;
+	pRecord->m_ClientID = ClientID;
+	switch(Type)
+	{
+	case TEEHISTORIAN_NONE:
+	{
+		CPlayer &Player = m_aPlayers[ClientID];
+		Player.m_X += m_Unpacker.GetInt();
+		Player.m_Y += m_Unpacker.GetInt();
+		pRecord->m_Type = RECORD_PLAYER_DIFF;
+		break;
+	}
+	case TEEHISTORIAN_FINISH:
+		m_Finished = true;
+		pRecord->m_Type = RECORD_FINISH;
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+		m_Tick += m_Unpacker.GetInt() + 1;
+		m_MaxClientID = -1;
+		pRecord->m_Type = RECORD_TICK;
+		pRecord->m_Tick = m_Tick;
+		break;
+	case TEEHISTORIAN_PLAYER_NEW:
+	{
+		CPlayer &Player = m_aPlayers[ClientID];
+		Player.m_Alive = true;
+		Player.m_X = m_Unpacker.GetInt();
+		Player.m_Y = m_Unpacker.GetInt();
+		pRecord->m_Type = RECORD_PLAYER_NEW;
+		break;
+	}
+	case TEEHISTORIAN_PLAYER_OLD:
+		m_aPlayers[ClientID].m_Alive = false;
+		pRecord->m_Type = RECORD_PLAYER_OLD;
+		break;
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+	{
+		pRecord->m_ClientID = m_Unpacker.GetInt();
+		if(!ValidClientID(pRecord->m_ClientID))
+			return false;
+		CPlayer &Player = m_aPlayers[pRecord->m_ClientID];
+		const bool Diff = Type == TEEHISTORIAN_INPUT_DIFF;
+		if(Diff && !Player.m_HasInput)
+		{
+			m_Error = true;
+			return false;
+		}
+		for(int i = 0; i < NUM_INPUT_INTS; i++)
+		{
+			int *pValue = &((int *)&Player.m_Input)[i];
+			*pValue = (Diff ? *pValue : 0) + m_Unpacker.GetInt();
+		}
+		Player.m_HasInput = true;
+		pRecord->m_Type = Diff ? RECORD_INPUT_DIFF : RECORD_INPUT_NEW;
+		break;
+	}
+	case TEEHISTORIAN_MESSAGE:
+		pRecord->m_Type = RECORD_MESSAGE;
+		pRecord->m_ClientID = m_Unpacker.GetInt();
+		pRecord->m_DataSize = m_Unpacker.GetInt();
+		pRecord->m_pData = m_Unpacker.GetRaw(pRecord->m_DataSize);
+		break;
+	case TEEHISTORIAN_JOIN:
+		pRecord->m_Type = RECORD_JOIN;
+		pRecord->m_ClientID = m_Unpacker.GetInt();
+		break;
+	case TEEHISTORIAN_DROP:
+		pRecord->m_Type = RECORD_DROP;
+		pRecord->m_ClientID = m_Unpacker.GetInt();
+		pRecord->m_pString = m_Unpacker.GetString(0);
+		break;
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+	{
+		pRecord->m_Type = RECORD_CONSOLE_COMMAND;
+		pRecord->m_ClientID = m_Unpacker.GetInt();
+		pRecord->m_FlagMask = m_Unpacker.GetInt();
+		pRecord->m_pString = m_Unpacker.GetString(0);
+		const int NumArgs = m_Unpacker.GetInt();
+		for(int i = 0; i < NumArgs && !m_Unpacker.Error(); i++)
+			pRecord->m_vpArgs.push_back(m_Unpacker.GetString(0));
+		break;
+	}
+	case TEEHISTORIAN_EX:
+	{
+		const CUuid *pUuid = (const CUuid *)m_Unpacker.GetRaw(sizeof(CUuid));
+		pRecord->m_DataSize = m_Unpacker.GetInt();
+		pRecord->m_pData = m_Unpacker.GetRaw(pRecord->m_DataSize);
+		if(m_Unpacker.Error())
+			break;
+		pRecord->m_Uuid = *pUuid;
+		pRecord->m_Type = RECORD_EX;
+
+		CUnpacker Ex;
+		Ex.Reset(pRecord->m_pData, pRecord->m_DataSize);
+		if(pRecord->m_Uuid == UUID_TEEHISTORIAN_KEYFRAME)
+		{
+			if(!ReadKeyframe(&Ex))
+			{
+				m_Error = true;
+				return false;
+			}
+			pRecord->m_Type = RECORD_KEYFRAME;
+			pRecord->m_Tick = m_Tick;
+		}
+		else if(pRecord->m_Uuid == UUID_TEEHISTORIAN_PLAYER_TEAM)
+		{
+			const int TeamClientID = Ex.GetInt();
+			const int Team = Ex.GetInt();
+			if(!Ex.Error() && ValidClientID(TeamClientID))
+				m_aPlayers[TeamClientID].m_Team = Team;
+		}
+		else if(pRecord->m_Uuid == UUID_TEEHISTORIAN_TEAM_PRACTICE)
+		{
+			const int Team = Ex.GetInt();
+			const int Practice = Ex.GetInt();
+			if(!Ex.Error() && Team >= 0 && Team < MAX_CLIENTS)
+				m_aPractice[Team] = Practice;
+		}
+		break;
+	}
+	default:
+		m_Error = true;
+		return false;
+	}
+
+	if(m_Unpacker.Error())
+		m_Error = true;
+	return !m_Error;
+}
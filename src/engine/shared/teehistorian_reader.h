@@ -0,0 +1,123 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_READER_H
+#define ENGINE_SHARED_TEEHISTORIAN_READER_H
+
+#include <base/system.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+#include <game/generated/protocol.h>
+
+#include <cstdint>
+#include <vector>
+
+// Decodes the records of a teehistorian file written by `CTeeHistorian`.
+// Decoding either starts right after the header or at a keyframe, which
+// replaces the whole state, see `CTeeHistorianWriter` for how to find them.
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		// the tick changed, reported before the records of the new tick
+		RECORD_TICK,
+		RECORD_FINISH,
+		RECORD_PLAYER_NEW,
+		RECORD_PLAYER_DIFF,
+		RECORD_PLAYER_OLD,
+		RECORD_INPUT_NEW,
+		RECORD_INPUT_DIFF,
+		RECORD_MESSAGE,
+		RECORD_JOIN,
+		RECORD_DROP,
+		RECORD_CONSOLE_COMMAND,
+		RECORD_KEYFRAME,
+		// extended records that aren't decoded further, player teams and
+		// team practice are also applied to the state
+		RECORD_EX,
+		NUM_RECORDS,
+	};
+
+	class CHeader
+	{
+	public:
+		int m_Version;
+		bool m_Compressed;
+		// size of the UUID and the JSON, including its null termination
+		int m_Size;
+	};
+
+	class CIndexEntry
+	{
+	public:
+		int m_Tick;
+		int64_t m_Offset;
+	};
+
+	class CPlayer
+	{
+	public:
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+		bool m_HasInput;
+		CNetObj_PlayerInput m_Input;
+		int m_Team;
+	};
+
+	class CRecord
+	{
+	public:
+		int m_Type;
+		int m_Tick;
+		int m_ClientID;
+		// RECORD_MESSAGE and RECORD_EX
+		CUuid m_Uuid;
+		const unsigned char *m_pData;
+		int m_DataSize;
+		// RECORD_DROP: the reason, RECORD_CONSOLE_COMMAND: the command
+		const char *m_pString;
+		int m_FlagMask;
+		std::vector<const char *> m_vpArgs;
+	};
+
+	CTeeHistorianReader();
+
+	// parses the header at the start of a file, returns false if the data
+	// doesn't contain a complete supported header
+	static bool ParseHeader(const void *pData, int DataSize, CHeader *pHeader);
+	// reads the index file written by `CTeeHistorianWriter`
+	static bool ReadIndex(IOHANDLE File, std::vector<CIndexEntry> *pvEntries);
+	// appends the decompressed data of consecutive compressed blocks
+	static bool Decompress(const void *pData, int DataSize, std::vector<unsigned char> *pvOut);
+
+	// resets to the state at the start of a file
+	void Reset();
+	// continues decoding in the given data, which must start at a record,
+	// the pointers in the records point into it
+	void SetData(const void *pData, int DataSize);
+	// returns false at the end of the data or on an error
+	bool Next(CRecord *pRecord);
+
+	bool Error() const { return m_Error; }
+	bool Finished() const { return m_Finished; }
+	int Tick() const { return m_Tick; }
+	const CPlayer &Player(int ClientID) const { return m_aPlayers[ClientID]; }
+	bool Practice(int Team) const { return m_aPractice[Team]; }
+
+private:
+	bool ReadKeyframe(CUnpacker *pUnpacker);
+	bool ValidClientID(int ClientID);
+
+	CUnpacker m_Unpacker;
+	bool m_Error;
+	bool m_Finished;
+
+	int m_Tick;
+	// the highest client id with player data in the current tick, a lower
+	// one starts the next tick
+	int m_MaxClientID;
+	CPlayer m_aPlayers[MAX_CLIENTS];
+	bool m_aPractice[MAX_CLIENTS];
+};
+
+#endif
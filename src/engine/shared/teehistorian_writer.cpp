@@ -0,0 +1,225 @@
+#include "teehistorian_writer.h"
+
+#include <base/math.h>
+
+#include <zlib.h>
+
+const CUuid CTeeHistorianWriter::INDEX_UUID = CalculateUuid("teehistorian-index@ddnet.tw");
+
+CTeeHistorianWriter::CTeeHistorianWriter() :
+	m_Submitted(0), m_Completed(0), m_Stop(false), m_Error(false), m_RawBytes(0), m_WrittenBytes(0)
+{
+	m_pThread = nullptr;
+	m_File = 0;
+	m_IndexFile = 0;
+	m_CompressionLevel = 0;
+	m_BlockTicks = 0;
+	m_OpenTime = 0;
+	m_MaxBacklog = 0;
+	m_NumStalls = 0;
+	for(auto &Block : m_aBlocks)
+	{
+		Block.m_Size = 0;
+		Block.m_Compress = false;
+		Block.m_Tick = -1;
+	}
+}
+
+CTeeHistorianWriter::~CTeeHistorianWriter()
+{
+	if(IsOpen())
+		Close();
+}
+
+void CTeeHistorianWriter::Open(IOHANDLE File, IOHANDLE IndexFile, int CompressionLevel)
+{
+	dbg_assert(!IsOpen(), "teehistorian writer already open");
+
+	m_File = File;
+	m_IndexFile = IndexFile;
+	m_CompressionLevel = clamp(CompressionLevel, 0, 9);
+	m_BlockTicks = 0;
+	m_Submitted.store(0);
+	m_Completed.store(0);
+	m_Stop.store(false);
+	m_Error.store(false);
+	m_OpenTime = time_get();
+	m_RawBytes.store(0);
+	m_WrittenBytes.store(0);
+	m_MaxBacklog = 0;
+	m_NumStalls = 0;
+
+	// allocate everything up front, so that writing doesn't allocate
+	for(auto &Block : m_aBlocks)
+	{
+		Block.m_vData.resize(2 * BLOCK_SIZE);
+		Block.m_Size = 0;
+		Block.m_Tick = -1;
+	}
+	if(m_CompressionLevel)
+		m_vCompressed.resize(BLOCK_HEADER_SIZE + compressBound(m_aBlocks[0].m_vData.size()));
+
+	if(m_IndexFile && io_write(m_IndexFile, &INDEX_UUID, sizeof(INDEX_UUID)) != sizeof(INDEX_UUID))
+		m_Error.store(true);
+
+	sphore_init(&m_WorkSemaphore);
+	sphore_init(&m_DoneSemaphore);
+	m_pThread = thread_init(Thread, this, "teehistorian");
+}
+
+bool CTeeHistorianWriter::Close()
+{
+	dbg_assert(IsOpen(), "teehistorian writer not open");
+
+	if(CurrentBlock().m_Size)
+		Submit(m_CompressionLevel != 0);
+	m_Stop.store(true);
+	sphore_signal(&m_WorkSemaphore);
+	thread_wait(m_pThread);
+	m_pThread = nullptr;
+	sphore_destroy(&m_WorkSemaphore);
+	sphore_destroy(&m_DoneSemaphore);
+
+	if(io_close(m_File))
+		m_Error.store(true);
+	m_File = 0;
+	if(m_IndexFile && io_close(m_IndexFile))
+		m_Error.store(true);
+	m_IndexFile = 0;
+	return !m_Error.load();
+}
+
+void CTeeHistorianWriter::Write(const void *pData, int DataSize)
+{
+	CBlock &Block = CurrentBlock();
+	if(Block.m_Size + DataSize > (int)Block.m_vData.size())
+	{
+		// only happens for ticks with a lot of data
+		Block.m_vData.resize(2 * (Block.m_Size + DataSize));
+	}
+	mem_copy(Block.m_vData.data() + Block.m_Size, pData, DataSize);
+	Block.m_Size += DataSize;
+}
+
+void CTeeHistorianWriter::EndHeader()
+{
+	Submit(false);
+}
+
+bool CTeeHistorianWriter::EndTick()
+{
+	m_BlockTicks++;
+	if(CurrentBlock().m_Size < BLOCK_SIZE && m_BlockTicks < MAX_BLOCK_TICKS)
+		return false;
+	Submit(m_CompressionLevel != 0);
+	return true;
+}
+
+void CTeeHistorianWriter::SetBlockTick(int Tick)
+{
+	CurrentBlock().m_Tick = Tick;
+}
+
+void CTeeHistorianWriter::Submit(bool Compress)
+{
+	CBlock &Block = CurrentBlock();
+	Block.m_Compress = Compress;
+	m_RawBytes.fetch_add(Block.m_Size);
+	const int64_t Submitted = m_Submitted.load() + 1;
+	m_Submitted.store(Submitted);
+	sphore_signal(&m_WorkSemaphore);
+
+	// wait for the block that is filled next
+	int Backlog = Submitted - m_Completed.load();
+	m_MaxBacklog = maximum(m_MaxBacklog, Backlog);
+	if(Backlog >= NUM_BLOCKS)
+	{
+		m_NumStalls++;
+		while(m_Submitted.load() - m_Completed.load() >= NUM_BLOCKS)
+			sphore_wait(&m_DoneSemaphore);
+	}
+	CurrentBlock().m_Size = 0;
+	CurrentBlock().m_Tick = -1;
+	m_BlockTicks = 0;
+}
+
+bool CTeeHistorianWriter::WriteIndexEntry(int Tick, int64_t Offset)
+{
+	unsigned char aEntry[INDEX_ENTRY_SIZE];
+	for(int i = 0; i < 4; i++)
+		aEntry[i] = ((unsigned)Tick >> (i * 8)) & 0xff;
+	for(int i = 0; i < 8; i++)
+		aEntry[4 + i] = ((uint64_t)Offset >> (i * 8)) & 0xff;
+	return io_write(m_IndexFile, aEntry, sizeof(aEntry)) == sizeof(aEntry);
+}
+
+bool CTeeHistorianWriter::WriteBlock(const CBlock &Block)
+{
+	if(m_IndexFile && Block.m_Tick >= 0 && !WriteIndexEntry(Block.m_Tick, m_WrittenBytes.load()))
+		return false;
+
+	if(!Block.m_Compress)
+	{
+		if(io_write(m_File, Block.m_vData.data(), Block.m_Size) != (unsigned)Block.m_Size)
+			return false;
+		m_WrittenBytes.fetch_add(Block.m_Size);
+		return true;
+	}
+
+	uLongf CompressedSize = compressBound(Block.m_Size);
+	if(m_vCompressed.size() < BLOCK_HEADER_SIZE + CompressedSize)
+		m_vCompressed.resize(BLOCK_HEADER_SIZE + CompressedSize);
+	if(compress2(m_vCompressed.data() + BLOCK_HEADER_SIZE, &CompressedSize, Block.m_vData.data(), Block.m_Size, m_CompressionLevel) != Z_OK)
+		return false;
+
+	const unsigned aSizes[] = {(unsigned)Block.m_Size, (unsigned)CompressedSize};
+	for(int i = 0; i < 2; i++)
+	{
+		for(int j = 0; j < 4; j++)
+			m_vCompressed[i * 4 + j] = (aSizes[i] >> (j * 8)) & 0xff;
+	}
+	const unsigned Size = BLOCK_HEADER_SIZE + CompressedSize;
+	if(io_write(m_File, m_vCompressed.data(), Size) != Size)
+		return false;
+	m_WrittenBytes.fetch_add(Size);
+	return true;
+}
+
+void CTeeHistorianWriter::Thread(void *pUser)
+{
+	CTeeHistorianWriter *pThis = (CTeeHistorianWriter *)pUser;
+	while(true)
+	{
+		sphore_wait(&pThis->m_WorkSemaphore);
+		// check for the stop request first, all blocks are submitted by then
+		const bool Stop = pThis->m_Stop.load();
+		while(pThis->m_Completed.load() < pThis->m_Submitted.load())
+		{
+			const CBlock &Block = pThis->m_aBlocks[pThis->m_Completed.load() % NUM_BLOCKS];
+			if(!pThis->m_Error.load() && !pThis->WriteBlock(Block))
+				pThis->m_Error.store(true);
+			pThis->m_Completed.fetch_add(1);
+			sphore_signal(&pThis->m_DoneSemaphore);
+		}
+		if(Stop)
+			break;
+	}
+	if(io_flush(pThis->m_File) || (pThis->m_IndexFile && io_flush(pThis->m_IndexFile)))
+		pThis->m_Error.store(true);
+}
+
+void CTeeHistorianWriter::GetStats(CStats *pStats) const
+{
+	pStats->m_RawBytes = m_RawBytes.load();
+	pStats->m_WrittenBytes = m_WrittenBytes.load();
+	pStats->m_NumBlocks = m_Submitted.load();
+	pStats->m_Backlog = m_Submitted.load() - m_Completed.load();
+	pStats->m_MaxBacklog = m_MaxBacklog;
+	pStats->m_NumStalls = m_NumStalls;
+	pStats->m_Seconds = (time_get() - m_OpenTime) / (double)time_freq();
+}
+
+void CTeeHistorianWriter::WriteCallback(const void *pData, int DataSize, void *pUser)
+{
+	((CTeeHistorianWriter *)pUser)->Write(pData, DataSize);
+}
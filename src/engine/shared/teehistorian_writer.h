@@ -0,0 +1,123 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_WRITER_H
+#define ENGINE_SHARED_TEEHISTORIAN_WRITER_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Writes a teehistorian file on a background thread. The tick thread only
+// copies the records into preallocated blocks, one of which is handed to
+// the background thread at the end of a tick when it is full or holds
+// MAX_BLOCK_TICKS ticks, so that quiet servers still reach the disk.
+//
+// The header is written as is. If compression is enabled, every block after
+// it is compressed independently and starts at a tick boundary:
+//
+//   int32 uncompressed size (little endian)
+//   int32 compressed size (little endian)
+//   zlib stream of the block
+//
+// Blocks that start with a keyframe can be decoded on their own. Their
+// ticks and file offsets are written to the index file, after its UUID:
+//
+//   int32 tick (little endian)
+//   int64 file offset of the block (little endian)
+class CTeeHistorianWriter
+{
+public:
+	enum
+	{
+		NUM_BLOCKS = 16,
+		BLOCK_SIZE = 64 * 1024,
+		MAX_BLOCK_TICKS = 5 * SERVER_TICK_SPEED,
+		BLOCK_HEADER_SIZE = 8,
+		INDEX_ENTRY_SIZE = 12,
+	};
+
+	static const CUuid INDEX_UUID;
+
+	class CStats
+	{
+	public:
+		int64_t m_RawBytes;
+		int64_t m_WrittenBytes;
+		int m_NumBlocks;
+		// blocks handed to the background thread, but not written yet
+		int m_Backlog;
+		int m_MaxBacklog;
+		// how often the tick thread had to wait for a free block
+		int m_NumStalls;
+		double m_Seconds;
+	};
+
+	CTeeHistorianWriter();
+	~CTeeHistorianWriter();
+
+	// takes ownership of the files, the index file is optional, a
+	// compression level of 0 writes the uncompressed format
+	void Open(IOHANDLE File, IOHANDLE IndexFile, int CompressionLevel);
+	bool IsOpen() const { return m_pThread != nullptr; }
+	// waits until everything is written, returns false on error
+	bool Close();
+	bool Error() const { return m_Error.load(); }
+
+	void Write(const void *pData, int DataSize);
+	// the data written so far is the uncompressed header
+	void EndHeader();
+	// returns true if a new block was started
+	bool EndTick();
+	// the current block starts with a keyframe of `Tick`
+	void SetBlockTick(int Tick);
+
+	void GetStats(CStats *pStats) const;
+
+	static void WriteCallback(const void *pData, int DataSize, void *pUser);
+
+private:
+	class CBlock
+	{
+	public:
+		std::vector<unsigned char> m_vData;
+		int m_Size;
+		bool m_Compress;
+		// -1 if the block doesn't start with a keyframe
+		int m_Tick;
+	};
+
+	CBlock m_aBlocks[NUM_BLOCKS];
+	// only increased, the block that is filled is at `m_Submitted`, the
+	// ones from `m_Completed` to it belong to the background thread
+	std::atomic<int64_t> m_Submitted;
+	std::atomic<int64_t> m_Completed;
+	std::atomic<bool> m_Stop;
+	std::atomic<bool> m_Error;
+	SEMAPHORE m_WorkSemaphore;
+	SEMAPHORE m_DoneSemaphore;
+	void *m_pThread;
+
+	IOHANDLE m_File;
+	IOHANDLE m_IndexFile;
+	int m_CompressionLevel;
+	// ticks ended in the current block
+	int m_BlockTicks;
+	// only used by the background thread
+	std::vector<unsigned char> m_vCompressed;
+
+	int64_t m_OpenTime;
+	std::atomic<int64_t> m_RawBytes;
+	std::atomic<int64_t> m_WrittenBytes;
+	int m_MaxBacklog;
+	int m_NumStalls;
+
+	CBlock &CurrentBlock() { return m_aBlocks[m_Submitted.load() % NUM_BLOCKS]; }
+	void Submit(bool Compress);
+	bool WriteBlock(const CBlock &Block);
+	bool WriteIndexEntry(int Tick, int64_t Offset);
+	static void Thread(void *pUser);
+};
+
+#endif
@@ -589,6 +589,9 @@ void CCharacter::Tick()
 
 	m_PrevPrevPos = m_PrevPos;
 	m_PrevPos = m_Core.m_Pos;
+
+	// tiles and ninja can move the core
+	GameWorld()->m_Core.UpdateBroadphase(GetCID());
 }
 
 void CCharacter::TickDeferred()
@@ -1034,7 +1037,7 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::list<int> Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
+	CCollision::CMapIndices Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
 	if(!Indices.empty())
 		for(int Index : Indices)
 			HandleTiles(Index);
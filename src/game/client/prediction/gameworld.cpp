@@ -115,6 +115,7 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		{
 			m_apCharacters[ID] = pChar;
 			m_Core.m_apCharacters[ID] = pChar->Core();
+			m_Core.UpdateBroadphase(ID);
 		}
 		pChar->SetCoreWorld(this);
 	}
@@ -162,6 +163,7 @@ void CGameWorld::RemoveCharacter(CCharacter *pChar)
 	{
 		m_apCharacters[ID] = 0;
 		m_Core.m_apCharacters[ID] = 0;
+		m_Core.UpdateBroadphase(ID);
 	}
 }
 
@@ -187,6 +189,8 @@ bool distCompare(std::pair<float, int> a, std::pair<float, int> b)
 
 void CGameWorld::Tick()
 {
+	m_Core.BuildBroadphase();
+
 	// update all objects
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
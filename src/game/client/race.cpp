@@ -1,5 +1,4 @@
 #include <cctype>
-#include <list>
 
 #include <game/client/gameclient.h>
 #include <game/mapitems.h>
@@ -76,9 +75,9 @@ bool CRaceHelper::IsStart(CGameClient *pClient, vec2 Prev, vec2 Pos)
 	}
 	else
 	{
-		std::list<int> Indices = pCollision->GetMapIndices(Prev, Pos);
+		CCollision::CMapIndices Indices = pCollision->GetMapIndices(Prev, Pos);
 		if(!Indices.empty())
-			for(int &Indice : Indices)
+			for(int Indice : Indices)
 			{
 				if(pCollision->GetTileIndex(Indice) == TILE_START)
 					return true;
@@ -107,6 +107,10 @@ void CCollision::Init(class CLayers *pLayers)
 			m_pFront = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->FrontLayer()->m_Front));
 	}
 
+	m_vTileFlags.resize((size_t)m_Width * m_Height);
+	for(int i = 0; i < m_Width * m_Height; i++)
+		UpdateTileFlags(i);
+
 	for(int i = 0; i < m_Width * m_Height; i++)
 	{
 		int Index;
@@ -133,6 +137,19 @@ void CCollision::Init(class CLayers *pLayers)
 	}
 }
 
+void CCollision::UpdateTileFlags(int Index)
+{
+	int Flags = 0;
+	int Tile = m_pTiles[Index].m_Index;
+	if(Tile >= TILE_SOLID && Tile <= TILE_NOLASER)
+		Flags |= Tile;
+	if(Tile == TILE_SOLID || Tile == TILE_NOHOOK)
+		Flags |= TILEFLAGS_SOLID;
+	if(m_pFront && (m_pFront[Index].m_Index == TILE_DEATH || m_pFront[Index].m_Index == TILE_NOLASER))
+		Flags |= m_pFront[Index].m_Index << TILEFLAGS_FRONT_SHIFT;
+	m_vTileFlags[Index] = Flags;
+}
+
 void CCollision::FillAntibot(CAntibotMapData *pMapData)
 {
 	pMapData->m_Width = m_Width;
@@ -274,63 +291,127 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 	return Restrictions;
 }
 
-int CCollision::GetTile(int x, int y) const
+// Tests the points mix(Pos0, Pos1, i / Divisor) for i in [0, NumSamples)
+// and stops at the first one Check returns true for. Check has to depend
+// only on the 32x32 cell the rounded point is in. The points move
+// monotonically along the line, so the points of a cell are consecutive
+// and only one of them has to be tested.
+template<typename TCheck>
+int CCollision::IntersectSamples(vec2 Pos0, vec2 Pos1, int NumSamples, float Divisor, vec2 *pOutCollision, vec2 *pOutBeforeCollision, TCheck &&Check) const
 {
-	if(!m_pTiles)
-		return 0;
+	auto Sample = [&](int i) { return mix(Pos0, Pos1, i / Divisor); };
 
-	int Nx = clamp(x / 32, 0, m_Width - 1);
-	int Ny = clamp(y / 32, 0, m_Height - 1);
-	int pos = Ny * m_Width + Nx;
+	int Result = 0;
+	auto Hit = [&](int i) {
+		if(pOutCollision)
+			*pOutCollision = Sample(i);
+		if(pOutBeforeCollision)
+			*pOutBeforeCollision = i > 0 ? Sample(i - 1) : Pos0;
+		return Result;
+	};
+
+	// far away points could overflow the rounding
+	const float Limit = 1e7f;
+	const bool InRange = absolute(Pos0.x) < Limit && absolute(Pos0.y) < Limit && absolute(Pos1.x) < Limit && absolute(Pos1.y) < Limit;
+	if(g_Config.m_DbgPixelIntersect || !InRange)
+	{
+		for(int i = 0; i < NumSamples; i++)
+		{
+			if(Check(Sample(i), &Result))
+				return Hit(i);
+		}
+	}
+	else
+	{
+		auto Cell = [](vec2 Pos) { return ivec2(round_to_int(Pos.x) >> 5, round_to_int(Pos.y) >> 5); };
+		const vec2 Dir = Pos1 - Pos0;
 
-	if(m_pTiles[pos].m_Index >= TILE_SOLID && m_pTiles[pos].m_Index <= TILE_NOLASER)
-		return m_pTiles[pos].m_Index;
+		int i = 0;
+		while(i < NumSamples)
+		{
+			const vec2 Pos = Sample(i);
+			if(Check(Pos, &Result))
+				return Hit(i);
+
+			// guess where the line leaves the cell and find the exact
+			// first point outside of it with a bisection around the guess
+			const ivec2 Current = Cell(Pos);
+			auto InCell = [&](int j) { return Cell(Sample(j)) == Current; };
+			float Leave = NumSamples;
+			if(Dir.x != 0.0f)
+				Leave = minimum(Leave, ((Dir.x > 0.0f ? Current.x + 1 : Current.x) * 32 - 0.5f - Pos0.x) / Dir.x * Divisor);
+			if(Dir.y != 0.0f)
+				Leave = minimum(Leave, ((Dir.y > 0.0f ? Current.y + 1 : Current.y) * 32 - 0.5f - Pos0.y) / Dir.y * Divisor);
+			const int Guess = clamp((int)std::ceil(maximum(Leave, (float)(i + 1))), i + 1, NumSamples);
+
+			int Inside = i;
+			int Outside = NumSamples;
+			if(Guess < NumSamples && InCell(Guess))
+			{
+				Inside = Guess;
+				if(Guess + 1 < NumSamples)
+				{
+					if(InCell(Guess + 1))
+						Inside = Guess + 1;
+					else
+						Outside = Guess + 1;
+				}
+			}
+			else
+			{
+				Outside = Guess;
+				if(Guess - 1 > i)
+				{
+					if(InCell(Guess - 1))
+						Inside = Guess - 1;
+					else
+						Outside = Guess - 1;
+				}
+			}
+			while(Outside - Inside > 1)
+			{
+				const int Middle = Inside + (Outside - Inside) / 2;
+				if(InCell(Middle))
+					Inside = Middle;
+				else
+					Outside = Middle;
+			}
+			i = Outside;
+		}
+	}
+
+	if(pOutCollision)
+		*pOutCollision = Pos1;
+	if(pOutBeforeCollision)
+		*pOutBeforeCollision = Pos1;
 	return 0;
 }
 
-// TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, End + 1, End, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
 
 		if(CheckPoint(ix, iy))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			*pResult = GetCollisionAt(ix, iy);
+			return true;
 		}
-
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		return false;
+	});
 }
 
 int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, End + 1, End, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -342,11 +423,8 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			*pTeleNr = IsTeleportHook(Index);
 		if(*pTeleNr)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINHOOK;
+			*pResult = TILE_TELEINHOOK;
+			return true;
 		}
 
 		int hit = 0;
@@ -359,33 +437,16 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		{
 			hit = TILE_NOHOOK;
 		}
-		if(hit)
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return hit;
-		}
-
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		*pResult = hit;
+		return hit != 0;
+	});
 }
 
 int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, End + 1, End, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -397,32 +458,19 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			*pTeleNr = IsTeleportWeapon(Index);
 		if(*pTeleNr)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINWEAPON;
+			*pResult = TILE_TELEINWEAPON;
+			return true;
 		}
 
 		if(CheckPoint(ix, iy))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			*pResult = GetCollisionAt(ix, iy);
+			return true;
 		}
-
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		return false;
+	});
 }
 
-// TODO: OPT: rewrite this smarter!
 void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces) const
 {
 	if(pBounces)
@@ -463,16 +511,16 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 
 bool CCollision::TestBox(vec2 Pos, vec2 Size) const
 {
+	if(!m_pTiles)
+		return false;
+
+	// same as CheckPoint on the four corners, sharing the rows and columns
 	Size *= 0.5f;
-	if(CheckPoint(Pos.x - Size.x, Pos.y - Size.y))
-		return true;
-	if(CheckPoint(Pos.x + Size.x, Pos.y - Size.y))
-		return true;
-	if(CheckPoint(Pos.x - Size.x, Pos.y + Size.y))
-		return true;
-	if(CheckPoint(Pos.x + Size.x, Pos.y + Size.y))
-		return true;
-	return false;
+	const int Left = clamp(round_to_int(Pos.x - Size.x) >> 5, 0, m_Width - 1);
+	const int Right = clamp(round_to_int(Pos.x + Size.x) >> 5, 0, m_Width - 1);
+	const int Top = clamp(round_to_int(Pos.y - Size.y) >> 5, 0, m_Height - 1) * m_Width;
+	const int Bottom = clamp(round_to_int(Pos.y + Size.y) >> 5, 0, m_Height - 1) * m_Width;
+	return (m_vTileFlags[Top + Left] | m_vTileFlags[Top + Right] | m_vTileFlags[Bottom + Left] | m_vTileFlags[Bottom + Right]) & TILEFLAGS_SOLID;
 }
 
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
@@ -558,12 +606,7 @@ void CCollision::Dest()
 	m_pSwitch = 0;
 	m_pTune = 0;
 	m_pDoor = 0;
-}
-
-int CCollision::IsSolid(int x, int y) const
-{
-	int index = GetTile(x, y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	m_vTileFlags.clear();
 }
 
 bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1) const
@@ -892,46 +935,45 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+CCollision::CMapIndices::CMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
 {
-	std::list<int> Indices;
-	float d = distance(PrevPos, Pos);
-	int End(d + 1);
-	if(!d)
-	{
-		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-		int Index = Ny * m_Width + Nx;
+	m_First.m_pCollision = pCollision;
+	m_First.m_PrevPos = PrevPos;
+	m_First.m_Pos = Pos;
+	m_First.m_Distance = distance(PrevPos, Pos);
+	m_First.m_End = m_First.m_Distance + 1;
+	m_First.m_MaxIndices = MaxIndices;
+	m_First.m_NumIndices = 0;
+	// a standing position reports its tile even if it is the first one of the map
+	m_First.m_Index = m_First.m_Distance ? 0 : -1;
+	m_First.m_Sample = -1;
+	m_First.Next();
+}
 
-		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
-	}
-	else
+void CCollision::CMapIndices::CIterator::Next()
+{
+	int LastIndex = m_Index;
+	while(++m_Sample < m_End)
 	{
-		int LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		vec2 Tmp = m_Distance ? mix(m_PrevPos, m_Pos, m_Sample / m_Distance) : m_Pos;
+		int Nx = clamp((int)Tmp.x / 32, 0, m_pCollision->m_Width - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, m_pCollision->m_Height - 1);
+		int Index = Ny * m_pCollision->m_Width + Nx;
+		if(LastIndex != Index && m_pCollision->TileExists(Index))
 		{
-			float a = i / d;
-			vec2 Tmp = mix(PrevPos, Pos, a);
-			int Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			int Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			int Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
-			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
-				LastIndex = Index;
-			}
+			if(m_MaxIndices && m_NumIndices > m_MaxIndices)
+				break;
+			m_NumIndices++;
+			m_Index = Index;
+			return;
 		}
-
-		return Indices;
 	}
+	m_Sample = m_End;
+}
+
+CCollision::CMapIndices CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+{
+	return CMapIndices(this, PrevPos, Pos, MaxIndices);
 }
 
 vec2 CCollision::GetPos(int Index) const
@@ -1016,18 +1058,6 @@ int CCollision::GetFIndex(int Nx, int Ny) const
 	return m_pFront[Ny * m_Width + Nx].m_Index;
 }
 
-int CCollision::GetFTile(int x, int y) const
-{
-	if(!m_pFront)
-		return 0;
-	int Nx = clamp(x / 32, 0, m_Width - 1);
-	int Ny = clamp(y / 32, 0, m_Height - 1);
-	if(m_pFront[Ny * m_Width + Nx].m_Index == TILE_DEATH || m_pFront[Ny * m_Width + Nx].m_Index == TILE_NOLASER)
-		return m_pFront[Ny * m_Width + Nx].m_Index;
-	else
-		return 0;
-}
-
 int CCollision::Entity(int x, int y, int Layer) const
 {
 	if((0 > x || x >= m_Width) || (0 > y || y >= m_Height))
@@ -1085,6 +1115,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateTileFlags(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1157,92 +1188,53 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = (int)ceilf(d); i < id; i++)
-	{
-		float a = (int)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, (int)ceilf(d), d, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		int Nx = clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
 		int Ny = clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID || GetIndex(Nx, Ny) == TILE_NOHOOK || GetIndex(Nx, Ny) == TILE_NOLASER || GetFIndex(Nx, Ny) == TILE_NOLASER)
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(GetFIndex(Nx, Ny) == TILE_NOLASER)
-				return GetFCollisionAt(Pos.x, Pos.y);
+				*pResult = GetFCollisionAt(Pos.x, Pos.y);
 			else
-				return GetCollisionAt(Pos.x, Pos.y);
+				*pResult = GetCollisionAt(Pos.x, Pos.y);
+			return true;
 		}
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		return false;
+	});
 }
 
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = (int)ceilf(d); i < id; i++)
-	{
-		float a = (float)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, (int)ceilf(d), d, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return GetCollisionAt(Pos.x, Pos.y);
+				*pResult = GetCollisionAt(Pos.x, Pos.y);
 			else
-				return GetFCollisionAt(Pos.x, Pos.y);
+				*pResult = GetFCollisionAt(Pos.x, Pos.y);
+			return true;
 		}
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		return false;
+	});
 }
 
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = (int)ceilf(d); i < id; i++)
-	{
-		float a = (float)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+	return IntersectSamples(Pos0, Pos1, (int)ceilf(d), d, pOutCollision, pOutBeforeCollision, [&](vec2 Pos, int *pResult) {
 		if(IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
 			if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return -1;
+				*pResult = -1;
 			else if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
+				*pResult = GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 			else
-				return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
+				*pResult = GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
+			return true;
 		}
-		Last = Pos;
-	}
-	if(pOutCollision)
-		*pOutCollision = Pos1;
-	if(pOutBeforeCollision)
-		*pOutBeforeCollision = Pos1;
-	return 0;
+		return false;
+	});
 }
 
 int CCollision::IsTimeCheckpoint(int Index) const
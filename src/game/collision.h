@@ -6,7 +6,7 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
+#include <vector>
 
 enum
 {
@@ -29,6 +29,53 @@ class CCollision
 	class CLayers *m_pLayers;
 
 public:
+	// Indices of the tiles with game tiles between two positions. The tiles
+	// are looked up lazily while iterating, so no memory is allocated.
+	class CMapIndices
+	{
+	public:
+		class CIterator
+		{
+			friend class CMapIndices;
+
+			const CCollision *m_pCollision;
+			vec2 m_PrevPos;
+			vec2 m_Pos;
+			float m_Distance;
+			int m_End;
+			unsigned m_MaxIndices;
+			unsigned m_NumIndices;
+			int m_Sample;
+			int m_Index;
+
+			void Next();
+
+		public:
+			int operator*() const { return m_Index; }
+			CIterator &operator++()
+			{
+				Next();
+				return *this;
+			}
+			bool operator==(const CIterator &Other) const { return m_Sample == Other.m_Sample; }
+			bool operator!=(const CIterator &Other) const { return m_Sample != Other.m_Sample; }
+		};
+
+		CMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos, unsigned MaxIndices);
+
+		CIterator begin() const { return m_First; }
+		CIterator end() const
+		{
+			CIterator End = m_First;
+			End.m_Sample = End.m_End;
+			return End;
+		}
+		bool empty() const { return m_First.m_Sample == m_First.m_End; }
+
+	private:
+		CIterator m_First;
+	};
+
 	CCollision();
 	~CCollision();
 	void Init(class CLayers *pLayers);
@@ -68,12 +115,22 @@ public:
 		return GetMoveRestrictions(nullptr, nullptr, Pos, Distance);
 	}
 
-	int GetTile(int x, int y) const;
-	int GetFTile(int x, int y) const;
+	int GetTile(int x, int y) const
+	{
+		if(!m_pTiles)
+			return 0;
+		return m_vTileFlags[TileFlagsIndex(x, y)] & TILEFLAGS_GAME_MASK;
+	}
+	int GetFTile(int x, int y) const
+	{
+		if(!m_pFront)
+			return 0;
+		return (m_vTileFlags[TileFlagsIndex(x, y)] & TILEFLAGS_FRONT_MASK) >> TILEFLAGS_FRONT_SHIFT;
+	}
 	int Entity(int x, int y, int Layer) const;
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+	CMapIndices GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
 	int GetMapIndex(vec2 Pos) const;
 	bool TileExists(int Index) const;
 	bool TileExistsNext(int Index) const;
@@ -96,7 +153,12 @@ public:
 	int GetSwitchNumber(int Index) const;
 	int GetSwitchDelay(int Index) const;
 
-	int IsSolid(int x, int y) const;
+	int IsSolid(int x, int y) const
+	{
+		if(!m_pTiles)
+			return 0;
+		return (m_vTileFlags[TileFlagsIndex(x, y)] & TILEFLAGS_SOLID) != 0;
+	}
 	bool IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1) const;
 	bool IsHookBlocker(int x, int y, vec2 pos0, vec2 pos1) const;
 	int IsWallJump(int Index) const;
@@ -117,6 +179,31 @@ public:
 	int m_HighestSwitchNumber;
 
 private:
+	// The game and front tiles that the collision checks look at merged
+	// into one byte per tile, built in Init. Much less memory to go
+	// through than the CTile arrays of both layers.
+	enum
+	{
+		// game tile index if it is one of TILE_SOLID to TILE_NOLASER
+		TILEFLAGS_GAME_MASK = 7,
+		// front tile index if it is TILE_DEATH or TILE_NOLASER
+		TILEFLAGS_FRONT_SHIFT = 3,
+		TILEFLAGS_FRONT_MASK = 7 << TILEFLAGS_FRONT_SHIFT,
+		// game tile is TILE_SOLID or TILE_NOHOOK
+		TILEFLAGS_SOLID = 1 << 6
+	};
+	std::vector<unsigned char> m_vTileFlags;
+	void UpdateTileFlags(int Index);
+	// same as clamping the truncated division by 32 since negative
+	// coordinates end up on the first tile either way
+	int TileFlagsIndex(int x, int y) const
+	{
+		return clamp(y >> 5, 0, m_Height - 1) * m_Width + clamp(x >> 5, 0, m_Width - 1);
+	}
+
+	template<typename TCheck>
+	int IntersectSamples(vec2 Pos0, vec2 Pos1, int NumSamples, float Divisor, vec2 *pOutCollision, vec2 *pOutBeforeCollision, TCheck &&Check) const;
+
 	class CTeleTile *m_pTele;
 	class CSpeedupTile *m_pSpeedup;
 	class CTile *m_pFront;
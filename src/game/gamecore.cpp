@@ -8,6 +8,12 @@
 
 #include <engine/shared/config.h>
 
+#include <algorithm>
+#include <cmath>
+
+// slack for the broadphase boxes so rounding never drops a character
+static constexpr float BROADPHASE_MARGIN = 1.0f;
+
 const char *CTuningParams::ms_apNames[] =
 	{
 #define MACRO_TUNING_PARAM(Name, ScriptName, Value, Description) #ScriptName,
@@ -296,11 +302,18 @@ void CCharacterCore::Tick(bool UseInput, bool DoDeferredTick)
 		// Check against other players first
 		if(!this->m_HookHitDisabled && m_pWorld && m_Tuning.m_PlayerHooking)
 		{
+			const float Range = PhysicalSize() + 2.0f + BROADPHASE_MARGIN;
+			const vec2 Min = vec2(minimum(m_HookPos.x, NewPos.x), minimum(m_HookPos.y, NewPos.y)) - vec2(Range, Range);
+			const vec2 Max = vec2(maximum(m_HookPos.x, NewPos.x), maximum(m_HookPos.y, NewPos.y)) + vec2(Range, Range);
+			int aIDs[MAX_CLIENTS];
+			int NumIDs = m_pWorld->FindCharacters(Min, Max, aIDs);
+
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			for(int k = 0; k < NumIDs; k++)
 			{
+				const int i = aIDs[k];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this || (!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
+				if(pCharCore == this || (!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
 					continue;
 
 				vec2 ClosestPoint;
@@ -413,11 +426,29 @@ void CCharacterCore::TickDeferred()
 {
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		const float Range = PhysicalSize() * 1.25f + BROADPHASE_MARGIN;
+		int aIDs[MAX_CLIENTS];
+		int NumIDs = m_pWorld->FindCharacters(m_Pos - vec2(Range, Range), m_Pos + vec2(Range, Range), aIDs);
+
+		// the hooked player gets dragged from any distance
+		if(m_HookedPlayer >= 0 && m_HookedPlayer < MAX_CLIENTS && m_pWorld->m_apCharacters[m_HookedPlayer])
 		{
+			int k = NumIDs;
+			while(k > 0 && aIDs[k - 1] >= m_HookedPlayer)
+				k--;
+			if(k == NumIDs || aIDs[k] != m_HookedPlayer)
+			{
+				for(int j = NumIDs; j > k; j--)
+					aIDs[j] = aIDs[j - 1];
+				aIDs[k] = m_HookedPlayer;
+				NumIDs++;
+			}
+		}
+
+		for(int k = 0; k < NumIDs; k++)
+		{
+			const int i = aIDs[k];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
-				continue;
 
 			// player *p = (player*)ent;
 			// if(pCharCore == this) // || !(p->flags&FLAG_ALIVE)
@@ -513,16 +544,23 @@ void CCharacterCore::Move()
 		float Distance = distance(m_Pos, NewPos);
 		if(Distance > 0)
 		{
+			const float Range = PhysicalSize() + BROADPHASE_MARGIN;
+			const vec2 Min = vec2(minimum(m_Pos.x, NewPos.x), minimum(m_Pos.y, NewPos.y)) - vec2(Range, Range);
+			const vec2 Max = vec2(maximum(m_Pos.x, NewPos.x), maximum(m_Pos.y, NewPos.y)) + vec2(Range, Range);
+			int aIDs[MAX_CLIENTS];
+			int NumIDs = m_pWorld->FindCharacters(Min, Max, aIDs);
+
 			int End = Distance + 1;
 			vec2 LastPos = m_Pos;
 			for(int i = 0; i < End; i++)
 			{
 				float a = i / Distance;
 				vec2 Pos = mix(m_Pos, NewPos, a);
-				for(int p = 0; p < MAX_CLIENTS; p++)
+				for(int k = 0; k < NumIDs; k++)
 				{
+					const int p = aIDs[k];
 					CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-					if(!pCharCore || pCharCore == this)
+					if(pCharCore == this)
 						continue;
 					if((!(pCharCore->m_Super || m_Super) && (m_Solo || pCharCore->m_Solo || pCharCore->m_CollisionDisabled || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, p)))))
 						continue;
@@ -533,6 +571,7 @@ void CCharacterCore::Move()
 							m_Pos = LastPos;
 						else if(distance(NewPos, pCharCore->m_Pos) > D)
 							m_Pos = NewPos;
+						m_pWorld->UpdateBroadphase(m_Id);
 						return;
 					}
 				}
@@ -542,6 +581,8 @@ void CCharacterCore::Move()
 	}
 
 	m_Pos = NewPos;
+	if(m_pWorld)
+		m_pWorld->UpdateBroadphase(m_Id);
 }
 
 void CCharacterCore::Write(CNetObj_CharacterCore *pObjCore)
@@ -579,6 +620,8 @@ void CCharacterCore::Read(const CNetObj_CharacterCore *pObjCore)
 	m_Jumped = pObjCore->m_Jumped;
 	m_Direction = pObjCore->m_Direction;
 	m_Angle = pObjCore->m_Angle;
+	if(m_pWorld)
+		m_pWorld->UpdateBroadphase(m_Id);
 }
 
 void CCharacterCore::ReadDDNet(const CNetObj_DDNetCharacter *pObjDDNet)
@@ -688,6 +731,143 @@ bool CCharacterCore::IsSwitchActiveCb(int Number, void *pUser)
 	return false;
 }
 
+static bool InBroadphaseBox(vec2 Pos, vec2 Min, vec2 Max)
+{
+	// written so that NaN positions are never filtered out
+	return !(Pos.x < Min.x || Pos.x > Max.x || Pos.y < Min.y || Pos.y > Max.y);
+}
+
+int CWorldCore::BroadphaseCoord(float Pos)
+{
+	// also keeps far away positions in range
+	return (int)std::floor(clamp(Pos, -1e7f, 1e7f) / BROADPHASE_CELL_SIZE);
+}
+
+int CWorldCore::BroadphaseBucket(int X, int Y)
+{
+	return ((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) % NUM_BROADPHASE_BUCKETS;
+}
+
+bool CWorldCore::BroadphaseCurrent(int ID) const
+{
+	const CCharacterCore *pCharCore = m_apCharacters[ID];
+	if(!pCharCore)
+		return m_aBroadphaseBucket[ID] < 0;
+	const vec2 Pos = pCharCore->m_Pos;
+	if(Pos.x != Pos.x || Pos.y != Pos.y)
+		return m_aBroadphaseBucket[ID] == BROADPHASE_BUCKET_NAN;
+	return m_aBroadphaseBucket[ID] >= 0 && m_aBroadphaseCell[ID] == ivec2(BroadphaseCoord(Pos.x), BroadphaseCoord(Pos.y));
+}
+
+void CWorldCore::BroadphaseLink(int ID)
+{
+	const vec2 Pos = m_apCharacters[ID]->m_Pos;
+	if(Pos.x != Pos.x || Pos.y != Pos.y)
+	{
+		m_aBroadphaseCell[ID] = ivec2(0, 0);
+		m_aBroadphaseBucket[ID] = BROADPHASE_BUCKET_NAN;
+	}
+	else
+	{
+		m_aBroadphaseCell[ID] = ivec2(BroadphaseCoord(Pos.x), BroadphaseCoord(Pos.y));
+		m_aBroadphaseBucket[ID] = BroadphaseBucket(m_aBroadphaseCell[ID].x, m_aBroadphaseCell[ID].y);
+	}
+
+	int &First = m_aBroadphaseFirst[m_aBroadphaseBucket[ID]];
+	if(First >= 0)
+		m_aBroadphasePrev[First] = ID;
+	m_aBroadphaseNext[ID] = First;
+	m_aBroadphasePrev[ID] = -1;
+	First = ID;
+}
+
+void CWorldCore::BroadphaseUnlink(int ID)
+{
+	if(m_aBroadphaseBucket[ID] < 0)
+		return;
+	if(m_aBroadphasePrev[ID] >= 0)
+		m_aBroadphaseNext[m_aBroadphasePrev[ID]] = m_aBroadphaseNext[ID];
+	else
+		m_aBroadphaseFirst[m_aBroadphaseBucket[ID]] = m_aBroadphaseNext[ID];
+	if(m_aBroadphaseNext[ID] >= 0)
+		m_aBroadphasePrev[m_aBroadphaseNext[ID]] = m_aBroadphasePrev[ID];
+	m_aBroadphaseBucket[ID] = -1;
+}
+
+void CWorldCore::BuildBroadphase()
+{
+	for(int &First : m_aBroadphaseFirst)
+		First = -1;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aBroadphaseBucket[i] = -1;
+		if(m_apCharacters[i])
+			BroadphaseLink(i);
+	}
+	m_BroadphaseBuilt = true;
+}
+
+void CWorldCore::UpdateBroadphase(int ID)
+{
+	if(!m_BroadphaseBuilt || ID < 0 || ID >= MAX_CLIENTS || BroadphaseCurrent(ID))
+		return;
+	BroadphaseUnlink(ID);
+	if(m_apCharacters[ID])
+		BroadphaseLink(ID);
+}
+
+int CWorldCore::FindCharacters(vec2 Min, vec2 Max, int *pIDs) const
+{
+	int Num = 0;
+	if(m_UseBroadphase && m_BroadphaseBuilt && Min.x <= Max.x && Min.y <= Max.y)
+	{
+#ifdef CONF_DEBUG
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			dbg_assert(BroadphaseCurrent(i), "character moved without UpdateBroadphase");
+#endif
+
+		const int MinX = BroadphaseCoord(Min.x);
+		const int MinY = BroadphaseCoord(Min.y);
+		const int MaxX = BroadphaseCoord(Max.x);
+		const int MaxY = BroadphaseCoord(Max.y);
+		if((int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) <= BROADPHASE_MAX_CELLS)
+		{
+			for(int y = MinY; y <= MaxY; y++)
+			{
+				for(int x = MinX; x <= MaxX; x++)
+				{
+					for(int i = m_aBroadphaseFirst[BroadphaseBucket(x, y)]; i >= 0; i = m_aBroadphaseNext[i])
+					{
+						// only take characters from this cell, not others in the bucket
+						if(m_aBroadphaseCell[i] == ivec2(x, y) && InBroadphaseBox(m_apCharacters[i]->m_Pos, Min, Max))
+							pIDs[Num++] = i;
+					}
+				}
+			}
+			for(int i = m_aBroadphaseFirst[BROADPHASE_BUCKET_NAN]; i >= 0; i = m_aBroadphaseNext[i])
+			{
+				if(InBroadphaseBox(m_apCharacters[i]->m_Pos, Min, Max))
+					pIDs[Num++] = i;
+			}
+
+			// same order as walking all characters
+			std::sort(pIDs, pIDs + Num);
+			return Num;
+		}
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[i];
+		if(!pCharCore)
+			continue;
+		if(m_UseBroadphase && !InBroadphaseBox(pCharCore->m_Pos, Min, Max))
+			continue;
+		pIDs[Num++] = i;
+	}
+	return Num;
+}
+
 void CWorldCore::InitSwitchers(int HighestSwitchNumber)
 {
 	if(HighestSwitchNumber > 0)
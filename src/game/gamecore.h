@@ -196,6 +196,8 @@ public:
 	{
 		mem_zero(m_apCharacters, sizeof(m_apCharacters));
 		m_pPrng = nullptr;
+		m_UseBroadphase = true;
+		m_BroadphaseBuilt = false;
 	}
 
 	int RandomOr0(int BelowThis)
@@ -214,8 +216,43 @@ public:
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
 	CPrng *m_pPrng;
 
+	// broadphase for the player <-> player checks, only filters out
+	// characters that can't interact so the physics stay the same. The
+	// grid is built once per tick, characters that are added, removed or
+	// moved outside of CCharacterCore::Move during the tick have to be
+	// passed to UpdateBroadphase. Worlds that never build it walk all
+	// characters.
+	bool m_UseBroadphase;
+	void BuildBroadphase();
+	void UpdateBroadphase(int ID);
+	int FindCharacters(vec2 Min, vec2 Max, int *pIDs) const;
+
 	void InitSwitchers(int HighestSwitchNumber);
 	std::vector<SSwitchers> m_vSwitchers;
+
+private:
+	enum
+	{
+		BROADPHASE_CELL_SIZE = 128,
+		NUM_BROADPHASE_BUCKETS = 256,
+		// characters with NaN positions, returned by every query
+		BROADPHASE_BUCKET_NAN = NUM_BROADPHASE_BUCKETS,
+		// larger queries walk all characters
+		BROADPHASE_MAX_CELLS = 16,
+	};
+
+	bool m_BroadphaseBuilt;
+	int m_aBroadphaseFirst[NUM_BROADPHASE_BUCKETS + 1];
+	int m_aBroadphaseNext[MAX_CLIENTS];
+	int m_aBroadphasePrev[MAX_CLIENTS];
+	int m_aBroadphaseBucket[MAX_CLIENTS];
+	ivec2 m_aBroadphaseCell[MAX_CLIENTS];
+
+	static int BroadphaseCoord(float Pos);
+	static int BroadphaseBucket(int X, int Y);
+	bool BroadphaseCurrent(int ID) const;
+	void BroadphaseLink(int ID);
+	void BroadphaseUnlink(int ID);
 };
 
 class CCharacterCore
@@ -40,6 +40,29 @@ void CPrng::Seed(uint64_t aSeed[2])
 	RandomBits();
 }
 
+bool CPrng::Seed(const char *pDescription)
+{
+	const char *pSeed = str_startswith(pDescription, NAME ":");
+	if(!pSeed || str_length(pSeed) != 2 * 16 + 1 || pSeed[16] != ':')
+	{
+		return false;
+	}
+	uint64_t aSeed[2];
+	for(int i = 0; i < 2; i++)
+	{
+		char aHex[16 + 1];
+		str_copy(aHex, pSeed + i * (16 + 1), sizeof(aHex));
+		unsigned char aBytes[8];
+		if(str_hex_decode(aBytes, sizeof(aBytes), aHex))
+		{
+			return false;
+		}
+		aSeed[i] = (uint64_t)bytes_be_to_uint(aBytes) << 32 | bytes_be_to_uint(aBytes + 4);
+	}
+	Seed(aSeed);
+	return true;
+}
+
 unsigned int CPrng::RandomBits()
 {
 	dbg_assert(m_Seeded, "prng needs to be seeded before it can generate random numbers");
@@ -17,6 +17,11 @@ public:
 	// to be the same for the same seed.
 	void Seed(uint64_t aSeed[2]);
 
+	// Seeds the random number generator with the seed contained in a
+	// description returned by `Description()`. Returns false if the
+	// description doesn't belong to a seeded generator of this type.
+	bool Seed(const char *pDescription);
+
 	// Generates 32 random bits. `Seed()` must be called before calling
 	// this function.
 	unsigned int RandomBits();
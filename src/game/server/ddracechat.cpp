@@ -363,6 +363,7 @@ void ToggleSpecPauseVoted(IConsole::IResult *pResult, void *pUserData, int Pause
 		if(IsPlayerBeingVoted)
 			pPlayer->m_SpectatorID = pSelf->m_VoteVictim;
 	}
+	pSelf->InvalidateTeamMasks();
 }
 
 void CGameContext::ConToggleSpec(IConsole::IResult *pResult, void *pUserData)
@@ -1264,6 +1265,7 @@ void CGameContext::ConShowOthers(IConsole::IResult *pResult, void *pUserData)
 			pPlayer->m_ShowOthers = pResult->GetInteger(0);
 		else
 			pPlayer->m_ShowOthers = !pPlayer->m_ShowOthers;
+		pSelf->InvalidateTeamMasks();
 	}
 	else
 		pSelf->Console()->Print(
@@ -1314,6 +1316,7 @@ void CGameContext::ConSpecTeam(IConsole::IResult *pResult, void *pUserData)
 		pPlayer->m_SpecTeam = pResult->GetInteger(0);
 	else
 		pPlayer->m_SpecTeam = !pPlayer->m_SpecTeam;
+	pSelf->InvalidateTeamMasks();
 }
 
 bool CheckClientID(int ClientID)
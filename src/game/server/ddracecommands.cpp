@@ -296,6 +296,7 @@ void CGameContext::Teleport(CCharacter *pChr, vec2 Pos)
 {
 	pChr->Core()->m_Pos = Pos;
 	pChr->m_Pos = Pos;
+	pChr->GameWorld()->EntityMoved(pChr);
 	pChr->m_PrevPos = Pos;
 	pChr->m_DDRaceState = DDRACE_CHEAT;
 }
@@ -832,6 +833,29 @@ void CGameContext::ConDumpAntibot(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Antibot()->Dump();
 }
 
+void CGameContext::ConTeeHistorianStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(!pSelf->m_TeeHistorianActive)
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", "teehistorian is not recording");
+		return;
+	}
+
+	CTeeHistorianWriter::CStats Stats;
+	pSelf->m_TeeHistorianWriter.GetStats(&Stats);
+	const double Seconds = maximum(Stats.m_Seconds, 1.0);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "raw=%.2fMiB (%.1fKiB/s) written=%.2fMiB (%.1fKiB/s) ratio=%.2f",
+		Stats.m_RawBytes / 1024.0 / 1024.0, Stats.m_RawBytes / 1024.0 / Seconds,
+		Stats.m_WrittenBytes / 1024.0 / 1024.0, Stats.m_WrittenBytes / 1024.0 / Seconds,
+		Stats.m_WrittenBytes ? Stats.m_RawBytes / (double)Stats.m_WrittenBytes : 0.0);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", aBuf);
+	str_format(aBuf, sizeof(aBuf), "blocks=%d backlog=%d max_backlog=%d/%d stalls=%d",
+		Stats.m_NumBlocks, Stats.m_Backlog, Stats.m_MaxBacklog, (int)CTeeHistorianWriter::NUM_BLOCKS, Stats.m_NumStalls);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "teehistorian", aBuf);
+}
+
 void CGameContext::ConDumpLog(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
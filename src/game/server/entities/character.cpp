@@ -81,6 +81,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 	m_Core.m_Pos = m_Pos;
 	m_Core.m_Id = m_pPlayer->GetCID();
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = &m_Core;
+	GameServer()->m_World.m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 
 	m_ReckoningTick = 0;
 	m_SendCore = CCharacterCore();
@@ -107,6 +108,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 void CCharacter::Destroy()
 {
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+	GameServer()->m_World.m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 	m_Alive = false;
 	SetSolo(false);
 }
@@ -134,6 +136,7 @@ void CCharacter::SetSolo(bool Solo)
 {
 	m_Core.m_Solo = Solo;
 	Teams()->m_Core.SetSolo(m_pPlayer->GetCID(), Solo);
+	Teams()->InvalidateTeamMasks();
 
 	if(Solo)
 		m_NeededFaketuning |= FAKETUNE_SOLO;
@@ -805,6 +808,9 @@ void CCharacter::Tick()
 	m_PrevInput = m_Input;
 
 	m_PrevPos = m_Core.m_Pos;
+
+	// tiles, ninja and the telegun can move the core
+	GameWorld()->m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 }
 
 void CCharacter::TickDeferred()
@@ -830,6 +836,7 @@ void CCharacter::TickDeferred()
 	m_Core.Quantize();
 	bool StuckAfterQuant = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 	m_Pos = m_Core.m_Pos;
+	GameWorld()->EntityMoved(this);
 
 	if(!StuckBefore && (StuckAfterMove || StuckAfterQuant))
 	{
@@ -885,6 +892,7 @@ void CCharacter::TickDeferred()
 	{
 		m_Pos.x = m_Input.m_TargetX;
 		m_Pos.y = m_Input.m_TargetY;
+		GameWorld()->EntityMoved(this);
 	}
 
 	// update the m_SendCore if needed
@@ -970,6 +978,7 @@ void CCharacter::Die(int Killer, int Weapon)
 
 	GameServer()->m_World.RemoveEntity(this);
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+	GameServer()->m_World.m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 	GameServer()->CreateDeath(m_Pos, m_pPlayer->GetCID(), TeamMask());
 	Teams()->OnCharacterDeath(GetPlayer()->GetCID(), Weapon);
 }
@@ -1228,6 +1237,13 @@ void CCharacter::Snap(int SnappingClient)
 	pDDNetCharacter->m_TargetY = m_Core.m_Input.m_TargetY;
 }
 
+bool CCharacter::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
+
 // DDRace
 
 bool CCharacter::CanCollide(int ClientID)
@@ -2108,10 +2124,10 @@ void CCharacter::DDRacePostCoreTick()
 		return;
 
 	// handle Anti-Skip tiles
-	std::list<int> Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
+	CCollision::CMapIndices Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
 	if(!Indices.empty())
 	{
-		for(int &Index : Indices)
+		for(int Index : Indices)
 		{
 			HandleTiles(Index);
 			if(!m_Alive)
@@ -2234,6 +2250,7 @@ void CCharacter::Pause(bool Pause)
 	if(Pause)
 	{
 		GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+		GameServer()->m_World.m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 		GameServer()->m_World.RemoveEntity(this);
 
 		if(m_Core.m_HookedPlayer != -1) // Keeping hook would allow cheats
@@ -2246,6 +2263,7 @@ void CCharacter::Pause(bool Pause)
 	{
 		m_Core.m_Vel = vec2(0, 0);
 		GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = &m_Core;
+		GameServer()->m_World.m_Core.UpdateBroadphase(m_pPlayer->GetCID());
 		GameServer()->m_World.InsertEntity(this);
 	}
 }
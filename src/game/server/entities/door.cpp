@@ -113,3 +113,10 @@ void CDoor::Snap(int SnappingClient)
 		pObj->m_StartTick = StartTick;
 	}
 }
+
+bool CDoor::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	*pMax = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
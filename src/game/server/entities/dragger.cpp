@@ -252,3 +252,10 @@ void CDragger::Snap(int SnappingClient)
 		pObj->m_StartTick = StartTick;
 	}
 }
+
+bool CDragger::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
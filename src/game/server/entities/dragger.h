@@ -40,6 +40,7 @@ public:
 	void Reset() override;
 	void Tick() override;
 	void Snap(int SnappingClient) override;
+	bool GetSnapBox(vec2 *pMin, vec2 *pMax) override;
 };
 
 #endif // GAME_SERVER_ENTITIES_DRAGGER_H
@@ -146,3 +146,14 @@ void CDraggerBeam::Snap(int SnappingClient)
 		pObj->m_StartTick = StartTick;
 	}
 }
+
+bool CDraggerBeam::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	CCharacter *pTarget = GameServer()->GetPlayerChar(m_ForClientID);
+	if(!pTarget)
+		return false;
+
+	*pMin = vec2(minimum(m_Pos.x, pTarget->m_Pos.x), minimum(m_Pos.y, pTarget->m_Pos.y));
+	*pMax = vec2(maximum(m_Pos.x, pTarget->m_Pos.x), maximum(m_Pos.y, pTarget->m_Pos.y));
+	return true;
+}
@@ -215,3 +215,10 @@ void CGun::Snap(int SnappingClient)
 		pObj->m_StartTick = StartTick;
 	}
 }
+
+bool CGun::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
@@ -320,13 +320,7 @@ void CLaser::Snap(int SnappingClient)
 		if(!pObj)
 			return;
 
-		pObj->m_ToX = (int)m_Pos.x;
-		pObj->m_ToY = (int)m_Pos.y;
-		pObj->m_FromX = (int)m_From.x;
-		pObj->m_FromY = (int)m_From.y;
-		pObj->m_StartTick = m_EvalTick;
-		pObj->m_Owner = m_Owner;
-		pObj->m_Type = m_Type == WEAPON_LASER ? LASERTYPE_RIFLE : m_Type == WEAPON_SHOTGUN ? LASERTYPE_SHOTGUN : -1;
+		FillInfo(pObj);
 	}
 	else
 	{
@@ -334,14 +328,58 @@ void CLaser::Snap(int SnappingClient)
 		if(!pObj)
 			return;
 
-		pObj->m_X = (int)m_Pos.x;
-		pObj->m_Y = (int)m_Pos.y;
-		pObj->m_FromX = (int)m_From.x;
-		pObj->m_FromY = (int)m_From.y;
-		pObj->m_StartTick = m_EvalTick;
+		FillInfo(pObj);
 	}
 }
 
+bool CLaser::SnapShared(CSnapItems *pItems)
+{
+	// the same checks as Snap, except for the ones of the snapping client
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+	if(!pOwnerChar)
+		return true;
+
+	CSnapItems::CFilter Filter(m_Pos, m_From);
+	if(pOwnerChar->IsAlive())
+		Filter.m_Mask = pOwnerChar->TeamMask();
+
+	Filter.m_MinVersion = VERSION_DDNET_MULTI_LASER;
+	FillInfo(static_cast<CNetObj_DDNetLaser *>(pItems->Add(Filter, NETOBJTYPE_DDNETLASER, GetID(), sizeof(CNetObj_DDNetLaser))));
+	Filter.m_MinVersion = 0;
+	Filter.m_MaxVersion = VERSION_DDNET_MULTI_LASER;
+	FillInfo(static_cast<CNetObj_Laser *>(pItems->Add(Filter, NETOBJTYPE_LASER, GetID(), sizeof(CNetObj_Laser))));
+	return true;
+}
+
+void CLaser::FillInfo(CNetObj_DDNetLaser *pObj)
+{
+	pObj->m_ToX = (int)m_Pos.x;
+	pObj->m_ToY = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_From.x;
+	pObj->m_FromY = (int)m_From.y;
+	pObj->m_StartTick = m_EvalTick;
+	pObj->m_Owner = m_Owner;
+	pObj->m_Type = m_Type == WEAPON_LASER ? LASERTYPE_RIFLE : m_Type == WEAPON_SHOTGUN ? LASERTYPE_SHOTGUN : -1;
+}
+
+void CLaser::FillInfo(CNetObj_Laser *pObj)
+{
+	pObj->m_X = (int)m_Pos.x;
+	pObj->m_Y = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_From.x;
+	pObj->m_FromY = (int)m_From.y;
+	pObj->m_StartTick = m_EvalTick;
+}
+
+bool CLaser::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_From.x), minimum(m_Pos.y, m_From.y));
+	*pMax = vec2(maximum(m_Pos.x, m_From.x), maximum(m_Pos.y, m_From.y));
+	return true;
+}
+
 void CLaser::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
@@ -14,11 +14,15 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool GetSnapBox(vec2 *pMin, vec2 *pMax) override;
+	virtual bool SnapShared(CSnapItems *pItems) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 protected:
 	bool HitCharacter(vec2 From, vec2 To);
 	void DoBounce();
+	void FillInfo(CNetObj_DDNetLaser *pObj);
+	void FillInfo(CNetObj_Laser *pObj);
 
 private:
 	vec2 m_From;
@@ -181,3 +181,10 @@ void CLight::Snap(int SnappingClient)
 		pObj->m_StartTick = StartTick;
 	}
 }
+
+bool CLight::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	*pMax = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
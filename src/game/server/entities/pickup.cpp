@@ -266,6 +266,13 @@ void CPickup::Snap(int SnappingClient)
 		pPickup->m_Subtype = m_Subtype;
 }
 
+bool CPickup::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
+
 void CPickup::Move()
 {
 	if(Server()->Tick() % (int)(Server()->TickSpeed() * 0.15f) == 0)
@@ -145,3 +145,10 @@ void CPlasma::Snap(int SnappingClient)
 		pObj->m_StartTick = m_EvalTick;
 	}
 }
+
+bool CPlasma::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = m_Pos;
+	*pMax = m_Pos;
+	return true;
+}
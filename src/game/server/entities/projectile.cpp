@@ -182,6 +182,27 @@ void CProjectile::Snap(int SnappingClient)
 	FillInfo(pProj);
 }
 
+bool CProjectile::GetSnapBox(vec2 *pMin, vec2 *pMax)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	*pMin = *pMax = GetPos(Ct);
+	return true;
+}
+
+bool CProjectile::SnapShared(CSnapItems *pItems)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+
+	// the owner's team mask, like in Snap
+	CSnapItems::CFilter Filter(GetPos(Ct));
+	CCharacter *pOwnerChar = m_Owner >= 0 ? GameServer()->GetPlayerChar(m_Owner) : nullptr;
+	if(pOwnerChar && pOwnerChar->IsAlive())
+		Filter.m_Mask = pOwnerChar->TeamMask();
+
+	FillInfo(static_cast<CNetObj_Projectile *>(pItems->Add(Filter, NETOBJTYPE_PROJECTILE, GetID(), sizeof(CNetObj_Projectile))));
+	return true;
+}
+
 void CProjectile::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
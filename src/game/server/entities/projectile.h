@@ -30,6 +30,8 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool GetSnapBox(vec2 *pMin, vec2 *pMax) override;
+	virtual bool SnapShared(CSnapItems *pItems) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 private:
@@ -22,6 +22,13 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	m_InsertOrder = 0;
+
+	m_pPrevGridEntity = 0;
+	m_pNextGridEntity = 0;
+	m_GridBucket = -1;
+	m_GridX = 0;
+	m_GridY = 0;
 }
 
 CEntity::~CEntity()
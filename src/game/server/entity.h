@@ -10,6 +10,7 @@
 
 class CCollision;
 class CGameContext;
+class CSnapItems;
 
 /*
 	Class: Entity
@@ -21,8 +22,18 @@ class CEntity
 
 private:
 	friend CGameWorld; // entity list handling
+	template<typename TEntity>
+	friend class CEntityGrid;
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	int64_t m_InsertOrder;
+
+	// spatial grid handling, m_GridBucket is -1 if not in the grid
+	CEntity *m_pPrevGridEntity;
+	CEntity *m_pNextGridEntity;
+	int m_GridBucket;
+	int m_GridX;
+	int m_GridY;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -118,6 +129,38 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: GetSnapBox
+			Returns the region in which the entity can be seen by a
+			client. Used to skip the Snap call for clients that can't
+			see any part of it.
+
+		Arguments:
+			pMin - Top left corner of the region.
+			pMax - Bottom right corner of the region.
+
+		Returns:
+			False if the entity has no known region and has to be
+			snapped for every client.
+	*/
+	virtual bool GetSnapBox(vec2 *pMin, vec2 *pMax) { return false; }
+
+	/*
+		Function: SnapShared
+			Called once per snapshot tick if the snapshot items are
+			shared. Adds the items of the entity together with the
+			clients that get them, instead of snapping them for every
+			client.
+
+		Arguments:
+			pItems - The shared snapshot items of the tick.
+
+		Returns:
+			False if the items depend on the snapping client, Snap is
+			called for every client then.
+	*/
+	virtual bool SnapShared(CSnapItems *pItems) { return false; }
+
 	/*
 		Function: SwapClients
 			Called when two players have swapped their client ids.
@@ -0,0 +1,154 @@
+#ifndef GAME_SERVER_ENTITYGRID_H
+#define GAME_SERVER_ENTITYGRID_H
+
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Links entities into a uniform grid, hashed into a fixed number of buckets,
+// to speed up proximity queries. The links are kept in the entities, in
+// m_pPrevGridEntity, m_pNextGridEntity, m_GridBucket (-1 if not in the
+// grid), m_GridX and m_GridY. Query results are ordered by m_InsertOrder,
+// newest first, like the entity lists of the game world.
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SIZE = 256,
+		NUM_BUCKETS = 1024,
+	};
+
+private:
+	TEntity *m_apBuckets[NUM_BUCKETS];
+	int m_Num;
+	float m_MaxRadius;
+
+	static int Bucket(int X, int Y)
+	{
+		return ((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) % NUM_BUCKETS;
+	}
+
+	void Link(TEntity *pEnt)
+	{
+		pEnt->m_GridX = Coord(pEnt->m_Pos.x);
+		pEnt->m_GridY = Coord(pEnt->m_Pos.y);
+		pEnt->m_GridBucket = Bucket(pEnt->m_GridX, pEnt->m_GridY);
+
+		TEntity *&pFirst = m_apBuckets[pEnt->m_GridBucket];
+		if(pFirst)
+			pFirst->m_pPrevGridEntity = pEnt;
+		pEnt->m_pNextGridEntity = pFirst;
+		pEnt->m_pPrevGridEntity = nullptr;
+		pFirst = pEnt;
+	}
+
+	void Unlink(TEntity *pEnt)
+	{
+		if(pEnt->m_pPrevGridEntity)
+			pEnt->m_pPrevGridEntity->m_pNextGridEntity = pEnt->m_pNextGridEntity;
+		else
+			m_apBuckets[pEnt->m_GridBucket] = pEnt->m_pNextGridEntity;
+		if(pEnt->m_pNextGridEntity)
+			pEnt->m_pNextGridEntity->m_pPrevGridEntity = pEnt->m_pPrevGridEntity;
+
+		pEnt->m_pNextGridEntity = nullptr;
+		pEnt->m_pPrevGridEntity = nullptr;
+		pEnt->m_GridBucket = -1;
+	}
+
+public:
+	CEntityGrid()
+	{
+		for(auto &pBucket : m_apBuckets)
+			pBucket = nullptr;
+		m_Num = 0;
+		m_MaxRadius = 0.0f;
+	}
+
+	static int Coord(float Pos)
+	{
+		// also keeps NaN and far away positions in range
+		if(!(Pos > -1e7f))
+			Pos = -1e7f;
+		else if(Pos > 1e7f)
+			Pos = 1e7f;
+		return (int)std::floor(Pos / CELL_SIZE);
+	}
+
+	// false if the entity was moved without calling Moved
+	bool IsCurrent(const TEntity *pEnt) const
+	{
+		return pEnt->m_GridBucket < 0 || (Coord(pEnt->m_Pos.x) == pEnt->m_GridX && Coord(pEnt->m_Pos.y) == pEnt->m_GridY);
+	}
+
+	int Num() const { return m_Num; }
+
+	void Insert(TEntity *pEnt, float Radius)
+	{
+		Link(pEnt);
+		m_Num++;
+		m_MaxRadius = std::max(m_MaxRadius, Radius);
+	}
+
+	void Remove(TEntity *pEnt)
+	{
+		if(pEnt->m_GridBucket < 0)
+			return;
+		Unlink(pEnt);
+		m_Num--;
+	}
+
+	void Moved(TEntity *pEnt)
+	{
+		if(pEnt->m_GridBucket < 0 || IsCurrent(pEnt))
+			return;
+		Unlink(pEnt);
+		Link(pEnt);
+	}
+
+	// writes the entities of the cells overlapping the box, widened by the
+	// largest radius, to ppEnts and returns their number. Returns -1 if the
+	// box spans so many cells that walking all entities is faster.
+	int Query(vec2 Min, vec2 Max, TEntity **ppEnts, int MaxEnts) const
+	{
+		// the boxes are widened by the largest entity and a bit for rounding
+		const float Margin = m_MaxRadius + 1.0f;
+		const int MinX = Coord(Min.x - Margin);
+		const int MinY = Coord(Min.y - Margin);
+		const int MaxX = Coord(Max.x + Margin);
+		const int MaxY = Coord(Max.y + Margin);
+
+		const int64_t NumCells = (int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1);
+		if(NumCells > m_Num || NumCells > NUM_BUCKETS / 4)
+			return -1;
+
+		int Num = 0;
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				for(TEntity *pEnt = m_apBuckets[Bucket(x, y)]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+				{
+					// only take entities from this cell, not others in the bucket
+					if(pEnt->m_GridX == x && pEnt->m_GridY == y)
+					{
+						dbg_assert(Num < MaxEnts, "too many entities in the grid query");
+						ppEnts[Num++] = pEnt;
+					}
+				}
+			}
+		}
+
+		std::sort(ppEnts, ppEnts + Num, [](const TEntity *pA, const TEntity *pB) {
+			return pA->m_InsertOrder > pB->m_InsertOrder;
+		});
+		return Num;
+	}
+};
+
+#endif // GAME_SERVER_ENTITYGRID_H
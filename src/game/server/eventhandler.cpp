@@ -4,9 +4,11 @@
 
 #include "entity.h"
 #include "gamecontext.h"
+#include "snapitems.h"
 
 #include <base/system.h>
 #include <base/vmath.h>
+#include <engine/shared/config.h>
 
 //////////////////////////////////////////////////
 // Event handler
@@ -43,10 +45,41 @@ void CEventHandler::Clear()
 {
 	m_NumEvents = 0;
 	m_CurrentOffset = 0;
+	m_Shared = false;
+}
+
+void CEventHandler::PreSnap(CSnapItems *pItems)
+{
+	m_Shared = GameServer()->Config()->m_SvSnapShared;
+	if(!m_Shared)
+		return;
+
+	for(int i = 0; i < m_NumEvents; i++)
+	{
+		const CNetEvent_Common *pEvent = (const CNetEvent_Common *)&m_aData[m_aOffsets[i]];
+		CSnapItems::CFilter Filter(vec2(pEvent->m_X, pEvent->m_Y));
+		Filter.m_Mask = m_aClientMasks[i];
+
+		int Type = m_aTypes[i];
+		int Size = m_aSizes[i];
+		const char *pData = &m_aData[m_aOffsets[i]];
+		EventToSixup(&Type, &Size, &pData);
+		if(Type != m_aTypes[i])
+		{
+			// 0.7 clients get a different event
+			Filter.m_Sixup = 1;
+			mem_copy(pItems->Add(Filter, Type, i, Size), pData, Size);
+			Filter.m_Sixup = 0;
+		}
+		mem_copy(pItems->Add(Filter, m_aTypes[i], i, m_aSizes[i]), &m_aData[m_aOffsets[i]], m_aSizes[i]);
+	}
 }
 
 void CEventHandler::Snap(int SnappingClient)
 {
+	if(m_Shared)
+		return;
+
 	for(int i = 0; i < m_NumEvents; i++)
 	{
 		if(SnappingClient == SERVER_DEMO_CLIENT || CmaskIsSet(m_aClientMasks[i], SnappingClient))
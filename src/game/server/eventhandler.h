@@ -5,6 +5,8 @@
 
 #include <stdint.h>
 
+class CSnapItems;
+
 class CEventHandler
 {
 	enum
@@ -24,6 +26,9 @@ class CEventHandler
 	int m_CurrentOffset;
 	int m_NumEvents;
 
+	// the events were added to the shared snapshot items by PreSnap
+	bool m_Shared;
+
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	void SetGameServer(CGameContext *pGameServer);
@@ -31,6 +36,7 @@ public:
 	CEventHandler();
 	void *Create(int Type, int Size, int64_t Mask = -1LL);
 	void Clear();
+	void PreSnap(CSnapItems *pItems);
 	void Snap(int SnappingClient);
 
 	void EventToSixup(int *pType, int *pSize, const char **ppData);
@@ -155,12 +155,6 @@ void CGameContext::Clear()
 	m_Tuning = Tuning;
 }
 
-void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
-{
-	CGameContext *pSelf = (CGameContext *)pUser;
-	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
-}
-
 void CGameContext::CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
@@ -831,6 +825,23 @@ void CGameContext::OnPreTickTeehistorian()
 	}
 }
 
+bool CGameContext::RestorePrng(const char *pPrngDescription)
+{
+	return m_Prng.Seed(pPrngDescription);
+}
+
+bool CGameContext::CharacterPos(int ClientID, int *pX, int *pY) const
+{
+	if(!m_apPlayers[ClientID] || !m_apPlayers[ClientID]->GetCharacter())
+		return false;
+
+	CNetObj_CharacterCore Char;
+	m_apPlayers[ClientID]->GetCharacter()->GetCore().Write(&Char);
+	*pX = Char.m_X;
+	*pY = Char.m_Y;
+	return true;
+}
+
 void CGameContext::OnTick()
 {
 	// check tuning
@@ -838,10 +849,9 @@ void CGameContext::OnTick()
 
 	if(m_TeeHistorianActive)
 	{
-		int Error = aio_error(m_pTeeHistorianFile);
-		if(Error)
+		if(m_TeeHistorianWriter.Error())
 		{
-			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
+			dbg_msg("teehistorian", "error writing to file");
 			Server()->SetErrorShutdown("teehistorian io error");
 		}
 
@@ -849,6 +859,10 @@ void CGameContext::OnTick()
 		{
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
+			// every block starts with a keyframe, so that it can be decoded
+			// on its own
+			if(m_TeeHistorianWriter.EndTick())
+				m_TeeHistorianWriter.SetBlockTick(m_TeeHistorian.RecordKeyframe());
 		}
 		m_TeeHistorian.BeginTick(Server()->Tick());
 		m_TeeHistorian.BeginPlayers();
@@ -1397,6 +1411,7 @@ void CGameContext::OnClientEnter(int ClientID)
 				SendChatTarget(ClientID, "You can see other players. To disable this use DDNet client and type /showothers");
 
 			m_apPlayers[ClientID]->m_ShowOthers = g_Config.m_SvShowOthersDefault;
+			InvalidateTeamMasks();
 		}
 	}
 	m_VoteUpdate = true;
@@ -1527,6 +1542,7 @@ void CGameContext::OnClientConnected(int ClientID, void *pData)
 	m_apPlayers[ClientID] = new(ClientID) CPlayer(this, NextUniqueClientID, ClientID, StartTeam);
 	m_apPlayers[ClientID]->SetAfk(Afk);
 	NextUniqueClientID += 1;
+	InvalidateTeamMasks();
 
 #ifdef CONF_DEBUG
 	if(g_Config.m_DbgDummies)
@@ -1559,6 +1575,7 @@ void CGameContext::OnClientDrop(int ClientID, const char *pReason)
 		if(pPlayer && pPlayer->m_SpectatorID == ClientID)
 			pPlayer->m_SpectatorID = SPEC_FREEVIEW;
 	}
+	InvalidateTeamMasks();
 
 	// update conversation targets
 	for(auto &pPlayer : m_apPlayers)
@@ -2299,6 +2316,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 			{
 				CNetMsg_Cl_ShowOthersLegacy *pMsg = (CNetMsg_Cl_ShowOthersLegacy *)pRawMsg;
 				pPlayer->m_ShowOthers = pMsg->m_Show;
+				InvalidateTeamMasks();
 			}
 		}
 		else if(MsgID == NETMSGTYPE_CL_SHOWOTHERS)
@@ -2307,6 +2325,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 			{
 				CNetMsg_Cl_ShowOthers *pMsg = (CNetMsg_Cl_ShowOthers *)pRawMsg;
 				pPlayer->m_ShowOthers = pMsg->m_Show;
+				InvalidateTeamMasks();
 			}
 		}
 		else if(MsgID == NETMSGTYPE_CL_SHOWDISTANCE)
@@ -2332,7 +2351,10 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 			if(pMsg->m_SpectatorID >= 0 && (!m_apPlayers[pMsg->m_SpectatorID] || m_apPlayers[pMsg->m_SpectatorID]->GetTeam() == TEAM_SPECTATORS))
 				SendChatTarget(ClientID, "Invalid spectator id used");
 			else
+			{
 				pPlayer->m_SpectatorID = pMsg->m_SpectatorID;
+				InvalidateTeamMasks();
+			}
 		}
 		else if(MsgID == NETMSGTYPE_CL_CHANGEINFO)
 		{
@@ -3242,6 +3264,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("add_map_votes", "", CFGFLAG_SERVER, ConAddMapVotes, this, "Automatically adds voting options for all maps");
 	Console()->Register("vote", "r['yes'|'no']", CFGFLAG_SERVER, ConVote, this, "Force a vote to yes/no");
 	Console()->Register("dump_antibot", "", CFGFLAG_SERVER, ConDumpAntibot, this, "Dumps the antibot status");
+	Console()->Register("teehistorian_stats", "", CFGFLAG_SERVER, ConTeeHistorianStats, this, "Show the size, rate and write backlog of the teehistorian file");
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
 
@@ -3397,13 +3420,22 @@ void CGameContext::OnInit()
 		{
 			dbg_msg("teehistorian", "failed to open '%s'", aFilename);
 			Server()->SetErrorShutdown("teehistorian open error");
+			m_TeeHistorianActive = false;
 			return;
 		}
 		else
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+
+		// the index is only needed for seeking, so recording works without it
+		str_append(aFilename, ".index", sizeof(aFilename));
+		IOHANDLE IndexFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!IndexFile)
+		{
+			dbg_msg("teehistorian", "failed to open '%s'", aFilename);
+		}
+		m_TeeHistorianWriter.Open(THFile, IndexFile, g_Config.m_SvTeeHistorianCompression);
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -3433,7 +3465,11 @@ void CGameContext::OnInit()
 		GameInfo.m_MapSha256 = MapSha256;
 		GameInfo.m_MapCrc = MapCrc;
 
-		m_TeeHistorian.Reset(&GameInfo, TeeHistorianWrite, this);
+		GameInfo.m_Compressed = g_Config.m_SvTeeHistorianCompression != 0;
+
+		m_TeeHistorian.Reset(&GameInfo, CTeeHistorianWriter::WriteCallback, &m_TeeHistorianWriter);
+		m_TeeHistorianWriter.EndHeader();
+		m_TeeHistorianWriter.SetBlockTick(m_TeeHistorian.RecordKeyframe());
 
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
@@ -3710,15 +3746,11 @@ void CGameContext::OnShutdown()
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
-		aio_close(m_pTeeHistorianFile);
-		aio_wait(m_pTeeHistorianFile);
-		int Error = aio_error(m_pTeeHistorianFile);
-		if(Error)
+		if(!m_TeeHistorianWriter.Close())
 		{
-			dbg_msg("teehistorian", "error closing file, err=%d", Error);
+			dbg_msg("teehistorian", "error closing file");
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
-		aio_free(m_pTeeHistorianFile);
 	}
 
 	DeleteTempfile();
@@ -3791,11 +3823,50 @@ void CGameContext::OnSnap(int ClientID)
 
 	m_World.Snap(ClientID);
 	m_Events.Snap(ClientID);
+	SnapItems(ClientID);
 }
-void CGameContext::OnPreSnap() {}
+
+void CGameContext::SnapItems(int SnappingClient)
+{
+	if(!m_SnapItems.Num())
+		return;
+
+	CSnapItems::CView View;
+	View.m_ClientID = SnappingClient;
+	View.m_Version = GetClientVersion(SnappingClient);
+	View.m_Sixup = Server()->IsSixup(SnappingClient);
+	View.m_ShowAll = true;
+	if(SnappingClient != SERVER_DEMO_CLIENT)
+	{
+		View.m_ShowAll = m_apPlayers[SnappingClient]->m_ShowAll;
+		View.m_Pos = m_apPlayers[SnappingClient]->m_ViewPos;
+		View.m_ShowDistance = m_apPlayers[SnappingClient]->m_ShowDistance;
+	}
+
+	m_SnapItems.Visible(View, &m_vSnapItemsVisible);
+	for(int i : m_vSnapItemsVisible)
+	{
+		const CSnapItems::CItem &Item = m_SnapItems.Item(i);
+		void *pData = Server()->SnapNewItem(Item.m_Type, Item.m_ID, Item.m_Size);
+		if(pData)
+			mem_copy(pData, m_SnapItems.Data(i), Item.m_Size);
+	}
+}
+
+void CGameContext::OnPreSnap()
+{
+	m_SnapItems.Clear();
+	m_World.PreSnap(&m_SnapItems);
+	m_Events.PreSnap(&m_SnapItems);
+	if(Config()->m_SvSnapShared >= 2)
+		m_SnapItems.BuildGrid();
+}
+
 void CGameContext::OnPostSnap()
 {
+	m_World.PostSnap();
 	m_Events.Clear();
+	m_SnapItems.Clear();
 }
 
 bool CGameContext::IsClientReady(int ClientID) const
@@ -3926,6 +3997,12 @@ int CGameContext::GetDDRaceTeam(int ClientID)
 	return pController->m_Teams.m_Core.Team(ClientID);
 }
 
+void CGameContext::InvalidateTeamMasks()
+{
+	CGameControllerDDRace *pController = (CGameControllerDDRace *)m_pController;
+	pController->m_Teams.InvalidateTeamMasks();
+}
+
 void CGameContext::ResetTuning()
 {
 	CTuningParams TuningParams;
@@ -5,6 +5,7 @@
 
 #include <engine/console.h>
 #include <engine/server.h>
+#include <engine/shared/teehistorian_writer.h>
 
 #include <game/collision.h>
 #include <game/layers.h>
@@ -14,6 +15,7 @@
 #include "eventhandler.h"
 #include "game/generated/protocol.h"
 #include "gameworld.h"
+#include "snapitems.h"
 #include "teehistorian.h"
 
 #include <memory>
@@ -77,15 +79,19 @@ class CGameContext : public IGameServer
 
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
-	ASYNCIO *m_pTeeHistorianFile;
+	CTeeHistorianWriter m_TeeHistorianWriter;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
 
 	bool m_Resetting;
 
+	// the snapshot items that are built once per snapshot tick
+	CSnapItems m_SnapItems;
+	std::vector<int> m_vSnapItemsVisible;
+	void SnapItems(int SnappingClient);
+
 	static void CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser);
-	static void TeeHistorianWrite(const void *pData, int DataSize, void *pUser);
 
 	static void ConTuneParam(IConsole::IResult *pResult, void *pUserData);
 	static void ConToggleTuneParam(IConsole::IResult *pResult, void *pUserData);
@@ -116,6 +122,7 @@ class CGameContext : public IGameServer
 	static void ConVoteNo(IConsole::IResult *pResult, void *pUserData);
 	static void ConDrySave(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpAntibot(IConsole::IResult *pResult, void *pUserData);
+	static void ConTeeHistorianStats(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConDumpLog(IConsole::IResult *pResult, void *pUserData);
 
@@ -288,10 +295,14 @@ public:
 
 	// DDRace
 	void OnPreTickTeehistorian() override;
+	bool RestorePrng(const char *pPrngDescription) override;
+	bool CharacterPos(int ClientID, int *pX, int *pY) const override;
 	bool OnClientDDNetVersionKnown(int ClientID);
 	void FillAntibot(CAntibotRoundData *pData) override;
 	bool ProcessSpamProtection(int ClientID, bool RespectChatInitialDelay = true);
 	int GetDDRaceTeam(int ClientID);
+	// call when anything `CGameTeams::TeamMask` depends on changes
+	void InvalidateTeamMasks();
 	// Describes the time when the first player joined the server.
 	int64_t m_NonEmptySince;
 	int64_t m_LastMapVote;
@@ -6,12 +6,13 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "gamemodes/DDRace.h"
 #include "player.h"
+#include "playermaps.h"
 
 #include <engine/shared/config.h>
 
 #include <algorithm>
-#include <utility>
 
 //////////////////////////////////////////////////
 // game world
@@ -48,22 +49,65 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+void CGameWorld::EntityMoved(CEntity *pEnt)
+{
+	m_CharacterGrid.Moved(pEnt);
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_Core.UpdateBroadphase(((CCharacter *)pEnt)->GetPlayer()->GetCID());
+}
+
+int CGameWorld::CharacterCandidates(vec2 Min, vec2 Max, CEntity **ppEnts)
+{
+#ifdef CONF_DEBUG
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		dbg_assert(m_CharacterGrid.IsCurrent(pEnt), "character moved without EntityMoved");
+#endif
+
+	int Num = m_CharacterGrid.Query(Min, Max, ppEnts, MAX_CLIENTS);
+	if(Num >= 0)
+		return Num;
+
+	// large areas are faster to check by walking all characters
+	Num = 0;
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	{
+		dbg_assert(Num < MAX_CLIENTS, "too many characters");
+		ppEnts[Num++] = pEnt;
+	}
+	return Num;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	auto Check = [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
+		return true;
+	};
+
+	if(Type == ENTTYPE_CHARACTER)
+	{
+		CEntity *apCandidates[MAX_CLIENTS];
+		const int NumCandidates = CharacterCandidates(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates);
+		for(int i = 0; i < NumCandidates; i++)
+			if(!Check(apCandidates[i]))
+				break;
+	}
+	else
+	{
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(!Check(pEnt))
+				break;
 	}
 
 	return Num;
@@ -82,6 +126,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+	pEnt->m_InsertOrder = m_NextInsertOrder++;
+
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+		m_CharacterGrid.Insert(pEnt, pEnt->m_ProximityRadius);
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -98,17 +146,132 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	if(pEnt->m_pNextTypeEntity)
 		pEnt->m_pNextTypeEntity->m_pPrevTypeEntity = pEnt->m_pPrevTypeEntity;
 
+	m_CharacterGrid.Remove(pEnt);
+
 	// keep list traversing valid
 	if(m_pNextTraverseEntity == pEnt)
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 
+	// keep snap candidates valid
+	if(m_SnapCandidatesValid)
+	{
+		for(auto &Candidate : m_vSnapCandidates)
+		{
+			if(Candidate.m_pEntity == pEnt)
+				Candidate.m_pEntity = nullptr;
+		}
+	}
+
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
 }
 
+void CGameWorld::SnapCandidate(CEntity *pEnt, CSnapItems *pItems)
+{
+	if(pEnt->SnapShared(pItems))
+		return;
+
+	CSnapCandidate Candidate;
+	Candidate.m_pEntity = pEnt;
+	Candidate.m_Bounded = pEnt->GetSnapBox(&Candidate.m_Min, &Candidate.m_Max);
+	m_vSnapCandidates.push_back(Candidate);
+}
+
+void CGameWorld::PreSnap(CSnapItems *pItems)
+{
+	m_vSnapCandidates.clear();
+	m_SnapCandidatesValid = Config()->m_SvSnapShared;
+	if(!m_SnapCandidatesValid)
+		return;
+
+	// same order as the per-client traversal in Snap
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		SnapCandidate(pEnt, pItems);
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			SnapCandidate(pEnt, pItems);
+	}
+
+	m_SnapGridValid = Config()->m_SvSnapShared >= 2;
+	if(!m_SnapGridValid)
+		return;
+
+	m_SnapGrid.Clear();
+	m_vSnapUnbounded.clear();
+	for(int i = 0; i < (int)m_vSnapCandidates.size(); i++)
+	{
+		const CSnapCandidate &Candidate = m_vSnapCandidates[i];
+		if(Candidate.m_Bounded)
+			m_SnapGrid.Add(i, Candidate.m_Min, Candidate.m_Max);
+		else
+			m_vSnapUnbounded.push_back(i);
+	}
+	m_SnapGrid.Build();
+}
+
+void CGameWorld::PostSnap()
+{
+	m_vSnapCandidates.clear();
+	m_SnapCandidatesValid = false;
+	m_SnapGridValid = false;
+}
+
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(m_SnapCandidatesValid && Config()->m_SvSnapShared)
+	{
+		const CPlayer *pPlayer = SnappingClient == SERVER_DEMO_CLIENT ? nullptr : GameServer()->m_apPlayers[SnappingClient];
+		const bool Filter = pPlayer && !pPlayer->m_ShowAll;
+		vec2 ViewMin, ViewMax;
+		if(Filter)
+		{
+			// lines are clipped against the larger show distance, one extra unit covers rounding
+			float ClipDistance = maximum(pPlayer->m_ShowDistance.x, pPlayer->m_ShowDistance.y) + 1.0f;
+			ViewMin = pPlayer->m_ViewPos - vec2(ClipDistance, ClipDistance);
+			ViewMax = pPlayer->m_ViewPos + vec2(ClipDistance, ClipDistance);
+		}
+
+		if(Filter && m_SnapGridValid && Config()->m_SvSnapShared >= 2)
+		{
+			// merge the visible bounded candidates with the unbounded ones,
+			// both are sorted by candidate index
+			m_SnapGrid.Query(ViewMin, ViewMax, &m_vSnapVisible);
+			auto VisibleIt = m_vSnapVisible.begin();
+			auto UnboundedIt = m_vSnapUnbounded.begin();
+			while(VisibleIt != m_vSnapVisible.end() || UnboundedIt != m_vSnapUnbounded.end())
+			{
+				int Index;
+				if(UnboundedIt == m_vSnapUnbounded.end() || (VisibleIt != m_vSnapVisible.end() && *VisibleIt < *UnboundedIt))
+					Index = *VisibleIt++;
+				else
+					Index = *UnboundedIt++;
+				if(m_vSnapCandidates[Index].m_pEntity)
+					m_vSnapCandidates[Index].m_pEntity->Snap(SnappingClient);
+			}
+			return;
+		}
+
+		for(const auto &Candidate : m_vSnapCandidates)
+		{
+			if(!Candidate.m_pEntity)
+				continue;
+
+			if(Filter && Candidate.m_Bounded &&
+				(Candidate.m_Max.x < ViewMin.x || Candidate.m_Min.x > ViewMax.x ||
+					Candidate.m_Max.y < ViewMin.y || Candidate.m_Min.y > ViewMax.y))
+				continue;
+
+			Candidate.m_pEntity->Snap(SnappingClient);
+		}
+		return;
+	}
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -166,97 +329,47 @@ void CGameWorld::RemoveEntities()
 		}
 }
 
-bool distCompare(std::pair<float, int> a, std::pair<float, int> b)
-{
-	return (a.first < b.first);
-}
-
 void CGameWorld::UpdatePlayerMaps()
 {
 	if(Server()->Tick() % g_Config.m_SvMapUpdateRate != 0)
 		return;
 
-	std::pair<float, int> Dist[MAX_CLIENTS];
+	// collect the state of all clients once, the maps only read it
+	CPlayerMaps PlayerMaps;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
-		if(!Server()->ClientIngame(i))
+		CPlayerMaps::CClient &Client = PlayerMaps.m_aClients[i];
+		CPlayer *pPlayer = GameServer()->m_apPlayers[i];
+		if(!Server()->ClientIngame(i) || !pPlayer)
 			continue;
-		int *pMap = Server()->GetIdMap(i);
-
-		// compute distances
-		for(int j = 0; j < MAX_CLIENTS; j++)
+		Client.m_ViewPos = pPlayer->m_ViewPos;
+		CCharacter *pChr = pPlayer->GetCharacter();
+		if(!pChr)
 		{
-			Dist[j].second = j;
-			if(!Server()->ClientIngame(j) || !GameServer()->m_apPlayers[j])
-			{
-				Dist[j].first = 1e10;
-				continue;
-			}
-			CCharacter *pChr = GameServer()->m_apPlayers[j]->GetCharacter();
-			if(!pChr)
-			{
-				Dist[j].first = 1e9;
-				continue;
-			}
-			// copypasted chunk from character.cpp Snap() follows
-			CCharacter *pSnapChar = GameServer()->GetPlayerChar(i);
-			if(pSnapChar && !pSnapChar->IsSuper() &&
-				!GameServer()->m_apPlayers[i]->IsPaused() && GameServer()->m_apPlayers[i]->GetTeam() != TEAM_SPECTATORS &&
-				!pChr->CanCollide(i) &&
-				(!GameServer()->m_apPlayers[i] ||
-					GameServer()->m_apPlayers[i]->GetClientVersion() == VERSION_VANILLA ||
-					(GameServer()->m_apPlayers[i]->GetClientVersion() >= VERSION_DDRACE &&
-						(GameServer()->m_apPlayers[i]->m_ShowOthers == SHOW_OTHERS_OFF ||
-							(GameServer()->m_apPlayers[i]->m_ShowOthers == SHOW_OTHERS_ONLY_TEAM && !GameServer()->m_apPlayers[i]->GetCharacter()->SameTeam(j))))))
-				Dist[j].first = 1e8;
-			else
-				Dist[j].first = 0;
-
-			Dist[j].first += distance(GameServer()->m_apPlayers[i]->m_ViewPos, GameServer()->m_apPlayers[j]->GetCharacter()->m_Pos);
-		}
-
-		// always send the player themselves
-		Dist[i].first = 0;
-
-		// compute reverse map
-		int aReverseMap[MAX_CLIENTS];
-		for(int &j : aReverseMap)
-		{
-			j = -1;
-		}
-		for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
-		{
-			if(pMap[j] == -1)
-				continue;
-			if(Dist[pMap[j]].first > 5e9f)
-				pMap[j] = -1;
-			else
-				aReverseMap[pMap[j]] = j;
+			Client.m_State = CPlayerMaps::STATE_NO_CHARACTER;
+			continue;
 		}
+		Client.m_State = CPlayerMaps::STATE_CHARACTER;
+		Client.m_Pos = pChr->m_Pos;
 
-		std::nth_element(&Dist[0], &Dist[VANILLA_MAX_CLIENTS - 1], &Dist[MAX_CLIENTS], distCompare);
+		// the visibility rules of CCharacter::Snap()
+		if(pChr->IsSuper() || pPlayer->IsPaused() || pPlayer->GetTeam() == TEAM_SPECTATORS)
+			continue;
+		if(pPlayer->GetClientVersion() == VERSION_VANILLA)
+			Client.m_Show = CPlayerMaps::SHOW_COLLIDING;
+		else if(pPlayer->GetClientVersion() >= VERSION_DDRACE && pPlayer->m_ShowOthers == SHOW_OTHERS_OFF)
+			Client.m_Show = CPlayerMaps::SHOW_COLLIDING;
+		else if(pPlayer->GetClientVersion() >= VERSION_DDRACE && pPlayer->m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
+			Client.m_Show = CPlayerMaps::SHOW_COLLIDING_OR_TEAM;
+	}
 
-		int Mapc = 0;
-		int Demand = 0;
-		for(int j = 0; j < VANILLA_MAX_CLIENTS - 1; j++)
-		{
-			int k = Dist[j].second;
-			if(aReverseMap[k] != -1 || Dist[j].first > 5e9f)
-				continue;
-			while(Mapc < VANILLA_MAX_CLIENTS && pMap[Mapc] != -1)
-				Mapc++;
-			if(Mapc < VANILLA_MAX_CLIENTS - 1)
-				pMap[Mapc] = k;
-			else
-				Demand++;
-		}
-		for(int j = MAX_CLIENTS - 1; j > VANILLA_MAX_CLIENTS - 2; j--)
-		{
-			int k = Dist[j].second;
-			if(aReverseMap[k] != -1 && Demand-- > 0)
-				pMap[aReverseMap[k]] = -1;
-		}
-		pMap[VANILLA_MAX_CLIENTS - 1] = -1; // player with empty name to say chat msgs
+	const CTeamsCore *pTeams = &((CGameControllerDDRace *)GameServer()->m_pController)->m_Teams.m_Core;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		// only vanilla clients use their map, see IServer::Translate()
+		if(PlayerMaps.m_aClients[i].m_State == CPlayerMaps::STATE_OFFLINE || Server()->IsSixup(i) || Server()->GetClientVersion(i) >= VERSION_DDNET_OLD)
+			continue;
+		PlayerMaps.UpdateMap(i, Server()->GetIdMap(i), pTeams, g_Config.m_SvMapUpdateHysteresis);
 	}
 }
 
@@ -270,6 +383,8 @@ void CGameWorld::Tick()
 		if(GameServer()->m_pController->IsForceBalanced())
 			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, "Teams have been balanced");
 
+		m_Core.BuildBroadphase();
+
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
 		{
@@ -347,9 +462,13 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	const int NumCandidates = CharacterCandidates(Min, Max, apCandidates);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *p = (CCharacter *)apCandidates[i];
 		if(p == pNotThis)
 			continue;
 
@@ -385,9 +504,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CEntity *apCandidates[MAX_CLIENTS];
+	const int NumCandidates = GameServer()->m_World.CharacterCandidates(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *p = (CCharacter *)apCandidates[i];
 		if(p == pNotThis)
 			continue;
 
@@ -409,9 +530,13 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 {
 	std::list<CCharacter *> listOfChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius);
+	CEntity *apCandidates[MAX_CLIENTS];
+	const int NumCandidates = CharacterCandidates(Min, Max, apCandidates);
+	for(int i = 0; i < NumCandidates; i++)
 	{
+		CCharacter *pChr = (CCharacter *)apCandidates[i];
 		if(pChr == pNotThis)
 			continue;
 
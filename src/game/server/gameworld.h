@@ -4,11 +4,15 @@
 #define GAME_SERVER_GAMEWORLD_H
 
 #include <game/gamecore.h>
+#include <game/server/entitygrid.h>
+#include <game/server/snapgrid.h>
 
 #include <list>
+#include <vector>
 
 class CEntity;
 class CCharacter;
+class CSnapItems;
 
 /*
 	Class: Game World
@@ -34,6 +38,15 @@ private:
 
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
+	int64_t m_NextInsertOrder = 0;
+
+	// characters are additionally kept in a grid to speed up the
+	// proximity queries
+	CEntityGrid<CEntity> m_CharacterGrid;
+
+	// writes the characters that can be in the box to ppEnts, newest
+	// first, and returns their number, ppEnts needs room for MAX_CLIENTS
+	int CharacterCandidates(vec2 Min, vec2 Max, CEntity **ppEnts);
 
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
@@ -41,6 +54,25 @@ private:
 
 	void UpdatePlayerMaps();
 
+	struct CSnapCandidate
+	{
+		CEntity *m_pEntity;
+		vec2 m_Min;
+		vec2 m_Max;
+		bool m_Bounded;
+	};
+	std::vector<CSnapCandidate> m_vSnapCandidates;
+	bool m_SnapCandidatesValid = false;
+
+	// with sv_snap_shared 2 the bounded candidates are looked up through a
+	// grid instead of checking all of them for every client
+	CSnapGrid m_SnapGrid;
+	bool m_SnapGridValid = false;
+	std::vector<int> m_vSnapUnbounded;
+	std::vector<int> m_vSnapVisible;
+
+	void SnapCandidate(CEntity *pEnt, CSnapItems *pItems);
+
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
 	class CConfig *Config() { return m_pConfig; }
@@ -121,10 +153,39 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: EntityMoved
+			Has to be called when the position of a character was
+			changed, keeps the spatial grid up to date.
+
+		Arguments:
+			pEntity - Entity that moved
+	*/
+	void EntityMoved(CEntity *pEntity);
+
+	/*
+		Function: PreSnap
+			Collects the entities that can appear in a snapshot together
+			with the region they can be seen in. Done once per snapshot
+			tick, the result is shared by all snapping clients.
+
+		Arguments:
+			pItems - Entities that are the same for every client add
+				their snapshot items here instead.
+	*/
+	void PreSnap(CSnapItems *pItems);
+
+	/*
+		Function: PostSnap
+			Drops the snapshot candidates collected by PreSnap.
+	*/
+	void PostSnap();
+
 	/*
 		Function: Snap
 			Calls Snap on all the entities in the world to create
-			the snapshot.
+			the snapshot. If PreSnap has been called, only the
+			candidates that can be visible to the client are snapped.
 
 		Arguments:
 			SnappingClient - ID of the client which snapshot
@@ -620,6 +620,7 @@ void CPlayer::SetTeam(int Team, bool DoChatMsg)
 				pPlayer->m_SpectatorID = SPEC_FREEVIEW;
 		}
 	}
+	GameServer()->InvalidateTeamMasks();
 }
 
 bool CPlayer::SetTimerType(int TimerType)
@@ -796,6 +797,7 @@ int CPlayer::Pause(int State, bool Force)
 		// Update state
 		m_Paused = State;
 		m_LastPause = Server()->Tick();
+		GameServer()->InvalidateTeamMasks();
 
 		// Sixup needs a teamchange
 		protocol7::CNetMsg_Sv_Team Msg;
@@ -844,6 +846,7 @@ void CPlayer::SpectatePlayerName(const char *pName)
 		if(i != m_ClientID && Server()->ClientIngame(i) && !str_comp(pName, Server()->ClientName(i)))
 		{
 			m_SpectatorID = i;
+			GameServer()->InvalidateTeamMasks();
 			return;
 		}
 	}
@@ -0,0 +1,141 @@
+#include "playermaps.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/teamscore.h>
+
+#include <cmath>
+#include <cstdint>
+
+void CPlayerMaps::Reset()
+{
+	for(auto &Client : m_aClients)
+	{
+		Client.m_State = STATE_OFFLINE;
+		Client.m_Show = SHOW_ALL;
+		Client.m_ViewPos = vec2(0, 0);
+		Client.m_Pos = vec2(0, 0);
+	}
+}
+
+// players are ranked by tier first, then by distance and then by id
+enum
+{
+	TIER_SELF = 0,
+	TIER_VISIBLE,
+	TIER_HIDDEN,
+	TIER_NO_CHARACTER,
+};
+
+// packs the ranking into one integer, squared distances beyond ~60000
+// units are treated as equal
+static uint64_t RankKey(int Tier, float DistanceSquared, int ClientID)
+{
+	uint32_t Distance = minimum(DistanceSquared, 4e9f);
+	return (uint64_t)Tier << 38 | (uint64_t)Distance << 6 | ClientID;
+}
+
+static int KeyClientID(uint64_t Key) { return Key & 63; }
+
+int CPlayerMaps::UpdateMap(int ClientID, int *pMap, const CTeamsCore *pTeams, float Hysteresis) const
+{
+	static_assert(MAX_CLIENTS <= 64, "client ids must fit into the 6 low bits of the rank key");
+
+	const CClient &Observer = m_aClients[ClientID];
+	int aOldMap[VANILLA_MAX_CLIENTS];
+	mem_copy(aOldMap, pMap, sizeof(aOldMap));
+
+	// compute reverse map
+	int aReverseMap[MAX_CLIENTS];
+	for(int &j : aReverseMap)
+	{
+		j = -1;
+	}
+	for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+	{
+		if(pMap[j] == -1)
+			continue;
+		if(m_aClients[pMap[j]].m_State == STATE_OFFLINE)
+			pMap[j] = -1;
+		else
+			aReverseMap[pMap[j]] = j;
+	}
+
+	// rank all players and keep the best ranked ones sorted, most players
+	// are rejected by a single comparison
+	const int NumBest = VANILLA_MAX_CLIENTS - 1;
+	uint64_t aBest[NumBest];
+	int NumRanked = 0;
+	uint64_t aKeys[MAX_CLIENTS];
+	for(int j = 0; j < MAX_CLIENTS; j++)
+	{
+		const CClient &Other = m_aClients[j];
+		if(j == ClientID)
+			aKeys[j] = RankKey(TIER_SELF, 0.0f, j);
+		else if(Other.m_State == STATE_OFFLINE)
+			continue;
+		else if(Other.m_State == STATE_NO_CHARACTER)
+			aKeys[j] = RankKey(TIER_NO_CHARACTER, 0.0f, j);
+		else
+		{
+			vec2 Delta = Other.m_Pos - Observer.m_ViewPos;
+			float DistanceSquared = dot(Delta, Delta);
+			if(aReverseMap[j] != -1 && Hysteresis > 0.0f)
+			{
+				float Distance = maximum(std::sqrt(DistanceSquared) - Hysteresis, 0.0f);
+				DistanceSquared = Distance * Distance;
+			}
+			bool Hidden = (Observer.m_Show == SHOW_COLLIDING && !pTeams->CanCollide(j, ClientID)) ||
+				      (Observer.m_Show == SHOW_COLLIDING_OR_TEAM && !pTeams->CanCollide(j, ClientID) && !pTeams->SameTeam(ClientID, j));
+			aKeys[j] = RankKey(Hidden ? TIER_HIDDEN : TIER_VISIBLE, DistanceSquared, j);
+		}
+
+		if(NumRanked == NumBest && aKeys[j] >= aBest[NumBest - 1])
+			continue;
+		int k = minimum(NumRanked, NumBest - 1);
+		for(; k > 0 && aBest[k - 1] > aKeys[j]; k--)
+			aBest[k] = aBest[k - 1];
+		aBest[k] = aKeys[j];
+		NumRanked = minimum(NumRanked + 1, NumBest);
+	}
+
+	// give the best ranked players an id, closest first
+	bool aIsBest[MAX_CLIENTS] = {false};
+	int Mapc = 0;
+	int Demand = 0;
+	for(int j = 0; j < NumRanked; j++)
+	{
+		int k = KeyClientID(aBest[j]);
+		aIsBest[k] = true;
+		if(aReverseMap[k] != -1)
+			continue;
+		while(Mapc < VANILLA_MAX_CLIENTS && pMap[Mapc] != -1)
+			Mapc++;
+		if(Mapc < VANILLA_MAX_CLIENTS - 1)
+			pMap[Mapc] = k;
+		else
+			Demand++;
+	}
+
+	// make room for the others in the next update by dropping the
+	// farthest of the remaining players
+	for(; Demand > 0; Demand--)
+	{
+		int Farthest = -1;
+		for(int j = 0; j < VANILLA_MAX_CLIENTS - 1; j++)
+		{
+			if(pMap[j] != -1 && !aIsBest[pMap[j]] && (Farthest == -1 || aKeys[pMap[j]] > aKeys[pMap[Farthest]]))
+				Farthest = j;
+		}
+		if(Farthest == -1)
+			break;
+		pMap[Farthest] = -1;
+	}
+	pMap[VANILLA_MAX_CLIENTS - 1] = -1; // player with empty name to say chat msgs
+
+	int NumChanged = 0;
+	for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+		if(pMap[j] != aOldMap[j])
+			NumChanged++;
+	return NumChanged;
+}
@@ -0,0 +1,49 @@
+#ifndef GAME_SERVER_PLAYERMAPS_H
+#define GAME_SERVER_PLAYERMAPS_H
+
+#include <base/vmath.h>
+#include <engine/shared/protocol.h>
+
+class CTeamsCore;
+
+// Maps the client ids to the VANILLA_MAX_CLIENTS ids vanilla clients can
+// see, preferring the players that are closest to their view. The state of
+// all clients is collected once per update and shared by all maps.
+class CPlayerMaps
+{
+public:
+	enum
+	{
+		STATE_OFFLINE = 0, // not ingame, never mapped
+		STATE_NO_CHARACTER,
+		STATE_CHARACTER,
+	};
+
+	// which characters a client sees, derived from the Snap() rules
+	enum
+	{
+		SHOW_ALL = 0,
+		SHOW_COLLIDING, // characters that can't collide are hidden
+		SHOW_COLLIDING_OR_TEAM, // like above, but the own team is shown
+	};
+
+	struct CClient
+	{
+		int m_State;
+		int m_Show;
+		vec2 m_ViewPos;
+		vec2 m_Pos; // position of the character
+	};
+
+	CClient m_aClients[MAX_CLIENTS];
+
+	CPlayerMaps() { Reset(); }
+	void Reset();
+
+	// Updates the map of one client in place. Already mapped players keep
+	// their id until others are closer by more than Hysteresis. Returns the
+	// number of changed ids.
+	int UpdateMap(int ClientID, int *pMap, const CTeamsCore *pTeams, float Hysteresis) const;
+};
+
+#endif
@@ -182,6 +182,7 @@ void CSaveTee::Load(CCharacter *pChr, int Team, bool IsSwap)
 
 	// Core
 	pChr->m_Core.m_Pos = m_CorePos;
+	pChr->GameWorld()->EntityMoved(pChr);
 	pChr->m_Core.m_Vel = m_Vel;
 	pChr->m_Core.m_HookHitDisabled = !m_HookHitEnabled;
 	pChr->m_Core.m_CollisionDisabled = !m_CollisionEnabled;
@@ -30,7 +30,8 @@ void CScore::ExecPlayerThread(
 	const char *pThreadName,
 	int ClientID,
 	const char *pName,
-	int Offset)
+	int Offset,
+	FCacheQuery pfnCacheQuery)
 {
 	auto pResult = NewSqlPlayerResult(ClientID);
 	if(pResult == nullptr)
@@ -42,9 +43,71 @@ void CScore::ExecPlayerThread(
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_aRequestingPlayer));
 	Tmp->m_Offset = Offset;
 
+	// the result is processed on the next tick like a finished query
+	CScoreCache *pCache = Cache();
+	if(pfnCacheQuery != nullptr && pCache != nullptr && (pCache->*pfnCacheQuery)(Tmp.get(), pResult.get()))
+	{
+		pResult->m_Success = true;
+		pResult->m_Completed.store(true);
+		return;
+	}
+
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
 
+CScoreCache *CScore::Cache()
+{
+	if(m_pCacheResult != nullptr && m_pCacheResult->m_Completed)
+	{
+		if(m_pCacheResult->m_Success)
+		{
+			m_pCacheResult->AddPendingFinishes();
+			m_pCache = std::make_unique<CScoreCache>(std::move(m_pCacheResult->m_Cache));
+			dbg_msg("sql", "loaded score cache with %d players and %d teams", m_pCache->NumPlayers(), m_pCache->NumTeams());
+		}
+		m_pCacheResult = nullptr;
+	}
+	AddWrittenFinishes();
+	return m_pCache.get();
+}
+
+void CScore::AddWrittenFinishes()
+{
+	for(auto It = m_vPendingFinishes.begin(); It != m_vPendingFinishes.end();)
+	{
+		if(!It->first->m_Completed)
+		{
+			++It;
+			continue;
+		}
+		// failed writes are never added, they aren't in the database either
+		if(It->first->m_Success)
+		{
+			if(m_pCache != nullptr)
+				m_pCache->AddFinish(It->second);
+			else if(m_pCacheResult != nullptr)
+				m_pCacheResult->m_vPendingFinishes.push_back(std::move(It->second));
+		}
+		It = m_vPendingFinishes.erase(It);
+	}
+	for(auto It = m_vPendingTeamFinishes.begin(); It != m_vPendingTeamFinishes.end();)
+	{
+		if(!It->first->m_Completed)
+		{
+			++It;
+			continue;
+		}
+		if(It->first->m_Success)
+		{
+			if(m_pCache != nullptr)
+				m_pCache->AddTeamFinish(It->second);
+			else if(m_pCacheResult != nullptr)
+				m_pCacheResult->m_vPendingTeamFinishes.push_back(std::move(It->second));
+		}
+		It = m_vPendingTeamFinishes.erase(It);
+	}
+}
+
 bool CScore::RateLimitPlayer(int ClientID)
 {
 	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientID];
@@ -111,6 +174,14 @@ CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	}
 
 	// m_pPool->Execute(CScoreWorker::Init, std::move(Tmp), "load best time");
+
+	if(g_Config.m_SvScoreCache)
+	{
+		m_pCacheResult = std::make_shared<CScoreCacheResult>();
+		auto CacheRequest = std::make_unique<CSqlScoreCacheRequest>(m_pCacheResult);
+		str_copy(CacheRequest->m_aMap, g_Config.m_SvMap, sizeof(CacheRequest->m_aMap));
+		m_pPool->Execute(CScoreCache::Load, std::move(CacheRequest), "load score cache");
+	}
 }
 
 void CScore::LoadPlayerData(int ClientID, const char *pName)
@@ -152,6 +223,10 @@ void CScore::SaveScore(int ClientID, float Time, const char *pTimestamp, const f
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
 
+	// the cache only learns about the finish once it is written
+	CScoreCache::CFinish Finish{Tmp->m_aName, g_Config.m_SvSqlServerName, Time};
+	m_vPendingFinishes.emplace_back(pCurPlayer->m_ScoreFinishResult, std::move(Finish));
+
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
 
@@ -165,7 +240,8 @@ void CScore::SaveTeamScore(int *pClientIDs, unsigned int Size, float Time, const
 		if(GameServer()->m_apPlayers[pClientIDs[i]]->m_NotEligibleForFinish)
 			return;
 	}
-	auto Tmp = std::make_unique<CSqlTeamScoreData>();
+	auto pResult = std::make_shared<ISqlResult>();
+	auto Tmp = std::make_unique<CSqlTeamScoreData>(pResult);
 	for(unsigned int i = 0; i < Size; i++)
 		str_copy(Tmp->m_aaNames[i], Server()->ClientName(pClientIDs[i]), sizeof(Tmp->m_aaNames[i]));
 	Tmp->m_Size = Size;
@@ -175,6 +251,11 @@ void CScore::SaveTeamScore(int *pClientIDs, unsigned int Size, float Time, const
 	str_copy(Tmp->m_aMap, g_Config.m_SvMap, sizeof(Tmp->m_aMap));
 	Tmp->m_TeamrankUuid = RandomUuid();
 
+	CScoreCache::CTeamFinish TeamFinish{Tmp->m_TeamrankUuid, {}, Time};
+	for(unsigned int i = 0; i < Size; i++)
+		TeamFinish.m_vNames.emplace_back(Tmp->m_aaNames[i]);
+	m_vPendingTeamFinishes.emplace_back(std::move(pResult), std::move(TeamFinish));
+
 	m_pPool->ExecuteWrite(CScoreWorker::SaveTeamScore, std::move(Tmp), "save team score");
 }
 
@@ -182,7 +263,7 @@ void CScore::ShowRank(int ClientID, const char *pName)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientID, pName, 0);
+	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientID, pName, 0, &CScoreCache::ShowRank);
 }
 
 void CScore::ShowTeamRank(int ClientID, const char *pName)
@@ -196,14 +277,14 @@ void CScore::ShowTop(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientID, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientID, "", Offset, &CScoreCache::ShowTop);
 }
 
 void CScore::ShowTeamTop5(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientID, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientID, "", Offset, &CScoreCache::ShowTeamTop5);
 }
 
 void CScore::ShowPlayerTeamTop5(int ClientID, const char *pName, int Offset)
@@ -3,6 +3,7 @@
 
 #include <game/prng.h>
 
+#include "scorecache.h"
 #include "scoreworker.h"
 
 class CDbConnectionPool;
@@ -21,19 +22,33 @@ class CScore
 	CGameContext *m_pGameServer;
 	IServer *m_pServer;
 
+	// answers ranking requests once it is loaded, SQL is used until then
+	std::unique_ptr<CScoreCache> m_pCache;
+	std::shared_ptr<CScoreCacheResult> m_pCacheResult;
+	// returns nullptr if the cache isn't loaded (yet)
+	CScoreCache *Cache();
+	// finishes waiting for their database write
+	std::vector<std::pair<std::shared_ptr<ISqlResult>, CScoreCache::CFinish>> m_vPendingFinishes;
+	std::vector<std::pair<std::shared_ptr<ISqlResult>, CScoreCache::CTeamFinish>> m_vPendingTeamFinishes;
+	// adds the finishes whose write succeeded to the cache
+	void AddWrittenFinishes();
+
 	std::vector<std::string> m_vWordlist;
 	CPrng m_Prng;
 	void GeneratePassphrase(char *pBuf, int BufSize);
 
 	// returns new SqlResult bound to the player, if no current Thread is active for this player
 	std::shared_ptr<CScorePlayerResult> NewSqlPlayerResult(int ClientID);
-	// Creates for player database requests
+	typedef bool (CScoreCache::*FCacheQuery)(const CSqlPlayerRequest *, CScorePlayerResult *) const;
+	// Creates for player database requests, they are answered from the
+	// cache instead if possible
 	void ExecPlayerThread(
 		bool (*pFuncPtr)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
 		const char *pThreadName,
 		int ClientID,
 		const char *pName,
-		int Offset);
+		int Offset,
+		FCacheQuery pfnCacheQuery = nullptr);
 
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientID);
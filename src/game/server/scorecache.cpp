@@ -0,0 +1,374 @@
+#include "scorecache.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/server/databases/connection.h>
+#include <engine/shared/config.h>
+
+#include <algorithm>
+#include <cmath>
+
+// the database stores times with two decimals
+static float RoundTime(float Time)
+{
+	char aBuf[32];
+	str_format(aBuf, sizeof(aBuf), "%.2f", Time);
+	return str_tofloat(aBuf);
+}
+
+// like `RANK() OVER (ORDER BY Time)` for a ranking sorted by time
+template<typename T>
+static int Rank(const std::vector<std::pair<float, T>> &vRanking, float Time)
+{
+	auto It = std::lower_bound(vRanking.begin(), vRanking.end(), Time, [](const std::pair<float, T> &Entry, float Value) {
+		return Entry.first < Value;
+	});
+	return It - vRanking.begin() + 1;
+}
+
+static void FormatNames(const std::vector<std::string> &vNames, char *pBuf, int BufSize)
+{
+	pBuf[0] = '\0';
+	for(size_t i = 0; i < vNames.size(); i++)
+	{
+		str_append(pBuf, vNames[i].c_str(), BufSize);
+		if(i + 2 < vNames.size())
+			str_append(pBuf, ", ", BufSize);
+		else if(i + 2 == vNames.size())
+			str_append(pBuf, " & ", BufSize);
+	}
+}
+
+bool CScoreCache::CTeam::operator<(const CTeam &Other) const
+{
+	if(m_Time != Other.m_Time)
+		return m_Time < Other.m_Time;
+	return m_ID < Other.m_ID;
+}
+
+bool CScoreCache::Load(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CSqlScoreCacheRequest *pData = dynamic_cast<const CSqlScoreCacheRequest *>(pGameData);
+	CScoreCacheResult *pResult = dynamic_cast<CScoreCacheResult *>(pGameData->m_pResult.get());
+	CScoreCache *pCache = &pResult->m_Cache;
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Server, MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? "
+		"GROUP BY Name, Server",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_aMap);
+
+	bool End = false;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		char aServer[16];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		pSqlServer->GetString(2, aServer, sizeof(aServer));
+		pCache->InsertFinish(aName, aServer, pSqlServer->GetFloat(3));
+	}
+	if(!End)
+	{
+		return true;
+	}
+	pCache->SortRanking();
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT ID, Name, Time, DDNet7 "
+		"FROM %s_teamrace "
+		"WHERE Map = ? "
+		"ORDER BY ID",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_aMap);
+
+	End = false;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CUuid TeamID;
+		pSqlServer->GetBlob(1, TeamID.m_aData, sizeof(TeamID.m_aData));
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(2, aName, sizeof(aName));
+		const float Time = pSqlServer->GetFloat(3);
+		if(pCache->m_vTeams.empty() || pCache->m_vTeams.back().m_ID != TeamID)
+		{
+			pCache->m_vTeams.push_back({TeamID, {}, Time, pSqlServer->GetInt(4) != 0});
+		}
+		CTeam &Team = pCache->m_vTeams.back();
+		Team.m_Time = minimum(Team.m_Time, Time);
+		Team.m_vNames.emplace_back(aName);
+	}
+	if(!End)
+	{
+		return true;
+	}
+	for(auto &Team : pCache->m_vTeams)
+		std::sort(Team.m_vNames.begin(), Team.m_vNames.end());
+	std::sort(pCache->m_vTeams.begin(), pCache->m_vTeams.end());
+	return false;
+}
+
+void CScoreCache::InsertFinish(const char *pName, const char *pServer, float Time)
+{
+	auto [It, Inserted] = m_Players.try_emplace(pName, CPlayer{Time, {}});
+	CPlayer &Player = It->second;
+	Player.m_BestTime = minimum(Player.m_BestTime, Time);
+	for(auto &[Server, ServerTime] : Player.m_vServerTimes)
+	{
+		if(Server == pServer)
+		{
+			ServerTime = minimum(ServerTime, Time);
+			return;
+		}
+	}
+	Player.m_vServerTimes.emplace_back(pServer, Time);
+}
+
+void CScoreCache::SortRanking()
+{
+	m_vRanking.clear();
+	m_vRanking.reserve(m_Players.size());
+	for(const auto &[Name, Player] : m_Players)
+		m_vRanking.emplace_back(Player.m_BestTime, Name);
+	std::sort(m_vRanking.begin(), m_vRanking.end());
+}
+
+bool CScoreCache::RegionalTime(const CPlayer &Player, const char *pServer, float *pTime)
+{
+	// like `Server LIKE '%<server>%'`
+	bool Found = false;
+	for(const auto &[Server, Time] : Player.m_vServerTimes)
+	{
+		if(str_find_nocase(Server.c_str(), pServer) && (!Found || Time < *pTime))
+		{
+			*pTime = Time;
+			Found = true;
+		}
+	}
+	return Found;
+}
+
+void CScoreCache::UpdateRanking(CRanking *pRanking, const std::string &Name, bool Ranked, float OldTime, float Time)
+{
+	if(Ranked)
+	{
+		if(Time >= OldTime)
+			return;
+		pRanking->erase(std::lower_bound(pRanking->begin(), pRanking->end(), std::make_pair(OldTime, Name)));
+	}
+	std::pair<float, std::string> Entry(Time, Name);
+	pRanking->insert(std::lower_bound(pRanking->begin(), pRanking->end(), Entry), std::move(Entry));
+}
+
+const CScoreCache::CRanking &CScoreCache::RegionalRanking(const char *pServer) const
+{
+	auto [It, Inserted] = m_RegionalRankings.try_emplace(pServer);
+	CRanking &Ranking = It->second;
+	if(Inserted)
+	{
+		for(const auto &[Name, Player] : m_Players)
+		{
+			float Time = 0.0f;
+			if(RegionalTime(Player, pServer, &Time))
+				Ranking.emplace_back(Time, Name);
+		}
+		std::sort(Ranking.begin(), Ranking.end());
+	}
+	return Ranking;
+}
+
+void CScoreCache::AddFinish(const CFinish &Finish)
+{
+	const float Time = RoundTime(Finish.m_Time);
+	auto It = m_Players.find(Finish.m_Name);
+	const bool Ranked = It != m_Players.end();
+
+	UpdateRanking(&m_vRanking, Finish.m_Name, Ranked, Ranked ? It->second.m_BestTime : 0.0f, Time);
+	// only the regions of the server the finish was on can change
+	for(auto &[Server, Ranking] : m_RegionalRankings)
+	{
+		if(!str_find_nocase(Finish.m_Server.c_str(), Server.c_str()))
+			continue;
+		float OldTime = 0.0f;
+		const bool RegionalRanked = Ranked && RegionalTime(It->second, Server.c_str(), &OldTime);
+		UpdateRanking(&Ranking, Finish.m_Name, RegionalRanked, OldTime, Time);
+	}
+
+	InsertFinish(Finish.m_Name.c_str(), Finish.m_Server.c_str(), Time);
+}
+
+void CScoreCache::AddTeamFinish(const CTeamFinish &Finish)
+{
+	CTeam Team{Finish.m_TeamID, Finish.m_vNames, RoundTime(Finish.m_Time), false};
+	std::sort(Team.m_vNames.begin(), Team.m_vNames.end());
+
+	// like CScoreWorker::SaveTeamScore, only improve the time of an existing
+	// team with the same players
+	auto It = std::find_if(m_vTeams.begin(), m_vTeams.end(), [&](const CTeam &Other) {
+		return !Other.m_DDNet7 && Other.m_vNames == Team.m_vNames;
+	});
+	if(It != m_vTeams.end())
+	{
+		if(Team.m_Time >= It->m_Time)
+			return;
+		It->m_Time = Team.m_Time;
+	}
+	else
+	{
+		m_vTeams.push_back(std::move(Team));
+	}
+	std::sort(m_vTeams.begin(), m_vTeams.end());
+}
+
+bool CScoreCache::ShowRank(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	// the names are compared exactly, like the binary collation of the
+	// name column does
+	auto It = m_Players.find(pData->m_aName);
+	if(It == m_Players.end())
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pData->m_aName);
+		return true;
+	}
+
+	char aRegionalRank[16];
+	float RegionalBest = 0.0f;
+	if(RegionalTime(It->second, pData->m_aServer, &RegionalBest))
+	{
+		const int RegionalRank = Rank(RegionalRanking(pData->m_aServer), RegionalBest);
+		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", RegionalRank);
+	}
+	else
+	{
+		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	}
+
+	const float Time = It->second.m_BestTime;
+	const int GlobalRank = Rank(m_vRanking, Time);
+	// like `PERCENT_RANK() OVER (ORDER BY Time)`
+	const int NumPlayers = m_vRanking.size();
+	const float PercentRank = NumPlayers > 1 ? (float)((double)(GlobalRank - 1) / (NumPlayers - 1)) : 0.0f;
+	int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+	char aBuf[64];
+	str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+	if(g_Config.m_SvHideScore)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
+	}
+	else
+	{
+		pResult->m_MessageKind = CScorePlayerResult::ALL;
+
+		if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%%",
+				pData->m_aName, aBuf, BetterThanPercent);
+		}
+		else
+		{
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%% - requested by %s",
+				pData->m_aName, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
+		}
+
+		str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+			"Global rank %d - %s %s",
+			GlobalRank, pData->m_aServer, aRegionalRank);
+	}
+	return true;
+}
+
+bool CScoreCache::ShowTop(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+	// like `ORDER BY Ranking ASC/DESC LIMIT <start>, <num>`
+	const int LimitStart = maximum(absolute(pData->m_Offset) - 1, 0);
+	const bool Ascending = pData->m_Offset >= 0;
+
+	int Line = 0;
+	str_copy(paMessages[Line], "------------ Global Top ------------", sizeof(paMessages[Line]));
+	Line++;
+
+	char aTime[32];
+	const int NumPlayers = m_vRanking.size();
+	for(int i = LimitStart; i < minimum(LimitStart + 5, NumPlayers); i++)
+	{
+		const auto &[Time, Name] = m_vRanking[Ascending ? i : NumPlayers - 1 - i];
+		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Time: %s", Rank(m_vRanking, Time), Name.c_str(), aTime);
+		Line++;
+	}
+
+	str_format(paMessages[Line], sizeof(paMessages[Line]),
+		"------------ %s Top ------------", pData->m_aServer);
+	Line++;
+
+	const CRanking &Regional = RegionalRanking(pData->m_aServer);
+	const int NumRegional = Regional.size();
+	for(int i = LimitStart; i < minimum(LimitStart + 3, NumRegional); i++)
+	{
+		const auto &[Time, Name] = Regional[Ascending ? i : NumRegional - 1 - i];
+		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Time: %s", Rank(Regional, Time), Name.c_str(), aTime);
+		Line++;
+	}
+	return true;
+}
+
+bool CScoreCache::ShowTeamTop5(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+	const int LimitStart = maximum(absolute(pData->m_Offset) - 1, 0);
+	const bool Ascending = pData->m_Offset >= 0;
+
+	int Line = 0;
+	str_copy(paMessages[Line], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+	Line++;
+
+	const int NumTeams = m_vTeams.size();
+	for(int i = LimitStart; i < minimum(LimitStart + 5, NumTeams); i++)
+	{
+		const int Index = Ascending ? i : NumTeams - 1 - i;
+		const CTeam &Team = m_vTeams[Index];
+		// teams with the same time share the rank of the first of them
+		int TeamRank = Index + 1;
+		while(TeamRank > 1 && m_vTeams[TeamRank - 2].m_Time == Team.m_Time)
+			TeamRank--;
+		char aTime[32];
+		str_time_float(Team.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		char aNames[2300];
+		FormatNames(Team.m_vNames, aNames, sizeof(aNames));
+		str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
+			TeamRank, aNames, aTime);
+		Line++;
+	}
+
+	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+	return true;
+}
+
+void CScoreCacheResult::AddPendingFinishes()
+{
+	for(const auto &Finish : m_vPendingFinishes)
+		m_Cache.AddFinish(Finish);
+	for(const auto &TeamFinish : m_vPendingTeamFinishes)
+		m_Cache.AddTeamFinish(TeamFinish);
+	m_vPendingFinishes.clear();
+	m_vPendingTeamFinishes.clear();
+}
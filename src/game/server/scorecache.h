@@ -0,0 +1,121 @@
+#ifndef GAME_SERVER_SCORECACHE_H
+#define GAME_SERVER_SCORECACHE_H
+
+#include "scoreworker.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The finish times and team ranks of one map, loaded from the database on
+// map change and updated with the finishes on this server afterwards. It
+// answers /rank, /top5 and /teamtop5 like the queries in CScoreWorker
+// without a database round trip. Finishes on other servers sharing the
+// database only show up after the next map change.
+class CScoreCache
+{
+public:
+	class CFinish
+	{
+	public:
+		std::string m_Name;
+		std::string m_Server;
+		float m_Time;
+	};
+
+	class CTeamFinish
+	{
+	public:
+		CUuid m_TeamID;
+		std::vector<std::string> m_vNames;
+		float m_Time;
+	};
+
+	// fills the cache of a CScoreCacheResult for the map of a
+	// CSqlScoreCacheRequest
+	static bool Load(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+
+	void AddFinish(const CFinish &Finish);
+	// improves the time of the team with the same players or adds a new team
+	void AddTeamFinish(const CTeamFinish &Finish);
+
+	// return false if the request has to be answered by the database
+	bool ShowRank(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+	bool ShowTop(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+	bool ShowTeamTop5(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+
+	int NumPlayers() const { return m_vRanking.size(); }
+	int NumTeams() const { return m_vTeams.size(); }
+
+private:
+	class CPlayer
+	{
+	public:
+		float m_BestTime;
+		// best time on every server the player finished on
+		std::vector<std::pair<std::string, float>> m_vServerTimes;
+	};
+
+	class CTeam
+	{
+	public:
+		CUuid m_ID;
+		// sorted
+		std::vector<std::string> m_vNames;
+		float m_Time;
+		// teams finished with the 0.7 client are never extended
+		bool m_DDNet7;
+
+		bool operator<(const CTeam &Other) const;
+	};
+
+	// best times sorted by time and name
+	typedef std::vector<std::pair<float, std::string>> CRanking;
+
+	// the best time of the player on servers matching `pServer`, returns
+	// false if there is none
+	static bool RegionalTime(const CPlayer &Player, const char *pServer, float *pTime);
+	// moves the player to `Time` if it is better than `OldTime`
+	static void UpdateRanking(CRanking *pRanking, const std::string &Name, bool Ranked, float OldTime, float Time);
+
+	void InsertFinish(const char *pName, const char *pServer, float Time);
+	void SortRanking();
+	// the best time of every player on servers matching `pServer`, built on
+	// the first request and kept up to date by AddFinish afterwards
+	const CRanking &RegionalRanking(const char *pServer) const;
+
+	std::unordered_map<std::string, CPlayer> m_Players;
+	// best time of every player
+	CRanking m_vRanking;
+	// keyed by the server of the requests, which is the same for all of
+	// them unless sv_sql_servername changes
+	mutable std::unordered_map<std::string, CRanking> m_RegionalRankings;
+	// sorted by time and ID
+	std::vector<CTeam> m_vTeams;
+};
+
+struct CScoreCacheResult : ISqlResult
+{
+	CScoreCache m_Cache;
+
+	// finishes written while the cache is loading, only used on the tick
+	// thread. They may be in the loaded cache already, adding them again
+	// doesn't change it.
+	std::vector<CScoreCache::CFinish> m_vPendingFinishes;
+	std::vector<CScoreCache::CTeamFinish> m_vPendingTeamFinishes;
+	// adds the pending finishes to the cache once it is loaded
+	void AddPendingFinishes();
+};
+
+struct CSqlScoreCacheRequest : ISqlData
+{
+	CSqlScoreCacheRequest(std::shared_ptr<CScoreCacheResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	char m_aMap[MAX_MAP_LENGTH];
+};
+
+#endif // GAME_SERVER_SCORECACHE_H
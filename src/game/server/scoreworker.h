@@ -174,8 +174,8 @@ struct CScoreSaveResult : ISqlResult
 
 struct CSqlTeamScoreData : ISqlData
 {
-	CSqlTeamScoreData() :
-		ISqlData(nullptr)
+	CSqlTeamScoreData(std::shared_ptr<ISqlResult> pResult) :
+		ISqlData(std::move(pResult))
 	{
 	}
 
@@ -0,0 +1,137 @@
+#include "snapgrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+int CSnapGrid::CellCoord(float Pos)
+{
+	// also keeps NaN and far away positions in range
+	if(!(Pos > -1e7f))
+		Pos = -1e7f;
+	else if(Pos > 1e7f)
+		Pos = 1e7f;
+	return (int)std::floor(Pos / CELL_SIZE);
+}
+
+int CSnapGrid::Bucket(int X, int Y)
+{
+	return ((unsigned)X * 73856093u ^ (unsigned)Y * 19349663u) % NUM_BUCKETS;
+}
+
+void CSnapGrid::Clear()
+{
+	m_vIndices.clear();
+	m_vLargeIndices.clear();
+	m_vBucketStarts.clear();
+	m_vBucketIndices.clear();
+}
+
+void CSnapGrid::Add(int Index, vec2 Min, vec2 Max)
+{
+	if(Index >= (int)m_vBoxes.size())
+	{
+		m_vBoxes.resize(Index + 1);
+		m_vQueryStamps.resize(Index + 1, 0);
+	}
+	m_vBoxes[Index].m_Min = Min;
+	m_vBoxes[Index].m_Max = Max;
+	m_vIndices.push_back(Index);
+}
+
+void CSnapGrid::Build()
+{
+	// counting sort of the boxes by bucket, a box is listed in every bucket
+	// of the cells it overlaps
+	m_vBucketStarts.assign(NUM_BUCKETS + 1, 0);
+	m_vLargeIndices.clear();
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		for(int Index : m_vIndices)
+		{
+			const CBox &Box = m_vBoxes[Index];
+			if(!(Box.m_Min.x <= Box.m_Max.x && Box.m_Min.y <= Box.m_Max.y))
+			{
+				// empty or NaN, let the exact check decide
+				if(Pass == 0)
+					m_vLargeIndices.push_back(Index);
+				continue;
+			}
+			int X0 = CellCoord(Box.m_Min.x), X1 = CellCoord(Box.m_Max.x);
+			int Y0 = CellCoord(Box.m_Min.y), Y1 = CellCoord(Box.m_Max.y);
+			if((int64_t)(X1 - X0 + 1) * (Y1 - Y0 + 1) > MAX_BOX_CELLS)
+			{
+				if(Pass == 0)
+					m_vLargeIndices.push_back(Index);
+				continue;
+			}
+			for(int y = Y0; y <= Y1; y++)
+			{
+				for(int x = X0; x <= X1; x++)
+				{
+					int Bucket = CSnapGrid::Bucket(x, y);
+					if(Pass == 0)
+						m_vBucketStarts[Bucket + 1]++;
+					else
+						m_vBucketIndices[m_vBucketStarts[Bucket]++] = Index;
+				}
+			}
+		}
+
+		if(Pass == 0)
+		{
+			for(int i = 0; i < NUM_BUCKETS; i++)
+				m_vBucketStarts[i + 1] += m_vBucketStarts[i];
+			m_vBucketIndices.resize(m_vBucketStarts[NUM_BUCKETS]);
+		}
+	}
+
+	// the fill pass moved every start to the start of the next bucket
+	for(int i = NUM_BUCKETS; i > 0; i--)
+		m_vBucketStarts[i] = m_vBucketStarts[i - 1];
+	m_vBucketStarts[0] = 0;
+}
+
+void CSnapGrid::Query(vec2 Min, vec2 Max, std::vector<int> *pvIndices)
+{
+	pvIndices->clear();
+
+	int X0 = CellCoord(Min.x), X1 = CellCoord(Max.x);
+	int Y0 = CellCoord(Min.y), Y1 = CellCoord(Max.y);
+	if(m_vBucketStarts.empty() || !(Min.x <= Max.x && Min.y <= Max.y) || (int64_t)(X1 - X0 + 1) * (Y1 - Y0 + 1) > MAX_VIEW_CELLS)
+	{
+		for(int Index : m_vIndices)
+			if(Overlaps(Index, Min, Max))
+				pvIndices->push_back(Index);
+	}
+	else
+	{
+		// boxes can be listed in several cells and cells can share buckets
+		if(++m_QueryStamp == 0)
+		{
+			std::fill(m_vQueryStamps.begin(), m_vQueryStamps.end(), 0);
+			m_QueryStamp = 1;
+		}
+		for(int y = Y0; y <= Y1; y++)
+		{
+			for(int x = X0; x <= X1; x++)
+			{
+				int Bucket = CSnapGrid::Bucket(x, y);
+				for(int i = m_vBucketStarts[Bucket]; i < m_vBucketStarts[Bucket + 1]; i++)
+				{
+					int Index = m_vBucketIndices[i];
+					if(m_vQueryStamps[Index] == m_QueryStamp)
+						continue;
+					m_vQueryStamps[Index] = m_QueryStamp;
+					if(Overlaps(Index, Min, Max))
+						pvIndices->push_back(Index);
+				}
+			}
+		}
+		for(int Index : m_vLargeIndices)
+			if(Overlaps(Index, Min, Max))
+				pvIndices->push_back(Index);
+	}
+
+	std::sort(pvIndices->begin(), pvIndices->end());
+}
@@ -0,0 +1,52 @@
+#ifndef GAME_SERVER_SNAPGRID_H
+#define GAME_SERVER_SNAPGRID_H
+
+#include <base/vmath.h>
+
+#include <vector>
+
+// Buckets the boxes in which snap items can be seen into a uniform grid,
+// built once per snapshot tick, so that finding the items in the view of a
+// client only visits the cells that the view overlaps.
+class CSnapGrid
+{
+	enum
+	{
+		CELL_SIZE = 512,
+		NUM_BUCKETS = 1024,
+		// boxes spanning more cells are checked by every query
+		MAX_BOX_CELLS = 16,
+		// views spanning more cells check every box
+		MAX_VIEW_CELLS = 256,
+	};
+
+	struct CBox
+	{
+		vec2 m_Min;
+		vec2 m_Max;
+	};
+
+	std::vector<CBox> m_vBoxes;
+	std::vector<int> m_vIndices;
+	std::vector<int> m_vLargeIndices;
+	std::vector<int> m_vBucketStarts;
+	std::vector<int> m_vBucketIndices;
+	std::vector<unsigned> m_vQueryStamps;
+	unsigned m_QueryStamp = 0;
+
+	static int CellCoord(float Pos);
+	static int Bucket(int X, int Y);
+	bool Overlaps(int Index, vec2 Min, vec2 Max) const { return !(m_vBoxes[Index].m_Max.x < Min.x || m_vBoxes[Index].m_Min.x > Max.x || m_vBoxes[Index].m_Max.y < Min.y || m_vBoxes[Index].m_Min.y > Max.y); }
+
+public:
+	void Clear();
+	// the indices have to be small, they are used to index arrays
+	void Add(int Index, vec2 Min, vec2 Max);
+	void Build();
+
+	// replaces the content of pvIndices with the sorted indices of the boxes
+	// overlapping the given one, edges included
+	void Query(vec2 Min, vec2 Max, std::vector<int> *pvIndices);
+};
+
+#endif
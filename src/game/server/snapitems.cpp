@@ -0,0 +1,81 @@
+#include "snapitems.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <cmath>
+
+void CSnapItems::Clear()
+{
+	m_vItems.clear();
+	m_vData.clear();
+	m_GridValid = false;
+}
+
+void *CSnapItems::Add(const CFilter &Filter, int Type, int ID, int Size)
+{
+	CItem Item{Type, ID, Size, (int)m_vData.size(), Filter};
+	m_vItems.push_back(Item);
+	m_vData.resize(m_vData.size() + (Size + sizeof(int) - 1) / sizeof(int));
+	m_GridValid = false;
+	return &m_vData[Item.m_Offset];
+}
+
+void CSnapItems::BuildGrid()
+{
+	m_Grid.Clear();
+	for(int i = 0; i < Num(); i++)
+	{
+		const CFilter &Filter = m_vItems[i].m_Filter;
+		if(std::isnan(Filter.m_Pos.x) || std::isnan(Filter.m_Pos.y) || std::isnan(Filter.m_Pos2.x) || std::isnan(Filter.m_Pos2.y))
+		{
+			// NaN positions are never clipped, the grid checks them for every view
+			m_Grid.Add(i, vec2(NAN, NAN), vec2(NAN, NAN));
+			continue;
+		}
+		m_Grid.Add(i,
+			vec2(minimum(Filter.m_Pos.x, Filter.m_Pos2.x), minimum(Filter.m_Pos.y, Filter.m_Pos2.y)),
+			vec2(maximum(Filter.m_Pos.x, Filter.m_Pos2.x), maximum(Filter.m_Pos.y, Filter.m_Pos2.y)));
+	}
+	m_Grid.Build();
+	m_GridValid = true;
+}
+
+static bool Clipped(const CSnapItems::CView &View, vec2 Pos)
+{
+	return absolute(View.m_Pos.x - Pos.x) > View.m_ShowDistance.x || absolute(View.m_Pos.y - Pos.y) > View.m_ShowDistance.y;
+}
+
+bool CSnapItems::Passes(const CFilter &Filter, const CView &View)
+{
+	if(View.m_Version < Filter.m_MinVersion || View.m_Version >= Filter.m_MaxVersion)
+		return false;
+	if(Filter.m_Sixup != -1 && Filter.m_Sixup != (int)View.m_Sixup)
+		return false;
+	if(View.m_ClientID < 0)
+		return true;
+	if(!((Filter.m_Mask >> View.m_ClientID) & 1))
+		return false;
+	return View.m_ShowAll || !Clipped(View, Filter.m_Pos) || !Clipped(View, Filter.m_Pos2);
+}
+
+void CSnapItems::Visible(const CView &View, std::vector<int> *pvIndices)
+{
+	if(!m_GridValid || View.m_ClientID < 0 || View.m_ShowAll)
+	{
+		pvIndices->clear();
+		for(int i = 0; i < Num(); i++)
+			if(Passes(m_vItems[i].m_Filter, View))
+				pvIndices->push_back(i);
+		return;
+	}
+
+	// one extra unit covers rounding, Passes decides
+	const vec2 Distance = View.m_ShowDistance + vec2(1.0f, 1.0f);
+	m_Grid.Query(View.m_Pos - Distance, View.m_Pos + Distance, pvIndices);
+	int NumVisible = 0;
+	for(int Index : *pvIndices)
+		if(Passes(m_vItems[Index].m_Filter, View))
+			(*pvIndices)[NumVisible++] = Index;
+	pvIndices->resize(NumVisible);
+}
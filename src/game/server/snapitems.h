@@ -0,0 +1,84 @@
+#ifndef GAME_SERVER_SNAPITEMS_H
+#define GAME_SERVER_SNAPITEMS_H
+
+#include <base/vmath.h>
+
+#include "snapgrid.h"
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+// The snapshot items that are the same for every client that gets them.
+// They are built once per snapshot tick, the snapshot of a client then only
+// copies the items that pass the client's filter.
+class CSnapItems
+{
+public:
+	// which clients get an item, like the checks in the Snap functions
+	struct CFilter
+	{
+		// the item is clipped if neither position is in the view
+		vec2 m_Pos;
+		vec2 m_Pos2;
+		// only the clients in the mask get it, the demo recorder always does
+		int64_t m_Mask = -1;
+		// only clients with a version in [m_MinVersion, m_MaxVersion) get it
+		int m_MinVersion = 0;
+		int m_MaxVersion = INT_MAX;
+		// -1 for all clients, 0 for 0.6 clients and 1 for 0.7 clients
+		int m_Sixup = -1;
+
+		CFilter(vec2 Pos) :
+			m_Pos(Pos), m_Pos2(Pos) {}
+		CFilter(vec2 Pos, vec2 Pos2) :
+			m_Pos(Pos), m_Pos2(Pos2) {}
+	};
+
+	// the snapping client
+	struct CView
+	{
+		// -1 for the demo recorder
+		int m_ClientID;
+		int m_Version;
+		bool m_Sixup;
+		bool m_ShowAll;
+		vec2 m_Pos;
+		vec2 m_ShowDistance;
+	};
+
+	struct CItem
+	{
+		int m_Type;
+		int m_ID;
+		int m_Size;
+		int m_Offset;
+		CFilter m_Filter;
+	};
+
+private:
+	std::vector<CItem> m_vItems;
+	std::vector<int> m_vData;
+
+	CSnapGrid m_Grid;
+	bool m_GridValid = false;
+
+public:
+	void Clear();
+	// the returned data has to be filled before the next item is added
+	void *Add(const CFilter &Filter, int Type, int ID, int Size);
+	// lets Visible look the items up in a grid
+	void BuildGrid();
+
+	int Num() const { return m_vItems.size(); }
+	const CItem &Item(int Index) const { return m_vItems[Index]; }
+	const void *Data(int Index) const { return &m_vData[m_vItems[Index].m_Offset]; }
+
+	// the same checks as the Snap functions, NetworkClipped for the positions
+	static bool Passes(const CFilter &Filter, const CView &View);
+	// replaces the content of pvIndices with the items the client gets, in
+	// the order they were added
+	void Visible(const CView &View, std::vector<int> *pvIndices);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "teammasks.h"
+
+#include <base/system.h>
+#include <game/gamecore.h>
+
+void CTeamMasks::Reset()
+{
+	for(auto &Client : m_aClients)
+	{
+		Client.m_Active = false;
+		Client.m_Spectating = false;
+		Client.m_SpectatorID = SPEC_FREEVIEW;
+		Client.m_SpecTeam = false;
+		Client.m_ShowOthers = SHOW_OTHERS_ON;
+		Client.m_HasCharacter = false;
+	}
+	m_ShownMask = 0;
+	m_ShownNoSoloMask = 0;
+	mem_zero(m_aTeamShownMask, sizeof(m_aTeamShownMask));
+	mem_zero(m_aTeamShownNoSoloMask, sizeof(m_aTeamShownNoSoloMask));
+	mem_zero(m_aAskerShownMask, sizeof(m_aAskerShownMask));
+}
+
+void CTeamMasks::Update(const CTeamsCore *pTeams)
+{
+	m_ShownMask = 0;
+	m_ShownNoSoloMask = 0;
+	mem_zero(m_aTeamShownMask, sizeof(m_aTeamShownMask));
+	mem_zero(m_aTeamShownNoSoloMask, sizeof(m_aTeamShownNoSoloMask));
+	mem_zero(m_aAskerShownMask, sizeof(m_aAskerShownMask));
+
+	for(int i = 0; i < MAX_CLIENTS; ++i)
+	{
+		const CClient &Client = m_aClients[i];
+		if(!Client.m_Active)
+			continue; // Player doesn't exist
+
+		uint64_t Bit = 1ULL << i;
+		int Viewed = i; // whose team decides what the player sees
+		int ShowOthers;
+		if(!Client.m_Spectating)
+		{ // Not spectator
+			m_aAskerShownMask[i] |= Bit; // See everything of yourself
+			if(!Client.m_HasCharacter)
+				continue; // Player is currently dead
+			ShowOthers = Client.m_ShowOthers;
+		}
+		else if(Client.m_SpectatorID != SPEC_FREEVIEW)
+		{ // Spectating specific player
+			Viewed = Client.m_SpectatorID;
+			if(Viewed < 0 || Viewed >= MAX_CLIENTS)
+				continue;
+			m_aAskerShownMask[Viewed] |= Bit; // See everything of player you're spectating
+			if(!m_aClients[Viewed].m_HasCharacter)
+				continue; // Player is currently dead
+			ShowOthers = Client.m_ShowOthers;
+		}
+		else
+		{ // Freeview, show only players in own team when spectating
+			ShowOthers = Client.m_SpecTeam ? SHOW_OTHERS_ONLY_TEAM : SHOW_OTHERS_ON;
+		}
+
+		int ViewedTeam = pTeams->Team(Viewed);
+		if(ShowOthers == SHOW_OTHERS_ONLY_TEAM)
+		{
+			if(ViewedTeam == TEAM_SUPER)
+				m_ShownMask |= Bit;
+			else if(ViewedTeam >= 0 && ViewedTeam < NUM_TEAMS)
+				m_aTeamShownMask[ViewedTeam] |= Bit;
+		}
+		else if(ShowOthers == SHOW_OTHERS_OFF)
+		{
+			if(pTeams->GetSolo(Viewed))
+				continue; // When in solo part don't show others
+			if(ViewedTeam == TEAM_SUPER)
+				m_ShownNoSoloMask |= Bit;
+			else if(ViewedTeam >= 0 && ViewedTeam < NUM_TEAMS)
+				m_aTeamShownNoSoloMask[ViewedTeam] |= Bit;
+		}
+		else
+		{
+			m_ShownMask |= Bit;
+		}
+	}
+}
+
+uint64_t CTeamMasks::Mask(int Team, int ExceptID, int Asker, const CTeamsCore *pTeams) const
+{
+	uint64_t Mask;
+	if(Team == TEAM_SUPER)
+	{
+		Mask = 0xffffffffffffffff;
+	}
+	else
+	{
+		// When the asker is in solo part, players not showing others don't see it
+		bool AskerSolo = pTeams->GetSolo(Asker);
+		Mask = m_ShownMask;
+		if(!AskerSolo)
+			Mask |= m_ShownNoSoloMask;
+		if(Team >= 0 && Team < NUM_TEAMS)
+		{
+			Mask |= m_aTeamShownMask[Team];
+			if(!AskerSolo)
+				Mask |= m_aTeamShownNoSoloMask[Team];
+		}
+		if(Asker >= 0 && Asker < MAX_CLIENTS)
+			Mask |= m_aAskerShownMask[Asker];
+	}
+
+	if(ExceptID >= 0 && ExceptID < MAX_CLIENTS)
+		Mask &= ~(1ULL << ExceptID); // Explicitly excluded
+	return Mask;
+}
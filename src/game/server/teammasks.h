@@ -0,0 +1,48 @@
+#ifndef GAME_SERVER_TEAMMASKS_H
+#define GAME_SERVER_TEAMMASKS_H
+
+#include <engine/shared/protocol.h>
+#include <game/teamscore.h>
+
+#include <cstdint>
+
+// Folds the spectator, solo and show_others rules deciding which players
+// see the events of a team into bitsets: the players that see everything
+// of a team, the ones that only do so if the asker isn't in a solo part and
+// the ones that see everything of a specific asker (the asker itself and its
+// spectators). The state of all clients is collected when the players
+// change, a lookup is a few ORs.
+class CTeamMasks
+{
+public:
+	struct CClient
+	{
+		bool m_Active; // the player exists
+		bool m_Spectating; // in the spectator team or paused
+		int m_SpectatorID;
+		bool m_SpecTeam;
+		int m_ShowOthers;
+		bool m_HasCharacter;
+	};
+
+	CClient m_aClients[MAX_CLIENTS];
+
+	CTeamMasks() { Reset(); }
+	void Reset();
+
+	// rebuilds the masks from m_aClients and the teams
+	void Update(const CTeamsCore *pTeams);
+
+	// the players that see the events of Team caused by Asker, the solo
+	// state of the asker is taken from the teams at the time of the call
+	uint64_t Mask(int Team, int ExceptID, int Asker, const CTeamsCore *pTeams) const;
+
+private:
+	uint64_t m_ShownMask;
+	uint64_t m_ShownNoSoloMask;
+	uint64_t m_aTeamShownMask[NUM_TEAMS];
+	uint64_t m_aTeamShownNoSoloMask[NUM_TEAMS];
+	uint64_t m_aAskerShownMask[MAX_CLIENTS];
+};
+
+#endif
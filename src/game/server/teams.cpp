@@ -19,6 +19,8 @@ CGameTeams::CGameTeams(CGameContext *pGameContext) :
 void CGameTeams::Reset()
 {
 	m_Core.Reset();
+	m_TeamMasksValid = false;
+	m_TeamMasksTick = -1;
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		m_aTeeStarted[i] = false;
@@ -400,6 +402,7 @@ void CGameTeams::SetForceCharacterTeam(int ClientID, int Team)
 	}
 
 	m_Core.Team(ClientID, Team);
+	InvalidateTeamMasks();
 
 	if(OldTeam != Team)
 	{
@@ -473,79 +476,31 @@ bool CGameTeams::TeamFinished(int Team)
 	return true;
 }
 
-int64_t CGameTeams::TeamMask(int Team, int ExceptID, int Asker)
+void CGameTeams::UpdateTeamMasks()
 {
-	if(Team == TEAM_SUPER)
-	{
-		if(ExceptID == -1)
-			return 0xffffffffffffffff;
-		return 0xffffffffffffffff & ~(1 << ExceptID);
-	}
-
-	int64_t Mask = 0;
+	m_TeamMasksValid = true;
+	m_TeamMasksTick = Server()->Tick();
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
-		if(i == ExceptID)
-			continue; // Explicitly excluded
-		if(!GetPlayer(i))
-			continue; // Player doesn't exist
-
-		if(!(GetPlayer(i)->GetTeam() == TEAM_SPECTATORS || GetPlayer(i)->IsPaused()))
-		{ // Not spectator
-			if(i != Asker)
-			{ // Actions of other players
-				if(!Character(i))
-					continue; // Player is currently dead
-				if(GetPlayer(i)->m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
-				{
-					if(m_Core.Team(i) != Team && m_Core.Team(i) != TEAM_SUPER)
-						continue; // In different teams
-				}
-				else if(GetPlayer(i)->m_ShowOthers == SHOW_OTHERS_OFF)
-				{
-					if(m_Core.GetSolo(Asker))
-						continue; // When in solo part don't show others
-					if(m_Core.GetSolo(i))
-						continue; // When in solo part don't show others
-					if(m_Core.Team(i) != Team && m_Core.Team(i) != TEAM_SUPER)
-						continue; // In different teams
-				}
-			} // See everything of yourself
-		}
-		else if(GetPlayer(i)->m_SpectatorID != SPEC_FREEVIEW)
-		{ // Spectating specific player
-			if(GetPlayer(i)->m_SpectatorID != Asker)
-			{ // Actions of other players
-				if(!Character(GetPlayer(i)->m_SpectatorID))
-					continue; // Player is currently dead
-				if(GetPlayer(i)->m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
-				{
-					if(m_Core.Team(GetPlayer(i)->m_SpectatorID) != Team && m_Core.Team(GetPlayer(i)->m_SpectatorID) != TEAM_SUPER)
-						continue; // In different teams
-				}
-				else if(GetPlayer(i)->m_ShowOthers == SHOW_OTHERS_OFF)
-				{
-					if(m_Core.GetSolo(Asker))
-						continue; // When in solo part don't show others
-					if(m_Core.GetSolo(GetPlayer(i)->m_SpectatorID))
-						continue; // When in solo part don't show others
-					if(m_Core.Team(GetPlayer(i)->m_SpectatorID) != Team && m_Core.Team(GetPlayer(i)->m_SpectatorID) != TEAM_SUPER)
-						continue; // In different teams
-				}
-			} // See everything of player you're spectating
-		}
-		else
-		{ // Freeview
-			if(GetPlayer(i)->m_SpecTeam)
-			{ // Show only players in own team when spectating
-				if(m_Core.Team(i) != Team && m_Core.Team(i) != TEAM_SUPER)
-					continue; // in different teams
-			}
-		}
-
-		Mask |= 1LL << i;
+		CTeamMasks::CClient &Client = m_TeamMasks.m_aClients[i];
+		CPlayer *pPlayer = GetPlayer(i);
+		Client.m_Active = pPlayer != nullptr;
+		if(!pPlayer)
+			continue;
+		Client.m_Spectating = pPlayer->GetTeam() == TEAM_SPECTATORS || pPlayer->IsPaused();
+		Client.m_SpectatorID = pPlayer->m_SpectatorID;
+		Client.m_SpecTeam = pPlayer->m_SpecTeam;
+		Client.m_ShowOthers = pPlayer->m_ShowOthers;
+		Client.m_HasCharacter = Character(i) != nullptr;
 	}
-	return Mask;
+	m_TeamMasks.Update(&m_Core);
+}
+
+int64_t CGameTeams::TeamMask(int Team, int ExceptID, int Asker)
+{
+	if(Team != TEAM_SUPER && (!m_TeamMasksValid || m_TeamMasksTick != Server()->Tick()))
+		UpdateTeamMasks();
+	return m_TeamMasks.Mask(Team, ExceptID, Asker, &m_Core);
 }
 
 void CGameTeams::SendTeamsState(int ClientID)
@@ -1013,6 +968,7 @@ void CGameTeams::ProcessSaveTeam()
 void CGameTeams::OnCharacterSpawn(int ClientID)
 {
 	m_Core.SetSolo(ClientID, false);
+	InvalidateTeamMasks();
 	int Team = m_Core.Team(ClientID);
 
 	if(GetSaving(Team))
@@ -1031,6 +987,7 @@ void CGameTeams::OnCharacterSpawn(int ClientID)
 void CGameTeams::OnCharacterDeath(int ClientID, int Weapon)
 {
 	m_Core.SetSolo(ClientID, false);
+	InvalidateTeamMasks();
 
 	int Team = m_Core.Team(ClientID);
 	if(GetSaving(Team))
@@ -4,6 +4,7 @@
 
 #include <engine/shared/config.h>
 #include <game/server/gamecontext.h>
+#include <game/server/teammasks.h>
 #include <game/teamscore.h>
 
 class CCharacter;
@@ -36,6 +37,13 @@ class CGameTeams
 	// the message from playing for a long time in an unfinishable team.
 	int m_aTeamUnfinishableKillTick[NUM_TEAMS];
 
+	// The masks of `TeamMask` are rebuilt at most once per tick and
+	// whenever a player changes team, spectator mode, pause state or
+	// show_others setting.
+	bool m_TeamMasksValid;
+	int m_TeamMasksTick;
+	CTeamMasks m_TeamMasks;
+
 	class CGameContext *m_pGameContext;
 
 	/**
@@ -46,6 +54,7 @@ class CGameTeams
 	*/
 	void KillTeam(int Team, int NewStrongID, int ExceptID = -1);
 	bool TeamFinished(int Team);
+	void UpdateTeamMasks();
 	void OnTeamFinish(CPlayer **Players, unsigned int Size, float Time, const char *pTimestamp);
 	void OnFinish(CPlayer *Player, float Time, const char *pTimestamp);
 
@@ -97,6 +106,7 @@ public:
 	void ChangeTeamState(int Team, int State);
 
 	int64_t TeamMask(int Team, int ExceptID = -1, int Asker = -1);
+	void InvalidateTeamMasks() { m_TeamMasksValid = false; }
 
 	int Count(int Team) const;
 
@@ -3,33 +3,21 @@
 #include <engine/shared/config.h>
 #include <engine/shared/json.h>
 #include <engine/shared/snapshot.h>
+#include <engine/shared/teehistorian_ex.h>
 #include <game/gamecore.h>
 
 static const char TEEHISTORIAN_NAME[] = "teehistorian@ddnet.tw";
 static const CUuid TEEHISTORIAN_UUID = CalculateUuid(TEEHISTORIAN_NAME);
 static const char TEEHISTORIAN_VERSION[] = "2";
+// version 2 split into zlib compressed blocks after the header, see
+// `CTeeHistorianWriter`
+static const char TEEHISTORIAN_VERSION_COMPRESSED[] = "3";
 static const char TEEHISTORIAN_VERSION_MINOR[] = "4";
 
 #define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
 #include <engine/shared/teehistorian_ex_chunks.h>
 #undef UUID
 
-enum
-{
-	TEEHISTORIAN_NONE,
-	TEEHISTORIAN_FINISH,
-	TEEHISTORIAN_TICK_SKIP,
-	TEEHISTORIAN_PLAYER_NEW,
-	TEEHISTORIAN_PLAYER_OLD,
-	TEEHISTORIAN_INPUT_DIFF,
-	TEEHISTORIAN_INPUT_NEW,
-	TEEHISTORIAN_MESSAGE,
-	TEEHISTORIAN_JOIN,
-	TEEHISTORIAN_DROP,
-	TEEHISTORIAN_CONSOLE_COMMAND,
-	TEEHISTORIAN_EX,
-};
-
 CTeeHistorian::CTeeHistorian()
 {
 	m_State = STATE_START;
@@ -99,6 +87,7 @@ void CTeeHistorian::WriteHeader(const CGameInfo *pGameInfo)
 		"\"comment\":\"%s\","
 		"\"version\":\"%s\","
 		"\"version_minor\":\"%s\","
+		"%s"
 		"\"game_uuid\":\"%s\","
 		"\"server_version\":\"%s\","
 		"\"start_time\":\"%s\","
@@ -112,8 +101,9 @@ void CTeeHistorian::WriteHeader(const CGameInfo *pGameInfo)
 		"\"prng_description\":\"%s\","
 		"\"config\":{",
 		E(aCommentBuffer, TEEHISTORIAN_NAME),
-		TEEHISTORIAN_VERSION,
+		pGameInfo->m_Compressed ? TEEHISTORIAN_VERSION_COMPRESSED : TEEHISTORIAN_VERSION,
 		TEEHISTORIAN_VERSION_MINOR,
+		pGameInfo->m_Compressed ? "\"compression\":\"zlib\"," : "",
 		aGameUuid,
 		E(aServerVersionBuffer, pGameInfo->m_pServerVersion),
 		E(aStartTimeBuffer, aStartTime),
@@ -199,7 +189,11 @@ void CTeeHistorian::WriteHeader(const CGameInfo *pGameInfo)
 void CTeeHistorian::WriteExtra(CUuid Uuid, const void *pData, int DataSize)
 {
 	EnsureTickWritten();
+	WriteExtraWithoutTick(Uuid, pData, DataSize);
+}
 
+void CTeeHistorian::WriteExtraWithoutTick(CUuid Uuid, const void *pData, int DataSize)
+{
 	CPacker Ex;
 	Ex.Reset();
 	Ex.AddInt(-TEEHISTORIAN_EX);
@@ -673,6 +667,76 @@ void CTeeHistorian::EndTick()
 	m_State = STATE_BEFORE_TICK;
 }
 
+int CTeeHistorian::RecordKeyframe()
+{
+	dbg_assert(m_State == STATE_START || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
+
+	int NumPlayers = 0;
+	for(const auto &Player : m_aPrevPlayers)
+	{
+		if(Player.m_Alive || Player.m_UniqueClientID || Player.m_Team)
+			NumPlayers++;
+	}
+	int NumPracticeTeams = 0;
+	for(const auto &Team : m_aPrevTeams)
+	{
+		if(Team.m_Practice)
+			NumPracticeTeams++;
+	}
+
+	CPacker Buffer;
+	Buffer.Reset();
+	// if the current tick isn't written, the next one is written explicitly,
+	// so the client id doesn't matter then
+	Buffer.AddInt(m_LastWrittenTick);
+	Buffer.AddInt(m_MaxClientID);
+	Buffer.AddInt(NumPlayers);
+	m_vKeyframe.assign(Buffer.Data(), Buffer.Data() + Buffer.Size());
+
+	for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+	{
+		const CTeehistorianPlayer &Player = m_aPrevPlayers[ClientID];
+		if(!Player.m_Alive && !Player.m_UniqueClientID && !Player.m_Team)
+			continue;
+
+		Buffer.Reset();
+		Buffer.AddInt(ClientID);
+		Buffer.AddInt((Player.m_Alive ? 1 : 0) | (Player.m_UniqueClientID ? 2 : 0));
+		if(Player.m_Alive)
+		{
+			Buffer.AddInt(Player.m_X);
+			Buffer.AddInt(Player.m_Y);
+		}
+		if(Player.m_UniqueClientID)
+		{
+			for(int i = 0; i < (int)(sizeof(Player.m_Input) / sizeof(int)); i++)
+			{
+				Buffer.AddInt(((const int *)&Player.m_Input)[i]);
+			}
+		}
+		Buffer.AddInt(Player.m_Team);
+		m_vKeyframe.insert(m_vKeyframe.end(), Buffer.Data(), Buffer.Data() + Buffer.Size());
+	}
+
+	Buffer.Reset();
+	Buffer.AddInt(NumPracticeTeams);
+	for(int Team = 0; Team < MAX_CLIENTS; Team++)
+	{
+		if(m_aPrevTeams[Team].m_Practice)
+			Buffer.AddInt(Team);
+	}
+	m_vKeyframe.insert(m_vKeyframe.end(), Buffer.Data(), Buffer.Data() + Buffer.Size());
+
+	if(m_Debug)
+	{
+		dbg_msg("teehistorian", "keyframe tick=%d players=%d practice_teams=%d", m_LastWrittenTick, NumPlayers, NumPracticeTeams);
+	}
+
+	// the keyframe is the first record when decoding starts here
+	WriteExtraWithoutTick(UUID_TEEHISTORIAN_KEYFRAME, m_vKeyframe.data(), m_vKeyframe.size());
+	return m_LastWrittenTick;
+}
+
 void CTeeHistorian::RecordDDNetVersionOld(int ClientID, int DDNetVersion)
 {
 	CPacker Buffer;
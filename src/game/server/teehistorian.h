@@ -7,6 +7,7 @@
 #include <game/generated/protocol.h>
 
 #include <time.h>
+#include <vector>
 
 class CConfig;
 class CTuningParams;
@@ -36,6 +37,9 @@ public:
 		CConfig *m_pConfig;
 		CTuningParams *m_pTuning;
 		CUuidManager *m_pUuids;
+
+		// whether the file is split into compressed blocks after the header
+		bool m_Compressed = false;
 	};
 
 	enum
@@ -77,6 +81,10 @@ public:
 
 	void EndTick();
 
+	// writes everything needed to continue decoding from this point, only
+	// between ticks, returns the last tick with records before it
+	int RecordKeyframe();
+
 	void RecordDDNetVersionOld(int ClientID, int DDNetVersion);
 	void RecordDDNetVersion(int ClientID, CUuid ConnectionID, int DDNetVersion, const char *pDDNetVersionStr);
 
@@ -89,6 +97,7 @@ public:
 private:
 	void WriteHeader(const CGameInfo *pGameInfo);
 	void WriteExtra(CUuid Uuid, const void *pData, int DataSize);
+	void WriteExtraWithoutTick(CUuid Uuid, const void *pData, int DataSize);
 	void EnsureTickWrittenPlayerData(int ClientID);
 	void EnsureTickWritten();
 	void WriteTick();
@@ -136,6 +145,8 @@ private:
 	int m_MaxClientID;
 	CTeehistorianPlayer m_aPrevPlayers[MAX_CLIENTS];
 	CTeam m_aPrevTeams[MAX_CLIENTS];
+
+	std::vector<unsigned char> m_vKeyframe;
 };
 
 #endif // GAME_SERVER_TEEHISTORIAN_H
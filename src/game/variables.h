@@ -194,6 +194,8 @@ MACRO_CONFIG_INT(SvDestroyBulletsOnDeath, sv_destroy_bullets_on_death, 1, 0, 1,
 MACRO_CONFIG_INT(SvDestroyLasersOnDeath, sv_destroy_lasers_on_death, 0, 0, 1, CFGFLAG_SERVER | CFGFLAG_GAME, "Destroy lasers when their owner dies")
 
 MACRO_CONFIG_INT(SvMapUpdateRate, sv_mapupdaterate, 5, 1, 100, CFGFLAG_SERVER, "64 player id <-> vanilla id players map update rate")
+MACRO_CONFIG_INT(SvMapUpdateHysteresis, sv_mapupdatehysteresis, 256, 0, 10000, CFGFLAG_SERVER, "Distance by which a player has to be closer to replace another one in the 64 player id <-> vanilla id players map")
+MACRO_CONFIG_INT(SvSnapShared, sv_snap_shared, 2, 0, 2, CFGFLAG_SERVER, "Build the snapshot items that are the same for every client once per tick and only snap the visible entities per client (0 = off, 1 = check all of them, 2 = look them up in a grid)")
 
 MACRO_CONFIG_STR(SvServerType, sv_server_type, 64, "none", CFGFLAG_SERVER, "Type of the server (novice, moderate, ...)")
 
@@ -0,0 +1,318 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+// count the heap allocations of the whole test runner to be able to check
+// that the hot paths below don't allocate
+static std::atomic<int64_t> gs_NumAllocations(0);
+
+void *operator new(std::size_t Size)
+{
+	gs_NumAllocations++;
+	void *pMemory = malloc(Size ? Size : 1);
+	dbg_assert(pMemory != nullptr, "out of memory");
+	return pMemory;
+}
+
+void operator delete(void *pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void *pMemory, std::size_t Size) noexcept
+{
+	free(pMemory);
+}
+
+class CCollisionMap
+{
+public:
+	std::unique_ptr<IKernel> m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	bool Load(const char *pFilename)
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		IEngineMap *pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+		m_pKernel->RegisterInterface(pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+		if(!pMap->Load(pFilename))
+			return false;
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+		return true;
+	}
+};
+
+static std::vector<std::string> ListMaps()
+{
+	std::vector<std::string> vMaps;
+	fs_listdir(
+		"data/maps", [](const char *pName, int IsDir, int DirType, void *pUser) {
+			if(!IsDir && str_endswith(pName, ".map"))
+				static_cast<std::vector<std::string> *>(pUser)->push_back(std::string("data/maps/") + pName);
+			return 0;
+		},
+		0, &vMaps);
+	return vMaps;
+}
+
+static void RandomSegment(CTestPrng *pPrng, const CCollision *pCollision, vec2 *pPos0, vec2 *pPos1)
+{
+	// include points outside of the map, where the border tiles repeat
+	const float Width = pCollision->GetWidth() * 32.0f;
+	const float Height = pCollision->GetHeight() * 32.0f;
+	*pPos0 = vec2(pPrng->RandomFloat(-200.0f, Width + 200.0f), pPrng->RandomFloat(-200.0f, Height + 200.0f));
+
+	// hit the rounding edges of the tiles every now and then
+	if(pPrng->RandomBits() % 4 == 0)
+		*pPos0 = vec2(std::round(pPos0->x / 32.0f) * 32.0f - 0.5f, std::round(pPos0->y / 32.0f) * 32.0f + 0.5f);
+
+	const float aLengths[] = {0.0f, 1.0f, 50.0f, 800.0f, 3000.0f};
+	const float Length = pPrng->RandomFloat(0.0f, aLengths[pPrng->RandomBits() % 5]);
+	switch(pPrng->RandomBits() % 6)
+	{
+	case 0: *pPos1 = *pPos0 + vec2(Length, 0.0f); break;
+	case 1: *pPos1 = *pPos0 - vec2(0.0f, Length); break;
+	case 2: *pPos1 = *pPos0 + vec2(-Length, Length); break;
+	default: *pPos1 = *pPos0 + direction(pPrng->RandomFloat(-pi, pi)) * Length; break;
+	}
+}
+
+struct SIntersection
+{
+	int m_Result;
+	vec2 m_Collision;
+	vec2 m_BeforeCollision;
+	int m_TeleNr;
+
+	bool operator==(const SIntersection &Other) const
+	{
+		return m_Result == Other.m_Result && m_TeleNr == Other.m_TeleNr && mem_comp(&m_Collision, &Other.m_Collision, sizeof(m_Collision)) == 0 && mem_comp(&m_BeforeCollision, &Other.m_BeforeCollision, sizeof(m_BeforeCollision)) == 0;
+	}
+};
+
+enum
+{
+	INTERSECT_LINE = 0,
+	INTERSECT_TELE_HOOK,
+	INTERSECT_TELE_WEAPON,
+	INTERSECT_NO_LASER,
+	INTERSECT_NO_LASER_NW,
+	INTERSECT_AIR,
+	NUM_INTERSECTS
+};
+
+static SIntersection Intersect(const CCollision *pCollision, int Type, vec2 Pos0, vec2 Pos1)
+{
+	SIntersection Result = {};
+	switch(Type)
+	{
+	case INTERSECT_LINE: Result.m_Result = pCollision->IntersectLine(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	case INTERSECT_TELE_HOOK: Result.m_Result = pCollision->IntersectLineTeleHook(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision, &Result.m_TeleNr); break;
+	case INTERSECT_TELE_WEAPON: Result.m_Result = pCollision->IntersectLineTeleWeapon(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision, &Result.m_TeleNr); break;
+	case INTERSECT_NO_LASER: Result.m_Result = pCollision->IntersectNoLaser(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	case INTERSECT_NO_LASER_NW: Result.m_Result = pCollision->IntersectNoLaserNW(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	case INTERSECT_AIR: Result.m_Result = pCollision->IntersectAir(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	}
+	return Result;
+}
+
+TEST(Collision, IntersectTraversalMatchesPixels)
+{
+	const int OldPixelIntersect = g_Config.m_DbgPixelIntersect;
+	const int OldTeleportHook = g_Config.m_SvOldTeleportHook;
+	const int OldTeleportWeapons = g_Config.m_SvOldTeleportWeapons;
+
+	std::vector<std::string> vMaps = ListMaps();
+	ASSERT_FALSE(vMaps.empty());
+	CTestPrng Prng(1);
+	int NumHits = 0;
+	for(const auto &Map : vMaps)
+	{
+		CCollisionMap CollisionMap;
+		ASSERT_TRUE(CollisionMap.Load(Map.c_str())) << Map;
+		const CCollision *pCollision = &CollisionMap.m_Collision;
+
+		for(int i = 0; i < 200; i++)
+		{
+			vec2 Pos0, Pos1;
+			RandomSegment(&Prng, pCollision, &Pos0, &Pos1);
+			g_Config.m_SvOldTeleportHook = i % 2;
+			g_Config.m_SvOldTeleportWeapons = i % 2;
+			for(int Type = 0; Type < NUM_INTERSECTS; Type++)
+			{
+				g_Config.m_DbgPixelIntersect = 1;
+				SIntersection Pixels = Intersect(pCollision, Type, Pos0, Pos1);
+				g_Config.m_DbgPixelIntersect = 0;
+				SIntersection Traversal = Intersect(pCollision, Type, Pos0, Pos1);
+				ASSERT_TRUE(Pixels == Traversal) << Map << " type=" << Type << " from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+				if(Pixels.m_Result)
+					NumHits++;
+			}
+		}
+	}
+	EXPECT_GT(NumHits, 0);
+
+	g_Config.m_DbgPixelIntersect = OldPixelIntersect;
+	g_Config.m_SvOldTeleportHook = OldTeleportHook;
+	g_Config.m_SvOldTeleportWeapons = OldTeleportWeapons;
+}
+
+TEST(Collision, TileFlags)
+{
+	for(const auto &Map : ListMaps())
+	{
+		CCollisionMap CollisionMap;
+		ASSERT_TRUE(CollisionMap.Load(Map.c_str())) << Map;
+		const CCollision *pCollision = &CollisionMap.m_Collision;
+		const CLayers *pLayers = &CollisionMap.m_Layers;
+		const CTile *pTiles = static_cast<CTile *>(pLayers->Map()->GetData(pLayers->GameLayer()->m_Data));
+		const CTile *pFront = pLayers->FrontLayer() ? static_cast<CTile *>(pLayers->Map()->GetData(pLayers->FrontLayer()->m_Front)) : nullptr;
+
+		// a sparse sweep over the map plus some outside of it, the step
+		// doesn't divide the tile size so all offsets in a tile come up
+		const int Width = pCollision->GetWidth();
+		const int Height = pCollision->GetHeight();
+		for(int y = -70; y < Height * 32 + 70; y += 37)
+		{
+			for(int x = -70; x < Width * 32 + 70; x += 37)
+			{
+				const int Index = clamp(y / 32, 0, Height - 1) * Width + clamp(x / 32, 0, Width - 1);
+				const int Tile = pTiles[Index].m_Index >= TILE_SOLID && pTiles[Index].m_Index <= TILE_NOLASER ? pTiles[Index].m_Index : 0;
+				const int FrontTile = pFront && (pFront[Index].m_Index == TILE_DEATH || pFront[Index].m_Index == TILE_NOLASER) ? pFront[Index].m_Index : 0;
+				ASSERT_EQ(pCollision->GetTile(x, y), Tile) << Map << " " << x << "," << y;
+				ASSERT_EQ(pCollision->GetFTile(x, y), FrontTile) << Map << " " << x << "," << y;
+				ASSERT_EQ(pCollision->IsSolid(x, y), Tile == TILE_SOLID || Tile == TILE_NOHOOK) << Map << " " << x << "," << y;
+
+				const vec2 Pos = vec2(x + 0.3f, y - 0.7f);
+				const bool Corners = pCollision->CheckPoint(Pos.x - 14.0f, Pos.y - 14.0f) || pCollision->CheckPoint(Pos.x + 14.0f, Pos.y - 14.0f) || pCollision->CheckPoint(Pos.x - 14.0f, Pos.y + 14.0f) || pCollision->CheckPoint(Pos.x + 14.0f, Pos.y + 14.0f);
+				ASSERT_EQ(pCollision->TestBox(Pos, vec2(28.0f, 28.0f)), Corners) << Map << " " << x << "," << y;
+			}
+		}
+	}
+}
+
+// the list based implementation that GetMapIndices used to have
+static std::list<int> ReferenceMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
+{
+	std::list<int> Indices;
+	const int Width = pCollision->GetWidth();
+	const int Height = pCollision->GetHeight();
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+	{
+		int Index = clamp((int)Pos.y / 32, 0, Height - 1) * Width + clamp((int)Pos.x / 32, 0, Width - 1);
+		if(pCollision->TileExists(Index))
+			Indices.push_back(Index);
+		return Indices;
+	}
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		vec2 Tmp = mix(PrevPos, Pos, i / d);
+		int Index = clamp((int)Tmp.y / 32, 0, Height - 1) * Width + clamp((int)Tmp.x / 32, 0, Width - 1);
+		if(pCollision->TileExists(Index) && LastIndex != Index)
+		{
+			if(MaxIndices && Indices.size() > MaxIndices)
+				return Indices;
+			Indices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return Indices;
+}
+
+TEST(Collision, MapIndicesMatchReference)
+{
+	std::vector<std::string> vMaps = ListMaps();
+	ASSERT_FALSE(vMaps.empty());
+	CTestPrng Prng(1);
+	int NumIndices = 0;
+	for(const auto &Map : vMaps)
+	{
+		CCollisionMap CollisionMap;
+		ASSERT_TRUE(CollisionMap.Load(Map.c_str())) << Map;
+		const CCollision *pCollision = &CollisionMap.m_Collision;
+
+		for(int i = 0; i < 300; i++)
+		{
+			vec2 Pos0, Pos1;
+			RandomSegment(&Prng, pCollision, &Pos0, &Pos1);
+			// also test tick sized movements and standing still
+			if(i % 3 == 1)
+				Pos1 = Pos0 + vec2(Prng.RandomFloat(-40.0f, 40.0f), Prng.RandomFloat(-40.0f, 40.0f));
+			else if(i % 3 == 2)
+				Pos1 = Pos0;
+			const unsigned MaxIndices = i % 4;
+
+			std::list<int> Reference = ReferenceMapIndices(pCollision, Pos0, Pos1, MaxIndices);
+			CCollision::CMapIndices Indices = pCollision->GetMapIndices(Pos0, Pos1, MaxIndices);
+			std::vector<int> vIndices;
+			for(int Index : Indices)
+				vIndices.push_back(Index);
+			ASSERT_EQ(Indices.empty(), Reference.empty());
+			ASSERT_TRUE(std::equal(Reference.begin(), Reference.end(), vIndices.begin(), vIndices.end())) << Map << " from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y << " max=" << MaxIndices;
+			NumIndices += vIndices.size();
+		}
+	}
+	EXPECT_GT(NumIndices, 0);
+}
+
+TEST(Collision, MapIndicesDontAllocate)
+{
+	CCollisionMap CollisionMap;
+	ASSERT_TRUE(CollisionMap.Load("data/maps/Tutorial.map"));
+	const CCollision *pCollision = &CollisionMap.m_Collision;
+
+	// the anti-skip tile lookup every character does each tick
+	const int NumCharacters = MAX_CLIENTS;
+	const int NumTicks = 20;
+	std::vector<vec2> vPositions;
+	std::vector<vec2> vVelocities;
+	CTestPrng Prng(1);
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		vPositions.push_back(vec2(Prng.RandomFloat(0.0f, pCollision->GetWidth() * 32.0f), Prng.RandomFloat(0.0f, pCollision->GetHeight() * 32.0f)));
+		vVelocities.push_back(vec2(Prng.RandomFloat(-20.0f, 20.0f), Prng.RandomFloat(-20.0f, 20.0f)));
+	}
+
+	int64_t ListSum = 0;
+	int64_t ListAllocations = gs_NumAllocations;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+		for(int i = 0; i < NumCharacters; i++)
+			for(int Index : ReferenceMapIndices(pCollision, vPositions[i] + vVelocities[i] * Tick, vPositions[i] + vVelocities[i] * (Tick + 1), 0))
+				ListSum += Index;
+	ListAllocations = gs_NumAllocations - ListAllocations;
+
+	int64_t Sum = 0;
+	int64_t Allocations = gs_NumAllocations;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+		for(int i = 0; i < NumCharacters; i++)
+			for(int Index : pCollision->GetMapIndices(vPositions[i] + vVelocities[i] * Tick, vPositions[i] + vVelocities[i] * (Tick + 1)))
+				Sum += Index;
+	Allocations = gs_NumAllocations - Allocations;
+
+	EXPECT_EQ(Sum, ListSum);
+	EXPECT_GT(ListAllocations, 0);
+	EXPECT_EQ(Allocations, 0);
+}
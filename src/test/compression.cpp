@@ -1,5 +1,7 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
+#include <base/system.h>
 #include <engine/shared/compression.h>
 
 static const int DATA[] = {0, 1, -1, 32, 64, 256, -512, 12345, -123456, 1234567, 12345678, 123456789, 2147483647, (-2147483647 - 1)};
@@ -82,3 +84,95 @@ TEST(CVariableInt, DecompressBufferTooSmall)
 	long CompressedSize = CVariableInt::Decompress(aCompressed, sizeof(aCompressed), aUncompressed, sizeof(aUncompressed));
 	ASSERT_EQ(CompressedSize, -1);
 }
+
+static int RandomValue(CTestPrng *pPrng)
+{
+	// mostly small values like in snapshot deltas, with some large ones
+	const int Value = (int)(pPrng->RandomBits() >> 8);
+	switch(pPrng->RandomBits() % 8)
+	{
+	case 0: return Value;
+	case 1: return Value % 100000 - 50000;
+	case 2: return Value % 128 - 64;
+	default: return 0;
+	}
+}
+
+// same as Compress/Decompress, one int at a time
+static long ReferenceCompress(const int *pSrc, int Num, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pCur = pDst;
+	for(int i = 0; i < Num; i++)
+	{
+		pCur = CVariableInt::Pack(pCur, pSrc[i], pDst + DstSize - pCur);
+		if(!pCur)
+			return -1;
+	}
+	return pCur - pDst;
+}
+
+static long ReferenceDecompress(const unsigned char *pSrc, int SrcSize, int *pDst, int DstNum)
+{
+	const unsigned char *pEnd = pSrc + SrcSize;
+	int Num = 0;
+	while(pSrc < pEnd)
+	{
+		if(Num >= DstNum)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, &pDst[Num++], pEnd - pSrc);
+		if(!pSrc)
+			return -1;
+	}
+	return Num * sizeof(int);
+}
+
+TEST(CVariableInt, CompressMatchesReference)
+{
+	const int MaxNum = 200;
+	int aData[MaxNum];
+	unsigned char aCompressed[MaxNum * CVariableInt::MAX_BYTES_PACKED], aReference[sizeof(aCompressed)];
+	int aDecompressed[MaxNum], aReferenceDecompressed[MaxNum];
+	CTestPrng Prng;
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		const int Num = Round % MaxNum;
+		for(int i = 0; i < Num; i++)
+			aData[i] = Round % 3 == 0 ? RandomValue(&Prng) % 64 : RandomValue(&Prng);
+		// also exercise destination buffers that run out in the middle of a run
+		const int DstSize = Round % 5 == 0 ? (int)(Prng.RandomBits() % sizeof(aCompressed)) : (int)sizeof(aCompressed);
+
+		long Size = CVariableInt::Compress(aData, Num * sizeof(int), aCompressed, DstSize);
+		ASSERT_EQ(Size, ReferenceCompress(aData, Num, aReference, DstSize));
+		if(Size < 0)
+			continue;
+		ASSERT_EQ(mem_comp(aCompressed, aReference, Size), 0);
+
+		const int DstNum = Round % 7 == 0 ? (int)(Prng.RandomBits() % (MaxNum + 1)) : MaxNum;
+		long DecompressedSize = CVariableInt::Decompress(aCompressed, Size, aDecompressed, DstNum * sizeof(int));
+		ASSERT_EQ(DecompressedSize, ReferenceDecompress(aCompressed, Size, aReferenceDecompressed, DstNum));
+		if(DecompressedSize < 0)
+			continue;
+		ASSERT_EQ(DecompressedSize, Num * (long)sizeof(int));
+		ASSERT_EQ(mem_comp(aDecompressed, aData, DecompressedSize), 0);
+	}
+}
+
+TEST(CVariableInt, DecompressMatchesReference)
+{
+	// arbitrary bytes, including truncated and overlong encodings
+	unsigned char aData[256];
+	int aDecompressed[256], aReference[256];
+	CTestPrng Prng;
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		const int Size = Round % sizeof(aData);
+		for(int i = 0; i < Size; i++)
+			aData[i] = (Prng.RandomBits() >> 8) & (Round % 2 ? 0x7F : 0xFF);
+		long Result = CVariableInt::Decompress(aData, Size, aDecompressed, sizeof(aDecompressed));
+		ASSERT_EQ(Result, ReferenceDecompress(aData, Size, aReference, std::size(aReference)));
+		if(Result > 0)
+		{
+			ASSERT_EQ(mem_comp(aDecompressed, aReference, Result), 0);
+		}
+	}
+}
@@ -0,0 +1,238 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/databases/connection_pool.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct CTestSqlData : ISqlData
+{
+	CTestSqlData(std::shared_ptr<ISqlResult> pResult, struct ConnectionPool *pTest, int Index) :
+		ISqlData(std::move(pResult)), m_pTest(pTest), m_Index(Index)
+	{
+	}
+
+	struct ConnectionPool *m_pTest;
+	int m_Index;
+};
+
+// runs the queries against sqlite databases, the reads and writes share one
+// database file like the read workers and the write worker do on a server
+struct ConnectionPool : public testing::Test
+{
+	CTestInfo m_Info;
+	char m_aReadWrite[IO_MAX_PATH_LENGTH];
+	char m_aBackup[IO_MAX_PATH_LENGTH];
+	CDbConnectionPool m_Pool;
+
+	std::mutex m_Lock;
+	std::vector<std::pair<int, Write>> m_vWrites;
+	std::atomic_int m_NumReading{0};
+	std::atomic_bool m_ReleaseWrite{false};
+
+	ConnectionPool()
+	{
+		str_format(m_aReadWrite, sizeof(m_aReadWrite), "%s.sqlite", m_Info.m_aFilename);
+		str_format(m_aBackup, sizeof(m_aBackup), "%s-backup.sqlite", m_Info.m_aFilename);
+		EXPECT_EQ(QueryInt(m_aReadWrite, "CREATE TABLE record_test (Id INTEGER NOT NULL)"), 0);
+		EXPECT_EQ(QueryInt(m_aBackup, "CREATE TABLE record_test (Id INTEGER NOT NULL)"), 0);
+		m_Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, m_aReadWrite);
+		m_Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, m_aReadWrite);
+	}
+
+	~ConnectionPool()
+	{
+		m_Pool.OnShutdown();
+		fs_remove(m_aReadWrite);
+		fs_remove(m_aBackup);
+	}
+
+	std::shared_ptr<ISqlResult> Read(CDbConnectionPool::FRead pFunc, int Index = 0)
+	{
+		auto pResult = std::make_shared<ISqlResult>();
+		m_Pool.Execute(pFunc, std::make_unique<CTestSqlData>(pResult, this, Index), "test read");
+		return pResult;
+	}
+
+	std::shared_ptr<ISqlResult> WriteQuery(CDbConnectionPool::FWrite pFunc, int Index = 0)
+	{
+		auto pResult = std::make_shared<ISqlResult>();
+		m_Pool.ExecuteWrite(pFunc, std::make_unique<CTestSqlData>(pResult, this, Index), "test write");
+		return pResult;
+	}
+
+	// runs a query on its own connection and returns the first column of the
+	// first row, 0 if there is none and -1 on errors
+	static int QueryInt(const char *pFilename, const char *pQuery)
+	{
+		auto pConnection = CreateSqliteConnection(pFilename, false);
+		char aError[256];
+		bool End = true;
+		int Result = -1;
+		if(!pConnection->Connect(aError, sizeof(aError)))
+		{
+			if(!pConnection->PrepareStatement(pQuery, aError, sizeof(aError)) &&
+				!pConnection->Step(&End, aError, sizeof(aError)))
+				Result = End ? 0 : pConnection->GetInt(1);
+			pConnection->Disconnect();
+		}
+		return Result;
+	}
+
+	// reads all rows, keeping the database locked for a moment like a slow
+	// query would
+	static bool ReadRows(IDbConnection *pSqlServer, char *pError, int ErrorSize)
+	{
+		if(pSqlServer->PrepareStatement("SELECT Id FROM record_test", pError, ErrorSize))
+			return true;
+		bool End;
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+			return true;
+		std::this_thread::sleep_for(1ms);
+		while(!End)
+		{
+			if(pSqlServer->Step(&End, pError, ErrorSize))
+				return true;
+		}
+		return false;
+	}
+
+	static bool WaitFor(const std::atomic_bool &Flag)
+	{
+		for(int i = 0; i < 1000 && !Flag.load(); i++)
+			std::this_thread::sleep_for(10ms);
+		return Flag.load();
+	}
+
+	static bool FastRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+	{
+		return ReadRows(pSqlServer, pError, ErrorSize);
+	}
+
+	// only returns once all four reads are executed at the same time
+	static bool ParallelRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+	{
+		if(ReadRows(pSqlServer, pError, ErrorSize))
+			return true;
+		ConnectionPool *pThis = ((const CTestSqlData *)pGameData)->m_pTest;
+		pThis->m_NumReading.fetch_add(1);
+		for(int i = 0; i < 1000 && pThis->m_NumReading.load() < 4; i++)
+			std::this_thread::sleep_for(10ms);
+		return pThis->m_NumReading.load() < 4;
+	}
+
+	static bool BlockedWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+	{
+		ConnectionPool *pThis = ((const CTestSqlData *)pGameData)->m_pTest;
+		return !WaitFor(pThis->m_ReleaseWrite);
+	}
+
+	static bool SlowWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+	{
+		const CTestSqlData *pData = (const CTestSqlData *)pGameData;
+		std::this_thread::sleep_for(std::chrono::milliseconds(pData->m_Index % 3));
+		// the backup copy is removed again once the write succeeded
+		if(pSqlServer->PrepareStatement(w == Write::NORMAL_SUCCEEDED ?
+							"DELETE FROM record_test WHERE Id = ?" :
+							"INSERT INTO record_test (Id) VALUES (?)",
+			   pError, ErrorSize))
+			return true;
+		pSqlServer->BindInt(1, pData->m_Index);
+		int NumUpdated;
+		if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
+			return true;
+		std::unique_lock<std::mutex> Lock(pData->m_pTest->m_Lock);
+		pData->m_pTest->m_vWrites.emplace_back(pData->m_Index, w);
+		return false;
+	}
+};
+
+TEST_F(ConnectionPool, ReadsDontWaitForWrites)
+{
+	auto pWrite = WriteQuery(BlockedWrite);
+	auto pRead = Read(FastRead);
+	ASSERT_TRUE(WaitFor(pRead->m_Completed));
+	EXPECT_TRUE(pRead->m_Success);
+	EXPECT_FALSE(pWrite->m_Completed);
+
+	m_ReleaseWrite.store(true);
+	ASSERT_TRUE(WaitFor(pWrite->m_Completed));
+	EXPECT_TRUE(pWrite->m_Success);
+}
+
+TEST_F(ConnectionPool, ParallelReads)
+{
+	m_Pool.SetNumReadWorkers(4);
+	std::shared_ptr<ISqlResult> apReads[4];
+	for(auto &pRead : apReads)
+		pRead = Read(ParallelRead);
+	for(auto &pRead : apReads)
+	{
+		ASSERT_TRUE(WaitFor(pRead->m_Completed));
+		EXPECT_TRUE(pRead->m_Success);
+	}
+
+	CDbConnectionPool::CQueueStats Stats;
+	m_Pool.GetStats(CDbConnectionPool::READ, &Stats);
+	EXPECT_EQ(Stats.m_NumWorkers, 4);
+	EXPECT_EQ(Stats.m_Queued, 0);
+	EXPECT_GE(Stats.m_MaxQueued, 1);
+	EXPECT_EQ(Stats.m_NumQueries, 4);
+	EXPECT_EQ(Stats.m_NumFailed, 0);
+	EXPECT_GE(Stats.m_ExecTime, Stats.m_MaxExecTime);
+	EXPECT_GT(Stats.m_MaxExecTime, 0);
+}
+
+TEST_F(ConnectionPool, WriteOrder)
+{
+	m_Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE_BACKUP, m_aBackup);
+	m_Pool.SetNumReadWorkers(4);
+	std::vector<std::shared_ptr<ISqlResult>> vpWrites;
+	for(int i = 0; i < 20; i++)
+	{
+		vpWrites.push_back(WriteQuery(SlowWrite, i));
+		Read(FastRead);
+	}
+	for(auto &pWrite : vpWrites)
+	{
+		ASSERT_TRUE(WaitFor(pWrite->m_Completed));
+		EXPECT_TRUE(pWrite->m_Success);
+	}
+
+	// every write goes to the backup first, then to the write database and
+	// is then removed from the backup again
+	std::unique_lock<std::mutex> Lock(m_Lock);
+	std::vector<std::vector<Write>> avWrites(vpWrites.size());
+	int Last = -1;
+	for(const auto &[Index, w] : m_vWrites)
+	{
+		avWrites[Index].push_back(w);
+		if(w == Write::NORMAL)
+		{
+			EXPECT_EQ(Index, Last + 1);
+			Last = Index;
+		}
+	}
+	EXPECT_EQ(Last, 19);
+	EXPECT_EQ(QueryInt(m_aReadWrite, "SELECT COUNT(*) FROM record_test"), 20);
+	EXPECT_EQ(QueryInt(m_aBackup, "SELECT COUNT(*) FROM record_test"), 0);
+	for(const auto &vWrites : avWrites)
+	{
+		EXPECT_EQ(vWrites, std::vector<Write>({Write::BACKUP_FIRST, Write::NORMAL, Write::NORMAL_SUCCEEDED}));
+	}
+
+	CDbConnectionPool::CQueueStats Stats;
+	m_Pool.GetStats(CDbConnectionPool::WRITE, &Stats);
+	EXPECT_EQ(Stats.m_NumWorkers, 1);
+	EXPECT_EQ(Stats.m_Queued, 0);
+	EXPECT_EQ(Stats.m_NumQueries, 20);
+	EXPECT_EQ(Stats.m_NumFailed, 0);
+}
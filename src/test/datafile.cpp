@@ -58,3 +58,50 @@ TEST(Datafile, ExtendedType)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, FileData)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	int aData[1024];
+	for(int i = 0; i < (int)std::size(aData); i++)
+		aData[i] = i * i;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+
+		int Item = 42;
+		Writer.AddItem(MAPITEMTYPE_TEST, 0, sizeof(Item), &Item);
+		Writer.AddData(sizeof(aData), aData);
+
+		Writer.Finish();
+	}
+
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_ALL, &pFile, &FileSize));
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+
+		// the reader exposes the exact file contents and hashes them
+		ASSERT_EQ(Reader.FileSize(), FileSize);
+		EXPECT_EQ(mem_comp(Reader.FileData(), pFile, FileSize), 0);
+		EXPECT_EQ(Reader.Sha256(), sha256(pFile, FileSize));
+		EXPECT_EQ(Reader.Crc(), crc32(0, (const Bytef *)pFile, FileSize));
+		EXPECT_EQ(Reader.MapSize(), (int)FileSize);
+
+		ASSERT_EQ(Reader.NumData(), 1);
+		ASSERT_EQ(Reader.GetDataSize(0), (int)sizeof(aData));
+		EXPECT_EQ(mem_comp(Reader.GetData(0), aData, sizeof(aData)), 0);
+	}
+	free(pFile);
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -0,0 +1,136 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <game/server/entitygrid.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+struct STestEntity
+{
+	vec2 m_Pos;
+	float m_ProximityRadius;
+	int64_t m_InsertOrder;
+
+	STestEntity *m_pPrevGridEntity = nullptr;
+	STestEntity *m_pNextGridEntity = nullptr;
+	int m_GridBucket = -1;
+	int m_GridX = 0;
+	int m_GridY = 0;
+};
+
+static vec2 RandomPos(CTestPrng *pPrng)
+{
+	switch(pPrng->RandomBits() % 32)
+	{
+	case 0: return vec2(NAN, pPrng->RandomFloat(0.0f, 4000.0f));
+	case 1: return vec2(pPrng->RandomFloat(-1e9f, 1e9f), pPrng->RandomFloat(-1e9f, 1e9f));
+	default: return vec2(pPrng->RandomFloat(-500.0f, 8000.0f), pPrng->RandomFloat(-500.0f, 4000.0f));
+	}
+}
+
+// the world keeps its entities newest first, that's the order of the
+// linear scan the grid has to reproduce
+class EntityGrid : public ::testing::Test
+{
+protected:
+	CEntityGrid<STestEntity> m_Grid;
+	std::vector<std::unique_ptr<STestEntity>> m_vpEntities;
+	std::vector<STestEntity *> m_vpList;
+	int64_t m_NextInsertOrder = 0;
+	CTestPrng m_Prng;
+
+	void Insert()
+	{
+		m_vpEntities.push_back(std::make_unique<STestEntity>());
+		STestEntity *pEnt = m_vpEntities.back().get();
+		pEnt->m_Pos = RandomPos(&m_Prng);
+		pEnt->m_ProximityRadius = m_Prng.RandomBits() % 4 ? 14.0f : 28.0f;
+		pEnt->m_InsertOrder = m_NextInsertOrder++;
+		m_Grid.Insert(pEnt, pEnt->m_ProximityRadius);
+		m_vpList.insert(m_vpList.begin(), pEnt);
+	}
+
+	void Remove(int Index)
+	{
+		m_Grid.Remove(m_vpList[Index]);
+		m_vpList.erase(m_vpList.begin() + Index);
+	}
+
+	// same as CGameWorld::FindEntities for characters
+	std::vector<STestEntity *> Find(vec2 Pos, float Radius, bool *pUsedGrid)
+	{
+		STestEntity *apCandidates[MAX_CLIENTS];
+		int NumCandidates = m_Grid.Query(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), apCandidates, MAX_CLIENTS);
+		*pUsedGrid = NumCandidates >= 0;
+		if(NumCandidates < 0)
+		{
+			NumCandidates = 0;
+			for(STestEntity *pEnt : m_vpList)
+				apCandidates[NumCandidates++] = pEnt;
+		}
+
+		std::vector<STestEntity *> vpFound;
+		for(int i = 0; i < NumCandidates; i++)
+			if(distance(apCandidates[i]->m_Pos, Pos) < Radius + apCandidates[i]->m_ProximityRadius)
+				vpFound.push_back(apCandidates[i]);
+		return vpFound;
+	}
+
+	std::vector<STestEntity *> FindLinear(vec2 Pos, float Radius)
+	{
+		std::vector<STestEntity *> vpFound;
+		for(STestEntity *pEnt : m_vpList)
+			if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
+				vpFound.push_back(pEnt);
+		return vpFound;
+	}
+};
+
+TEST_F(EntityGrid, MatchesLinearScan)
+{
+	int NumGridQueries = 0;
+	int NumFound = 0;
+	for(int Step = 0; Step < 5000; Step++)
+	{
+		switch(m_Prng.RandomBits() % 8)
+		{
+		case 0:
+			if((int)m_vpList.size() < MAX_CLIENTS)
+				Insert();
+			break;
+		case 1:
+			if(!m_vpList.empty())
+				Remove(m_Prng.RandomBits() % m_vpList.size());
+			break;
+		default:
+			// characters move a bit every tick and teleport sometimes
+			for(STestEntity *pEnt : m_vpList)
+			{
+				if(m_Prng.RandomBits() % 64 == 0)
+					pEnt->m_Pos = RandomPos(&m_Prng);
+				else if(pEnt->m_Pos.x == pEnt->m_Pos.x)
+					pEnt->m_Pos += vec2(m_Prng.RandomFloat(-30.0f, 30.0f), m_Prng.RandomFloat(-30.0f, 30.0f));
+				m_Grid.Moved(pEnt);
+			}
+		}
+
+		for(STestEntity *pEnt : m_vpList)
+			ASSERT_TRUE(m_Grid.IsCurrent(pEnt));
+		ASSERT_EQ(m_Grid.Num(), (int)m_vpList.size());
+
+		const vec2 Pos = !m_vpList.empty() && m_Prng.RandomBits() % 2 ? m_vpList[m_Prng.RandomBits() % m_vpList.size()]->m_Pos : RandomPos(&m_Prng);
+		const float aRadii[] = {0.0f, 6.0f, 28.0f, 400.0f, 3000.0f};
+		const float Radius = aRadii[m_Prng.RandomBits() % std::size(aRadii)];
+		bool UsedGrid;
+		std::vector<STestEntity *> vpFound = Find(Pos, Radius, &UsedGrid);
+		ASSERT_EQ(vpFound, FindLinear(Pos, Radius)) << "step " << Step << " at " << Pos.x << "," << Pos.y << " radius " << Radius;
+		NumGridQueries += UsedGrid;
+		NumFound += vpFound.size();
+	}
+	EXPECT_GT(NumGridQueries, 1000);
+	EXPECT_GT(NumFound, 0);
+}
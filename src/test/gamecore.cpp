@@ -0,0 +1,207 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/teamscore.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+class CCoreWorld
+{
+public:
+	CWorldCore m_World;
+	CTeamsCore m_Teams;
+	CCharacterCore m_aCores[MAX_CLIENTS] = {};
+
+	CCoreWorld(CCollision *pCollision, bool UseBroadphase, int NumCharacters, const vec2 *pSpawns)
+	{
+		m_World.m_UseBroadphase = UseBroadphase;
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			m_aCores[i].Init(&m_World, pCollision, &m_Teams);
+			m_aCores[i].m_Id = i;
+			m_aCores[i].m_Pos = pSpawns[i];
+			m_World.m_apCharacters[i] = &m_aCores[i];
+		}
+	}
+
+	// same order as the server: all core ticks, then all moves
+	void Tick(const CNetObj_PlayerInput *pInputs, int NumCharacters)
+	{
+		m_World.BuildBroadphase();
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			m_aCores[i].m_Input = pInputs[i];
+			m_aCores[i].Tick(true);
+		}
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			m_aCores[i].Move();
+			m_aCores[i].Quantize();
+		}
+	}
+};
+
+class GameCore : public ::testing::Test
+{
+protected:
+	std::unique_ptr<IKernel> m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+	bool m_Loaded = false;
+
+	void SetUp() override
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		IStorage *pStorage = CreateLocalStorage();
+		IEngineMap *pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(pStorage);
+		m_pKernel->RegisterInterface(pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+		if(!pMap->Load("data/maps/ctf1.map"))
+			return;
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+		m_Loaded = true;
+	}
+
+	bool IsFree(vec2 Pos) const
+	{
+		return !m_Collision.TestBox(Pos, CCharacterCore::PhysicalSizeVec2() * 2.0f);
+	}
+};
+
+TEST_F(GameCore, BroadphaseDeterminism)
+{
+	ASSERT_TRUE(m_Loaded);
+
+	const int NumCharacters = MAX_CLIENTS;
+	const int NumTicks = 50 * 30;
+	CTestPrng Prng(1);
+
+	// crowd the characters around a few free spots of the map so they
+	// collide and hook each other a lot
+	vec2 aSpawns[NumCharacters];
+	vec2 aCenters[4];
+	for(auto &Center : aCenters)
+	{
+		do
+			Center = vec2(Prng.RandomBits() % (m_Collision.GetWidth() * 32), Prng.RandomBits() % (m_Collision.GetHeight() * 32));
+		while(!IsFree(Center));
+	}
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		do
+			aSpawns[i] = aCenters[i % 4] + vec2((int)(Prng.RandomBits() % 257) - 128, (int)(Prng.RandomBits() % 257) - 128);
+		while(!IsFree(aSpawns[i]));
+	}
+
+	// record the inputs once, held for a random number of ticks each
+	std::vector<CNetObj_PlayerInput> vInputs(NumTicks * NumCharacters);
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		CNetObj_PlayerInput Input = {};
+		Input.m_TargetY = -1;
+		for(int Tick = 0; Tick < NumTicks; Tick++)
+		{
+			if(Prng.RandomBits() % 8 == 0)
+			{
+				Input.m_Direction = (int)(Prng.RandomBits() % 3) - 1;
+				Input.m_Jump = Prng.RandomBits() % 4 == 0;
+				Input.m_Hook = Prng.RandomBits() % 3 != 0;
+				Input.m_TargetX = (int)(Prng.RandomBits() % 601) - 300;
+				Input.m_TargetY = (int)(Prng.RandomBits() % 601) - 300;
+				if(Input.m_TargetX == 0 && Input.m_TargetY == 0)
+					Input.m_TargetY = -1;
+			}
+			vInputs[Tick * NumCharacters + i] = Input;
+		}
+	}
+
+	CCoreWorld Reference(&m_Collision, false, NumCharacters, aSpawns);
+	CCoreWorld Broadphase(&m_Collision, true, NumCharacters, aSpawns);
+
+	int NumHooked = 0;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		const CNetObj_PlayerInput *pInputs = &vInputs[Tick * NumCharacters];
+
+		Reference.Tick(pInputs, NumCharacters);
+		Broadphase.Tick(pInputs, NumCharacters);
+
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			CNetObj_CharacterCore ReferenceCore = {};
+			CNetObj_CharacterCore BroadphaseCore = {};
+			Reference.m_aCores[i].Write(&ReferenceCore);
+			Broadphase.m_aCores[i].Write(&BroadphaseCore);
+			ASSERT_EQ(mem_comp(&ReferenceCore, &BroadphaseCore, sizeof(ReferenceCore)), 0) << "tick " << Tick << " character " << i;
+			if(ReferenceCore.m_HookedPlayer != -1)
+				NumHooked++;
+		}
+	}
+
+	// make sure that the player interactions were actually tested
+	EXPECT_GT(NumHooked, 0);
+}
+
+static float RandomCoord(CTestPrng *pPrng)
+{
+	const unsigned Kind = pPrng->RandomBits() % 16;
+	if(Kind == 0)
+		return NAN;
+	else if(Kind == 1)
+		return pPrng->RandomBits() % 2 ? INFINITY : -INFINITY;
+	else if(Kind == 2)
+		return pPrng->RandomBits() % 2 ? 1e9f : -1e9f;
+	return (int)(pPrng->RandomBits() % 2001) - 1000 + (pPrng->RandomBits() % 100) / 100.0f;
+}
+
+TEST(Broadphase, MatchesLinearScan)
+{
+	CCharacterCore aCores[MAX_CLIENTS] = {};
+	CWorldCore Grid;
+	CWorldCore Linear;
+	CTestPrng Prng(7);
+
+	for(int Step = 0; Step < 2000; Step++)
+	{
+		// add, remove and move characters, sometimes by more than a cell
+		// and sometimes to NaN or far away positions
+		for(int j = 0; j < 4; j++)
+		{
+			const int ID = Prng.RandomBits() % MAX_CLIENTS;
+			if(Prng.RandomBits() % 8 == 0)
+				Grid.m_apCharacters[ID] = Grid.m_apCharacters[ID] ? nullptr : &aCores[ID];
+			aCores[ID].m_Pos = Prng.RandomBits() % 2 ? aCores[ID].m_Pos + vec2((int)(Prng.RandomBits() % 65) - 32, (int)(Prng.RandomBits() % 65) - 32) : vec2(RandomCoord(&Prng), RandomCoord(&Prng));
+			Linear.m_apCharacters[ID] = Grid.m_apCharacters[ID];
+			Grid.UpdateBroadphase(ID);
+		}
+		if(Step % 50 == 0)
+			Grid.BuildBroadphase();
+
+		for(int j = 0; j < 8; j++)
+		{
+			const vec2 Center = vec2(RandomCoord(&Prng), RandomCoord(&Prng));
+			const vec2 Size = vec2(Prng.RandomBits() % 200, Prng.RandomBits() % 200);
+			const vec2 Min = Center - Size;
+			const vec2 Max = Center + Size;
+
+			int aGridIDs[MAX_CLIENTS];
+			int aLinearIDs[MAX_CLIENTS];
+			const int NumGrid = Grid.FindCharacters(Min, Max, aGridIDs);
+			const int NumLinear = Linear.FindCharacters(Min, Max, aLinearIDs);
+			ASSERT_EQ(NumGrid, NumLinear) << "step " << Step;
+			for(int k = 0; k < NumGrid; k++)
+				ASSERT_EQ(aGridIDs[k], aLinearIDs[k]) << "step " << Step;
+		}
+	}
+}
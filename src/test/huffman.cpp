@@ -1,3 +1,4 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/system.h>
@@ -46,3 +47,54 @@ TEST(Huffman, CompressionCompatible)
 	EXPECT_EQ(match, 0) << "The compression is not compatible with older/other implementations anymore";
 	EXPECT_EQ(Size, 15);
 }
+
+static void FillPacketLike(unsigned char *pData, int Size, unsigned Seed)
+{
+	// mostly small values and zeros, like packed snapshot deltas
+	CTestPrng Prng(Seed);
+	for(int i = 0; i < Size; i++)
+	{
+		unsigned Value = Prng.RandomBits() >> 16;
+		if(Value % 3 == 0)
+			pData[i] = 0;
+		else if(Value % 7 == 0)
+			pData[i] = Value >> 4;
+		else
+			pData[i] = Value % 24;
+	}
+}
+
+TEST(Huffman, Roundtrip)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	unsigned char aInput[1400];
+	unsigned char aCompressed[2048];
+	unsigned char aDecompressed[1400];
+	for(int Size = 0; Size <= (int)sizeof(aInput); Size += 7)
+	{
+		FillPacketLike(aInput, Size, Size);
+		if(Size % 2)
+		{
+			// random bytes make use of the long codes
+			for(int i = 0; i < Size; i += 3)
+				aInput[i] = (i * 151 + Size) & 0xff;
+		}
+
+		int CompressedSize = Huffman.Compress(aInput, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		int DecompressedSize = Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, sizeof(aDecompressed));
+		ASSERT_EQ(DecompressedSize, Size);
+		EXPECT_EQ(mem_comp(aInput, aDecompressed, Size), 0);
+
+		// output buffers have to fit exactly
+		EXPECT_EQ(Huffman.Compress(aInput, Size, aCompressed, CompressedSize), CompressedSize);
+		EXPECT_EQ(Huffman.Compress(aInput, Size, aCompressed, CompressedSize - 1), -1);
+		EXPECT_EQ(Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, Size), Size);
+		if(Size)
+		{
+			EXPECT_EQ(Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, Size - 1), -1);
+		}
+	}
+}
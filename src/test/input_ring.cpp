@@ -0,0 +1,120 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <engine/server/input_ring.h>
+
+#include <deque>
+#include <vector>
+
+// the serial number of an input is stored in its first data field
+struct CModelInput
+{
+	int m_Tick;
+	int m_Serial;
+};
+
+static std::vector<int> RingInputs(CInputRing &Ring, int Tick)
+{
+	std::vector<int> vSerials;
+	for(const CInputRing::CInput *pInput = Ring.First(Tick); pInput; pInput = Ring.Next(pInput))
+	{
+		EXPECT_EQ(pInput->m_GameTick, Tick);
+		vSerials.push_back(pInput->m_aData[0]);
+	}
+	return vSerials;
+}
+
+// the last MAX_INPUTS accepted inputs for the tick in the order they arrived
+static std::vector<int> ModelInputs(const std::deque<CModelInput> &Model, int Tick)
+{
+	std::vector<int> vSerials;
+	for(const auto &Input : Model)
+		if(Input.m_Tick == Tick)
+			vSerials.push_back(Input.m_Serial);
+	return vSerials;
+}
+
+static void RunModel(int StartTick, unsigned Seed)
+{
+	CTestPrng Prng(Seed);
+	CInputRing Ring;
+	std::deque<CModelInput> Model;
+	int CurrentTick = StartTick;
+	int NumDropped = 0;
+	for(int Serial = 0; Serial < 5000; Serial++)
+	{
+		// mostly a few ticks ahead, sometimes late or far ahead
+		CurrentTick += Prng.RandomBits() % 3 == 0;
+		int GameTick = CurrentTick + 1 + Prng.RandomBits() % 4;
+		if(Prng.RandomBits() % 8 == 0)
+			GameTick = CurrentTick - 2 + (int)(Prng.RandomBits() % (2 * CInputRing::NUM_TICKS + 4));
+
+		CInputRing::CInput *pInput = Ring.Add(GameTick, CurrentTick);
+		if(GameTick <= CurrentTick || GameTick >= CurrentTick + CInputRing::NUM_TICKS)
+		{
+			ASSERT_EQ(pInput, nullptr) << "tick=" << GameTick << " current=" << CurrentTick;
+			NumDropped++;
+		}
+		else
+		{
+			ASSERT_NE(pInput, nullptr) << "tick=" << GameTick << " current=" << CurrentTick;
+			pInput->m_aData[0] = Serial;
+			Model.push_back({GameTick, Serial});
+			if(Model.size() > CInputRing::MAX_INPUTS)
+				Model.pop_front();
+		}
+		ASSERT_EQ(Ring.NumDropped(), NumDropped);
+
+		// every tick that can still be simulated keeps its inputs
+		for(int Tick = CurrentTick; Tick < CurrentTick + CInputRing::NUM_TICKS; Tick++)
+			ASSERT_EQ(RingInputs(Ring, Tick), ModelInputs(Model, Tick)) << "tick=" << Tick << " current=" << CurrentTick << " serial=" << Serial;
+	}
+}
+
+TEST(InputRing, MatchesModel)
+{
+	RunModel(0, 1);
+	RunModel(12345, 2);
+}
+
+TEST(InputRing, MatchesModelAcrossWrap)
+{
+	// the ticks pass several multiples of the slot count
+	RunModel(CInputRing::NUM_TICKS * 1000 - 37, 3);
+}
+
+TEST(InputRing, FarAheadDoesNotAlias)
+{
+	CInputRing Ring;
+	const int CurrentTick = 1000;
+	CInputRing::CInput *pInput = Ring.Add(CurrentTick + 1, CurrentTick);
+	ASSERT_NE(pInput, nullptr);
+	pInput->m_aData[0] = 1;
+
+	// these share the slot of the next tick
+	EXPECT_EQ(Ring.Add(CurrentTick + 1 + CInputRing::NUM_TICKS, CurrentTick), nullptr);
+	EXPECT_EQ(Ring.Add(CurrentTick + 1 + 2 * CInputRing::NUM_TICKS, CurrentTick), nullptr);
+	// the slot of the current tick is the one NUM_TICKS ahead
+	EXPECT_EQ(Ring.Add(CurrentTick + CInputRing::NUM_TICKS, CurrentTick), nullptr);
+	EXPECT_EQ(Ring.Add(CurrentTick, CurrentTick), nullptr);
+	EXPECT_EQ(Ring.NumDropped(), 4);
+
+	EXPECT_EQ(RingInputs(Ring, CurrentTick + 1), std::vector<int>{1});
+	EXPECT_EQ(Ring.First(CurrentTick + 1 + CInputRing::NUM_TICKS), nullptr);
+
+	// the last tick of the window is kept
+	pInput = Ring.Add(CurrentTick + CInputRing::NUM_TICKS - 1, CurrentTick);
+	ASSERT_NE(pInput, nullptr);
+	pInput->m_aData[0] = 2;
+	EXPECT_EQ(RingInputs(Ring, CurrentTick + CInputRing::NUM_TICKS - 1), std::vector<int>{2});
+}
+
+TEST(InputRing, Reset)
+{
+	CInputRing Ring;
+	ASSERT_NE(Ring.Add(5, 0), nullptr);
+	EXPECT_EQ(Ring.Add(500, 0), nullptr);
+	Ring.Reset();
+	EXPECT_EQ(Ring.First(5), nullptr);
+	EXPECT_EQ(Ring.NumDropped(), 0);
+}
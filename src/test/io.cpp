@@ -78,3 +78,27 @@ TEST(Io, SyncWorks)
 	EXPECT_FALSE(io_close(File));
 	EXPECT_FALSE(fs_remove(Info.m_aFilename));
 }
+
+TEST(Io, Map)
+{
+	CTestInfo Info;
+	const char *pContents = "mapped file contents";
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, pContents, str_length(pContents)), str_length(pContents));
+	EXPECT_FALSE(io_close(File));
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	void *pData;
+	unsigned Size;
+	ASSERT_TRUE(io_map(File, &pData, &Size));
+	EXPECT_FALSE(io_close(File));
+
+	// the mapping outlives the file handle
+	ASSERT_EQ(Size, (unsigned)str_length(pContents));
+	EXPECT_EQ(mem_comp(pData, pContents, Size), 0);
+	io_unmap(pData, Size);
+
+	fs_remove(Info.m_aFilename);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/message.h>
+#include <engine/server/map_chunks.h>
+#include <engine/shared/protocol.h>
+
+#include <vector>
+
+static const unsigned MAP_CRC = 0x12345678;
+
+// how the server packed a chunk when it was requested, before the chunks
+// were built on map load, returns false for dropped requests
+static bool ReferenceChunk(const std::vector<unsigned char> &vMap, int Chunk, bool Sixup, CPacker *pPack)
+{
+	unsigned int ChunkSize = 1024 - 128;
+	unsigned int Offset = Chunk * ChunkSize;
+	int Last = 0;
+
+	if(Chunk < 0 || Offset > vMap.size())
+		return false;
+
+	if(Offset + ChunkSize >= vMap.size())
+	{
+		ChunkSize = vMap.size() - Offset;
+		Last = 1;
+	}
+
+	CMsgPacker Msg(NETMSG_MAP_DATA, true);
+	if(!Sixup)
+	{
+		Msg.AddInt(Last);
+		Msg.AddInt(MAP_CRC);
+		Msg.AddInt(Chunk);
+		Msg.AddInt(ChunkSize);
+	}
+	Msg.AddRaw(vMap.data() + Offset, ChunkSize);
+
+	pPack->Reset();
+	pPack->AddInt((Msg.m_MsgID << 1) | 1);
+	pPack->AddRaw(Msg.Data(), Msg.Size());
+	return true;
+}
+
+static std::vector<unsigned char> CreateMap(unsigned Size)
+{
+	std::vector<unsigned char> vMap(Size);
+	for(unsigned i = 0; i < Size; i++)
+		vMap[i] = (i * 151 + 7) & 0xff;
+	return vMap;
+}
+
+TEST(MapChunks, MatchesOnTheFlyPacking)
+{
+	const unsigned aSizes[] = {0, 1, 100, CMapChunks::CHUNK_SIZE - 1, CMapChunks::CHUNK_SIZE, CMapChunks::CHUNK_SIZE + 1, 3 * CMapChunks::CHUNK_SIZE, 3 * CMapChunks::CHUNK_SIZE + 5, 100000};
+	for(unsigned Size : aSizes)
+	{
+		std::vector<unsigned char> vMap = CreateMap(Size);
+		for(int Sixup = 0; Sixup < 2; Sixup++)
+		{
+			CMapChunks Chunks;
+			Chunks.Build(vMap.data(), Size, MAP_CRC, Sixup);
+
+			CPacker Reference;
+			int NumReference = 0;
+			while(ReferenceChunk(vMap, NumReference, Sixup, &Reference))
+			{
+				ASSERT_LT(NumReference, Chunks.Num()) << "size=" << Size << " sixup=" << Sixup;
+				ASSERT_EQ(Chunks.Size(NumReference), Reference.Size()) << "size=" << Size << " chunk=" << NumReference;
+				EXPECT_EQ(mem_comp(Chunks.Data(NumReference), Reference.Data(), Reference.Size()), 0) << "size=" << Size << " chunk=" << NumReference;
+				NumReference++;
+			}
+			EXPECT_EQ(Chunks.Num(), NumReference) << "size=" << Size << " sixup=" << Sixup;
+		}
+	}
+}
+
+TEST(MapChunks, LastChunk)
+{
+	const unsigned aSizes[] = {1, CMapChunks::CHUNK_SIZE - 1, CMapChunks::CHUNK_SIZE, 2 * CMapChunks::CHUNK_SIZE, 2 * CMapChunks::CHUNK_SIZE + 1};
+	for(unsigned Size : aSizes)
+	{
+		std::vector<unsigned char> vMap = CreateMap(Size);
+		CMapChunks Chunks;
+		Chunks.Build(vMap.data(), Size, MAP_CRC, false);
+
+		// maps that are a multiple of the chunk size end with an empty chunk
+		const int NumChunks = Size / CMapChunks::CHUNK_SIZE + 1;
+		ASSERT_EQ(Chunks.Num(), NumChunks) << "size=" << Size;
+		unsigned Received = 0;
+		for(int Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			CUnpacker Unpacker;
+			Unpacker.Reset(Chunks.Data(Chunk), Chunks.Size(Chunk));
+			EXPECT_EQ(Unpacker.GetInt(), (NETMSG_MAP_DATA << 1) | 1);
+			const int Last = Unpacker.GetInt();
+			EXPECT_EQ((unsigned)Unpacker.GetInt(), MAP_CRC);
+			EXPECT_EQ(Unpacker.GetInt(), Chunk);
+			const int ChunkSize = Unpacker.GetInt();
+			const unsigned char *pData = Unpacker.GetRaw(ChunkSize);
+			ASSERT_FALSE(Unpacker.Error()) << "size=" << Size << " chunk=" << Chunk;
+			EXPECT_EQ(Unpacker.RemainingSize(), 0);
+
+			// the full chunk before the empty one is marked as last as well
+			const bool ReachesEnd = Chunk == NumChunks - 1 || (Chunk == NumChunks - 2 && Size % CMapChunks::CHUNK_SIZE == 0);
+			EXPECT_EQ(Last, ReachesEnd) << "size=" << Size << " chunk=" << Chunk;
+			EXPECT_EQ(ChunkSize, CMapChunks::MapBytes(Size, Chunk));
+			EXPECT_EQ(mem_comp(pData, vMap.data() + Received, ChunkSize), 0);
+			Received += ChunkSize;
+		}
+		EXPECT_EQ(Received, Size);
+		if(Size % CMapChunks::CHUNK_SIZE == 0)
+		{
+			EXPECT_EQ(CMapChunks::MapBytes(Size, NumChunks - 1), 0);
+		}
+		else
+		{
+			EXPECT_EQ(CMapChunks::MapBytes(Size, NumChunks - 1), (int)(Size % CMapChunks::CHUNK_SIZE));
+		}
+	}
+}
+
+TEST(MapChunks, Clear)
+{
+	std::vector<unsigned char> vMap = CreateMap(5000);
+	CMapChunks Chunks;
+	EXPECT_EQ(Chunks.Num(), 0);
+	Chunks.Build(vMap.data(), vMap.size(), MAP_CRC, true);
+	EXPECT_EQ(Chunks.Num(), 6);
+	Chunks.Clear();
+	EXPECT_EQ(Chunks.Num(), 0);
+}
@@ -45,3 +45,70 @@ TEST(Net, Ipv4AndIpv6Work)
 	EXPECT_EQ(Addr, LocalhostV6);
 	EXPECT_EQ(mem_comp(pData, "def", 3), 0);
 }
+
+TEST(Net, BatchedSend)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4 | NETTYPE_IPV6;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR TargetV4;
+	NETADDR TargetV6;
+	ASSERT_FALSE(net_addr_from_str(&TargetV4, "127.0.0.1"));
+	ASSERT_FALSE(net_addr_from_str(&TargetV6, "[::1]"));
+	TargetV4.port = Bindaddr.port;
+	TargetV6.port = Bindaddr.port;
+
+	NETSTATS Before;
+	net_stats(&Before);
+
+	// more packets than fit into one batch, alternating address families
+	const int NumPackets = 300;
+	net_udp_set_batching(Socket2, true);
+	for(int i = 0; i < NumPackets; i++)
+	{
+		const NETADDR *pTarget = (i / 50) % 2 ? &TargetV6 : &TargetV4;
+		EXPECT_EQ(net_udp_send(Socket2, pTarget, &i, sizeof(i)), (int)sizeof(i));
+	}
+	net_udp_flush(Socket2);
+
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NumPackets);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_LT(After.send_syscalls - Before.send_syscalls, (uint64_t)NumPackets / 10);
+#endif
+
+	// loopback keeps the order within each address family
+	int aNext[2] = {0, 50};
+	for(int Received = 0; Received < NumPackets; Received++)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		int Size = net_udp_recv(Socket1, &Addr, &pData);
+		if(Size <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+			Received--;
+			continue;
+		}
+		ASSERT_EQ(Size, (int)sizeof(int));
+		int Value;
+		mem_copy(&Value, pData, sizeof(Value));
+		const int Family = Addr.type == NETTYPE_IPV6;
+		EXPECT_EQ(Value, aNext[Family]);
+		aNext[Family]++;
+		if(aNext[Family] % 50 == 0)
+			aNext[Family] += 50;
+	}
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+#include <vector>
+
+static int NewClient(int ClientID, void *pUser, bool Sixup) { return 0; }
+static int NewClientNoAuth(int ClientID, void *pUser) { return 0; }
+static int ClientRejoin(int ClientID, void *pUser) { return 0; }
+static int DelClient(int ClientID, const char *pReason, void *pUser) { return 0; }
+
+class NetServer : public ::testing::Test
+{
+protected:
+	CNetServer m_Server;
+	NETADDR m_ServerAddr;
+	std::vector<NETSOCKET> m_vClients;
+	std::vector<NETADDR> m_vClientAddrs;
+
+	void SetUp() override
+	{
+		CNetBase::Init();
+		g_Config.m_SvVanillaAntiSpoof = 0;
+		g_Config.m_SvConnlimit = 0;
+		g_Config.m_Password[0] = 0;
+
+		NETADDR BindAddr = {};
+		BindAddr.type = NETTYPE_IPV4;
+		do
+		{
+			BindAddr.port = secure_rand() % 64511 + 1024;
+		} while(!m_Server.Open(BindAddr, nullptr, NET_MAX_CLIENTS, NET_MAX_CLIENTS));
+		m_Server.SetCallbacks(NewClient, NewClientNoAuth, ClientRejoin, DelClient, nullptr);
+
+		ASSERT_FALSE(net_addr_from_str(&m_ServerAddr, "127.0.0.1"));
+		m_ServerAddr.port = BindAddr.port;
+	}
+
+	void TearDown() override
+	{
+		for(auto Socket : m_vClients)
+			net_udp_close(Socket);
+		m_Server.Close();
+	}
+
+	void ConnectClients(int Num)
+	{
+		for(int i = 0; i < Num; i++)
+		{
+			NETADDR BindAddr = {};
+			BindAddr.type = NETTYPE_IPV4;
+			NETSOCKET Socket = net_udp_create(BindAddr);
+			ASSERT_TRUE(Socket);
+			m_vClients.push_back(Socket);
+
+			// vanilla connect without anti spoof is accepted right away
+			CNetBase::SendControlMsg(Socket, &m_ServerAddr, 0, NET_CTRLMSG_CONNECT, nullptr, 0, NET_SECURITY_TOKEN_UNSUPPORTED);
+		}
+		Drain();
+
+		// find out the client ports from the slot addresses
+		for(int i = 0; i < Num; i++)
+		{
+			ASSERT_EQ(m_Server.ClientAddr(i)->type, NETTYPE_IPV4);
+			m_vClientAddrs.push_back(*m_Server.ClientAddr(i));
+		}
+	}
+
+	static void SendChunk(NETSOCKET Socket, const NETADDR *pAddr, int Value)
+	{
+		CNetPacketConstruct Construct;
+		mem_zero(&Construct, sizeof(Construct));
+		CNetChunkHeader Header;
+		Header.m_Flags = 0;
+		Header.m_Size = sizeof(Value);
+		Header.m_Sequence = 0;
+		unsigned char *pData = Header.Pack(Construct.m_aChunkData);
+		mem_copy(pData, &Value, sizeof(Value));
+		Construct.m_DataSize = (int)(pData + sizeof(Value) - Construct.m_aChunkData);
+		Construct.m_NumChunks = 1;
+		CNetBase::SendPacket(Socket, (NETADDR *)pAddr, &Construct, NET_SECURITY_TOKEN_UNSUPPORTED);
+	}
+
+	struct CReceived
+	{
+		int m_ClientID;
+		NETADDR m_Address;
+		int m_Value;
+	};
+
+	// receives until no packet arrives for IdleWait microseconds
+	std::vector<CReceived> Drain(int Expected = 0, int IdleWait = 50000)
+	{
+		std::vector<CReceived> vChunks;
+		CNetChunk Chunk;
+		SECURITY_TOKEN ResponseToken;
+		while(true)
+		{
+			while(m_Server.Recv(&Chunk, &ResponseToken))
+			{
+				// the chunk data is only valid until the next Recv
+				CReceived Received = {Chunk.m_ClientID, Chunk.m_Address, -1};
+				if(Chunk.m_DataSize == sizeof(int))
+					mem_copy(&Received.m_Value, Chunk.m_pData, sizeof(int));
+				vChunks.push_back(Received);
+			}
+			const int Timeout = (int)vChunks.size() < Expected ? 1000000 : IdleWait;
+			if(!net_socket_read_wait(m_Server.Socket(), Timeout))
+				break;
+		}
+		return vChunks;
+	}
+
+	int SlotOf(const NETADDR &Addr) const
+	{
+		for(int i = 0; i < (int)m_vClientAddrs.size(); i++)
+			if(m_vClientAddrs[i] == Addr)
+				return i;
+		return -1;
+	}
+};
+
+TEST_F(NetServer, ChunksArriveFromTheirSlot)
+{
+	ConnectClients(NET_MAX_CLIENTS);
+
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		int Slot = SlotOf(m_vClientAddrs[i]);
+		ASSERT_EQ(Slot, i);
+	}
+
+	// every socket sends its own index
+	for(int i = 0; i < (int)m_vClients.size(); i++)
+		SendChunk(m_vClients[i], &m_ServerAddr, i);
+	std::vector<CReceived> vChunks = Drain(NET_MAX_CLIENTS);
+	ASSERT_EQ((int)vChunks.size(), NET_MAX_CLIENTS);
+
+	// the same socket always ends up in the same slot
+	std::vector<int> vSlotOfSocket(NET_MAX_CLIENTS, -1);
+	for(const auto &Chunk : vChunks)
+	{
+		const int Socket = Chunk.m_Value;
+		ASSERT_GE(Socket, 0);
+		ASSERT_GE(Chunk.m_ClientID, 0);
+		EXPECT_EQ(vSlotOfSocket[Socket], -1);
+		vSlotOfSocket[Socket] = Chunk.m_ClientID;
+		EXPECT_EQ(*m_Server.ClientAddr(Chunk.m_ClientID), Chunk.m_Address);
+	}
+
+	// dropped clients are no longer found
+	m_Server.Drop(vSlotOfSocket[5], "test");
+	SendChunk(m_vClients[5], &m_ServerAddr, 5);
+	SendChunk(m_vClients[6], &m_ServerAddr, 6);
+	vChunks = Drain(1);
+	ASSERT_EQ((int)vChunks.size(), 1);
+	EXPECT_EQ(vChunks[0].m_ClientID, vSlotOfSocket[6]);
+}
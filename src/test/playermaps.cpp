@@ -0,0 +1,333 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/gamecore.h>
+#include <game/server/playermaps.h>
+#include <game/teamscore.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// synthetic stand-in for the server's players
+struct SPlayer
+{
+	bool m_Ingame;
+	bool m_HasCharacter;
+	bool m_Super;
+	bool m_Paused;
+	bool m_Spectator;
+	int m_ClientVersion;
+	int m_ShowOthers;
+	vec2 m_ViewPos;
+	vec2 m_Pos;
+	vec2 m_Vel;
+};
+
+class PlayerMaps : public ::testing::Test
+{
+protected:
+	SPlayer m_aPlayers[MAX_CLIENTS];
+	CTeamsCore m_Teams;
+	CTestPrng m_Prng;
+
+	void SetUp() override
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			SPlayer &Player = m_aPlayers[i];
+			Player.m_Ingame = m_Prng.RandomBits() % 16 != 0;
+			Player.m_HasCharacter = m_Prng.RandomBits() % 8 != 0;
+			Player.m_Super = m_Prng.RandomBits() % 32 == 0;
+			Player.m_Paused = m_Prng.RandomBits() % 32 == 0;
+			Player.m_Spectator = m_Prng.RandomBits() % 16 == 0;
+			const int aVersions[] = {VERSION_VANILLA, VERSION_DDRACE, VERSION_DDNET_OLD};
+			Player.m_ClientVersion = aVersions[m_Prng.RandomBits() % 3];
+			Player.m_ShowOthers = m_Prng.RandomBits() % 3;
+			Player.m_Pos = vec2(m_Prng.RandomFloat(0.0f, 8000.0f), m_Prng.RandomFloat(0.0f, 4000.0f));
+			Player.m_ViewPos = Player.m_Pos;
+			Player.m_Vel = vec2(m_Prng.RandomFloat(-20.0f, 20.0f), m_Prng.RandomFloat(-20.0f, 20.0f));
+			m_Teams.Team(i, m_Prng.RandomBits() % 4);
+			m_Teams.SetSolo(i, m_Prng.RandomBits() % 8 == 0);
+		}
+	}
+
+	// a few ticks of running around, bouncing off the edges of the map
+	void Move(int Ticks)
+	{
+		for(auto &Player : m_aPlayers)
+		{
+			for(int i = 0; i < Ticks; i++)
+			{
+				Player.m_Pos += Player.m_Vel;
+				if(Player.m_Pos.x < 0.0f || Player.m_Pos.x > 8000.0f)
+					Player.m_Vel.x = -Player.m_Vel.x;
+				if(Player.m_Pos.y < 0.0f || Player.m_Pos.y > 4000.0f)
+					Player.m_Vel.y = -Player.m_Vel.y;
+			}
+			Player.m_ViewPos = Player.m_Pos;
+		}
+	}
+
+	void Collect(CPlayerMaps *pPlayerMaps) const
+	{
+		pPlayerMaps->Reset();
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			const SPlayer &Player = m_aPlayers[i];
+			CPlayerMaps::CClient &Client = pPlayerMaps->m_aClients[i];
+			if(!Player.m_Ingame)
+				continue;
+			Client.m_ViewPos = Player.m_ViewPos;
+			if(!Player.m_HasCharacter)
+			{
+				Client.m_State = CPlayerMaps::STATE_NO_CHARACTER;
+				continue;
+			}
+			Client.m_State = CPlayerMaps::STATE_CHARACTER;
+			Client.m_Pos = Player.m_Pos;
+			if(Player.m_Super || Player.m_Paused || Player.m_Spectator)
+				continue;
+			if(Player.m_ClientVersion == VERSION_VANILLA)
+				Client.m_Show = CPlayerMaps::SHOW_COLLIDING;
+			else if(Player.m_ClientVersion >= VERSION_DDRACE && Player.m_ShowOthers == SHOW_OTHERS_OFF)
+				Client.m_Show = CPlayerMaps::SHOW_COLLIDING;
+			else if(Player.m_ClientVersion >= VERSION_DDRACE && Player.m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
+				Client.m_Show = CPlayerMaps::SHOW_COLLIDING_OR_TEAM;
+		}
+	}
+
+	// the chunk of CCharacter::Snap() deciding whether i sees j
+	bool IsHidden(int i, int j) const
+	{
+		const SPlayer &Snap = m_aPlayers[i];
+		return Snap.m_HasCharacter && !Snap.m_Super && !Snap.m_Paused && !Snap.m_Spectator &&
+		       !m_Teams.CanCollide(j, i) &&
+		       (Snap.m_ClientVersion == VERSION_VANILLA ||
+			       (Snap.m_ClientVersion >= VERSION_DDRACE &&
+				       (Snap.m_ShowOthers == SHOW_OTHERS_OFF ||
+					       (Snap.m_ShowOthers == SHOW_OTHERS_ONLY_TEAM && !m_Teams.SameTeam(i, j)))));
+	}
+
+	// the per client loop that CGameWorld::UpdatePlayerMaps used to have
+	int ReferenceUpdateMap(int i, int *pMap) const
+	{
+		int aOldMap[VANILLA_MAX_CLIENTS];
+		mem_copy(aOldMap, pMap, sizeof(aOldMap));
+
+		std::pair<float, int> Dist[MAX_CLIENTS];
+		for(int j = 0; j < MAX_CLIENTS; j++)
+		{
+			Dist[j].second = j;
+			if(!m_aPlayers[j].m_Ingame)
+			{
+				Dist[j].first = 1e10;
+				continue;
+			}
+			if(!m_aPlayers[j].m_HasCharacter)
+			{
+				Dist[j].first = 1e9;
+				continue;
+			}
+			if(IsHidden(i, j))
+				Dist[j].first = 1e8;
+			else
+				Dist[j].first = 0;
+
+			Dist[j].first += distance(m_aPlayers[i].m_ViewPos, m_aPlayers[j].m_Pos);
+		}
+
+		Dist[i].first = 0;
+
+		int aReverseMap[MAX_CLIENTS];
+		for(int &j : aReverseMap)
+			j = -1;
+		for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+		{
+			if(pMap[j] == -1)
+				continue;
+			if(Dist[pMap[j]].first > 5e9f)
+				pMap[j] = -1;
+			else
+				aReverseMap[pMap[j]] = j;
+		}
+
+		std::nth_element(&Dist[0], &Dist[VANILLA_MAX_CLIENTS - 1], &Dist[MAX_CLIENTS], [](std::pair<float, int> a, std::pair<float, int> b) { return a.first < b.first; });
+
+		int Mapc = 0;
+		int Demand = 0;
+		for(int j = 0; j < VANILLA_MAX_CLIENTS - 1; j++)
+		{
+			int k = Dist[j].second;
+			if(aReverseMap[k] != -1 || Dist[j].first > 5e9f)
+				continue;
+			while(Mapc < VANILLA_MAX_CLIENTS && pMap[Mapc] != -1)
+				Mapc++;
+			if(Mapc < VANILLA_MAX_CLIENTS - 1)
+				pMap[Mapc] = k;
+			else
+				Demand++;
+		}
+		for(int j = MAX_CLIENTS - 1; j > VANILLA_MAX_CLIENTS - 2; j--)
+		{
+			int k = Dist[j].second;
+			if(aReverseMap[k] != -1 && Demand-- > 0)
+				pMap[aReverseMap[k]] = -1;
+		}
+		pMap[VANILLA_MAX_CLIENTS - 1] = -1;
+
+		int NumChanged = 0;
+		for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+			if(pMap[j] != aOldMap[j])
+				NumChanged++;
+		return NumChanged;
+	}
+};
+
+static void InitMaps(int (*paMaps)[VANILLA_MAX_CLIENTS])
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+			paMaps[i][j] = -1;
+		paMaps[i][0] = i;
+	}
+}
+
+TEST_F(PlayerMaps, MapsClosestPlayers)
+{
+	int aaMaps[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+	InitMaps(aaMaps);
+
+	CPlayerMaps Maps;
+	for(int Update = 0; Update < 500; Update++)
+	{
+		// let players join, leave and die now and then
+		SPlayer &Player = m_aPlayers[m_Prng.RandomBits() % MAX_CLIENTS];
+		if(m_Prng.RandomBits() % 2)
+			Player.m_Ingame = !Player.m_Ingame;
+		else
+			Player.m_HasCharacter = !Player.m_HasCharacter;
+		Move(5);
+
+		Collect(&Maps);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_aPlayers[i].m_Ingame)
+				continue;
+			// players only get the ids freed by the previous update
+			Maps.UpdateMap(i, aaMaps[i], &m_Teams, 0.0f);
+			Maps.UpdateMap(i, aaMaps[i], &m_Teams, 0.0f);
+
+			// rank the players like CGameWorld::UpdatePlayerMaps used to
+			std::vector<std::pair<double, int>> vRanking;
+			for(int j = 0; j < MAX_CLIENTS; j++)
+			{
+				if(j == i)
+					continue;
+				if(!m_aPlayers[j].m_Ingame)
+					continue;
+				double Dist = m_aPlayers[j].m_HasCharacter ? distance(m_aPlayers[i].m_ViewPos, m_aPlayers[j].m_Pos) : 1e9;
+				if(m_aPlayers[j].m_HasCharacter && IsHidden(i, j))
+					Dist += 1e8;
+				vRanking.emplace_back(Dist, j);
+			}
+			std::sort(vRanking.begin(), vRanking.end());
+
+			bool aMapped[MAX_CLIENTS] = {false};
+			for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+			{
+				int Mapped = aaMaps[i][j];
+				if(Mapped == -1)
+					continue;
+				ASSERT_TRUE(m_aPlayers[Mapped].m_Ingame);
+				ASSERT_FALSE(aMapped[Mapped]) << "client " << Mapped << " mapped twice";
+				aMapped[Mapped] = true;
+			}
+			ASSERT_EQ(aaMaps[i][VANILLA_MAX_CLIENTS - 1], -1);
+			ASSERT_TRUE(aMapped[i]);
+			for(int j = 0; j < (int)vRanking.size() && j < VANILLA_MAX_CLIENTS - 2; j++)
+				ASSERT_TRUE(aMapped[vRanking[j].second]) << "update " << Update << " client " << i << " misses " << vRanking[j].second;
+		}
+	}
+}
+
+TEST_F(PlayerMaps, UniqueIds)
+{
+	int aaMaps[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+	InitMaps(aaMaps);
+
+	CPlayerMaps Maps;
+	for(int Update = 0; Update < 500; Update++)
+	{
+		Move(5);
+		Collect(&Maps);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_aPlayers[i].m_Ingame)
+				continue;
+			Maps.UpdateMap(i, aaMaps[i], &m_Teams, 256.0f);
+
+			bool aMapped[MAX_CLIENTS] = {false};
+			for(int j = 0; j < VANILLA_MAX_CLIENTS; j++)
+			{
+				int Mapped = aaMaps[i][j];
+				if(Mapped == -1)
+					continue;
+				ASSERT_FALSE(aMapped[Mapped]) << "client " << Mapped << " mapped twice";
+				aMapped[Mapped] = true;
+			}
+			ASSERT_TRUE(aMapped[i]);
+		}
+	}
+}
+
+TEST_F(PlayerMaps, FewerRemaps)
+{
+	const int NumUpdates = 100;
+	const int aNumVanilla[] = {MAX_CLIENTS, 8};
+	for(int NumVanilla : aNumVanilla)
+	{
+		int aRemaps[2];
+		for(int Run = 0; Run < 2; Run++)
+		{
+			// 64 connected players, some of them with vanilla clients
+			m_Prng = CTestPrng();
+			SetUp();
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				m_aPlayers[i].m_Ingame = true;
+				m_aPlayers[i].m_ClientVersion = i < NumVanilla ? VERSION_VANILLA : VERSION_DDNET_OLD;
+			}
+
+			int aaMaps[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+			InitMaps(aaMaps);
+			CPlayerMaps Maps;
+			aRemaps[Run] = 0;
+			for(int Update = 0; Update < NumUpdates; Update++)
+			{
+				Move(5);
+				if(Run == 0)
+				{
+					// the old code updated the maps of all clients
+					for(int i = 0; i < MAX_CLIENTS; i++)
+					{
+						int Remaps = ReferenceUpdateMap(i, aaMaps[i]);
+						if(i < NumVanilla)
+							aRemaps[Run] += Remaps;
+					}
+				}
+				else
+				{
+					Collect(&Maps);
+					for(int i = 0; i < NumVanilla; i++)
+						aRemaps[Run] += Maps.UpdateMap(i, aaMaps[i], &m_Teams, 256.0f);
+				}
+			}
+		}
+
+		// the hysteresis keeps ids of players that are about as close
+		EXPECT_LT(aRemaps[1], aRemaps[0]) << "vanilla=" << NumVanilla;
+	}
+}
@@ -241,7 +241,7 @@ struct TeamScore : public Score
 {
 	void SetUp() override
 	{
-		CSqlTeamScoreData teamScoreData;
+		CSqlTeamScoreData teamScoreData(nullptr);
 		str_copy(teamScoreData.m_aMap, "Kobra 3", sizeof(teamScoreData.m_aMap));
 		str_copy(teamScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(teamScoreData.m_aGameUuid));
 		teamScoreData.m_Size = 2;
@@ -0,0 +1,445 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <engine/server/databases/connection.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/shared/config.h>
+#include <game/server/scorecache.h>
+
+#include <algorithm>
+#include <set>
+
+struct ScoreCache : public testing::Test
+{
+	ScoreCache()
+	{
+		g_Config.m_SvHideScore = 0;
+		str_copy(m_PlayerRequest.m_aMap, "Kobra 3", sizeof(m_PlayerRequest.m_aMap));
+		str_copy(m_PlayerRequest.m_aRequestingPlayer, "brainless tee", sizeof(m_PlayerRequest.m_aRequestingPlayer));
+		m_PlayerRequest.m_Offset = 0;
+		str_copy(m_PlayerRequest.m_aServer, "GER", sizeof(m_PlayerRequest.m_aServer));
+		str_copy(m_PlayerRequest.m_aName, "nameless tee", sizeof(m_PlayerRequest.m_aName));
+	}
+
+	void AddTeamFinish(std::vector<std::string> vNames, float Time)
+	{
+		m_Cache.AddTeamFinish({RandomUuid(), std::move(vNames), Time});
+	}
+
+	void ExpectLines(std::initializer_list<const char *> Lines, bool All = false)
+	{
+		EXPECT_EQ(m_pPlayerResult->m_MessageKind, All ? CScorePlayerResult::ALL : CScorePlayerResult::DIRECT);
+
+		int i = 0;
+		for(const char *pLine : Lines)
+		{
+			EXPECT_STREQ(m_pPlayerResult->m_Data.m_aaMessages[i], pLine);
+			i++;
+		}
+
+		for(; i < CScorePlayerResult::MAX_MESSAGES; i++)
+		{
+			EXPECT_STREQ(m_pPlayerResult->m_Data.m_aaMessages[i], "");
+		}
+	}
+
+	CScoreCache m_Cache;
+	std::shared_ptr<CScorePlayerResult> m_pPlayerResult{std::make_shared<CScorePlayerResult>()};
+	CSqlPlayerRequest m_PlayerRequest{m_pPlayerResult};
+};
+
+// the same results as the SingleScore tests of the database
+struct SingleScoreCache : public ScoreCache
+{
+	SingleScoreCache()
+	{
+		m_Cache.AddFinish({"nameless tee", "USA", 100.0f});
+	}
+};
+
+TEST_F(SingleScoreCache, Top)
+{
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"1. nameless tee Time: 01:40.00",
+		"------------ GER Top ------------"});
+}
+
+TEST_F(SingleScoreCache, Rank)
+{
+	ASSERT_TRUE(m_Cache.ShowRank(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"nameless tee - 01:40.00 - better than 100% - requested by brainless tee", "Global rank 1 - GER unranked"}, true);
+}
+
+TEST_F(SingleScoreCache, TopServer)
+{
+	str_copy(m_PlayerRequest.m_aServer, "USA", sizeof(m_PlayerRequest.m_aServer));
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"1. nameless tee Time: 01:40.00",
+		"------------ USA Top ------------",
+		"1. nameless tee Time: 01:40.00"});
+}
+
+TEST_F(SingleScoreCache, RankServer)
+{
+	str_copy(m_PlayerRequest.m_aServer, "USA", sizeof(m_PlayerRequest.m_aServer));
+	ASSERT_TRUE(m_Cache.ShowRank(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"nameless tee - 01:40.00 - better than 100% - requested by brainless tee", "Global rank 1 - USA rank 1"}, true);
+}
+
+TEST_F(SingleScoreCache, UnknownPlayer)
+{
+	// the name column has a binary collation, names differing in case are
+	// different players
+	str_copy(m_PlayerRequest.m_aName, "Nameless Tee", sizeof(m_PlayerRequest.m_aName));
+	ASSERT_TRUE(m_Cache.ShowRank(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"Nameless Tee is not ranked"});
+}
+
+TEST_F(ScoreCache, RankTies)
+{
+	m_Cache.AddFinish({"a", "GER", 100.0f});
+	m_Cache.AddFinish({"b", "USA", 100.0f});
+	m_Cache.AddFinish({"nameless tee", "GER", 120.0f});
+	m_Cache.AddFinish({"c", "GER", 130.0f});
+	EXPECT_EQ(m_Cache.NumPlayers(), 4);
+
+	ASSERT_TRUE(m_Cache.ShowRank(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"nameless tee - 02:00.00 - better than 33% - requested by brainless tee", "Global rank 3 - GER rank 2"}, true);
+
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"1. a Time: 01:40.00",
+		"1. b Time: 01:40.00",
+		"3. nameless tee Time: 02:00.00",
+		"4. c Time: 02:10.00",
+		"------------ GER Top ------------",
+		"1. a Time: 01:40.00",
+		"2. nameless tee Time: 02:00.00",
+		"3. c Time: 02:10.00"});
+}
+
+TEST_F(ScoreCache, Improve)
+{
+	m_Cache.AddFinish({"a", "GER", 100.0f});
+	m_Cache.AddFinish({"nameless tee", "GER", 120.0f});
+	m_Cache.AddFinish({"nameless tee", "GER", 130.0f});
+	m_Cache.AddFinish({"nameless tee", "USA", 90.004f});
+	EXPECT_EQ(m_Cache.NumPlayers(), 2);
+
+	ASSERT_TRUE(m_Cache.ShowRank(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"nameless tee - 01:30.00 - better than 100% - requested by brainless tee", "Global rank 1 - GER rank 2"}, true);
+}
+
+TEST_F(ScoreCache, TopOffset)
+{
+	for(int i = 0; i < 10; i++)
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "tee %d", i);
+		m_Cache.AddFinish({aName, "GER", 100.0f + i});
+	}
+
+	m_PlayerRequest.m_Offset = 4;
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"4. tee 3 Time: 01:43.00",
+		"5. tee 4 Time: 01:44.00",
+		"6. tee 5 Time: 01:45.00",
+		"7. tee 6 Time: 01:46.00",
+		"8. tee 7 Time: 01:47.00",
+		"------------ GER Top ------------",
+		"4. tee 3 Time: 01:43.00",
+		"5. tee 4 Time: 01:44.00",
+		"6. tee 5 Time: 01:45.00"});
+
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	m_PlayerRequest.m_Offset = -1;
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"10. tee 9 Time: 01:49.00",
+		"9. tee 8 Time: 01:48.00",
+		"8. tee 7 Time: 01:47.00",
+		"7. tee 6 Time: 01:46.00",
+		"6. tee 5 Time: 01:45.00",
+		"------------ GER Top ------------",
+		"10. tee 9 Time: 01:49.00",
+		"9. tee 8 Time: 01:48.00",
+		"8. tee 7 Time: 01:47.00"});
+}
+
+TEST_F(ScoreCache, TeamTop5)
+{
+	AddTeamFinish({"nameless tee", "brainless tee"}, 100.0f);
+	ASSERT_TRUE(m_Cache.ShowTeamTop5(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------- Team Top 5 -------",
+		"1. brainless tee & nameless tee Team Time: 01:40.00",
+		"-------------------------------"});
+}
+
+TEST_F(ScoreCache, TeamTop5Improve)
+{
+	AddTeamFinish({"nameless tee", "brainless tee"}, 100.0f);
+	AddTeamFinish({"a", "b", "c"}, 90.0f);
+	AddTeamFinish({"brainless tee", "nameless tee"}, 80.0f);
+	AddTeamFinish({"brainless tee", "nameless tee"}, 85.0f);
+	AddTeamFinish({"a", "b"}, 95.0f);
+	EXPECT_EQ(m_Cache.NumTeams(), 3);
+
+	ASSERT_TRUE(m_Cache.ShowTeamTop5(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------- Team Top 5 -------",
+		"1. brainless tee & nameless tee Team Time: 01:20.00",
+		"2. a, b & c Team Time: 01:30.00",
+		"3. a & b Team Time: 01:35.00",
+		"-------------------------------"});
+}
+
+TEST_F(ScoreCache, Empty)
+{
+	ASSERT_TRUE(m_Cache.ShowTop(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------------ Global Top ------------",
+		"------------ GER Top ------------"});
+
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_TRUE(m_Cache.ShowTeamTop5(&m_PlayerRequest, m_pPlayerResult.get()));
+	ExpectLines({"------- Team Top 5 -------",
+		"-------------------------------"});
+}
+
+// fills an SQLite database with the CScoreWorker functions that save
+// finishes and compares the cache loaded from it with the queries
+struct ScoreCacheDatabase : public testing::Test
+{
+	std::unique_ptr<IDbConnection> m_pConn{CreateSqliteConnection(":memory:", false)};
+	char m_aError[256] = {};
+	CTestPrng m_Prng;
+	// the finish times are unique, ties are ordered differently
+	std::set<int> m_UsedTimes;
+	std::vector<std::string> m_vNames;
+
+	ScoreCacheDatabase()
+	{
+		g_Config.m_SvHideScore = 0;
+		for(int i = 0; i < 30; i++)
+		{
+			char aName[16];
+			str_format(aName, sizeof(aName), "tee %d", i);
+			m_vNames.emplace_back(aName);
+			// the same name in another case is another player
+			if(i % 5 == 0)
+			{
+				str_format(aName, sizeof(aName), "Tee %d", i);
+				m_vNames.emplace_back(aName);
+			}
+		}
+
+		EXPECT_FALSE(m_pConn->Connect(m_aError, sizeof(m_aError))) << m_aError;
+		// the columns used by the functions in the test, with the
+		// collations of the real tables
+		char aCheckpoints[1024] = "";
+		for(int i = 1; i <= 25; i++)
+		{
+			char aCheckpoint[32];
+			str_format(aCheckpoint, sizeof(aCheckpoint), "cp%d FLOAT DEFAULT 0, ", i);
+			str_append(aCheckpoints, aCheckpoint, sizeof(aCheckpoints));
+		}
+		char aRace[2048];
+		str_format(aRace, sizeof(aRace),
+			"CREATE TABLE record_race ("
+			"  Map VARCHAR(128) COLLATE BINARY NOT NULL, Name VARCHAR(16) COLLATE BINARY NOT NULL, "
+			"  Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Time FLOAT DEFAULT 0, Server CHAR(4), "
+			"  %s GameID VARCHAR(64), DDNet7 BOOL DEFAULT FALSE)",
+			aCheckpoints);
+		Execute(aRace);
+		Execute("CREATE TABLE record_teamrace ("
+			"  Map VARCHAR(128) COLLATE BINARY NOT NULL, Name VARCHAR(16) COLLATE BINARY NOT NULL, "
+			"  Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Time FLOAT DEFAULT 0, "
+			"  ID BLOB NOT NULL, GameID VARCHAR(64), DDNet7 BOOL DEFAULT FALSE, PRIMARY KEY (ID, Name))");
+		Execute("CREATE TABLE record_maps (Map VARCHAR(128) COLLATE BINARY NOT NULL, Points INT DEFAULT 0)");
+	}
+
+	~ScoreCacheDatabase()
+	{
+		m_pConn->Disconnect();
+	}
+
+	void Execute(const char *pStmt)
+	{
+		int NumUpdated;
+		ASSERT_FALSE(m_pConn->PrepareStatement(pStmt, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_FALSE(m_pConn->ExecuteUpdate(&NumUpdated, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	unsigned Random(unsigned Max)
+	{
+		return m_Prng.RandomBits() % Max;
+	}
+
+	float RandomTime()
+	{
+		int Centiseconds;
+		do
+			Centiseconds = 3000 + Random(20000);
+		while(!m_UsedTimes.insert(Centiseconds).second);
+		return Centiseconds / 100.0f;
+	}
+
+	CScoreCache::CFinish RandomFinish()
+	{
+		static const char *s_apServers[] = {"GER", "GER2", "USA", "CHN"};
+		return {m_vNames[Random(m_vNames.size())], s_apServers[Random(4)], RandomTime()};
+	}
+
+	CScoreCache::CTeamFinish RandomTeamFinish()
+	{
+		// few names so that teams finish again
+		std::vector<std::string> vNames(m_vNames.begin(), m_vNames.begin() + 6);
+		for(int i = vNames.size() - 1; i > 0; i--)
+			std::swap(vNames[i], vNames[Random(i + 1)]);
+		vNames.resize(2 + Random(2));
+		return {RandomUuid(), vNames, RandomTime()};
+	}
+
+	void SaveFinish(const CScoreCache::CFinish &Finish)
+	{
+		str_copy(g_Config.m_SvSqlServerName, Finish.m_Server.c_str(), sizeof(g_Config.m_SvSqlServerName));
+		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+		str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+		str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+		str_copy(ScoreData.m_aName, Finish.m_Name.c_str(), sizeof(ScoreData.m_aName));
+		ScoreData.m_ClientID = 0;
+		ScoreData.m_Time = Finish.m_Time;
+		str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+		for(float &Time : ScoreData.m_aCurrentTimeCp)
+			Time = 0.0f;
+		ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn.get(), &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	void SaveTeamFinish(const CScoreCache::CTeamFinish &Finish)
+	{
+		CSqlTeamScoreData ScoreData(nullptr);
+		str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+		str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+		ScoreData.m_Time = Finish.m_Time;
+		str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+		ScoreData.m_Size = Finish.m_vNames.size();
+		for(unsigned i = 0; i < ScoreData.m_Size; i++)
+			str_copy(ScoreData.m_aaNames[i], Finish.m_vNames[i].c_str(), sizeof(ScoreData.m_aaNames[i]));
+		ScoreData.m_TeamrankUuid = Finish.m_TeamID;
+		ASSERT_FALSE(CScoreWorker::SaveTeamScore(m_pConn.get(), &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	std::shared_ptr<CScoreCacheResult> Load()
+	{
+		auto pResult = std::make_shared<CScoreCacheResult>();
+		CSqlScoreCacheRequest Request(pResult);
+		str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+		EXPECT_FALSE(CScoreCache::Load(m_pConn.get(), &Request, m_aError, sizeof(m_aError))) << m_aError;
+		return pResult;
+	}
+
+	std::shared_ptr<CScorePlayerResult> Request(std::unique_ptr<CSqlPlayerRequest> *ppRequest, const char *pName, int Offset)
+	{
+		auto pResult = std::make_shared<CScorePlayerResult>();
+		*ppRequest = std::make_unique<CSqlPlayerRequest>(pResult);
+		CSqlPlayerRequest *pRequest = ppRequest->get();
+		str_copy(pRequest->m_aName, pName, sizeof(pRequest->m_aName));
+		str_copy(pRequest->m_aMap, "Kobra 3", sizeof(pRequest->m_aMap));
+		str_copy(pRequest->m_aRequestingPlayer, "brainless tee", sizeof(pRequest->m_aRequestingPlayer));
+		pRequest->m_Offset = Offset;
+		str_copy(pRequest->m_aServer, "GER", sizeof(pRequest->m_aServer));
+		return pResult;
+	}
+
+	void Compare(const CScoreCache &Cache, bool (*pfnWorker)(IDbConnection *, const ISqlData *, char *, int),
+		bool (CScoreCache::*pfnCache)(const CSqlPlayerRequest *, CScorePlayerResult *) const, const char *pName, int Offset)
+	{
+		std::unique_ptr<CSqlPlayerRequest> pRequest;
+		std::shared_ptr<CScorePlayerResult> pExpected = Request(&pRequest, pName, Offset);
+		ASSERT_FALSE(pfnWorker(m_pConn.get(), pRequest.get(), m_aError, sizeof(m_aError))) << m_aError;
+		std::shared_ptr<CScorePlayerResult> pResult = Request(&pRequest, pName, Offset);
+		ASSERT_TRUE((Cache.*pfnCache)(pRequest.get(), pResult.get()));
+
+		EXPECT_EQ(pResult->m_MessageKind, pExpected->m_MessageKind) << "name=" << pName << " offset=" << Offset;
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(pResult->m_Data.m_aaMessages[i], pExpected->m_Data.m_aaMessages[i]) << "name=" << pName << " offset=" << Offset;
+	}
+
+	void CompareAll(const CScoreCache &Cache)
+	{
+		for(const auto &Name : m_vNames)
+			Compare(Cache, CScoreWorker::ShowRank, &CScoreCache::ShowRank, Name.c_str(), 0);
+		Compare(Cache, CScoreWorker::ShowRank, &CScoreCache::ShowRank, "unknown tee", 0);
+		for(int Offset : {0, 1, 3, 8, 30, -1, -4, 100})
+		{
+			Compare(Cache, CScoreWorker::ShowTop, &CScoreCache::ShowTop, "", Offset);
+			Compare(Cache, CScoreWorker::ShowTeamTop5, &CScoreCache::ShowTeamTop5, "", Offset);
+		}
+	}
+};
+
+TEST_F(ScoreCacheDatabase, MatchesWorker)
+{
+	for(int i = 0; i < 100; i++)
+		SaveFinish(RandomFinish());
+	for(int i = 0; i < 20; i++)
+		SaveTeamFinish(RandomTeamFinish());
+
+	std::shared_ptr<CScoreCacheResult> pResult = Load();
+	CScoreCache &Cache = pResult->m_Cache;
+	CompareAll(Cache);
+
+	// the regional ranking is built by now and updated by AddFinish
+	for(int i = 0; i < 50; i++)
+	{
+		CScoreCache::CFinish Finish = RandomFinish();
+		SaveFinish(Finish);
+		Cache.AddFinish(Finish);
+		CScoreCache::CTeamFinish TeamFinish = RandomTeamFinish();
+		SaveTeamFinish(TeamFinish);
+		Cache.AddTeamFinish(TeamFinish);
+		if(i % 10 == 0)
+			CompareAll(Cache);
+	}
+	CompareAll(Cache);
+}
+
+TEST_F(ScoreCacheDatabase, PendingFinishes)
+{
+	std::vector<CScoreCache::CFinish> vFinishes;
+	std::vector<CScoreCache::CTeamFinish> vTeamFinishes;
+	for(int i = 0; i < 60; i++)
+	{
+		vFinishes.push_back(RandomFinish());
+		SaveFinish(vFinishes.back());
+	}
+	for(int i = 0; i < 15; i++)
+	{
+		vTeamFinishes.push_back(RandomTeamFinish());
+		SaveTeamFinish(vTeamFinishes.back());
+	}
+
+	// the last finishes were saved while the cache was loading, but were
+	// written before it read them
+	std::shared_ptr<CScoreCacheResult> pResult = Load();
+	pResult->m_vPendingFinishes.assign(vFinishes.end() - 10, vFinishes.end());
+	pResult->m_vPendingTeamFinishes.assign(vTeamFinishes.end() - 5, vTeamFinishes.end());
+	// and these after it
+	for(int i = 0; i < 20; i++)
+	{
+		pResult->m_vPendingFinishes.push_back(RandomFinish());
+		SaveFinish(pResult->m_vPendingFinishes.back());
+	}
+	for(int i = 0; i < 5; i++)
+	{
+		pResult->m_vPendingTeamFinishes.push_back(RandomTeamFinish());
+		SaveTeamFinish(pResult->m_vPendingTeamFinishes.back());
+	}
+
+	pResult->AddPendingFinishes();
+	EXPECT_TRUE(pResult->m_vPendingFinishes.empty());
+	EXPECT_TRUE(pResult->m_vPendingTeamFinishes.empty());
+	CompareAll(pResult->m_Cache);
+}
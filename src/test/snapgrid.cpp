@@ -0,0 +1,126 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/snapgrid.h>
+
+#include <cmath>
+#include <vector>
+
+struct SBox
+{
+	vec2 m_Min;
+	vec2 m_Max;
+};
+
+static bool Overlaps(const SBox &Box, vec2 Min, vec2 Max)
+{
+	return !(Box.m_Max.x < Min.x || Box.m_Min.x > Max.x || Box.m_Max.y < Min.y || Box.m_Min.y > Max.y);
+}
+
+static std::vector<SBox> RandomBoxes(CTestPrng *pPrng, int Num)
+{
+	std::vector<SBox> vBoxes;
+	for(int i = 0; i < Num; i++)
+	{
+		SBox Box;
+		Box.m_Min = vec2(pPrng->RandomFloat(-2000.0f, 16000.0f), pPrng->RandomFloat(-2000.0f, 8000.0f));
+		switch(pPrng->RandomBits() % 8)
+		{
+		case 0: // points like events
+			Box.m_Max = Box.m_Min;
+			break;
+		case 1: // long lasers
+			Box.m_Max = Box.m_Min + vec2(pPrng->RandomFloat(0.0f, 4000.0f), pPrng->RandomFloat(0.0f, 4000.0f));
+			break;
+		case 2: // broken ones
+			Box.m_Max = pPrng->RandomBits() % 2 ? Box.m_Min - vec2(10.0f, 10.0f) : vec2(NAN, Box.m_Min.y);
+			break;
+		default:
+			Box.m_Max = Box.m_Min + vec2(pPrng->RandomFloat(0.0f, 128.0f), pPrng->RandomFloat(0.0f, 128.0f));
+		}
+		vBoxes.push_back(Box);
+	}
+	return vBoxes;
+}
+
+TEST(SnapGrid, MatchesLinearScan)
+{
+	CTestPrng Prng(1);
+	CSnapGrid Grid;
+	std::vector<int> vIndices;
+	int NumFound = 0;
+	for(int Round = 0; Round < 20; Round++)
+	{
+		std::vector<SBox> vBoxes = RandomBoxes(&Prng, 1 + Prng.RandomBits() % 2000);
+		// leave some indices out, like unbounded candidates
+		Grid.Clear();
+		for(int i = 0; i < (int)vBoxes.size(); i++)
+			if(i % 5 != 4)
+				Grid.Add(i, vBoxes[i].m_Min, vBoxes[i].m_Max);
+		Grid.Build();
+
+		for(int Query = 0; Query < 500; Query++)
+		{
+			vec2 Center = vec2(Prng.RandomFloat(-4000.0f, 18000.0f), Prng.RandomFloat(-4000.0f, 10000.0f));
+			vec2 Extent = Query % 50 == 0 ? vec2(50000.0f, 50000.0f) : vec2(Prng.RandomFloat(0.0f, 1500.0f), Prng.RandomFloat(0.0f, 1000.0f));
+			Grid.Query(Center - Extent, Center + Extent, &vIndices);
+
+			std::vector<int> vExpected;
+			for(int i = 0; i < (int)vBoxes.size(); i++)
+				if(i % 5 != 4 && Overlaps(vBoxes[i], Center - Extent, Center + Extent))
+					vExpected.push_back(i);
+			ASSERT_EQ(vIndices, vExpected) << "round " << Round << " query " << Query;
+			NumFound += vIndices.size();
+		}
+	}
+	EXPECT_GT(NumFound, 0);
+}
+
+TEST(SnapGrid, RebuiltEachTick)
+{
+	// a big map with lots of entities, viewed by 64 clients
+	CTestPrng Prng(1);
+	const int NumBoxes = 5000;
+	const int NumViews = 64;
+	const int NumTicks = 3;
+	std::vector<SBox> vBoxes;
+	for(int i = 0; i < NumBoxes; i++)
+	{
+		// mostly small entities and some lasers
+		SBox Box;
+		Box.m_Min = vec2(Prng.RandomFloat(0.0f, 16000.0f), Prng.RandomFloat(0.0f, 8000.0f));
+		float Size = i % 10 == 0 ? 800.0f : 64.0f;
+		Box.m_Max = Box.m_Min + vec2(Prng.RandomFloat(0.0f, Size), Prng.RandomFloat(0.0f, Size));
+		vBoxes.push_back(Box);
+	}
+	std::vector<vec2> vViews;
+	for(int i = 0; i < NumViews; i++)
+		vViews.push_back(vec2(Prng.RandomFloat(0.0f, 16000.0f), Prng.RandomFloat(0.0f, 8000.0f)));
+	const vec2 ShowDistance = vec2(1200.0f, 1200.0f);
+
+	CSnapGrid Grid;
+	std::vector<int> vIndices;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		// the entities move a bit between the snapshots
+		for(SBox &Box : vBoxes)
+		{
+			Box.m_Min.x += 10.0f;
+			Box.m_Max.x += 10.0f;
+		}
+
+		Grid.Clear();
+		for(int i = 0; i < NumBoxes; i++)
+			Grid.Add(i, vBoxes[i].m_Min, vBoxes[i].m_Max);
+		Grid.Build();
+		for(const vec2 &View : vViews)
+		{
+			int LinearFound = 0;
+			for(const SBox &Box : vBoxes)
+				LinearFound += Overlaps(Box, View - ShowDistance, View + ShowDistance);
+			Grid.Query(View - ShowDistance, View + ShowDistance, &vIndices);
+			ASSERT_EQ((int)vIndices.size(), LinearFound) << "tick " << Tick;
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+#include <game/server/snapitems.h>
+
+#include <cmath>
+#include <vector>
+
+struct SItem
+{
+	CSnapItems::CFilter m_Filter;
+	int m_Type;
+	int m_ID;
+	std::vector<int> m_vData;
+};
+
+static std::vector<SItem> RandomItems(CTestPrng *pPrng, int Num)
+{
+	std::vector<SItem> vItems;
+	for(int i = 0; i < Num; i++)
+	{
+		vec2 Pos = vec2(pPrng->RandomFloat(-2000.0f, 16000.0f), pPrng->RandomFloat(-2000.0f, 8000.0f));
+		vec2 Pos2 = Pos;
+		switch(pPrng->RandomBits() % 8)
+		{
+		case 0: // long lasers
+			Pos2 = Pos + vec2(pPrng->RandomFloat(-4000.0f, 4000.0f), pPrng->RandomFloat(-4000.0f, 4000.0f));
+			break;
+		case 1: // short lasers
+			Pos2 = Pos + vec2(pPrng->RandomFloat(-300.0f, 300.0f), pPrng->RandomFloat(-300.0f, 300.0f));
+			break;
+		case 2: // broken ones
+			Pos2 = vec2(NAN, Pos.y);
+			break;
+		}
+		SItem Item{CSnapItems::CFilter(Pos, Pos2), 1 + (int)(pPrng->RandomBits() % 20), i, {}};
+		if(pPrng->RandomBits() % 2)
+			Item.m_Filter.m_Mask = ((int64_t)pPrng->RandomBits() << 32) | pPrng->RandomBits();
+		switch(pPrng->RandomBits() % 4)
+		{
+		case 0:
+			Item.m_Filter.m_MinVersion = 16000;
+			break;
+		case 1:
+			Item.m_Filter.m_MaxVersion = 16000;
+			break;
+		}
+		Item.m_Filter.m_Sixup = (int)(pPrng->RandomBits() % 3) - 1;
+		int Size = 1 + pPrng->RandomBits() % 8;
+		for(int j = 0; j < Size; j++)
+			Item.m_vData.push_back(pPrng->RandomBits());
+		vItems.push_back(Item);
+	}
+	return vItems;
+}
+
+static std::vector<CSnapItems::CView> RandomViews(CTestPrng *pPrng)
+{
+	std::vector<CSnapItems::CView> vViews;
+	for(int i = -1; i < 64; i++)
+	{
+		CSnapItems::CView View;
+		View.m_ClientID = i;
+		View.m_Version = pPrng->RandomBits() % 2 ? 15000 : 17000;
+		View.m_Sixup = pPrng->RandomBits() % 4 == 0;
+		View.m_ShowAll = pPrng->RandomBits() % 16 == 0;
+		View.m_Pos = vec2(pPrng->RandomFloat(-1000.0f, 15000.0f), pPrng->RandomFloat(-1000.0f, 7000.0f));
+		View.m_ShowDistance = vec2(pPrng->RandomFloat(500.0f, 3000.0f), pPrng->RandomFloat(400.0f, 2000.0f));
+		if(i == 5)
+			View.m_Pos.x = NAN;
+		vViews.push_back(View);
+	}
+	return vViews;
+}
+
+// like NetworkClipped
+static bool Clipped(const CSnapItems::CView &View, vec2 Pos)
+{
+	if(View.m_ClientID < 0 || View.m_ShowAll)
+		return false;
+	return absolute(View.m_Pos.x - Pos.x) > View.m_ShowDistance.x || absolute(View.m_Pos.y - Pos.y) > View.m_ShowDistance.y;
+}
+
+// the checks of the Snap functions, done for every client
+static int PerClientSnapshot(const std::vector<SItem> &vItems, const CSnapItems::CView &View, CSnapshot *pSnap, int *pNumItems)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	*pNumItems = 0;
+	for(const auto &Item : vItems)
+	{
+		const CSnapItems::CFilter &Filter = Item.m_Filter;
+		if(Clipped(View, Filter.m_Pos) && Clipped(View, Filter.m_Pos2))
+			continue;
+		if(View.m_ClientID >= 0 && !(Filter.m_Mask & (1LL << View.m_ClientID)))
+			continue;
+		if(View.m_Version < Filter.m_MinVersion || View.m_Version >= Filter.m_MaxVersion)
+			continue;
+		if(Filter.m_Sixup != -1 && Filter.m_Sixup != (int)View.m_Sixup)
+			continue;
+		void *pData = Builder.NewItem(Item.m_Type, Item.m_ID, Item.m_vData.size() * sizeof(int));
+		mem_copy(pData, Item.m_vData.data(), Item.m_vData.size() * sizeof(int));
+		(*pNumItems)++;
+	}
+	return Builder.Finish(pSnap);
+}
+
+static int SharedSnapshot(CSnapItems *pItems, const CSnapItems::CView &View, CSnapshot *pSnap)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	std::vector<int> vVisible;
+	pItems->Visible(View, &vVisible);
+	for(int i : vVisible)
+	{
+		const CSnapItems::CItem &Item = pItems->Item(i);
+		void *pData = Builder.NewItem(Item.m_Type, Item.m_ID, Item.m_Size);
+		mem_copy(pData, pItems->Data(i), Item.m_Size);
+	}
+	return Builder.Finish(pSnap);
+}
+
+static void ExpectSameSnapshots(bool Grid)
+{
+	CTestPrng Prng;
+	CSnapItems Items;
+	for(int Tick = 0; Tick < 3; Tick++)
+	{
+		std::vector<SItem> vItems = RandomItems(&Prng, 600);
+		std::vector<CSnapItems::CView> vViews = RandomViews(&Prng);
+
+		// the items are rebuilt every tick
+		Items.Clear();
+		for(const auto &Item : vItems)
+		{
+			void *pData = Items.Add(Item.m_Filter, Item.m_Type, Item.m_ID, Item.m_vData.size() * sizeof(int));
+			mem_copy(pData, Item.m_vData.data(), Item.m_vData.size() * sizeof(int));
+		}
+		if(Grid)
+			Items.BuildGrid();
+
+		int TotalVisible = 0;
+		for(const auto &View : vViews)
+		{
+			static char s_aPerClient[CSnapshot::MAX_SIZE];
+			static char s_aShared[CSnapshot::MAX_SIZE];
+			int NumItems;
+			int PerClientSize = PerClientSnapshot(vItems, View, (CSnapshot *)s_aPerClient, &NumItems);
+			int SharedSize = SharedSnapshot(&Items, View, (CSnapshot *)s_aShared);
+			ASSERT_EQ(PerClientSize, SharedSize) << "client " << View.m_ClientID << " tick " << Tick;
+			EXPECT_EQ(mem_comp(s_aPerClient, s_aShared, PerClientSize), 0) << "client " << View.m_ClientID << " tick " << Tick;
+			TotalVisible += NumItems;
+		}
+		// neither nothing nor everything is visible
+		EXPECT_GT(TotalVisible, 0);
+		EXPECT_LT(TotalVisible, (int)(vItems.size() * vViews.size()));
+	}
+}
+
+// sv_snap_shared 1 against 0
+TEST(SnapItems, MatchesPerClient)
+{
+	ExpectSameSnapshots(false);
+}
+
+// sv_snap_shared 2 against 0
+TEST(SnapItems, GridMatchesPerClient)
+{
+	ExpectSameSnapshots(true);
+}
@@ -0,0 +1,361 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+
+#include <climits>
+#include <vector>
+
+static CTestPrng s_Prng;
+
+static int Random(int Max)
+{
+	return s_Prng.RandomBits() % Max;
+}
+
+static int CreateRandomSnapshot(CSnapshot *pSnap, int NumItems, int Version)
+{
+	// items are added in an unsorted order, like the game does
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		int Type = 1 + (i * 7) % 20;
+		int ID = (NumItems - i) * 3;
+		int *pData = (int *)Builder.NewItem(Type, ID, 3 * sizeof(int));
+		if(!pData)
+			break;
+		pData[0] = i;
+		pData[1] = (i % 5 == 0) ? Version : 0;
+		pData[2] = Type * ID;
+	}
+	return Builder.Finish(pSnap);
+}
+
+static bool SnapshotsEqual(const CSnapshot *pA, const CSnapshot *pB)
+{
+	if(pA->NumItems() != pB->NumItems())
+		return false;
+	for(int i = 0; i < pA->NumItems(); i++)
+	{
+		if(pA->GetItem(i)->Key() != pB->GetItem(i)->Key() || pA->GetItemSize(i) != pB->GetItemSize(i))
+			return false;
+		if(mem_comp(pA->GetItem(i)->Data(), pB->GetItem(i)->Data(), pA->GetItemSize(i)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// same delta as CSnapshotDelta::CreateDelta, but with a linear search per item
+static int ReferenceCreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
+{
+	CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+	int *pData = pDelta->m_aData;
+	pDelta->m_NumDeletedItems = 0;
+	pDelta->m_NumUpdateItems = 0;
+	pDelta->m_NumTempItems = 0;
+
+	auto &&Find = [](const CSnapshot *pSnap, int Key) {
+		for(int i = 0; i < pSnap->NumItems(); i++)
+			if(pSnap->GetItem(i)->Key() == Key)
+				return i;
+		return -1;
+	};
+
+	for(int i = 0; i < pFrom->NumItems(); i++)
+	{
+		if(Find(pTo, pFrom->GetItem(i)->Key()) == -1)
+		{
+			*pData++ = pFrom->GetItem(i)->Key();
+			pDelta->m_NumDeletedItems++;
+		}
+	}
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pTo->GetItem(i);
+		const int Size = pTo->GetItemSize(i) / 4;
+		const int PastIndex = Find(pFrom, pItem->Key());
+		int *pItemDataDst = pData + 3;
+		if(PastIndex != -1)
+		{
+			if(!CSnapshotDelta::DiffItem(pFrom->GetItem(PastIndex)->Data(), pItem->Data(), pItemDataDst, Size))
+				continue;
+		}
+		else
+			mem_copy(pItemDataDst, pItem->Data(), Size * 4);
+		*pData++ = pItem->Type();
+		*pData++ = pItem->ID();
+		*pData++ = Size;
+		pData += Size;
+		pDelta->m_NumUpdateItems++;
+	}
+	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems)
+		return 0;
+	return (int)((char *)pData - (char *)pDstData);
+}
+
+// scalar versions of CSnapshotDelta::DiffItem and UndiffItem
+static int ReferenceDiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = pCurrent[i] - pPast[i];
+		Needed |= pOut[i];
+	}
+	return Needed;
+}
+
+static void ReferenceUndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, int *pDataRate)
+{
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = pPast[i] + pDiff[i];
+		if(pDiff[i] == 0)
+			*pDataRate += 1;
+		else
+		{
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[i], sizeof(aBuf));
+			*pDataRate += (int)(pEnd - aBuf) * 8;
+		}
+	}
+}
+
+static int RandomInt()
+{
+	switch(Random(4))
+	{
+	case 0: return Random(1 << 24) * 255 + Random(255);
+	case 1: return Random(100000) - 50000;
+	case 2: return Random(128) - 64;
+	default: return 0;
+	}
+}
+
+TEST(Snapshot, BuilderSortsItems)
+{
+	std::vector<char> vData(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnap = (CSnapshot *)vData.data();
+	int Size = CreateRandomSnapshot(pSnap, 100, 0);
+
+	EXPECT_TRUE(pSnap->IsValid(Size));
+	EXPECT_TRUE(pSnap->IsSorted());
+	EXPECT_EQ(pSnap->NumItems(), 100);
+	for(int i = 0; i < 100; i++)
+	{
+		int Type = 1 + (i * 7) % 20;
+		int ID = (100 - i) * 3;
+		const int *pData = (const int *)pSnap->FindItem(Type, ID);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(pData[0], i);
+		EXPECT_EQ(pData[2], Type * ID);
+	}
+	EXPECT_EQ(pSnap->FindItem(1, 1), nullptr);
+	EXPECT_EQ(pSnap->GetItemIndex(0), -1);
+	EXPECT_EQ(pSnap->GetItemIndex(0x7fffffff), -1);
+}
+
+TEST(Snapshot, UnsortedIsInvalid)
+{
+	std::vector<char> vData(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnap = (CSnapshot *)vData.data();
+	int Size = CreateRandomSnapshot(pSnap, 2, 0);
+	ASSERT_TRUE(pSnap->IsValid(Size));
+
+	// swap the two items
+	int *pItems = (int *)pSnap->GetItem(0);
+	int aTmp[4];
+	mem_copy(aTmp, pItems, sizeof(aTmp));
+	mem_copy(pItems, pItems + 4, sizeof(aTmp));
+	mem_copy(pItems + 4, aTmp, sizeof(aTmp));
+
+	EXPECT_TRUE(pSnap->IsValidLayout(Size));
+	EXPECT_FALSE(pSnap->IsSorted());
+	EXPECT_FALSE(pSnap->IsValid(Size));
+}
+
+TEST(Snapshot, DeltaRoundtrip)
+{
+	std::vector<char> vFrom(CSnapshot::MAX_SIZE), vTo(CSnapshot::MAX_SIZE), vResult(CSnapshot::MAX_SIZE);
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE), vReferenceDelta(CSnapshot::MAX_SIZE);
+	CSnapshot *pFrom = (CSnapshot *)vFrom.data();
+	CSnapshot *pTo = (CSnapshot *)vTo.data();
+	CSnapshot *pResult = (CSnapshot *)vResult.data();
+
+	CSnapshotDelta Delta;
+	for(int Round = 0; Round < 20; Round++)
+	{
+		CreateRandomSnapshot(pFrom, 1 + Random(CSnapshot::MAX_ITEMS), Round);
+		int ToSize = CreateRandomSnapshot(pTo, 1 + Random(CSnapshot::MAX_ITEMS), Round + 1);
+
+		int DeltaSize = Delta.CreateDelta(pFrom, pTo, vDelta.data());
+		int ReferenceSize = ReferenceCreateDelta(pFrom, pTo, vReferenceDelta.data());
+		ASSERT_EQ(DeltaSize, ReferenceSize);
+		EXPECT_EQ(mem_comp(vDelta.data(), vReferenceDelta.data(), DeltaSize), 0);
+
+		int ResultSize = Delta.UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize);
+		ASSERT_EQ(ResultSize, ToSize);
+		EXPECT_TRUE(pResult->IsValid(ResultSize));
+		EXPECT_TRUE(SnapshotsEqual(pResult, pTo));
+	}
+}
+
+TEST(Snapshot, UnpackUnsortedDelta)
+{
+	std::vector<char> vFrom(CSnapshot::MAX_SIZE), vResult(CSnapshot::MAX_SIZE);
+	CSnapshot *pFrom = (CSnapshot *)vFrom.data();
+	CSnapshot *pResult = (CSnapshot *)vResult.data();
+
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int ID = 0; ID < 4; ID++)
+		*(int *)Builder.NewItem(1, ID, sizeof(int)) = ID;
+	Builder.Finish(pFrom);
+
+	// delta of an older server: keys in insertion order and an update
+	// referring to an item added earlier in the same delta
+	int aDelta[] = {
+		2, 3, 0, // deleted, updated, temp
+		3, 0, // keys 1:3 and 1:0
+		2, 5, 1, 50, // new item 2:5
+		1, 1, 1, 10, // update 1:1
+		2, 5, 1, 5, // 2:5 again, not in the old snapshot so it is replaced
+	};
+	aDelta[3] = (1 << 16) | 3;
+	aDelta[4] = (1 << 16) | 0;
+
+	CSnapshotDelta Delta;
+	int Size = Delta.UnpackDelta(pFrom, pResult, aDelta, sizeof(aDelta));
+	ASSERT_GT(Size, 0);
+	EXPECT_TRUE(pResult->IsValid(Size));
+	ASSERT_EQ(pResult->NumItems(), 3);
+	EXPECT_EQ(*(const int *)pResult->FindItem(1, 1), 11);
+	EXPECT_EQ(*(const int *)pResult->FindItem(1, 2), 2);
+	EXPECT_EQ(*(const int *)pResult->FindItem(2, 5), 5);
+	EXPECT_EQ(pResult->FindItem(1, 0), nullptr);
+	EXPECT_EQ(pResult->FindItem(1, 3), nullptr);
+}
+
+TEST(Snapshot, DiffItemMatchesReference)
+{
+	const int MaxSize = 64;
+	int aPast[MaxSize], aCurrent[MaxSize], aDiff[MaxSize], aReferenceDiff[MaxSize], aOut[MaxSize], aReferenceOut[MaxSize];
+	for(int Round = 0; Round < 5000; Round++)
+	{
+		const int Size = Round % MaxSize;
+		for(int i = 0; i < Size; i++)
+		{
+			aPast[i] = RandomInt();
+			aCurrent[i] = Random(3) ? aPast[i] : RandomInt();
+		}
+		if(Random(2))
+			aPast[Random(MaxSize)] = INT_MIN;
+
+		const int Needed = CSnapshotDelta::DiffItem(aPast, aCurrent, aDiff, Size);
+		ASSERT_EQ(Needed, ReferenceDiffItem(aPast, aCurrent, aReferenceDiff, Size));
+		ASSERT_EQ(mem_comp(aDiff, aReferenceDiff, Size * sizeof(int)), 0);
+
+		int DataRate = Round, ReferenceDataRate = Round;
+		CSnapshotDelta::UndiffItem(aPast, aDiff, aOut, Size, &DataRate);
+		ReferenceUndiffItem(aPast, aDiff, aReferenceOut, Size, &ReferenceDataRate);
+		ASSERT_EQ(DataRate, ReferenceDataRate);
+		ASSERT_EQ(mem_comp(aOut, aReferenceOut, Size * sizeof(int)), 0);
+		ASSERT_EQ(mem_comp(aOut, aCurrent, Size * sizeof(int)), 0);
+	}
+}
+
+TEST(SnapshotStorage, GetByTick)
+{
+	CSnapshotStorage Storage;
+	int aData[4] = {0};
+	// more ticks than the index holds, with a gap in between
+	for(int Tick = 0; Tick < 600; Tick++)
+	{
+		if(Tick == 300)
+			Tick = 350;
+		aData[0] = Tick;
+		Storage.Add(Tick, Tick * 10, sizeof(aData), aData, 0, nullptr);
+	}
+	for(int Tick = -1; Tick < 610; Tick++)
+	{
+		CSnapshot *pSnap = nullptr;
+		int64_t Tagtime = 0;
+		int Size = Storage.Get(Tick, &Tagtime, &pSnap, nullptr);
+		if(Tick < 0 || (Tick >= 300 && Tick < 350) || Tick >= 600)
+		{
+			EXPECT_EQ(Size, -1);
+			continue;
+		}
+		ASSERT_EQ(Size, (int)sizeof(aData));
+		EXPECT_EQ(Tagtime, Tick * 10);
+		EXPECT_EQ(*(int *)pSnap, Tick);
+	}
+
+	Storage.PurgeUntil(500);
+	EXPECT_EQ(Storage.m_pFirst->m_Tick, 500);
+	EXPECT_EQ(Storage.NumHolders(), 100);
+	EXPECT_EQ(Storage.Get(499, nullptr, nullptr, nullptr), -1);
+	EXPECT_EQ(Storage.Get(500, nullptr, nullptr, nullptr), (int)sizeof(aData));
+	EXPECT_EQ(Storage.Get(599, nullptr, nullptr, nullptr), (int)sizeof(aData));
+
+	Storage.PurgeUntil(1000);
+	EXPECT_EQ(Storage.m_pFirst, nullptr);
+	EXPECT_EQ(Storage.m_pLast, nullptr);
+	EXPECT_EQ(Storage.Get(599, nullptr, nullptr, nullptr), -1);
+}
+
+TEST(SnapshotStorage, DuplicateTick)
+{
+	CSnapshotStorage Storage;
+	int First = 1, Second = 2;
+	Storage.Add(5, 0, sizeof(First), &First, 0, nullptr);
+	Storage.Add(5, 0, sizeof(Second), &Second, 0, nullptr);
+
+	// like the list walk, the first snapshot of a tick is found
+	CSnapshot *pSnap;
+	ASSERT_EQ(Storage.Get(5, nullptr, &pSnap, nullptr), (int)sizeof(int));
+	EXPECT_EQ(*(int *)pSnap, 1);
+}
+
+TEST(SnapshotStorage, SharedBuffers)
+{
+	CSnapshotBufferPool Pool;
+	{
+		CSnapshotStorage aStorages[3];
+		for(auto &Storage : aStorages)
+			Storage.Init(&Pool);
+
+		std::vector<int> vData(100);
+		for(int Tick = 0; Tick < 10; Tick++)
+		{
+			vData[0] = Tick;
+			for(auto &Storage : aStorages)
+				Storage.PurgeUntil(Tick - 3);
+			aStorages[0].Add(Tick, 0, vData.size() * sizeof(int), vData.data(), 0, nullptr);
+			aStorages[1].Add(Tick, 0, aStorages[0].m_pLast->m_pBuffer);
+			aStorages[2].Add(Tick, 0, vData.size() * sizeof(int), vData.data(), 0, nullptr);
+			EXPECT_EQ(aStorages[0].m_pLast->m_pBuffer->Refcount(), 2);
+		}
+
+		// four ticks kept, two buffers per tick, purged ones got reused
+		EXPECT_EQ(Pool.NumUsedBuffers(), 8);
+		EXPECT_EQ(Pool.NumBuffers(), 8);
+
+		CSnapshot *pSnap;
+		ASSERT_EQ(aStorages[1].Get(8, nullptr, &pSnap, nullptr), (int)(vData.size() * sizeof(int)));
+		EXPECT_EQ(*(int *)pSnap, 8);
+
+		aStorages[0].PurgeAll();
+		EXPECT_EQ(Pool.NumUsedBuffers(), 8);
+		aStorages[1].PurgeAll();
+		EXPECT_EQ(Pool.NumUsedBuffers(), 4);
+	}
+	EXPECT_EQ(Pool.NumUsedBuffers(), 0);
+	EXPECT_EQ(Pool.UsedBytes(), 0u);
+	Pool.Trim();
+	EXPECT_EQ(Pool.NumBuffers(), 0);
+	EXPECT_EQ(Pool.AllocatedBytes(), 0u);
+}
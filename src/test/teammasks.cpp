@@ -0,0 +1,225 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/gamecore.h>
+#include <game/server/teammasks.h>
+#include <game/teamscore.h>
+
+class TeamMasks : public ::testing::Test
+{
+protected:
+	CTeamMasks::CClient m_aClients[MAX_CLIENTS];
+	CTeamsCore m_Teams;
+	CTestPrng m_Prng;
+
+	void SetUp() override
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			Randomize(i);
+	}
+
+	void Randomize(int ClientID)
+	{
+		CTeamMasks::CClient &Client = m_aClients[ClientID];
+		Client.m_Active = m_Prng.RandomBits() % 8 != 0;
+		Client.m_Spectating = m_Prng.RandomBits() % 4 == 0;
+		Client.m_SpectatorID = m_Prng.RandomBits() % 2 ? SPEC_FREEVIEW : (int)(m_Prng.RandomBits() % MAX_CLIENTS);
+		Client.m_SpecTeam = m_Prng.RandomBits() % 2;
+		Client.m_ShowOthers = m_Prng.RandomBits() % 3;
+		Client.m_HasCharacter = m_Prng.RandomBits() % 4 != 0;
+		m_Teams.Team(ClientID, m_Prng.RandomBits() % 16 == 0 ? (int)TEAM_SUPER : (int)(m_Prng.RandomBits() % 4));
+		m_Teams.SetSolo(ClientID, m_Prng.RandomBits() % 4 == 0);
+	}
+
+	bool HasCharacter(int ClientID) const
+	{
+		return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_HasCharacter;
+	}
+
+	// the per player loop that CGameTeams::TeamMask used to have
+	uint64_t ReferenceMask(int Team, int ExceptID, int Asker) const
+	{
+		if(Team == TEAM_SUPER)
+		{
+			if(ExceptID == -1)
+				return 0xffffffffffffffff;
+			return 0xffffffffffffffff & ~(1ULL << ExceptID);
+		}
+
+		uint64_t Mask = 0;
+		for(int i = 0; i < MAX_CLIENTS; ++i)
+		{
+			const CTeamMasks::CClient &Client = m_aClients[i];
+			if(i == ExceptID)
+				continue;
+			if(!Client.m_Active)
+				continue;
+
+			if(!Client.m_Spectating)
+			{
+				if(i != Asker)
+				{
+					if(!HasCharacter(i))
+						continue;
+					if(Client.m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
+					{
+						if(m_Teams.Team(i) != Team && m_Teams.Team(i) != TEAM_SUPER)
+							continue;
+					}
+					else if(Client.m_ShowOthers == SHOW_OTHERS_OFF)
+					{
+						if(m_Teams.GetSolo(Asker) || m_Teams.GetSolo(i))
+							continue;
+						if(m_Teams.Team(i) != Team && m_Teams.Team(i) != TEAM_SUPER)
+							continue;
+					}
+				}
+			}
+			else if(Client.m_SpectatorID != SPEC_FREEVIEW)
+			{
+				const int Viewed = Client.m_SpectatorID;
+				if(Viewed != Asker)
+				{
+					if(!HasCharacter(Viewed))
+						continue;
+					if(Client.m_ShowOthers == SHOW_OTHERS_ONLY_TEAM)
+					{
+						if(m_Teams.Team(Viewed) != Team && m_Teams.Team(Viewed) != TEAM_SUPER)
+							continue;
+					}
+					else if(Client.m_ShowOthers == SHOW_OTHERS_OFF)
+					{
+						if(m_Teams.GetSolo(Asker) || m_Teams.GetSolo(Viewed))
+							continue;
+						if(m_Teams.Team(Viewed) != Team && m_Teams.Team(Viewed) != TEAM_SUPER)
+							continue;
+					}
+				}
+			}
+			else if(Client.m_SpecTeam)
+			{
+				if(m_Teams.Team(i) != Team && m_Teams.Team(i) != TEAM_SUPER)
+					continue;
+			}
+
+			Mask |= 1ULL << i;
+		}
+		return Mask;
+	}
+
+	void Collect(CTeamMasks *pMasks) const
+	{
+		mem_copy(pMasks->m_aClients, m_aClients, sizeof(m_aClients));
+		pMasks->Update(&m_Teams);
+	}
+
+	// every team the game asks for, with and without excluded players
+	void ExpectMatchesReference(const CTeamMasks &Masks, const char *pWhat)
+	{
+		const int aTeams[] = {TEAM_FLOCK, 1, 2, 3, 17, TEAM_SUPER};
+		for(int Team : aTeams)
+		{
+			for(int Asker = -1; Asker < MAX_CLIENTS; Asker++)
+			{
+				const int ExceptID = m_Prng.RandomBits() % 2 ? -1 : Asker;
+				ASSERT_EQ(Masks.Mask(Team, ExceptID, Asker, &m_Teams), ReferenceMask(Team, ExceptID, Asker))
+					<< pWhat << " team=" << Team << " except=" << ExceptID << " asker=" << Asker;
+			}
+		}
+	}
+};
+
+TEST_F(TeamMasks, MatchesReference)
+{
+	for(int Round = 0; Round < 50; Round++)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			Randomize(i);
+		CTeamMasks Masks;
+		Collect(&Masks);
+		ExpectMatchesReference(Masks, "random");
+	}
+}
+
+TEST_F(TeamMasks, CacheFollowsChanges)
+{
+	// one instance that is rebuilt after every change, like the one of
+	// CGameTeams, against one built from scratch
+	CTeamMasks Cached;
+	Collect(&Cached);
+	for(int Change = 0; Change < 400; Change++)
+	{
+		const int ClientID = m_Prng.RandomBits() % MAX_CLIENTS;
+		const char *pWhat;
+		switch(Change % 6)
+		{
+		case 0:
+			pWhat = "join";
+			m_Teams.Team(ClientID, 1 + m_Prng.RandomBits() % 3);
+			break;
+		case 1:
+			pWhat = "leave";
+			m_Teams.Team(ClientID, TEAM_FLOCK);
+			break;
+		case 2:
+			pWhat = "solo";
+			m_Teams.SetSolo(ClientID, !m_Teams.GetSolo(ClientID));
+			break;
+		case 3:
+			pWhat = "super";
+			m_Teams.Team(ClientID, m_Teams.Team(ClientID) == TEAM_SUPER ? (int)TEAM_FLOCK : (int)TEAM_SUPER);
+			break;
+		case 4:
+			pWhat = "spawn or death";
+			m_aClients[ClientID].m_HasCharacter = !m_aClients[ClientID].m_HasCharacter;
+			break;
+		default:
+			pWhat = "connect, spectate or show others";
+			Randomize(ClientID);
+			break;
+		}
+
+		Collect(&Cached);
+		CTeamMasks Fresh;
+		Collect(&Fresh);
+		for(int Team = 0; Team < 4; Team++)
+			for(int Asker = 0; Asker < MAX_CLIENTS; Asker++)
+				ASSERT_EQ(Cached.Mask(Team, -1, Asker, &m_Teams), Fresh.Mask(Team, -1, Asker, &m_Teams)) << pWhat << " change=" << Change;
+		ExpectMatchesReference(Cached, pWhat);
+	}
+}
+
+TEST_F(TeamMasks, AskerSoloIsNotCached)
+{
+	// the solo state of the asker is read at the time of the call, so
+	// entering a solo part hides the asker from the players that don't show
+	// others right away
+	for(auto &Client : m_aClients)
+	{
+		Client.m_Active = true;
+		Client.m_Spectating = false;
+		Client.m_ShowOthers = SHOW_OTHERS_OFF;
+		Client.m_HasCharacter = true;
+	}
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_Teams.Team(i, TEAM_FLOCK);
+		m_Teams.SetSolo(i, false);
+	}
+	CTeamMasks Masks;
+	Collect(&Masks);
+	EXPECT_EQ(Masks.Mask(TEAM_FLOCK, -1, 0, &m_Teams), 0xffffffffffffffff);
+	m_Teams.SetSolo(0, true);
+	EXPECT_EQ(Masks.Mask(TEAM_FLOCK, -1, 0, &m_Teams), 1ULL);
+	EXPECT_EQ(Masks.Mask(TEAM_FLOCK, -1, 0, &m_Teams), ReferenceMask(TEAM_FLOCK, -1, 0));
+}
+
+TEST_F(TeamMasks, SuperExcludesHighClientIds)
+{
+	// the old code shifted an int, which overflowed for ids of 32 and above
+	CTeamMasks Masks;
+	Collect(&Masks);
+	EXPECT_EQ(Masks.Mask(TEAM_SUPER, MAX_CLIENTS - 1, -1, &m_Teams), ~(1ULL << (MAX_CLIENTS - 1)));
+	EXPECT_EQ(Masks.Mask(TEAM_SUPER, -1, -1, &m_Teams), 0xffffffffffffffff);
+}
@@ -219,6 +219,15 @@ TEST_F(TeeHistorian, Empty)
 	Expect((const unsigned char *)"", 0);
 }
 
+TEST_F(TeeHistorian, CompressedVersion)
+{
+	m_GameInfo.m_Compressed = true;
+	Reset(&m_GameInfo);
+	static const char PREFIX[] = "{\"comment\":\"teehistorian@ddnet.tw\",\"version\":\"3\",\"version_minor\":\"4\",\"compression\":\"zlib\",\"game_uuid\":";
+	ASSERT_GT(m_Buffer.Size(), (int)(sizeof(CUuid) + str_length(PREFIX)));
+	EXPECT_EQ(mem_comp(m_Buffer.Data() + sizeof(CUuid), PREFIX, str_length(PREFIX)), 0);
+}
+
 TEST_F(TeeHistorian, Finished)
 {
 	const unsigned char EXPECTED[] = {0x40}; // FINISH
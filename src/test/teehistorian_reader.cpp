@@ -0,0 +1,298 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/shared/teehistorian_ex.h>
+#include <engine/shared/teehistorian_reader.h>
+#include <game/gamecore.h>
+#include <game/server/teehistorian.h>
+
+#include <vector>
+
+class TeeHistorianReader : public ::testing::Test
+{
+protected:
+	enum
+	{
+		NUM_CLIENTS = 16,
+		NUM_TEAMS = 4,
+	};
+
+	class CState
+	{
+	public:
+		CTeeHistorianReader::CPlayer m_aPlayers[NUM_CLIENTS];
+		bool m_aPractice[NUM_TEAMS];
+	};
+
+	CConfig m_Config;
+	CTuningParams m_Tuning;
+	CUuidManager m_UuidManager;
+	CTeeHistorian m_TH;
+
+	std::vector<unsigned char> m_vData;
+	// offsets and ticks of the keyframes in `m_vData`
+	std::vector<int> m_vKeyframes;
+	std::vector<int> m_vKeyframeTicks;
+	// the state at the end of each tick
+	std::vector<CState> m_vStates;
+
+	TeeHistorianReader()
+	{
+		mem_zero(&m_Config, sizeof(m_Config));
+#define MACRO_CONFIG_INT(Name, ScriptName, Def, Min, Max, Save, Desc) \
+	m_Config.m_##Name = (Def);
+#define MACRO_CONFIG_COL(Name, ScriptName, Def, Save, Desc) MACRO_CONFIG_INT(Name, ScriptName, Def, 0, 0, Save, Desc)
+#define MACRO_CONFIG_STR(Name, ScriptName, Len, Def, Save, Desc) \
+	str_copy(m_Config.m_##Name, (Def), sizeof(m_Config.m_##Name));
+#include <engine/shared/config_variables.h>
+#undef MACRO_CONFIG_STR
+#undef MACRO_CONFIG_COL
+#undef MACRO_CONFIG_INT
+
+		RegisterUuids(&m_UuidManager);
+		RegisterTeehistorianUuids(&m_UuidManager);
+	}
+
+	static void Write(const void *pData, int DataSize, void *pUser)
+	{
+		TeeHistorianReader *pThis = (TeeHistorianReader *)pUser;
+		pThis->m_vData.insert(pThis->m_vData.end(), (const unsigned char *)pData, (const unsigned char *)pData + DataSize);
+	}
+
+	// players joining, moving, changing inputs and teams and leaving
+	void Record(int NumTicks, int KeyframeInterval)
+	{
+		CTeeHistorian::CGameInfo GameInfo;
+		mem_zero(&GameInfo, sizeof(GameInfo));
+		GameInfo.m_GameUuid = CalculateUuid("test@ddnet.tw");
+		GameInfo.m_pServerVersion = "DDNet test";
+		GameInfo.m_pPrngDescription = "";
+		GameInfo.m_pServerName = "";
+		GameInfo.m_pGameType = "";
+		GameInfo.m_pMapName = "";
+		GameInfo.m_pConfig = &m_Config;
+		GameInfo.m_pTuning = &m_Tuning;
+		GameInfo.m_pUuids = &m_UuidManager;
+		m_TH.Reset(&GameInfo, Write, this);
+
+		CState State;
+		mem_zero(&State, sizeof(State));
+		m_vStates.push_back(State);
+		m_vKeyframes.push_back(m_vData.size());
+		m_vKeyframeTicks.push_back(m_TH.RecordKeyframe());
+		EXPECT_EQ(m_vKeyframeTicks.back(), 0);
+
+		bool aConnected[NUM_CLIENTS] = {false};
+		CTestPrng Prng(1);
+		for(int Tick = 1; Tick <= NumTicks; Tick++)
+		{
+			m_TH.BeginTick(Tick);
+			m_TH.BeginPlayers();
+			// some ticks without any changes
+			const bool Quiet = Tick % 50 >= 40;
+			for(int ClientID = 0; ClientID < NUM_CLIENTS; ClientID++)
+			{
+				CTeeHistorianReader::CPlayer &Player = State.m_aPlayers[ClientID];
+				if(!Quiet && aConnected[ClientID] && Prng.RandomBits() % 8 == 0)
+				{
+					Player.m_Alive = !Player.m_Alive;
+					Player.m_X = Prng.RandomBits() % 10000;
+					Player.m_Y = Prng.RandomBits() % 10000;
+				}
+				else if(!Quiet && Player.m_Alive && Prng.RandomBits() % 2)
+				{
+					Player.m_X += (int)(Prng.RandomBits() % 64) - 32;
+					Player.m_Y += (int)(Prng.RandomBits() % 64) - 32;
+				}
+
+				if(Player.m_Alive)
+				{
+					CNetObj_CharacterCore Char;
+					mem_zero(&Char, sizeof(Char));
+					Char.m_X = Player.m_X;
+					Char.m_Y = Player.m_Y;
+					m_TH.RecordPlayer(ClientID, &Char);
+				}
+				else
+				{
+					m_TH.RecordDeadPlayer(ClientID);
+				}
+			}
+			m_TH.EndPlayers();
+
+			m_TH.BeginInputs();
+			for(int ClientID = 0; ClientID < NUM_CLIENTS && !Quiet; ClientID++)
+			{
+				CTeeHistorianReader::CPlayer &Player = State.m_aPlayers[ClientID];
+				if(!aConnected[ClientID])
+				{
+					if(Prng.RandomBits() % 20 == 0)
+					{
+						aConnected[ClientID] = true;
+						m_TH.RecordPlayerJoin(ClientID, CTeeHistorian::PROTOCOL_6);
+					}
+					continue;
+				}
+				if(Prng.RandomBits() % 3 == 0)
+				{
+					Player.m_HasInput = true;
+					Player.m_Input.m_Direction = (int)(Prng.RandomBits() % 3) - 1;
+					Player.m_Input.m_TargetX = Prng.RandomBits() % 500;
+					Player.m_Input.m_Jump = Prng.RandomBits() % 2;
+					m_TH.RecordPlayerInput(ClientID, ClientID + 1, &Player.m_Input);
+				}
+				if(Prng.RandomBits() % 30 == 0)
+				{
+					Player.m_Team = Prng.RandomBits() % NUM_TEAMS;
+					m_TH.RecordPlayerTeam(ClientID, Player.m_Team);
+				}
+				if(Prng.RandomBits() % 40 == 0)
+				{
+					const char aMsg[] = "message";
+					m_TH.RecordPlayerMessage(ClientID, aMsg, sizeof(aMsg));
+				}
+				if(Prng.RandomBits() % 100 == 0)
+				{
+					aConnected[ClientID] = false;
+					m_TH.RecordPlayerDrop(ClientID, "reason");
+				}
+			}
+			if(!Quiet && Prng.RandomBits() % 10 == 0)
+			{
+				const int Team = Prng.RandomBits() % NUM_TEAMS;
+				State.m_aPractice[Team] = !State.m_aPractice[Team];
+				m_TH.RecordTeamPractice(Team, State.m_aPractice[Team]);
+			}
+			m_TH.EndInputs();
+			m_TH.EndTick();
+			m_vStates.push_back(State);
+
+			if(Tick % KeyframeInterval == 0)
+			{
+				// quiet ticks aren't written
+				m_vKeyframes.push_back(m_vData.size());
+				m_vKeyframeTicks.push_back(m_TH.RecordKeyframe());
+				EXPECT_EQ(m_vKeyframeTicks.back(), Quiet ? Tick - Tick % 50 + 39 : Tick);
+			}
+		}
+		m_TH.Finish();
+	}
+
+	// decodes from the keyframe with the given index until `End`, and
+	// compares the state at the end of every tick
+	void ExpectStates(int Keyframe, int End)
+	{
+		const int Offset = m_vKeyframes[Keyframe];
+		CTeeHistorianReader Reader;
+		Reader.SetData(m_vData.data() + Offset, End - Offset);
+		CTeeHistorianReader::CRecord Record;
+		int Tick = -1;
+		while(Reader.Next(&Record))
+		{
+			if(Tick == -1)
+			{
+				ASSERT_EQ(Record.m_Type, CTeeHistorianReader::RECORD_KEYFRAME) << "offset " << Offset;
+				ASSERT_EQ(Record.m_Tick, m_vKeyframeTicks[Keyframe]) << "offset " << Offset;
+				Tick = Record.m_Tick;
+				continue;
+			}
+			if(Record.m_Type != CTeeHistorianReader::RECORD_TICK && Record.m_Type != CTeeHistorianReader::RECORD_FINISH)
+				continue;
+			ASSERT_LE(Record.m_Tick, (int)m_vStates.size());
+			// nothing changes in skipped ticks
+			for(; Tick < Record.m_Tick; Tick++)
+				ExpectState(Reader, Tick);
+		}
+		EXPECT_FALSE(Reader.Error());
+		EXPECT_EQ(Reader.Finished(), End == (int)m_vData.size());
+		EXPECT_GT(Tick, 0);
+	}
+
+	void ExpectState(const CTeeHistorianReader &Reader, int Tick)
+	{
+		for(int ClientID = 0; ClientID < NUM_CLIENTS; ClientID++)
+		{
+			const CTeeHistorianReader::CPlayer &Expected = m_vStates[Tick].m_aPlayers[ClientID];
+			const CTeeHistorianReader::CPlayer &Player = Reader.Player(ClientID);
+			ASSERT_EQ(Player.m_Alive, Expected.m_Alive) << "tick " << Tick << " cid " << ClientID;
+			if(Expected.m_Alive)
+			{
+				ASSERT_EQ(Player.m_X, Expected.m_X) << "tick " << Tick << " cid " << ClientID;
+				ASSERT_EQ(Player.m_Y, Expected.m_Y) << "tick " << Tick << " cid " << ClientID;
+			}
+			ASSERT_EQ(Player.m_HasInput, Expected.m_HasInput) << "tick " << Tick << " cid " << ClientID;
+			ASSERT_EQ(mem_comp(&Player.m_Input, &Expected.m_Input, sizeof(Player.m_Input)), 0) << "tick " << Tick << " cid " << ClientID;
+			ASSERT_EQ(Player.m_Team, Expected.m_Team) << "tick " << Tick << " cid " << ClientID;
+		}
+		for(int Team = 0; Team < NUM_TEAMS; Team++)
+			ASSERT_EQ(Reader.Practice(Team), m_vStates[Tick].m_aPractice[Team]) << "tick " << Tick << " team " << Team;
+	}
+};
+
+TEST_F(TeeHistorianReader, Header)
+{
+	Record(10, 10);
+	CTeeHistorianReader::CHeader Header;
+	ASSERT_TRUE(CTeeHistorianReader::ParseHeader(m_vData.data(), m_vData.size(), &Header));
+	EXPECT_EQ(Header.m_Version, 2);
+	EXPECT_FALSE(Header.m_Compressed);
+	EXPECT_EQ(Header.m_Size, m_vKeyframes[0]);
+	EXPECT_FALSE(CTeeHistorianReader::ParseHeader(m_vData.data(), Header.m_Size - 1, &Header));
+}
+
+TEST_F(TeeHistorianReader, Sequential)
+{
+	Record(2000, 97);
+	ExpectStates(0, m_vData.size());
+}
+
+TEST_F(TeeHistorianReader, FromKeyframes)
+{
+	Record(2000, 97);
+	ASSERT_EQ(m_vKeyframes.size(), 21u);
+	for(int i = 0; i < (int)m_vKeyframes.size(); i++)
+		ExpectStates(i, i + 1 < (int)m_vKeyframes.size() ? m_vKeyframes[i + 1] : m_vData.size());
+}
+
+TEST_F(TeeHistorianReader, Records)
+{
+	Record(310, 1000);
+	CTeeHistorianReader::CHeader Header;
+	ASSERT_TRUE(CTeeHistorianReader::ParseHeader(m_vData.data(), m_vData.size(), &Header));
+	CTeeHistorianReader Reader;
+	Reader.SetData(m_vData.data() + Header.m_Size, m_vData.size() - Header.m_Size);
+	CTeeHistorianReader::CRecord Record;
+	ASSERT_TRUE(Reader.Next(&Record));
+	ASSERT_EQ(Record.m_Type, CTeeHistorianReader::RECORD_KEYFRAME);
+	int Tick = 0;
+	int aNumRecords[CTeeHistorianReader::NUM_RECORDS] = {0};
+	while(Reader.Next(&Record))
+	{
+		aNumRecords[Record.m_Type]++;
+		if(Record.m_Type == CTeeHistorianReader::RECORD_TICK || Record.m_Type == CTeeHistorianReader::RECORD_FINISH)
+		{
+			for(; Tick < Record.m_Tick; Tick++)
+				ExpectState(Reader, Tick);
+		}
+		if(Record.m_Type == CTeeHistorianReader::RECORD_DROP)
+		{
+			EXPECT_STREQ(Record.m_pString, "reason");
+		}
+		if(Record.m_Type == CTeeHistorianReader::RECORD_MESSAGE)
+		{
+			EXPECT_EQ(mem_comp(Record.m_pData, "message", Record.m_DataSize), 0);
+		}
+	}
+	EXPECT_FALSE(Reader.Error());
+	EXPECT_TRUE(Reader.Finished());
+	EXPECT_EQ(Tick, 310);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_JOIN], 0);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_DROP], 0);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_MESSAGE], 0);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_PLAYER_DIFF], 0);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_INPUT_DIFF], 0);
+	EXPECT_GT(aNumRecords[CTeeHistorianReader::RECORD_EX], 0);
+}
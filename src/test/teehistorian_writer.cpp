@@ -0,0 +1,193 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/teehistorian_reader.h>
+#include <engine/shared/teehistorian_writer.h>
+
+#include <vector>
+
+#include <zlib.h>
+
+static const char HEADER[] = "header";
+
+// writes a header and some ticks of compressible data, returns everything
+// that was written, blocks are marked with the number of ticks before them
+static std::vector<unsigned char> WriteTicks(const char *pFilename, const char *pIndexFilename, int CompressionLevel, int NumTicks, int TickSize)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	EXPECT_TRUE(File);
+	IOHANDLE IndexFile = 0;
+	if(pIndexFilename)
+	{
+		IndexFile = io_open(pIndexFilename, IOFLAG_WRITE);
+		EXPECT_TRUE(IndexFile);
+	}
+
+	CTeeHistorianWriter Writer;
+	Writer.Open(File, IndexFile, CompressionLevel);
+	Writer.Write(HEADER, sizeof(HEADER));
+	Writer.EndHeader();
+	Writer.SetBlockTick(0);
+
+	std::vector<unsigned char> vWritten(HEADER, HEADER + sizeof(HEADER));
+	CTestPrng Prng;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		// a few records of different sizes per tick
+		int Written = 0;
+		while(Written < TickSize)
+		{
+			unsigned char aRecord[64];
+			int Size = minimum(1 + (int)(Prng.RandomBits() % sizeof(aRecord)), TickSize - Written);
+			for(int i = 0; i < Size; i++)
+				aRecord[i] = (Tick + i) % 16;
+			Writer.Write(aRecord, Size);
+			vWritten.insert(vWritten.end(), aRecord, aRecord + Size);
+			Written += Size;
+		}
+		if(Writer.EndTick())
+			Writer.SetBlockTick(Tick + 1);
+	}
+
+	CTeeHistorianWriter::CStats Stats;
+	Writer.GetStats(&Stats);
+	EXPECT_FALSE(Writer.Error());
+	EXPECT_TRUE(Writer.Close());
+	EXPECT_LE(Stats.m_RawBytes, (int64_t)vWritten.size());
+	EXPECT_LE(Stats.m_MaxBacklog, (int)CTeeHistorianWriter::NUM_BLOCKS);
+	return vWritten;
+}
+
+static std::vector<unsigned char> ReadFile(const char *pFilename)
+{
+	void *pData;
+	unsigned DataSize;
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	EXPECT_TRUE(File);
+	io_read_all(File, &pData, &DataSize);
+	io_close(File);
+	std::vector<unsigned char> vData((unsigned char *)pData, (unsigned char *)pData + DataSize);
+	free(pData);
+	return vData;
+}
+
+static unsigned ReadSize(const unsigned char *pData)
+{
+	return pData[0] | pData[1] << 8 | pData[2] << 16 | (unsigned)pData[3] << 24;
+}
+
+TEST(TeeHistorianWriter, Uncompressed)
+{
+	CTestInfo Info;
+	std::vector<unsigned char> vWritten = WriteTicks(Info.m_aFilename, nullptr, 0, 500, 700);
+	EXPECT_EQ(ReadFile(Info.m_aFilename), vWritten);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST(TeeHistorianWriter, Index)
+{
+	CTestInfo Info;
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", Info.m_aFilename);
+	for(int CompressionLevel : {0, 6})
+	{
+		const int TickSize = 700;
+		WriteTicks(Info.m_aFilename, aIndexFilename, CompressionLevel, 500, TickSize);
+		std::vector<unsigned char> vFile = ReadFile(Info.m_aFilename);
+
+		IOHANDLE IndexFile = io_open(aIndexFilename, IOFLAG_READ);
+		ASSERT_TRUE(IndexFile);
+		std::vector<CTeeHistorianReader::CIndexEntry> vEntries;
+		EXPECT_TRUE(CTeeHistorianReader::ReadIndex(IndexFile, &vEntries));
+		io_close(IndexFile);
+
+		// every block after the header is indexed, and decodes to the ticks
+		// it is marked with
+		ASSERT_GT(vEntries.size(), 1u);
+		EXPECT_EQ(vEntries[0].m_Tick, 0);
+		EXPECT_EQ(vEntries[0].m_Offset, (int64_t)sizeof(HEADER));
+		for(int i = 0; i < (int)vEntries.size(); i++)
+		{
+			const int64_t End = i + 1 < (int)vEntries.size() ? vEntries[i + 1].m_Offset : vFile.size();
+			std::vector<unsigned char> vRaw;
+			if(CompressionLevel)
+				ASSERT_TRUE(CTeeHistorianReader::Decompress(&vFile[vEntries[i].m_Offset], End - vEntries[i].m_Offset, &vRaw));
+			else
+				vRaw.assign(vFile.begin() + vEntries[i].m_Offset, vFile.begin() + End);
+			ASSERT_FALSE(vRaw.empty());
+			EXPECT_EQ(vRaw[0], vEntries[i].m_Tick % 16);
+		}
+	}
+	fs_remove(Info.m_aFilename);
+	fs_remove(aIndexFilename);
+}
+
+TEST(TeeHistorianWriter, Compressed)
+{
+	CTestInfo Info;
+	// also ticks larger than a block
+	const int aaTicks[][2] = {{500, 700}, {20, 3 * CTeeHistorianWriter::BLOCK_SIZE}};
+	for(const auto &aTicks : aaTicks)
+	{
+		const int TickSize = aTicks[1];
+		std::vector<unsigned char> vWritten = WriteTicks(Info.m_aFilename, nullptr, 6, aTicks[0], TickSize);
+		std::vector<unsigned char> vFile = ReadFile(Info.m_aFilename);
+
+		// the header is not compressed
+		ASSERT_GE(vFile.size(), sizeof(HEADER));
+		std::vector<unsigned char> vRead(vFile.begin(), vFile.begin() + sizeof(HEADER));
+		unsigned Offset = sizeof(HEADER);
+		int NumBlocks = 0;
+		while(Offset < vFile.size())
+		{
+			ASSERT_LE(Offset + CTeeHistorianWriter::BLOCK_HEADER_SIZE, vFile.size());
+			unsigned RawSize = ReadSize(&vFile[Offset]);
+			unsigned CompressedSize = ReadSize(&vFile[Offset + 4]);
+			Offset += CTeeHistorianWriter::BLOCK_HEADER_SIZE;
+			ASSERT_LE(Offset + CompressedSize, vFile.size());
+			// blocks end at tick boundaries
+			EXPECT_EQ(RawSize % TickSize, 0u);
+
+			std::vector<unsigned char> vBlock(RawSize);
+			uLongf Size = RawSize;
+			ASSERT_EQ(uncompress(vBlock.data(), &Size, &vFile[Offset], CompressedSize), Z_OK);
+			ASSERT_EQ(Size, RawSize);
+			vRead.insert(vRead.end(), vBlock.begin(), vBlock.end());
+			Offset += CompressedSize;
+			NumBlocks++;
+		}
+		EXPECT_GT(NumBlocks, 1);
+		EXPECT_LT(vFile.size(), vWritten.size() / 4);
+		EXPECT_EQ(vRead, vWritten);
+	}
+	fs_remove(Info.m_aFilename);
+}
+
+TEST(TeeHistorianWriter, QuietTicks)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	CTeeHistorianWriter Writer;
+	Writer.Open(File, 0, 6);
+	Writer.Write(HEADER, sizeof(HEADER));
+	Writer.EndHeader();
+
+	// ticks far smaller than a block are still handed over every
+	// MAX_BLOCK_TICKS ticks
+	const unsigned char aTick[] = {1, 2, 3};
+	for(int Tick = 1; Tick <= 3 * CTeeHistorianWriter::MAX_BLOCK_TICKS; Tick++)
+	{
+		Writer.Write(aTick, sizeof(aTick));
+		EXPECT_EQ(Writer.EndTick(), Tick % CTeeHistorianWriter::MAX_BLOCK_TICKS == 0) << "tick=" << Tick;
+	}
+
+	CTeeHistorianWriter::CStats Stats;
+	Writer.GetStats(&Stats);
+	EXPECT_EQ(Stats.m_NumBlocks, 4);
+	EXPECT_EQ(Stats.m_RawBytes, (int64_t)(sizeof(HEADER) + 3 * CTeeHistorianWriter::MAX_BLOCK_TICKS * sizeof(aTick)));
+	EXPECT_TRUE(Writer.Close());
+	fs_remove(Info.m_aFilename);
+}
@@ -16,6 +16,17 @@ CTestInfo::CTestInfo()
 	IStorage::FormatTmpPath(m_aFilename, sizeof(m_aFilename), aBuf);
 }
 
+CTestPrng::CTestPrng(uint64_t Seed)
+{
+	uint64_t aSeed[2] = {Seed, 0};
+	CPrng::Seed(aSeed);
+}
+
+float CTestPrng::RandomFloat(float Min, float Max)
+{
+	return Min + (RandomBits() % 1000000) / 1000000.0f * (Max - Min);
+}
+
 IStorage *CTestInfo::CreateTestStorage()
 {
 	bool Error = fs_makedir(m_aFilename);
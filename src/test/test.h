@@ -1,6 +1,10 @@
 #ifndef TEST_TEST_H
 #define TEST_TEST_H
 
+#include <game/prng.h>
+
+#include <cstdint>
+
 class IStorage;
 
 class CTestInfo
@@ -12,4 +16,13 @@ public:
 	bool m_DeleteTestStorageFilesOnSuccess = false;
 	char m_aFilename[64];
 };
+
+// a CPrng with a fixed seed for reproducible random test data
+class CTestPrng : public CPrng
+{
+public:
+	CTestPrng(uint64_t Seed = 1);
+	// a random float in [Min, Max)
+	float RandomFloat(float Min, float Max);
+};
 #endif // TEST_TEST_H
@@ -0,0 +1,702 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/huffman.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/prng.h>
+#include <game/server/playermaps.h>
+#include <game/server/snapgrid.h>
+#include <game/server/snapitems.h>
+#include <game/teamscore.h>
+
+#include <memory>
+#include <vector>
+
+// Times hot paths of the engine and the game in isolation, so that changes
+// to them can be measured without running a server. The unit tests check
+// that they work.
+
+// the same data for every run
+static void SeedPrng(CPrng *pPrng, unsigned Seed)
+{
+	uint64_t aSeed[2] = {Seed, 0};
+	pPrng->Seed(aSeed);
+}
+
+// mostly small values like in snapshot deltas, with some large ones
+static int RandomValue(CPrng *pPrng)
+{
+	const int Value = (int)(pPrng->RandomBits() >> 8);
+	switch(pPrng->RandomBits() % 8)
+	{
+	case 0: return Value;
+	case 1: return Value % 100000 - 50000;
+	case 2: return Value % 128 - 64;
+	default: return 0;
+	}
+}
+
+static float RandomFloat(CPrng *pPrng, float Min, float Max)
+{
+	return Min + (pPrng->RandomBits() % 1000000) / 1000000.0f * (Max - Min);
+}
+
+static double Milliseconds(int64_t Time, int Iterations)
+{
+	return Time * 1000.0 / time_freq() / Iterations;
+}
+
+// the map the game benchmarks run on, relative to the build directory
+static const char *const BENCH_MAP = "data/maps/Tutorial.map";
+
+class CBenchMap
+{
+public:
+	std::unique_ptr<IKernel> m_pKernel;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	bool Load()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		IEngineMap *pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+		m_pKernel->RegisterInterface(pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+		if(!pMap->Load(BENCH_MAP))
+		{
+			dbg_msg("micro_bench", "failed to load map '%s'", BENCH_MAP);
+			return false;
+		}
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+		return true;
+	}
+};
+
+static void CreateSnapshot(CSnapshot *pSnap, int NumItems, int Version)
+{
+	// items are added in an unsorted order, like the game does
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		int Type = 1 + (i * 7) % 20;
+		int ID = (NumItems - i) * 3;
+		int *pData = (int *)Builder.NewItem(Type, ID, 3 * sizeof(int));
+		if(!pData)
+			break;
+		pData[0] = i;
+		pData[1] = (i % 5 == 0) ? Version : 0;
+		pData[2] = Type * ID;
+	}
+	Builder.Finish(pSnap);
+}
+
+static void BenchSnapshotDelta(int Iterations)
+{
+	std::vector<char> vFrom(CSnapshot::MAX_SIZE), vTo(CSnapshot::MAX_SIZE), vResult(CSnapshot::MAX_SIZE);
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE);
+	CSnapshot *pFrom = (CSnapshot *)vFrom.data();
+	CSnapshot *pTo = (CSnapshot *)vTo.data();
+	CSnapshot *pResult = (CSnapshot *)vResult.data();
+	CreateSnapshot(pFrom, CSnapshot::MAX_ITEMS, 0);
+	CreateSnapshot(pTo, CSnapshot::MAX_ITEMS, 1);
+
+	CSnapshotDelta Delta;
+	int DeltaSize = 0;
+	int64_t Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+		DeltaSize = Delta.CreateDelta(pFrom, pTo, vDelta.data());
+	const int64_t CreateTime = time_get() - Start;
+
+	Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+		Delta.UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize);
+	const int64_t UnpackTime = time_get() - Start;
+
+	dbg_msg("snapshot_delta", "items=%d delta=%d bytes create=%.3fms unpack=%.3fms crc %s",
+		pTo->NumItems(), DeltaSize, Milliseconds(CreateTime, Iterations), Milliseconds(UnpackTime, Iterations),
+		pResult->Crc() == pTo->Crc() ? "match" : "differ");
+}
+
+static void BenchDiffItem(int Iterations)
+{
+	// roughly the size of a character item
+	const int Size = 22;
+	const int NumItems = 4096;
+	std::vector<int> vPast(Size * NumItems), vCurrent(Size * NumItems), vDiff(Size * NumItems), vOut(Size * NumItems);
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	for(int i = 0; i < Size * NumItems; i++)
+	{
+		vPast[i] = RandomValue(&Prng);
+		vCurrent[i] = Prng.RandomBits() % 3 ? vPast[i] : RandomValue(&Prng);
+	}
+
+	int Needed = 0, DataRate = 0;
+	int64_t Start = time_get();
+	for(int j = 0; j < Iterations; j++)
+		for(int i = 0; i < NumItems; i++)
+			Needed += CSnapshotDelta::DiffItem(&vPast[i * Size], &vCurrent[i * Size], &vDiff[i * Size], Size) != 0;
+	const int64_t DiffTime = time_get() - Start;
+
+	Start = time_get();
+	for(int j = 0; j < Iterations; j++)
+		for(int i = 0; i < NumItems; i++)
+			CSnapshotDelta::UndiffItem(&vPast[i * Size], &vDiff[i * Size], &vOut[i * Size], Size, &DataRate);
+	const int64_t UndiffTime = time_get() - Start;
+
+	dbg_msg("diff_item", "items=%d changed=%d diff=%.3fms undiff=%.3fms output %s",
+		NumItems, Needed / Iterations, Milliseconds(DiffTime, Iterations), Milliseconds(UndiffTime, Iterations),
+		vOut == vCurrent ? "match" : "differ");
+}
+
+static void BenchVarInt(int Iterations)
+{
+	const int Num = 16 * 1024;
+	std::vector<int> vData(Num), vDecompressed(Num);
+	std::vector<unsigned char> vCompressed(Num * CVariableInt::MAX_BYTES_PACKED);
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	for(auto &Value : vData)
+		Value = RandomValue(&Prng);
+
+	long Size = 0;
+	int64_t Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+		Size = CVariableInt::Compress(vData.data(), Num * sizeof(int), vCompressed.data(), vCompressed.size());
+	const int64_t CompressTime = time_get() - Start;
+
+	Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+		CVariableInt::Decompress(vCompressed.data(), Size, vDecompressed.data(), Num * sizeof(int));
+	const int64_t DecompressTime = time_get() - Start;
+
+	dbg_msg("varint", "ints=%d packed=%ld bytes compress=%.3fms decompress=%.3fms output %s",
+		Num, Size, Milliseconds(CompressTime, Iterations), Milliseconds(DecompressTime, Iterations),
+		vDecompressed == vData ? "match" : "differ");
+}
+
+static int NetNewClient(int ClientID, void *pUser, bool Sixup) { return 0; }
+static int NetNewClientNoAuth(int ClientID, void *pUser) { return 0; }
+static int NetClientRejoin(int ClientID, void *pUser) { return 0; }
+static int NetDelClient(int ClientID, const char *pReason, void *pUser) { return 0; }
+
+static void NetSendChunk(NETSOCKET Socket, NETADDR *pAddr, int Value)
+{
+	CNetPacketConstruct Construct;
+	mem_zero(&Construct, sizeof(Construct));
+	CNetChunkHeader Header;
+	Header.m_Flags = 0;
+	Header.m_Size = sizeof(Value);
+	Header.m_Sequence = 0;
+	unsigned char *pData = Header.Pack(Construct.m_aChunkData);
+	mem_copy(pData, &Value, sizeof(Value));
+	Construct.m_DataSize = (int)(pData + sizeof(Value) - Construct.m_aChunkData);
+	Construct.m_NumChunks = 1;
+	CNetBase::SendPacket(Socket, pAddr, &Construct, NET_SECURITY_TOKEN_UNSUPPORTED);
+}
+
+// receives until no packet arrived for a while, returns the number of
+// chunks and adds the time spent in Recv to pRecvTime
+static int NetDrain(CNetServer *pServer, int Expected, int64_t *pRecvTime)
+{
+	int Received = 0;
+	CNetChunk Chunk;
+	SECURITY_TOKEN ResponseToken;
+	while(true)
+	{
+		const int64_t Start = time_get();
+		while(pServer->Recv(&Chunk, &ResponseToken))
+			Received++;
+		*pRecvTime += time_get() - Start;
+		if(!net_socket_read_wait(pServer->Socket(), Received < Expected ? 1000000 : 1000))
+			return Received;
+	}
+}
+
+static void BenchNetRecv(int Iterations)
+{
+	CNetBase::Init();
+	g_Config.m_SvVanillaAntiSpoof = 0;
+	g_Config.m_SvConnlimit = 0;
+	g_Config.m_Password[0] = 0;
+
+	CNetServer Server;
+	NETADDR BindAddr = {};
+	BindAddr.type = NETTYPE_IPV4;
+	do
+	{
+		BindAddr.port = secure_rand() % 64511 + 1024;
+	} while(!Server.Open(BindAddr, nullptr, NET_MAX_CLIENTS, NET_MAX_CLIENTS));
+	Server.SetCallbacks(NetNewClient, NetNewClientNoAuth, NetClientRejoin, NetDelClient, nullptr);
+	NETADDR ServerAddr;
+	net_addr_from_str(&ServerAddr, "127.0.0.1");
+	ServerAddr.port = BindAddr.port;
+
+	// vanilla connects without anti spoof are accepted right away
+	std::vector<NETSOCKET> vClients;
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		NETADDR ClientAddr = {};
+		ClientAddr.type = NETTYPE_IPV4;
+		NETSOCKET Socket = net_udp_create(ClientAddr);
+		if(!Socket)
+			break;
+		vClients.push_back(Socket);
+		CNetBase::SendControlMsg(Socket, &ServerAddr, 0, NET_CTRLMSG_CONNECT, nullptr, 0, NET_SECURITY_TOKEN_UNSUPPORTED);
+	}
+	int64_t RecvTime = 0;
+	NetDrain(&Server, 0, &RecvTime);
+
+	// a stream of packets from all clients, in batches small enough for
+	// the socket receive buffer
+	const int Batch = 2;
+	int Received = 0;
+	RecvTime = 0;
+	for(int Round = 0; Round < Iterations; Round++)
+	{
+		for(int b = 0; b < Batch; b++)
+			for(int i = 0; i < (int)vClients.size(); i++)
+				NetSendChunk(vClients[i], &ServerAddr, i);
+		Received += NetDrain(&Server, Batch * (int)vClients.size(), &RecvTime);
+	}
+
+	dbg_msg("net_recv", "clients=%d packets=%d recv=%.3fms (%.0f packets/s)",
+		(int)vClients.size(), Received, RecvTime * 1000.0 / time_freq(),
+		Received / (maximum(RecvTime, (int64_t)1) / (double)time_freq()));
+
+	for(auto Socket : vClients)
+		net_udp_close(Socket);
+	Server.Close();
+}
+
+static void BenchHuffman(int Iterations)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	// mostly small values and zeros, like packed snapshot deltas
+	const int PacketSize = 1200;
+	const int NumPackets = 64;
+	static unsigned char s_aaInput[NumPackets][PacketSize];
+	static unsigned char s_aaCompressed[NumPackets][2048];
+	int aCompressedSize[NumPackets];
+	unsigned char aDecompressed[PacketSize];
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	for(auto &aInput : s_aaInput)
+	{
+		for(auto &Byte : aInput)
+		{
+			const unsigned Value = Prng.RandomBits() >> 8;
+			Byte = Value % 3 == 0 ? 0 : Value % 7 == 0 ? Value >> 4 : Value % 24;
+		}
+	}
+
+	int64_t CompressTime = 0;
+	int64_t DecompressTime = 0;
+	int64_t CompressedBytes = 0;
+	int Failed = 0;
+	for(int Round = 0; Round < Iterations; Round++)
+	{
+		int64_t Start = time_get();
+		for(int i = 0; i < NumPackets; i++)
+			aCompressedSize[i] = Huffman.Compress(s_aaInput[i], PacketSize, s_aaCompressed[i], sizeof(s_aaCompressed[i]));
+		CompressTime += time_get() - Start;
+
+		Start = time_get();
+		for(int i = 0; i < NumPackets; i++)
+			Failed += Huffman.Decompress(s_aaCompressed[i], aCompressedSize[i], aDecompressed, sizeof(aDecompressed)) != PacketSize;
+		DecompressTime += time_get() - Start;
+
+		for(int Size : aCompressedSize)
+			CompressedBytes += Size;
+	}
+
+	const double Bytes = (double)PacketSize * NumPackets * Iterations;
+	dbg_msg("huffman", "ratio=%.3f compress=%.1fMB/s decompress=%.1fMB/s failed=%d",
+		CompressedBytes / Bytes,
+		Bytes / (maximum(CompressTime, (int64_t)1) / (double)time_freq()) / 1e6,
+		Bytes / (maximum(DecompressTime, (int64_t)1) / (double)time_freq()) / 1e6,
+		Failed);
+}
+
+static void BenchIntersectLine(int Iterations)
+{
+	CBenchMap Map;
+	if(!Map.Load())
+		return;
+	const CCollision *pCollision = &Map.m_Collision;
+
+	// laser sized rays starting in air, like the ones the game traces
+	const int NumRays = 20000;
+	std::vector<vec2> vRays;
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	while((int)vRays.size() < 2 * NumRays)
+	{
+		vec2 Pos0 = vec2(RandomFloat(&Prng, 0.0f, pCollision->GetWidth() * 32.0f), RandomFloat(&Prng, 0.0f, pCollision->GetHeight() * 32.0f));
+		if(pCollision->CheckPoint(Pos0))
+			continue;
+		vRays.push_back(Pos0);
+		vRays.push_back(Pos0 + direction(RandomFloat(&Prng, -pi, pi)) * 800.0f);
+	}
+
+	const int OldPixelIntersect = g_Config.m_DbgPixelIntersect;
+	int64_t aTime[2];
+	int aChecksum[2];
+	for(int PixelIntersect = 0; PixelIntersect < 2; PixelIntersect++)
+	{
+		g_Config.m_DbgPixelIntersect = PixelIntersect;
+		aChecksum[PixelIntersect] = 0;
+		const int64_t Start = time_get();
+		for(int j = 0; j < Iterations; j++)
+		{
+			for(int i = 0; i < NumRays; i++)
+			{
+				vec2 Collision;
+				aChecksum[PixelIntersect] += pCollision->IntersectLine(vRays[2 * i], vRays[2 * i + 1], &Collision, nullptr);
+				aChecksum[PixelIntersect] += round_to_int(Collision.x + Collision.y);
+			}
+		}
+		aTime[PixelIntersect] = maximum(time_get() - Start, (int64_t)1);
+	}
+	g_Config.m_DbgPixelIntersect = OldPixelIntersect;
+
+	const double Rays = (double)NumRays * Iterations;
+	dbg_msg("intersect_line", "rays=%d traversal=%.0f rays/s pixels=%.0f rays/s checksum %s",
+		NumRays, Rays / (aTime[0] / (double)time_freq()), Rays / (aTime[1] / (double)time_freq()),
+		aChecksum[0] == aChecksum[1] ? "match" : "differ");
+}
+
+static void BenchMoveBox(int Iterations)
+{
+	CBenchMap Map;
+	if(!Map.Load())
+		return;
+	const CCollision *pCollision = &Map.m_Collision;
+
+	// boxes of tee size moving like falling and running tees
+	const int NumBoxes = 2000;
+	std::vector<vec2> vPositions;
+	std::vector<vec2> vVelocities;
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	while((int)vPositions.size() < NumBoxes)
+	{
+		vec2 Pos = vec2(RandomFloat(&Prng, 0.0f, pCollision->GetWidth() * 32.0f), RandomFloat(&Prng, 0.0f, pCollision->GetHeight() * 32.0f));
+		if(pCollision->TestBox(Pos, vec2(28.0f, 28.0f)))
+			continue;
+		vPositions.push_back(Pos);
+		vVelocities.push_back(vec2(RandomFloat(&Prng, -10.0f, 10.0f), RandomFloat(&Prng, -15.0f, 15.0f)));
+	}
+
+	const int64_t Start = time_get();
+	for(int Tick = 0; Tick < Iterations; Tick++)
+	{
+		for(int i = 0; i < NumBoxes; i++)
+		{
+			vVelocities[i].y += 0.5f;
+			pCollision->MoveBox(&vPositions[i], &vVelocities[i], vec2(28.0f, 28.0f), 0.0f);
+		}
+	}
+	const int64_t Time = maximum(time_get() - Start, (int64_t)1);
+
+	dbg_msg("move_box", "boxes=%d %.0f moves/s", NumBoxes, (double)Iterations * NumBoxes / (Time / (double)time_freq()));
+}
+
+static void BenchMapIndices(int Iterations)
+{
+	CBenchMap Map;
+	if(!Map.Load())
+		return;
+	const CCollision *pCollision = &Map.m_Collision;
+
+	// the anti-skip tile lookup every character does each tick
+	const int NumCharacters = MAX_CLIENTS;
+	std::vector<vec2> vPositions;
+	std::vector<vec2> vVelocities;
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		vPositions.push_back(vec2(RandomFloat(&Prng, 0.0f, pCollision->GetWidth() * 32.0f), RandomFloat(&Prng, 0.0f, pCollision->GetHeight() * 32.0f)));
+		vVelocities.push_back(vec2(RandomFloat(&Prng, -20.0f, 20.0f), RandomFloat(&Prng, -20.0f, 20.0f)));
+	}
+
+	int64_t Sum = 0;
+	const int64_t Start = time_get();
+	for(int Tick = 0; Tick < Iterations; Tick++)
+	{
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			const vec2 PrevPos = vPositions[i] + vVelocities[i] * (Tick % 100);
+			for(int Index : pCollision->GetMapIndices(PrevPos, PrevPos + vVelocities[i]))
+				Sum += Index;
+		}
+	}
+	const int64_t Time = time_get() - Start;
+
+	dbg_msg("map_indices", "characters=%d %.2fus/tick sum=%lld",
+		NumCharacters, Time * 1000000.0 / time_freq() / Iterations, (long long)Sum);
+}
+
+static void BenchPlayerMaps(int Iterations)
+{
+	// 64 players running around a large map in a few teams
+	CTeamsCore Teams;
+	vec2 aPos[MAX_CLIENTS];
+	vec2 aVel[MAX_CLIENTS];
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		aPos[i] = vec2(RandomFloat(&Prng, 0.0f, 8000.0f), RandomFloat(&Prng, 0.0f, 4000.0f));
+		aVel[i] = vec2(RandomFloat(&Prng, -20.0f, 20.0f), RandomFloat(&Prng, -20.0f, 20.0f));
+		Teams.Team(i, Prng.RandomBits() % 4);
+	}
+
+	const int aNumVanilla[] = {MAX_CLIENTS, 8};
+	for(int NumVanilla : aNumVanilla)
+	{
+		int aaMaps[MAX_CLIENTS][VANILLA_MAX_CLIENTS];
+		for(auto &aMap : aaMaps)
+			for(int &ID : aMap)
+				ID = -1;
+
+		CPlayerMaps Maps;
+		int Remaps = 0;
+		int64_t Time = 0;
+		for(int Update = 0; Update < Iterations; Update++)
+		{
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				aPos[i] += aVel[i] * 5.0f;
+				if(aPos[i].x < 0.0f || aPos[i].x > 8000.0f)
+					aVel[i].x = -aVel[i].x;
+				if(aPos[i].y < 0.0f || aPos[i].y > 4000.0f)
+					aVel[i].y = -aVel[i].y;
+			}
+
+			const int64_t Start = time_get();
+			Maps.Reset();
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				CPlayerMaps::CClient &Client = Maps.m_aClients[i];
+				Client.m_State = CPlayerMaps::STATE_CHARACTER;
+				Client.m_Show = i < NumVanilla ? CPlayerMaps::SHOW_COLLIDING : CPlayerMaps::SHOW_ALL;
+				Client.m_ViewPos = aPos[i];
+				Client.m_Pos = aPos[i];
+			}
+			for(int i = 0; i < NumVanilla; i++)
+				Remaps += Maps.UpdateMap(i, aaMaps[i], &Teams, 256.0f);
+			Time += time_get() - Start;
+		}
+
+		dbg_msg("player_maps", "clients=%d vanilla=%d %.2fus/update %.2f remaps/update",
+			MAX_CLIENTS, NumVanilla, Time * 1000000.0 / time_freq() / Iterations, Remaps / (double)Iterations);
+	}
+}
+
+static void BenchSnapGrid(int Iterations)
+{
+	// a big map with lots of entities, viewed by 64 clients
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	const int NumBoxes = 5000;
+	const int NumViews = 64;
+	std::vector<vec2> vMins;
+	std::vector<vec2> vMaxs;
+	for(int i = 0; i < NumBoxes; i++)
+	{
+		// mostly small entities and some lasers
+		const vec2 Min = vec2(RandomFloat(&Prng, 0.0f, 16000.0f), RandomFloat(&Prng, 0.0f, 8000.0f));
+		const float Size = i % 10 == 0 ? 800.0f : 64.0f;
+		vMins.push_back(Min);
+		vMaxs.push_back(Min + vec2(RandomFloat(&Prng, 0.0f, Size), RandomFloat(&Prng, 0.0f, Size)));
+	}
+	std::vector<vec2> vViews;
+	for(int i = 0; i < NumViews; i++)
+		vViews.push_back(vec2(RandomFloat(&Prng, 0.0f, 16000.0f), RandomFloat(&Prng, 0.0f, 8000.0f)));
+	const vec2 ShowDistance = vec2(1200.0f, 1200.0f);
+
+	CSnapGrid Grid;
+	std::vector<int> vIndices;
+	int64_t Found = 0;
+	const int64_t Start = time_get();
+	for(int Tick = 0; Tick < Iterations; Tick++)
+	{
+		Grid.Clear();
+		for(int i = 0; i < NumBoxes; i++)
+			Grid.Add(i, vMins[i], vMaxs[i]);
+		Grid.Build();
+		for(const vec2 &View : vViews)
+		{
+			Grid.Query(View - ShowDistance, View + ShowDistance, &vIndices);
+			Found += vIndices.size();
+		}
+	}
+	const int64_t Time = time_get() - Start;
+
+	dbg_msg("snap_grid", "boxes=%d clients=%d %.2fus/tick visible=%.1f/client",
+		NumBoxes, NumViews, Time * 1000000.0 / time_freq() / Iterations,
+		Found / (double)Iterations / NumViews);
+}
+
+static void BenchSnapItems(int Iterations)
+{
+	// projectiles and lasers on a big map, snapped for 64 clients
+	CPrng Prng;
+	SeedPrng(&Prng, 1);
+	const int NumItems = 2000;
+	const int NumViews = 64;
+	struct CBenchItem
+	{
+		vec2 m_Pos;
+		vec2 m_From;
+		int m_aData[6];
+	};
+	std::vector<CBenchItem> vItems(NumItems);
+	for(auto &Item : vItems)
+	{
+		Item.m_Pos = vec2(RandomFloat(&Prng, 0.0f, 16000.0f), RandomFloat(&Prng, 0.0f, 8000.0f));
+		Item.m_From = Item.m_Pos + vec2(RandomFloat(&Prng, -400.0f, 400.0f), RandomFloat(&Prng, -400.0f, 400.0f));
+		for(int &Data : Item.m_aData)
+			Data = RandomValue(&Prng);
+	}
+	std::vector<CSnapItems::CView> vViews(NumViews);
+	for(int i = 0; i < NumViews; i++)
+	{
+		vViews[i].m_ClientID = i;
+		vViews[i].m_Version = 16050;
+		vViews[i].m_Sixup = false;
+		vViews[i].m_ShowAll = false;
+		vViews[i].m_Pos = vec2(RandomFloat(&Prng, 0.0f, 16000.0f), RandomFloat(&Prng, 0.0f, 8000.0f));
+		vViews[i].m_ShowDistance = vec2(1000.0f, 800.0f);
+	}
+
+	static CSnapshotBuilder s_Builder;
+	static char s_aData[CSnapshot::MAX_SIZE];
+	CSnapItems Items;
+	std::vector<int> vVisible;
+	int64_t aTimes[3] = {0, 0, 0};
+	unsigned aChecksums[3] = {0, 0, 0};
+	for(int Mode = 0; Mode < 3; Mode++)
+	{
+		for(int Tick = 0; Tick < Iterations; Tick++)
+		{
+			const int64_t Start = time_get();
+			if(Mode > 0)
+			{
+				// built once per tick
+				Items.Clear();
+				for(int i = 0; i < NumItems; i++)
+					mem_copy(Items.Add(CSnapItems::CFilter(vItems[i].m_Pos, vItems[i].m_From), 9, i, sizeof(vItems[i].m_aData)), vItems[i].m_aData, sizeof(vItems[i].m_aData));
+				if(Mode == 2)
+					Items.BuildGrid();
+			}
+			for(const auto &View : vViews)
+			{
+				s_Builder.Init();
+				if(Mode == 0)
+				{
+					// every client checks and fills every item, like the Snap functions
+					for(int i = 0; i < NumItems; i++)
+					{
+						const CBenchItem &Item = vItems[i];
+						if(!CSnapItems::Passes(CSnapItems::CFilter(Item.m_Pos, Item.m_From), View))
+							continue;
+						int *pData = (int *)s_Builder.NewItem(9, i, sizeof(Item.m_aData));
+						for(int j = 0; j < 6; j++)
+							pData[j] = Item.m_aData[j];
+					}
+				}
+				else
+				{
+					Items.Visible(View, &vVisible);
+					for(int i : vVisible)
+						mem_copy(s_Builder.NewItem(9, i, Items.Item(i).m_Size), Items.Data(i), Items.Item(i).m_Size);
+				}
+				const int Size = s_Builder.Finish(s_aData);
+				if(Tick == 0)
+					aChecksums[Mode] = aChecksums[Mode] * 31 + ((CSnapshot *)s_aData)->Crc() + Size;
+			}
+			aTimes[Mode] += time_get() - Start;
+		}
+	}
+
+	dbg_msg("snap_items", "items=%d clients=%d per-client=%.2fus/tick shared=%.2fus/tick grid=%.2fus/tick snapshots %s",
+		NumItems, NumViews,
+		aTimes[0] * 1000000.0 / time_freq() / Iterations,
+		aTimes[1] * 1000000.0 / time_freq() / Iterations,
+		aTimes[2] * 1000000.0 / time_freq() / Iterations,
+		aChecksums[0] == aChecksums[1] && aChecksums[0] == aChecksums[2] ? "match" : "differ");
+}
+
+struct CBenchmark
+{
+	const char *m_pName;
+	void (*m_pfnRun)(int Iterations);
+	int m_Iterations;
+};
+
+static const CBenchmark s_aBenchmarks[] = {
+	{"snapshot_delta", BenchSnapshotDelta, 1000},
+	{"diff_item", BenchDiffItem, 200},
+	{"varint", BenchVarInt, 200},
+	{"huffman", BenchHuffman, 100},
+	{"net_recv", BenchNetRecv, 50},
+	{"intersect_line", BenchIntersectLine, 5},
+	{"move_box", BenchMoveBox, 200},
+	{"map_indices", BenchMapIndices, 2000},
+	{"player_maps", BenchPlayerMaps, 2000},
+	{"snap_grid", BenchSnapGrid, 100},
+	{"snap_items", BenchSnapItems, 100},
+};
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("secure", "could not initialize secure RNG");
+		return -1;
+	}
+
+	if(argc > 3)
+	{
+		dbg_msg("usage", "%s [benchmark] [iterations]", argv[0]);
+		return -1;
+	}
+	const char *pName = argc > 1 ? argv[1] : nullptr;
+	const int Iterations = argc > 2 ? str_toint(argv[2]) : 0;
+
+	bool Found = false;
+	for(const auto &Benchmark : s_aBenchmarks)
+	{
+		if(pName && str_comp(pName, "all") != 0 && str_comp(pName, Benchmark.m_pName) != 0)
+			continue;
+		Found = true;
+		Benchmark.m_pfnRun(Iterations > 0 ? Iterations : Benchmark.m_Iterations);
+	}
+	if(!Found)
+	{
+		dbg_msg("micro_bench", "unknown benchmark '%s', available:", pName);
+		for(const auto &Benchmark : s_aBenchmarks)
+			dbg_msg("micro_bench", "  %s", Benchmark.m_pName);
+	}
+
+	secure_random_uninit();
+	return Found ? 0 : -1;
+}
@@ -0,0 +1,173 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+#include <game/prng.h>
+#include <game/teamscore.h>
+
+#include <memory>
+#include <vector>
+
+// Steps characters with scripted inputs on a map without a server, to
+// measure the cost of the character physics alone.
+
+// holds a random input for a random number of ticks, like a player
+// running around, jumping and hooking
+class CScriptedInput
+{
+	CPrng m_Prng;
+	int m_NextChange;
+
+public:
+	CNetObj_PlayerInput m_Input;
+
+	void Init(unsigned Seed)
+	{
+		uint64_t aSeed[2] = {Seed, 0};
+		m_Prng.Seed(aSeed);
+		m_NextChange = 0;
+		mem_zero(&m_Input, sizeof(m_Input));
+		m_Input.m_TargetY = -1;
+	}
+
+	void Tick(int Tick)
+	{
+		if(Tick < m_NextChange)
+			return;
+		m_NextChange = Tick + 5 + m_Prng.RandomBits() % 40;
+		m_Input.m_Direction = (int)(m_Prng.RandomBits() % 3) - 1;
+		m_Input.m_Jump = m_Prng.RandomBits() % 4 == 0;
+		m_Input.m_Hook = m_Prng.RandomBits() % 3 == 0;
+		// aim anywhere, but mostly upwards
+		m_Input.m_TargetX = (int)(m_Prng.RandomBits() % 601) - 300;
+		m_Input.m_TargetY = (int)(m_Prng.RandomBits() % 401) - 300;
+		if(m_Input.m_TargetX == 0 && m_Input.m_TargetY == 0)
+			m_Input.m_TargetY = -1;
+	}
+};
+
+static std::vector<vec2> FindSpawns(const CCollision &Collision)
+{
+	std::vector<vec2> vSpawns;
+	for(int y = 0; y < Collision.GetHeight(); y++)
+	{
+		for(int x = 0; x < Collision.GetWidth(); x++)
+		{
+			int Entity = Collision.GetTileIndex(y * Collision.GetWidth() + x) - ENTITY_OFFSET;
+			if(Entity == ENTITY_SPAWN || Entity == ENTITY_SPAWN_RED || Entity == ENTITY_SPAWN_BLUE)
+				vSpawns.emplace_back(x * 32.0f + 16.0f, y * 32.0f + 16.0f);
+		}
+	}
+	return vSpawns;
+}
+
+static double Microseconds(int64_t Time, int Ticks)
+{
+	return Time * 1000000.0 / time_freq() / Ticks;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2 || argc > 5)
+	{
+		dbg_msg("physics_bench", "Usage: %s <map> [characters=64] [ticks=5000] [seed=1]", argv[0]);
+		return -1;
+	}
+	const int NumCharacters = argc > 2 ? clamp(str_toint(argv[2]), 1, (int)MAX_CLIENTS) : MAX_CLIENTS;
+	const int NumTicks = argc > 3 ? maximum(str_toint(argv[3]), 1) : 5000;
+	const unsigned Seed = argc > 4 ? str_toint(argv[4]) : 1;
+
+	std::unique_ptr<IKernel> pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+	IEngineMap *pMap = CreateEngineMap();
+	pKernel->RegisterInterface(CreateLocalStorage());
+	pKernel->RegisterInterface(pMap);
+	pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+	if(!pMap->Load(argv[1]))
+	{
+		dbg_msg("physics_bench", "failed to load map '%s'", argv[1]);
+		return -1;
+	}
+
+	CLayers Layers;
+	CCollision Collision;
+	Layers.Init(pKernel.get());
+	Collision.Init(&Layers);
+
+	std::vector<vec2> vSpawns = FindSpawns(Collision);
+	if(vSpawns.empty())
+	{
+		dbg_msg("physics_bench", "map '%s' has no spawn", argv[1]);
+		return -1;
+	}
+
+	CWorldCore World;
+	World.InitSwitchers(Collision.m_HighestSwitchNumber);
+	CTeamsCore Teams;
+	std::vector<CCharacterCore> vCores(NumCharacters);
+	std::vector<CScriptedInput> vInputs(NumCharacters);
+	for(int i = 0; i < NumCharacters; i++)
+	{
+		CCharacterCore &Core = vCores[i];
+		Core.Init(&World, &Collision, &Teams);
+		Core.m_Id = i;
+		Core.m_Pos = vSpawns[i % vSpawns.size()];
+		World.m_apCharacters[i] = &Core;
+		vInputs[i].Init(Seed * 7919 + i);
+	}
+
+	// the phases are timed separately in the order the server runs them
+	int64_t TickTime = 0;
+	int64_t TickDeferredTime = 0;
+	int64_t MoveTime = 0;
+	const int64_t Start = time_get();
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		int64_t PhaseStart = time_get();
+		World.BuildBroadphase();
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			vInputs[i].Tick(Tick);
+			vCores[i].m_Input = vInputs[i].m_Input;
+			vCores[i].Tick(true, false);
+		}
+		int64_t Now = time_get();
+		TickTime += Now - PhaseStart;
+		PhaseStart = Now;
+
+		for(auto &Core : vCores)
+			Core.TickDeferred();
+		Now = time_get();
+		TickDeferredTime += Now - PhaseStart;
+		PhaseStart = Now;
+
+		for(auto &Core : vCores)
+		{
+			Core.Move();
+			Core.Quantize();
+		}
+		Now = time_get();
+		MoveTime += Now - PhaseStart;
+	}
+	const int64_t Total = time_get() - Start;
+
+	// the positions only depend on the map, the arguments and the physics,
+	// so a changed checksum means the physics changed
+	unsigned Checksum = 0;
+	for(const auto &Core : vCores)
+		Checksum = Checksum * 31 + (unsigned)round_to_int(Core.m_Pos.x) * 17 + (unsigned)round_to_int(Core.m_Pos.y);
+
+	dbg_msg("physics_bench", "map='%s' characters=%d ticks=%d seed=%u checksum=%08x", argv[1], NumCharacters, NumTicks, Seed, Checksum);
+	dbg_msg("physics_bench", "ticks/s=%.0f total=%.2fus/tick tick=%.2fus tickdeferred=%.2fus move=%.2fus",
+		NumTicks * (double)time_freq() / maximum(Total, (int64_t)1), Microseconds(Total, NumTicks),
+		Microseconds(TickTime, NumTicks), Microseconds(TickDeferredTime, NumTicks), Microseconds(MoveTime, NumTicks));
+	return 0;
+}
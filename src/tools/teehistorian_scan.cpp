@@ -0,0 +1,323 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/teehistorian_reader.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Decodes a teehistorian file. With an index written next to it, the blocks
+// between its keyframes are decoded in parallel, and jumping to a tick only
+// decodes the block containing it.
+
+static const char *const s_apRecordNames[] = {
+	"tick",
+	"finish",
+	"player_new",
+	"player_diff",
+	"player_old",
+	"input_new",
+	"input_diff",
+	"message",
+	"join",
+	"drop",
+	"console_command",
+	"keyframe",
+	"ex",
+};
+static_assert(std::size(s_apRecordNames) == CTeeHistorianReader::NUM_RECORDS, "a record name is missing");
+
+class CSegment
+{
+public:
+	int64_t m_Offset;
+	int64_t m_Size;
+	// -1 if the segment doesn't start with a keyframe
+	int m_Tick;
+};
+
+class CScan
+{
+public:
+	const char *m_pFilename;
+	CTeeHistorianReader::CHeader m_Header;
+	std::vector<CSegment> m_vSegments;
+	std::atomic<int> m_NextSegment;
+
+	class CWorker
+	{
+	public:
+		CScan *m_pScan;
+		int64_t m_RawBytes;
+		int64_t m_aNumRecords[CTeeHistorianReader::NUM_RECORDS];
+		int m_FirstTick;
+		int m_LastTick;
+		int m_NumErrors;
+	};
+};
+
+// `io_seek` only takes an int
+static bool SeekTo(IOHANDLE File, int64_t Offset)
+{
+	if(io_seek(File, 0, IOSEEK_START))
+		return false;
+	while(Offset > 0)
+	{
+		const int Step = minimum(Offset, (int64_t)1 << 30);
+		if(io_seek(File, Step, IOSEEK_CUR))
+			return false;
+		Offset -= Step;
+	}
+	return true;
+}
+
+// reads the segment and prepares the reader for decoding it
+static bool LoadSegment(IOHANDLE File, const CTeeHistorianReader::CHeader &Header, const CSegment &Segment, std::vector<unsigned char> *pvFile, std::vector<unsigned char> *pvRaw, CTeeHistorianReader *pReader)
+{
+	if(Segment.m_Size > 0x7fffffff || !SeekTo(File, Segment.m_Offset))
+		return false;
+	pvFile->resize(Segment.m_Size);
+	if(io_read(File, pvFile->data(), Segment.m_Size) != (unsigned)Segment.m_Size)
+		return false;
+	pvRaw->clear();
+	if(Header.m_Compressed)
+	{
+		if(!CTeeHistorianReader::Decompress(pvFile->data(), pvFile->size(), pvRaw))
+			return false;
+	}
+	else
+	{
+		pvRaw->swap(*pvFile);
+	}
+	if(pvRaw->size() > 0x7fffffff)
+		return false;
+	pReader->Reset();
+	pReader->SetData(pvRaw->data(), pvRaw->size());
+	return true;
+}
+
+static void Worker(void *pUser)
+{
+	CScan::CWorker *pWorker = (CScan::CWorker *)pUser;
+	CScan *pScan = pWorker->m_pScan;
+	IOHANDLE File = io_open(pScan->m_pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		pWorker->m_NumErrors++;
+		return;
+	}
+
+	std::vector<unsigned char> vFile;
+	std::vector<unsigned char> vRaw;
+	CTeeHistorianReader Reader;
+	CTeeHistorianReader::CRecord Record;
+	while(true)
+	{
+		const int Index = pScan->m_NextSegment.fetch_add(1);
+		if(Index >= (int)pScan->m_vSegments.size())
+			break;
+		const CSegment &Segment = pScan->m_vSegments[Index];
+		if(!LoadSegment(File, pScan->m_Header, Segment, &vFile, &vRaw, &Reader))
+		{
+			dbg_msg("teehistorian_scan", "failed to read the segment at offset %lld", (long long)Segment.m_Offset);
+			pWorker->m_NumErrors++;
+			continue;
+		}
+		pWorker->m_RawBytes += vRaw.size();
+
+		bool First = true;
+		while(Reader.Next(&Record))
+		{
+			if(First && Segment.m_Tick >= 0 && (Record.m_Type != CTeeHistorianReader::RECORD_KEYFRAME || Record.m_Tick != Segment.m_Tick))
+			{
+				dbg_msg("teehistorian_scan", "segment at offset %lld doesn't start with a keyframe of tick %d", (long long)Segment.m_Offset, Segment.m_Tick);
+				pWorker->m_NumErrors++;
+			}
+			First = false;
+			pWorker->m_aNumRecords[Record.m_Type]++;
+		}
+		if(Reader.Error())
+		{
+			dbg_msg("teehistorian_scan", "failed to decode the segment at offset %lld after tick %d", (long long)Segment.m_Offset, Reader.Tick());
+			pWorker->m_NumErrors++;
+		}
+		pWorker->m_FirstTick = minimum(pWorker->m_FirstTick, Segment.m_Tick >= 0 ? Segment.m_Tick : 0);
+		pWorker->m_LastTick = maximum(pWorker->m_LastTick, Reader.Tick());
+	}
+	io_close(File);
+}
+
+static int ScanAll(CScan *pScan, int NumThreads)
+{
+	std::vector<CScan::CWorker> vWorkers(minimum(NumThreads, (int)pScan->m_vSegments.size()));
+	std::vector<void *> vpThreads;
+	const int64_t Start = time_get();
+	pScan->m_NextSegment.store(0);
+	for(auto &Worker : vWorkers)
+	{
+		mem_zero(&Worker, sizeof(Worker));
+		Worker.m_pScan = pScan;
+		Worker.m_FirstTick = 0x7fffffff;
+	}
+	for(auto &Worker : vWorkers)
+		vpThreads.push_back(thread_init(::Worker, &Worker, "teehistorian_scan"));
+	for(void *pThread : vpThreads)
+		thread_wait(pThread);
+	const double Seconds = maximum((time_get() - Start) / (double)time_freq(), 1e-9);
+
+	CScan::CWorker Total;
+	mem_zero(&Total, sizeof(Total));
+	Total.m_FirstTick = 0x7fffffff;
+	for(const auto &Worker : vWorkers)
+	{
+		Total.m_RawBytes += Worker.m_RawBytes;
+		for(int i = 0; i < CTeeHistorianReader::NUM_RECORDS; i++)
+			Total.m_aNumRecords[i] += Worker.m_aNumRecords[i];
+		Total.m_FirstTick = minimum(Total.m_FirstTick, Worker.m_FirstTick);
+		Total.m_LastTick = maximum(Total.m_LastTick, Worker.m_LastTick);
+		Total.m_NumErrors += Worker.m_NumErrors;
+	}
+
+	dbg_msg("teehistorian_scan", "segments=%d threads=%d ticks=%d-%d raw=%.2fMiB time=%.3fs rate=%.1fMiB/s errors=%d",
+		(int)pScan->m_vSegments.size(), (int)vWorkers.size(), Total.m_FirstTick, Total.m_LastTick,
+		Total.m_RawBytes / 1024.0 / 1024.0, Seconds, Total.m_RawBytes / 1024.0 / 1024.0 / Seconds, Total.m_NumErrors);
+	for(int i = 0; i < CTeeHistorianReader::NUM_RECORDS; i++)
+		dbg_msg("teehistorian_scan", "%s=%lld", s_apRecordNames[i], (long long)Total.m_aNumRecords[i]);
+	return Total.m_NumErrors ? -1 : 0;
+}
+
+static int ShowTick(CScan *pScan, int Tick)
+{
+	// the last segment starting before the tick contains all of its records
+	int Index = 0;
+	while(Index + 1 < (int)pScan->m_vSegments.size() && pScan->m_vSegments[Index + 1].m_Tick <= Tick)
+		Index++;
+	const CSegment &Segment = pScan->m_vSegments[Index];
+
+	const int64_t Start = time_get();
+	IOHANDLE File = io_open(pScan->m_pFilename, IOFLAG_READ);
+	std::vector<unsigned char> vFile;
+	std::vector<unsigned char> vRaw;
+	CTeeHistorianReader Reader;
+	if(!File || !LoadSegment(File, pScan->m_Header, Segment, &vFile, &vRaw, &Reader))
+	{
+		dbg_msg("teehistorian_scan", "failed to read the segment at offset %lld", (long long)Segment.m_Offset);
+		if(File)
+			io_close(File);
+		return -1;
+	}
+	io_close(File);
+
+	CTeeHistorianReader::CRecord Record;
+	while(Reader.Next(&Record))
+	{
+		// stop before the next tick changes anything
+		if(Record.m_Type == CTeeHistorianReader::RECORD_TICK && Record.m_Tick > Tick)
+			break;
+	}
+	if(Reader.Error())
+	{
+		dbg_msg("teehistorian_scan", "failed to decode the segment at offset %lld after tick %d", (long long)Segment.m_Offset, Reader.Tick());
+		return -1;
+	}
+	const double Seconds = (time_get() - Start) / (double)time_freq();
+
+	if(Reader.Tick() < Tick && Index + 1 == (int)pScan->m_vSegments.size())
+		dbg_msg("teehistorian_scan", "the file ends at tick %d", Reader.Tick());
+	dbg_msg("teehistorian_scan", "tick=%d segment=%d/%d segment_tick=%d raw=%.2fMiB time=%.3fs",
+		Tick, Index + 1, (int)pScan->m_vSegments.size(), Segment.m_Tick, vRaw.size() / 1024.0 / 1024.0, Seconds);
+	for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+	{
+		const CTeeHistorianReader::CPlayer &Player = Reader.Player(ClientID);
+		if(!Player.m_Alive && !Player.m_HasInput)
+			continue;
+		char aPos[64];
+		if(Player.m_Alive)
+			str_format(aPos, sizeof(aPos), "pos=%d,%d", Player.m_X, Player.m_Y);
+		else
+			str_copy(aPos, "dead");
+		const CNetObj_PlayerInput &Input = Player.m_Input;
+		dbg_msg("teehistorian_scan", "cid=%d team=%d%s %s dir=%d target=%d,%d jump=%d fire=%d hook=%d weapon=%d",
+			ClientID, Player.m_Team, Reader.Practice(Player.m_Team) ? " (practice)" : "", aPos,
+			Input.m_Direction, Input.m_TargetX, Input.m_TargetY, Input.m_Jump, Input.m_Fire, Input.m_Hook, Input.m_WantedWeapon);
+	}
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2 || argc > 4)
+	{
+		dbg_msg("teehistorian_scan", "Usage: %s <file> [tick|all] [threads]", argv[0]);
+		return -1;
+	}
+	const bool All = argc < 3 || str_comp(argv[2], "all") == 0;
+	const int Tick = All ? -1 : str_toint(argv[2]);
+	const int NumThreads = argc > 3 ? maximum(str_toint(argv[3]), 1) : maximum((int)std::thread::hardware_concurrency(), 1);
+
+	CScan Scan;
+	Scan.m_pFilename = argv[1];
+	IOHANDLE File = io_open(Scan.m_pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("teehistorian_scan", "failed to open '%s'", Scan.m_pFilename);
+		return -1;
+	}
+	const int64_t FileSize = io_length(File);
+
+	// the header ends with a null byte
+	std::vector<unsigned char> vHeader;
+	unsigned char aBuf[16 * 1024];
+	unsigned Read;
+	while((vHeader.size() <= sizeof(CUuid) || !mem_has_null(vHeader.data() + sizeof(CUuid), vHeader.size() - sizeof(CUuid))) && (Read = io_read(File, aBuf, sizeof(aBuf))))
+		vHeader.insert(vHeader.end(), aBuf, aBuf + Read);
+	io_close(File);
+	if(!CTeeHistorianReader::ParseHeader(vHeader.data(), vHeader.size(), &Scan.m_Header))
+	{
+		dbg_msg("teehistorian_scan", "'%s' isn't a supported teehistorian file", Scan.m_pFilename);
+		return -1;
+	}
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", Scan.m_pFilename);
+	IOHANDLE IndexFile = io_open(aIndexFilename, IOFLAG_READ);
+	std::vector<CTeeHistorianReader::CIndexEntry> vEntries;
+	if(IndexFile)
+	{
+		if(!CTeeHistorianReader::ReadIndex(IndexFile, &vEntries))
+		{
+			dbg_msg("teehistorian_scan", "ignoring broken index '%s'", aIndexFilename);
+			vEntries.clear();
+		}
+		io_close(IndexFile);
+	}
+	for(int i = 0; i < (int)vEntries.size(); i++)
+	{
+		CSegment Segment;
+		Segment.m_Offset = vEntries[i].m_Offset;
+		Segment.m_Size = (i + 1 < (int)vEntries.size() ? vEntries[i + 1].m_Offset : FileSize) - Segment.m_Offset;
+		Segment.m_Tick = vEntries[i].m_Tick;
+		if(Segment.m_Offset < Scan.m_Header.m_Size || Segment.m_Size <= 0)
+		{
+			dbg_msg("teehistorian_scan", "ignoring broken index '%s'", aIndexFilename);
+			Scan.m_vSegments.clear();
+			break;
+		}
+		Scan.m_vSegments.push_back(Segment);
+	}
+	if(Scan.m_vSegments.empty())
+	{
+		// without an index, everything is decoded in one piece
+		CSegment Segment;
+		Segment.m_Offset = Scan.m_Header.m_Size;
+		Segment.m_Size = FileSize - Scan.m_Header.m_Size;
+		Segment.m_Tick = -1;
+		Scan.m_vSegments.push_back(Segment);
+	}
+
+	return All ? ScanAll(&Scan, NumThreads) : ShowTick(&Scan, Tick);
+}